@@ -18,20 +18,129 @@ typedef struct {
 } NavNode;
 
 typedef struct {
+	// Precomputed distance between nodes
+	float length;
+
 	u16 id_A;
 	u16 id_B;
 
 } NavEdge;
 
+#define NAV_CLUSTER_SIZE		512.0f
+#define NAV_NULL_ENTRANCE		0xFFFF
+
+typedef struct {
+	float cost;
+	u16 to;
+
+} NavAbstractEdge;
+
+// * NOTE:
+// Cluster abstraction of a nav graph for hierarchical search.
+// Nodes are grouped by a uniform grid, nodes with an edge leaving their cluster are entrances.
+// Abstract graph links entrances: along graph edges between clusters, 
+// and to every entrance of the same cluster with the cost of the path inside it
+typedef struct {
+	u16 *node_cluster;
+	u16 *node_entrance;
+
+	// Entrance graph nodes grouped by cluster, cluster i owns [cluster_first[i], cluster_first[i + 1])
+	u16 *entrances;
+	u32 *cluster_first;
+
+	// Abstract edges of entrance i are [edge_first[i], edge_first[i + 1])
+	NavAbstractEdge *edges;
+	u32 *edge_first;
+
+	// Query scratch, costs from start and goal to the entrances of their clusters
+	float *start_cost;
+	float *goal_cost;
+
+	u32 edge_count;
+
+	u16 cluster_count;
+	u16 entrance_count;
+	u16 max_cluster_entrances;
+
+} NavClusters;
+
+// Node lookup grid cell size, one cell covers the usual node search radius
+#define NAV_INDEX_CELL 64.0f
+
+// Uniform grid over node positions, cells are hashed into a power of two bucket count.
+// Bucket i holds node ids [bucket_first[i], bucket_first[i + 1]), a bucket can mix cells
+typedef struct {
+	u32 *bucket_first;
+	u16 *ids;
+
+	u32 bucket_mask;
+
+} NavIndex;
+
 typedef struct {
 	NavNode *nodes;
 	NavEdge *edges;
 
+	NavClusters *clusters;
+	NavIndex *index;
+
 	u16 node_count, node_cap;
 	u16 edge_count, edge_cap;
 
 } NavGraph;
 
+// * NOTE:
+// Navmesh generated from level collision tris.
+// Tris are voxelized into a heightfield, spans with a walkable floor and enough headroom
+// are connected into regions, then each tile greedily packs regions into axis aligned rects.
+// Rects are the nav polygons, shared boundaries between them become portal links
+
+#define NAVMESH_CELL_SIZE		8.0f	// Voxel width and depth
+#define NAVMESH_CELL_HEIGHT		4.0f	// Voxel height
+#define NAVMESH_TILE_CELLS		32		// Tile width in cells, tiles are built on separate threads
+#define NAVMESH_NULL_POLY		0xFFFF
+#define NAVMESH_MAX_CORRIDOR	256		// Max polys walked by a path query
+
+typedef struct {
+	// Counter-clockwise from above, starting at min corner
+	Vector3 verts[4];
+	Vector3 center;
+
+	u32 first_link;
+	u16 link_count;
+
+	u16 region;
+
+} NavPoly;
+
+// Portal into a neighbouring poly,
+// left and right are as seen when leaving the owning poly
+typedef struct {
+	Vector3 left;
+	Vector3 right;
+
+	u16 poly;
+
+} NavLink;
+
+typedef struct {
+	NavPoly *polys;
+	NavLink *links;
+
+	// Polys are grouped by tile, tile i owns [tile_first[i], tile_first[i + 1])
+	u32 *tile_first;
+
+	Vector3 origin;
+	float tile_size;
+
+	u32 link_count;
+	u16 poly_count;
+
+	u16 tiles_x, tiles_y;
+	u16 region_count;
+
+} NavMesh;
+
 #define MAX_PATH_NODES 64
 typedef struct {
 	u16 nodes[MAX_PATH_NODES];
@@ -42,6 +151,42 @@ typedef struct {
 
 } NavPath;
 
+// * NOTE:
+// Line of sight between node pairs, used to string-pull paths.
+// Open addressed on graph and node pair, an entry is only valid while its stamp matches the generation
+// so bumping the generation drops every cached result at once
+#define NAV_LOS_CACHE_SIZE		4096
+#define NAV_LOS_CACHE_PROBES	8
+
+typedef struct {
+	u64 key;
+	u32 stamp;
+
+	bool visible;
+
+} NavLosEntry;
+
+typedef struct {
+	NavLosEntry *entries;
+	u32 generation;
+
+	u32 hits;
+	u32 misses;
+
+} NavLosCache;
+
+// Waypoints of an abstract path, NavPath holds the refined nodes up to nodes[curr].
+// If the abstract path is longer than the route it's planned again from the last waypoint
+#define NAV_MAX_ROUTE 32
+typedef struct {
+	u16 nodes[NAV_MAX_ROUTE];
+	u16 goal;
+
+	u8 count;
+	u8 curr;
+
+} NavRoute;
+
 // ** Input mask definitions ** //
 //
 #define AI_INPUT_SEE_PLAYER		0x0001
@@ -91,6 +236,7 @@ enum AI_TASKS : u8 {
 
 typedef struct {
 	NavPath path;
+	NavRoute route;
 
 	Vector3 target_position;
 	Vector3 known_target_position;
@@ -102,7 +248,12 @@ typedef struct {
 
 	u32 interrupt_mask;
 
-	i16 target_entity;
+	u32 target_entity;	// Entity handle, 0 if there's none
+
+	// Queued path search, see NavQueue.
+	// path_status mirrors NAV_SEARCH_STATUS, FOUND/FAILED stay set until a schedule consumes them
+	u32 path_request;
+	u8 path_status;
 
 	bool path_set;
 
@@ -0,0 +1,310 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <time.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "bench.h"
+#include "geo.h"
+#include "map.h"
+
+// Clip hull 1 is the standard player box, not centered on its origin
+#define BENCH_HULL1_MINS	(Vector3) { -16, -16, -24 }
+#define BENCH_HULL1_MAXS	(Vector3) {  16,  16,  32 }
+
+// Disagreements printed per test, the rest are only counted
+#define BENCH_PRINT_DISAGREE 4
+
+// Tries to find a start point outside solid before taking whatever came last
+#define BENCH_START_TRIES 64
+
+typedef struct {
+	Vector3 start;
+	Vector3 dir;
+	float dist;
+
+} BenchQuery;
+
+u32 bench_rng;
+
+// xorshift32, same sequence everywhere unlike rand()
+float BenchRandom() {
+	bench_rng ^= bench_rng << 13;
+	bench_rng ^= bench_rng >> 17;
+	bench_rng ^= bench_rng << 5;
+
+	return (bench_rng >> 8) * (1.0f / 16777216.0f);
+}
+
+Vector3 BenchPointInBox(BoundingBox box) {
+	return (Vector3) {
+		Lerp(box.min.x, box.max.x, BenchRandom()),
+		Lerp(box.min.y, box.max.y, BenchRandom()),
+		Lerp(box.min.z, box.max.z, BenchRandom())
+	};
+}
+
+Vector3 BenchDirection() {
+	for(;;) {
+		Vector3 v = (Vector3) { BenchRandom() * 2 - 1, BenchRandom() * 2 - 1, BenchRandom() * 2 - 1 };
+		float len_sq = Vector3LengthSqr(v);
+
+		if(len_sq > 0.0001f && len_sq <= 1)
+			return Vector3Scale(v, 1.0f / sqrtf(len_sq));
+	}
+}
+
+// Random queries starting in open space of a clip hull, offset moves hull origin to the query start
+void BenchMakeQueries(BenchQuery *queries, u32 count, BoundingBox bounds, Bsp_Hull *hull, Vector3 offset) {
+	for(u32 i = 0; i < count; i++) {
+		Vector3 start = BenchPointInBox(bounds);
+
+		for(u8 j = 0; j < BENCH_START_TRIES; j++) {
+			if(Bsp_PointContents(hull, hull->first_node, Vector3Add(start, offset)) != CONTENTS_SOLID)
+				break;
+
+			start = BenchPointInBox(bounds);
+		}
+
+		queries[i] = (BenchQuery) {
+			.start = start,
+			.dir = BenchDirection(),
+			.dist = BENCH_MAX_DIST * (0.05f + 0.95f * BenchRandom())
+		};
+	}
+}
+
+double BenchNow() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+double bench_start;
+
+void BenchBegin() {
+	coll_stats = (CollisionStats) {0};
+	bench_start = BenchNow();
+}
+
+void BenchEnd(char *name, u32 count, u32 hits) {
+	double ns = (BenchNow() - bench_start) * 1e9 / count;
+
+#ifdef COLLISION_STATS
+	printf("%-24s %10.1f %10.1f %10.1f %8u\n", name, ns, (double)coll_stats.nodes / count, (double)coll_stats.prims / count, hits);
+#else
+	printf("%-24s %10.1f %10s %10s %8u\n", name, ns, "-", "-", hits);
+#endif
+}
+
+// Hit distances are negative for a miss.
+// Outside the brushes the bsp is solid void, hits out there have nothing to compare against
+u32 BenchCompare(char *name, BenchQuery *queries, float *bvh_dists, float *bsp_dists, u32 count, BoundingBox bounds) {
+	u32 disagree = 0;
+
+	bounds.min = Vector3SubtractValue(bounds.min, BENCH_DIST_TOLERANCE);
+	bounds.max = Vector3AddValue(bounds.max, BENCH_DIST_TOLERANCE);
+
+	for(u32 i = 0; i < count; i++) {
+		bool bvh_hit = (bvh_dists[i] >= 0);
+		bool bsp_hit = (bsp_dists[i] >= 0);
+
+		if(bsp_hit && !bvh_hit) {
+			Vector3 bsp_point = Vector3Add(queries[i].start, Vector3Scale(queries[i].dir, bsp_dists[i]));
+			if(!CheckCollisionBoxSphere(bounds, bsp_point, 0))
+				continue;
+		}
+
+		bool same = (bvh_hit == bsp_hit);
+		if(same && bvh_hit)
+			same = (fabsf(bvh_dists[i] - bsp_dists[i]) <= BENCH_DIST_TOLERANCE);
+
+		if(same)
+			continue;
+
+		if(disagree++ < BENCH_PRINT_DISAGREE) {
+			BenchQuery *q = &queries[i];
+			printf("  %s #%u: start { %.2f, %.2f, %.2f }, dir { %.3f, %.3f, %.3f }, dist %.2f, bvh %.2f, bsp %.2f\n",
+				name, i, q->start.x, q->start.y, q->start.z, q->dir.x, q->dir.y, q->dir.z, q->dist, bvh_dists[i], bsp_dists[i]);
+		}
+	}
+
+	printf("%s: %u of %u disagree\n", name, disagree, count);
+	return disagree;
+}
+
+int BenchCollision(char *map_dir, u32 query_count) {
+	if(!DirectoryExists(map_dir)) {
+		printf("ERROR: Missing directory %s\n", map_dir);
+		return 1;
+	}
+
+	if(query_count == 0)
+		query_count = BENCH_QUERY_COUNT;
+
+	FilePathList path_list = LoadDirectoryFiles(map_dir);
+
+	short map_id = -1, bsp_id = -1;
+	for(short i = 0; i < path_list.count; i++) {
+		if(strcmp(GetFileExtension(path_list.paths[i]), ".map") == 0) map_id = i;
+		if(strcmp(GetFileExtension(path_list.paths[i]), ".bsp") == 0) bsp_id = i;
+	}
+
+	if(map_id == -1 || bsp_id == -1) {
+		printf("ERROR: %s needs both a .map and a .bsp\n", map_dir);
+		UnloadDirectoryFiles(path_list);
+		return 1;
+	}
+
+	// Big struct, kept off the stack
+	static MapSection sect;
+	sect = (MapSection) {0};
+
+	// Model is only passed through, collision comes from the .map brushes
+	Model model = (Model) {0};
+	SpawnList spawn_list;
+	BuildMapCollision(&sect, path_list.paths[map_id], &model, &spawn_list);
+	free(spawn_list.arr);
+
+	sect.bsp_data = LoadBspCollision(path_list.paths[bsp_id]);
+	UnloadDirectoryFiles(path_list);
+
+	if(sect.bsp_data.num_models == 0) {
+		MapSectionClose(&sect);
+		return 1;
+	}
+
+	for(short i = 0; i < 4; i++)
+		sect.bsp[i] = Bsp_BuildHull(&sect.bsp_data, i);
+
+	// Bsp world bounds are padded out past the brushes, queries stay inside the BVH root instead
+	BoundingBox bounds = sect.bvh[BVH_POINT].nodes[0].bounds;
+
+	// Box sweeps use hull 1's box, centered where the hull's origin sits
+	BoundingBox box = (BoundingBox) { BENCH_HULL1_MINS, BENCH_HULL1_MAXS };
+	Vector3 box_offset = Vector3Negate(BoxCenter(box));
+	box.min = Vector3Add(box.min, box_offset);
+	box.max = Vector3Add(box.max, box_offset);
+
+	BenchQuery *rays = malloc(sizeof(BenchQuery) * query_count);
+	BenchQuery *sweeps = malloc(sizeof(BenchQuery) * query_count);
+	Vector3 *points = malloc(sizeof(Vector3) * query_count);
+
+	float *bvh_dists = malloc(sizeof(float) * query_count);
+	float *bsp_dists = malloc(sizeof(float) * query_count);
+	int *contents = malloc(sizeof(int) * query_count);
+
+	bench_rng = BENCH_SEED;
+	BenchMakeQueries(rays, query_count, bounds, &sect.bsp[0], Vector3Zero());
+	BenchMakeQueries(sweeps, query_count, bounds, &sect.bsp[1], box_offset);
+	for(u32 i = 0; i < query_count; i++)
+		points[i] = BenchPointInBox(bounds);
+
+	printf("\ncollision bench: %s, %u queries per test, seed 0x%08X\n", map_dir, query_count, BENCH_SEED);
+	printf("%-24s %10s %10s %10s %8s\n", "test", "ns/query", "nodes", "prims", "hits");
+
+	u32 hits = 0;
+
+	// Rays, point BVH against point hull
+	BenchBegin();
+	for(u32 i = 0; i < query_count; i++) {
+		BvhTraceData tr = TraceDataEmpty();
+		BvhTracePointEx((Ray) { rays[i].start, rays[i].dir }, &sect, &sect.bvh[BVH_POINT], 0, &tr, rays[i].dist);
+
+		bvh_dists[i] = (tr.hit) ? tr.distance : -1;
+		hits += tr.hit;
+	}
+	BenchEnd("BvhTracePointEx", query_count, hits);
+
+	hits = 0;
+	BenchBegin();
+	for(u32 i = 0; i < query_count; i++) {
+		Vector3 end = Vector3Add(rays[i].start, Vector3Scale(rays[i].dir, rays[i].dist));
+
+		Bsp_TraceData tr = Bsp_TraceDataEmpty();
+		Bsp_RecursiveTraceEx(&sect.bsp[0], sect.bsp[0].first_node, 0, 1, rays[i].start, end, &tr);
+
+		bsp_dists[i] = (tr.fraction < 1) ? tr.fraction * rays[i].dist : -1;
+		hits += (tr.fraction < 1);
+	}
+	BenchEnd("Bsp_RecursiveTraceEx h0", query_count, hits);
+
+	u32 ray_disagree = BenchCompare("rays", rays, bvh_dists, bsp_dists, query_count, bounds);
+	printf("\n");
+
+	// Box sweeps, box against point BVH and the same box as clip hull 1
+	hits = 0;
+	BenchBegin();
+	for(u32 i = 0; i < query_count; i++) {
+		BvhTraceData tr = TraceDataEmpty();
+		tr.distance = sweeps[i].dist;
+		BvhBoxSweep((Ray) { sweeps[i].start, sweeps[i].dir }, &sect, &sect.bvh[BVH_POINT], 0, box, &tr);
+
+		bvh_dists[i] = (tr.hit) ? fmaxf(tr.contact_dist, 0) : -1;
+		hits += tr.hit;
+	}
+	BenchEnd("BvhBoxSweep", query_count, hits);
+
+	hits = 0;
+	BenchBegin();
+	for(u32 i = 0; i < query_count; i++) {
+		Vector3 start = Vector3Add(sweeps[i].start, box_offset);
+		Vector3 end = Vector3Add(start, Vector3Scale(sweeps[i].dir, sweeps[i].dist));
+
+		Bsp_TraceData tr = Bsp_TraceDataEmpty();
+		Bsp_RecursiveTraceEx(&sect.bsp[1], sect.bsp[1].first_node, 0, 1, start, end, &tr);
+
+		bsp_dists[i] = (tr.fraction < 1) ? tr.fraction * sweeps[i].dist : -1;
+		hits += (tr.fraction < 1);
+	}
+	BenchEnd("Bsp_RecursiveTraceEx h1", query_count, hits);
+
+	u32 sweep_disagree = BenchCompare("box sweeps", sweeps, bvh_dists, bsp_dists, query_count, bounds);
+	printf("\n");
+
+	// Point contents, checked against the brushes the BVH was built from
+	hits = 0;
+	BenchBegin();
+	for(u32 i = 0; i < query_count; i++) {
+		contents[i] = Bsp_PointContents(&sect.bsp[0], sect.bsp[0].first_node, points[i]);
+		hits += (contents[i] == CONTENTS_SOLID);
+	}
+	BenchEnd("Bsp_PointContents h0", query_count, hits);
+
+	// Outside the map is solid to the bsp but not inside any brush, so only empty points are checked
+	u32 point_disagree = 0;
+	for(u32 i = 0; i < query_count; i++) {
+		if(contents[i] != CONTENTS_EMPTY)
+			continue;
+
+		HullPool *hulls = &sect._hulls[0];
+		for(u16 j = 0; j < hulls->count; j++) {
+			// Brushes without planes didn't convert, those contain everything
+			if(hulls->arr[j].plane_count == 0 || !IsPointInHull(points[i], &hulls->arr[j]))
+				continue;
+
+			if(point_disagree++ < BENCH_PRINT_DISAGREE)
+				printf("  points #%u: { %.2f, %.2f, %.2f } empty in bsp, inside brush %d\n", i, points[i].x, points[i].y, points[i].z, j);
+
+			break;
+		}
+	}
+	printf("points: %u of %u disagree\n", point_disagree, query_count);
+
+	printf("\ntotal disagreements: %u\n", ray_disagree + sweep_disagree + point_disagree);
+
+	free(rays);
+	free(sweeps);
+	free(points);
+	free(bvh_dists);
+	free(bsp_dists);
+	free(contents);
+
+	MapSectionClose(&sect);
+
+	return 0;
+}
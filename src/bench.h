@@ -0,0 +1,24 @@
+#include "../include/num_redefs.h"
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#define BENCH_QUERY_COUNT	20000
+#define BENCH_SEED			0x2545F491
+
+// Longest generated ray or sweep
+#define BENCH_MAX_DIST		1024
+
+// BVH and clip hull hit distances further apart than this count as a disagreement
+#define BENCH_DIST_TOLERANCE	1.0f
+
+// * NOTE:
+// Loads collision of a map directory without a window (BVHs from the .map, clip hulls from the .bsp)
+// and times batches of random queries against both: rays, box sweeps and point contents.
+// Queries come from a fixed seed so runs on the same map are comparable.
+// Prints ns per query and, in builds with -DCOLLISION_STATS, nodes visited and primitives tested per query.
+// BVH and clip hull results are cross checked and disagreements are counted, with a few printed.
+// Returns 0 if the map loaded
+int BenchCollision(char *map_dir, u32 query_count);
+
+#endif
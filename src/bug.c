@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <float.h>
+#include <string.h>
 #include "raylib.h"
 #include "raymath.h"
 #include "ent.h"
@@ -23,6 +24,47 @@ bool bug_target_picked = false;
 
 float bug_z_vel_prev = 0;
 
+// Globals carried in world snapshots
+typedef struct {
+	float launch_timer;
+	float cooldown;
+	float z_vel_prev;
+
+	u8 bounce;
+	bool big_bounce_used;
+	bool target_picked;
+
+} BugState;
+
+u32 BugStateSize() {
+	return sizeof(BugState);
+}
+
+void BugStateSave(void *out) {
+	BugState state = {
+		.launch_timer = launch_timer,
+		.cooldown = bug_cooldown,
+		.z_vel_prev = bug_z_vel_prev,
+		.bounce = bug_bounce,
+		.big_bounce_used = big_bounce_used,
+		.target_picked = bug_target_picked
+	};
+
+	memcpy(out, &state, sizeof(BugState));
+}
+
+void BugStateLoad(void *in) {
+	BugState state;
+	memcpy(&state, in, sizeof(BugState));
+
+	launch_timer = state.launch_timer;
+	bug_cooldown = state.cooldown;
+	bug_z_vel_prev = state.z_vel_prev;
+	bug_bounce = state.bounce;
+	big_bounce_used = state.big_bounce_used;
+	bug_target_picked = state.target_picked;
+}
+
 // This function handles setting Bug's target as well as moving towards it. 
 void BugBounce(Entity *bug_ent, comp_Transform *ct, MapSection *sect, EntityHandler *handler, u8 *bounce, float dt) {
 	EntGrid *grid = &handler->grid;
@@ -45,18 +87,17 @@ void BugBounce(Entity *bug_ent, comp_Transform *ct, MapSection *sect, EntityHand
 		short adj_count = sizeof(cell_coords) / sizeof(cell_coords[0]);
 		
 		float closest = FLT_MAX;
-		i16 enemy_id = -1;
+		EntHandle enemy = ENT_NULL_HANDLE;
 
 		for(u8 j = 0; j < adj_count; j++) {
-			if(!CoordsInBounds(cell_coords[j], grid))
+			EntGridCell *cell = EntGridFind(grid, cell_coords[j]);
+			if(!cell)
 				continue;
 
-			i16 cell_id = CellCoordsToId(cell_coords[j], grid);
-			EntGridCell *cell = &grid->cells[cell_id];
-
-			for(u8 i = 0; i < cell->ent_count; i++) {
-				Entity *enemy_ent = &handler->ents[cell->ents[i]];
-				comp_Ai *enemy_ai = &enemy_ent->comp_ai;
+			u16 *cell_ents = EntGridCellEnts(grid, cell);
+			for(u16 i = 0; i < cell->ent_count; i++) {
+				Entity *enemy_ent = &handler->ents[cell_ents[i]];
+				comp_Ai *enemy_ai = enemy_ent->comp_ai;
 
 				// **
 				// Skip things that are not valid targets
@@ -83,13 +124,13 @@ void BugBounce(Entity *bug_ent, comp_Transform *ct, MapSection *sect, EntityHand
 				/*
 				Vector3 to_enemy = Vector3Subtract(
 					Vector3Add(
-						Vector3Add(enemy_ent->comp_transform.position, enemy_ent->comp_health.bug_point),
-						Vector3Scale(enemy_ent->comp_transform.velocity, 1)),
+						Vector3Add(enemy_ent->comp_transform->position, enemy_ent->comp_health->bug_point),
+						Vector3Scale(enemy_ent->comp_transform->velocity, 1)),
 					ct->position
 				);	
 				*/
 				Vector3 to_enemy = Vector3Subtract(
-					Vector3Add(enemy_ent->comp_transform.position, enemy_ent->comp_health.bug_point),
+					Vector3Add(enemy_ent->comp_transform->position, enemy_ent->comp_health->bug_point),
 					ct->position
 				);	
 
@@ -112,13 +153,13 @@ void BugBounce(Entity *bug_ent, comp_Transform *ct, MapSection *sect, EntityHand
 				// Set target to closest candidate
 				if(dist < closest) {
 					closest = dist;
-					enemy_id = enemy_ent->id;
+					enemy = EntHandleOf(handler, enemy_ent->id);
 					bug_target_picked = true;
 				}
 			}
 		}
 
-		bug_ent->comp_ai.task_data.target_entity = enemy_id;
+		bug_ent->comp_ai->task_data.target_entity = enemy;
 	} 
 
 	// Increment bounce count
@@ -137,19 +178,25 @@ void BugBounce(Entity *bug_ent, comp_Transform *ct, MapSection *sect, EntityHand
 	if(!bug_target_picked) 
 		return;
 
-	Entity *enemy_ent = &handler->ents[bug_ent->comp_ai.task_data.target_entity];
-	if(enemy_ent->comp_ai.state == STATE_DEAD) {
+	Entity *enemy_ent = EntGet(handler, bug_ent->comp_ai->task_data.target_entity);
+	if(!enemy_ent) {
+		bug_target_picked = false;
+		*bounce = 0;
+		return;
+	}
+
+	if(enemy_ent->comp_ai->state == STATE_DEAD) {
 		bug_target_picked = false;
-		bug_ent->comp_ai.task_data.target_entity = -1;
+		bug_ent->comp_ai->task_data.target_entity = ENT_NULL_HANDLE;
 		*bounce = 0;
 	}
 
-	Vector3 to_enemy = Vector3Subtract( enemy_ent->comp_transform.position, ct->position );	
+	Vector3 to_enemy = Vector3Subtract( enemy_ent->comp_transform->position, ct->position );	
 	float d = Vector3Length(to_enemy);
 	to_enemy.z = 0;
 	to_enemy = Vector3Normalize(to_enemy);
 
-	if(d > 100 && (fabsf(enemy_ent->comp_transform.position.z - ct->position.z) <= 48)) {
+	if(d > 100 && (fabsf(enemy_ent->comp_transform->position.z - ct->position.z) <= 48)) {
 		ct->velocity.x = to_enemy.x * d * (1.2f + (GetRandomValue(0, 5) * 0.1f));	
 		ct->velocity.y = to_enemy.y * d * (1.2f + (GetRandomValue(0, 5) * 0.1f));	
 	} else {
@@ -168,7 +215,7 @@ void BugBounce(Entity *bug_ent, comp_Transform *ct, MapSection *sect, EntityHand
 			}
 		} else {
 			ct->velocity.z += 100.0f + (1.15f*(*bounce));
-			if(enemy_ent->comp_transform.position.z > ct->position.z + 64.0f) {
+			if(enemy_ent->comp_transform->position.z > ct->position.z + 64.0f) {
 				ct->velocity.z += 300.0f;
 			}
 		}
@@ -177,7 +224,7 @@ void BugBounce(Entity *bug_ent, comp_Transform *ct, MapSection *sect, EntityHand
 	// Forgiveness,
 	// feels very bad when bug doesn't hit and lands super close to enemy
 	if(d <= 128 && *bounce >= BUG_MAX_BOUNCES ) {
-		bug_ent->comp_ai.state = BUG_LAUNCHED;
+		bug_ent->comp_ai->state = BUG_LAUNCHED;
 		ct->velocity.z += 100.0f;
 		(*bounce)--;
 	}
@@ -200,9 +247,9 @@ u8 bug_CheckGround(Entity *ent, comp_Transform *ct, Vector3 position, MapSection
 		return 0;
 	}
 
-	if(handler->ents[handler->player_id].comp_transform.position.z - ct->position.z > 700.0f && launch_timer <= 0) {
-		ent->comp_health.amount = 0;
-		ent->comp_ai.state = STATE_DEAD;
+	if(handler->ents[handler->player_id].comp_transform->position.z - ct->position.z > 700.0f && launch_timer <= 0) {
+		ent->comp_health->amount = 0;
+		ent->comp_ai->state = STATE_DEAD;
 		bug_cooldown = 5;
 		return 0;
 	}
@@ -221,7 +268,7 @@ u8 bug_CheckGround(Entity *ent, comp_Transform *ct, Vector3 position, MapSection
 }
 
 void bug_TraceMove(Entity *bug_ent, Vector3 start, Vector3 wish_vel, pmTraceData *pm, float dt, MapSection *sect, EntityHandler *handler) {
-	comp_Transform *ct = &bug_ent->comp_transform;
+	comp_Transform *ct = bug_ent->comp_transform;
 
 	*pm = (pmTraceData) { .start_in_solid = -1, .end_in_solid = -1, .origin = start, .block = 0 };
 
@@ -262,7 +309,7 @@ void bug_TraceMove(Entity *bug_ent, Vector3 start, Vector3 wish_vel, pmTraceData
 		bool use_ent = (ent_tr.hit_ent > -1 && ent_tr.hit_ent < handler->count && ent_tr.hit_ent != handler->player_id);
 
 		Entity *other_ent = &handler->ents[ent_tr.hit_ent];
-		if(other_ent->comp_ai.state == STATE_DEAD && other_ent->type != ENT_TURRET)
+		if(other_ent->comp_ai->state == STATE_DEAD && other_ent->type != ENT_TURRET)
 			use_ent = false;
 
 		if(use_ent) {
@@ -311,31 +358,33 @@ void bug_TraceMove(Entity *bug_ent, Vector3 start, Vector3 wish_vel, pmTraceData
 }
 
 void BugInit(Entity *ent, EntityHandler *handler, MapSection *sect) {
-	ent->model = LoadModel("resources/models/weapons/bug_00.glb");
+	ent->comp_render->model = LoadModel("resources/models/weapons/bug_00.glb");
 	model_dead = LoadModel("resources/models/weapons/bug_dead_00.glb");
 
-	//ent->model.transform = MatrixRotateZ(90*DEG2RAD);
+	//ent->comp_render->model.transform = MatrixRotateZ(90*DEG2RAD);
 	//model_dead.transform = MatrixRotateZ(90*DEG2RAD);
 
-	ent->comp_transform.bounds = (BoundingBox) {
+	ent->comp_transform->bounds = (BoundingBox) {
 		.min = (Vector3) { -4, -4, -4 },
 		.max = (Vector3) {  4,  4,  4 }
 	};
 
-	ent->comp_ai.component_valid = false;
-	ent->comp_ai.task_data.target_entity = -1;
-	ent->comp_ai.state = 0;
+	ent->comp_ai->component_valid = false;
+	ent->comp_ai->task_data.target_entity = ENT_NULL_HANDLE;
+	ent->comp_ai->state = 0;
 }
 
 void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt) {
 	Entity *player_ent = &handler->ents[handler->player_id];
 
-	comp_Transform *ct = &ent->comp_transform;
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Transform *ct = ent->comp_transform;
+	comp_Ai *ai = ent->comp_ai;
 
 	EntGrid *grid = &handler->grid;
-	Coords coords = Vec3ToCoords(ct->position, grid);
-	if(!CoordsInBounds(coords, grid))
+
+	// Flew out of the level
+	BoundingBox world_bounds = sect->bvh[BVH_POINT].nodes[0].bounds;
+	if(!CheckCollisionBoxes(world_bounds, (BoundingBox) { ct->position, ct->position }))
 		ai->state = STATE_DEAD;
 
 	bug_z_vel_prev = ct->velocity.z;
@@ -343,7 +392,7 @@ void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt)
 	//ent->cell_id = CellCoordsToId(Vec3ToCoords(ct->position, &handler->grid), &handler->grid);
 
 	if(ai->state == BUG_DEFAULT) {
-		ct->position = player_ent->comp_transform.position;
+		ct->position = player_ent->comp_transform->position;
 		ct->velocity = Vector3Zero();
 
 		ent->flags &= ~ENT_COLLIDERS;	
@@ -357,13 +406,14 @@ void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt)
 
 		bug_cooldown = 10;
 
-		ent->comp_health.amount = 100;
+		ent->comp_health->amount = 100;
 
 		bug_target_picked = false;
-		ent->comp_ai.task_data.target_entity = -1;
+		ent->comp_ai->task_data.target_entity = ENT_NULL_HANDLE;
 	}
 
 	ct->bounds = BoxTranslate(ct->bounds, ct->position);
+	EntGridMarkDirty(&handler->grid, ent->id);
 
 	// -------------------------------------------------------------------------------------------------------------
 	if(ai->state == BUG_LAUNCHED) {
@@ -386,12 +436,11 @@ void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt)
 		if(launch_timer <= 0)
 			ct->velocity = Vector3ClampValue(ct->velocity, -BUG_MAX_VEL, BUG_MAX_VEL);
 
-		EntGrid *grid = &handler->grid;
-		Coords coords = Vec3ToCoords(ct->position, grid);
-		i16 cell_id = CellCoordsToId(coords, grid);
-		EntGridCell *cell = &grid->cells[cell_id];
-		for(u8 i = 0; i < cell->ent_count; i++) {
-			Entity *enemy_ent = &handler->ents[cell->ents[i]];
+		u16 near_ents[MAX_ENTS_PER_QUERY];
+		u16 near_count = EntGridQueryBox(&handler->grid, ct->bounds, near_ents, MAX_ENTS_PER_QUERY);
+
+		for(u16 i = 0; i < near_count; i++) {
+			Entity *enemy_ent = &handler->ents[near_ents[i]];
 
 			if(enemy_ent->type == ENT_PLAYER)
 				continue;
@@ -399,23 +448,23 @@ void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt)
 			if(enemy_ent->type == ENT_DISRUPTOR)
 				continue;
 
-			if(enemy_ent->comp_ai.input_mask & AI_INPUT_SELF_GLITCHED)
+			if(enemy_ent->comp_ai->input_mask & AI_INPUT_SELF_GLITCHED)
 				continue;
 
-			if(enemy_ent->comp_ai.state == STATE_DEAD)
+			if(enemy_ent->comp_ai->state == STATE_DEAD)
 				continue;
 
-			bool height_check = (ct->position.z >= enemy_ent->comp_transform.position.z - 16);
+			bool height_check = (ct->position.z >= enemy_ent->comp_transform->position.z - 16);
 			if(bug_bounce == 0) {
 				height_check = true;
 			}
 
-			if(CheckCollisionBoxes(ct->bounds, enemy_ent->comp_transform.bounds) && height_check) {
+			if(CheckCollisionBoxes(ct->bounds, enemy_ent->comp_transform->bounds) && height_check) {
 				ct->on_ground = true;
-				ct->position = BoxCenter(enemy_ent->comp_health.bug_box);
-				ai->task_data.target_entity = enemy_ent->id;
-				ct->forward = enemy_ent->comp_transform.forward;
-				ent->comp_health.damage_cooldown = 10;
+				ct->position = BoxCenter(enemy_ent->comp_health->bug_box);
+				ai->task_data.target_entity = EntHandleOf(handler, enemy_ent->id);
+				ct->forward = enemy_ent->comp_transform->forward;
+				ent->comp_health->damage_cooldown = 10;
 				ct->velocity = Vector3Zero();
 
 				break;
@@ -427,7 +476,7 @@ void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt)
 				// Works in most cases
 				Vector3 hvel = (Vector3) { ct->velocity.x, ct->velocity.y, 0 };
 				Vector3 self_xy = (Vector3) { ct->position.x, ct->position.y, 0 }; 
-				Vector3 targ_xy = (Vector3) { enemy_ent->comp_transform.position.x, enemy_ent->comp_transform.position.y, 0 }; 
+				Vector3 targ_xy = (Vector3) { enemy_ent->comp_transform->position.x, enemy_ent->comp_transform->position.y, 0 }; 
 				if(Vector3Distance(self_xy, targ_xy) <= 18.0f && height_check) {
 					Vector3 to_targ = Vector3Subtract(targ_xy, self_xy);
 
@@ -457,11 +506,11 @@ void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt)
 		
 		// Check if there is an enemy to disrupt
 		if(!(ent->flags & BUG_DISRUPTED_ENEMY)) {
-			i16 cell_id = CellCoordsToId(coords, grid);
-			EntGridCell *cell = &grid->cells[cell_id];
+			u16 near_ents[MAX_ENTS_PER_QUERY];
+			u16 near_count = EntGridQueryBox(grid, ct->bounds, near_ents, MAX_ENTS_PER_QUERY);
 
-			for(u8 i = 0; i < cell->ent_count; i++) {
-				Entity *enemy_ent = &handler->ents[cell->ents[i]];
+			for(u16 i = 0; i < near_count; i++) {
+				Entity *enemy_ent = &handler->ents[near_ents[i]];
 
 				if(enemy_ent->type == ENT_PLAYER)
 					continue;
@@ -469,10 +518,10 @@ void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt)
 				if(enemy_ent->type == ENT_DISRUPTOR)
 					continue;
 
-				if(!enemy_ent->comp_ai.component_valid)
+				if(!enemy_ent->comp_ai->component_valid)
 					continue;
 
-				if(!CheckCollisionBoxes(ct->bounds, enemy_ent->comp_transform.bounds))
+				if(!CheckCollisionBoxes(ct->bounds, enemy_ent->comp_transform->bounds))
 					continue;
 
 				DisruptEntity(handler, enemy_ent->id, sect);	
@@ -480,15 +529,14 @@ void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt)
 			}
 		}
 
-		if((ent->flags & BUG_DISRUPTED_ENEMY) && ai->task_data.target_entity > -1 && ai->task_data.target_entity < handler->count
-		   && !(ent->flags & BUG_RECALL)) {
-			Entity *stick_ent = &handler->ents[ai->task_data.target_entity];			
-			ct->position = Vector3Add(stick_ent->comp_transform.position, stick_ent->comp_health.bug_point);
+		Entity *stick_ent = EntGet(handler, ai->task_data.target_entity);
+		if((ent->flags & BUG_DISRUPTED_ENEMY) && stick_ent && !(ent->flags & BUG_RECALL)) {
+			ct->position = Vector3Add(stick_ent->comp_transform->position, stick_ent->comp_health->bug_point);
 
 			// Bounce off enemy when it dies
-			if(stick_ent->comp_ai.state == STATE_DEAD) {
+			if(stick_ent->comp_ai->state == STATE_DEAD) {
 				ai->state = BUG_LAUNCHED;
-				ai->task_data.target_entity = -1;
+				ai->task_data.target_entity = ENT_NULL_HANDLE;
 
 				ent->flags &= ~BUG_DISRUPTED_ENEMY;
 				bug_bounce = 0;
@@ -496,8 +544,8 @@ void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt)
 
 				BugBounce(ent, ct, sect, handler, &bug_bounce, dt);
 
-				if(ai->task_data.target_entity == -1) {
-					ai->task_data.target_entity = handler->player_id;
+				if(ai->task_data.target_entity == ENT_NULL_HANDLE) {
+					ai->task_data.target_entity = EntHandleOf(handler, handler->player_id);
 					bug_target_picked = true;
 					BugBounce(ent, ct, sect, handler, &bug_bounce, dt);
 				}
@@ -507,25 +555,25 @@ void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt)
 		// * NOTE:
 		// Remove later
 		// This is here for retrieval "puzzle" in alpha build 
-		if((ent->flags & BUG_DISRUPTED_ENEMY) && fabsf(player_ent->comp_transform.position.z - ct->position.z) >= 175.0f) 
+		if((ent->flags & BUG_DISRUPTED_ENEMY) && fabsf(player_ent->comp_transform->position.z - ct->position.z) >= 175.0f) 
 			can_recall = false;
 
 		// Recall
 		if(can_recall) {
-			if(IsMouseButtonPressed(MOUSE_BUTTON_RIGHT)) {
+			if(PlayerGetInput()->actions[ACTION_RECALL].state == INPUT_PRESSED) {
 				bug_bounce = 0;
 				bug_target_picked = true;
 
-				ent->comp_ai.task_data.target_entity = handler->player_id;
+				ent->comp_ai->task_data.target_entity = EntHandleOf(handler, handler->player_id);
 				
-				float dist_add = 80.0f + (Vector3Distance(player_ent->comp_transform.position, ct->position) * 0.1f);
+				float dist_add = 80.0f + (Vector3Distance(player_ent->comp_transform->position, ct->position) * 0.1f);
 				dist_add = Clamp(dist_add, 0, 300);
 				ct->velocity.z += dist_add;
 
-				if(ct->position.z < player_ent->comp_transform.position.z - 32)
+				if(ct->position.z < player_ent->comp_transform->position.z - 32)
 					ct->velocity.z += 150.0f;
 
-				ent->comp_ai.state = BUG_LAUNCHED;
+				ent->comp_ai->state = BUG_LAUNCHED;
 				ent->flags |= BUG_RECALL;
 
 				BugBounce(ent, ct, sect, handler, &bug_bounce, dt);
@@ -539,13 +587,13 @@ void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt)
 	// -------------------------------------------------------------------------------------------------------------
 
 	// Pickup
-	if(CheckCollisionSpheres(ct->position, 8, player_ent->comp_transform.position, 16) && launch_timer <= 0) {
+	if(CheckCollisionSpheres(ct->position, 8, player_ent->comp_transform->position, 16) && launch_timer <= 0) {
 		ai->state = BUG_DEFAULT;
 	}
 
 	if(ai->state == STATE_DEAD) {
 		// Pickup dead
-		if(CheckCollisionBoxes(ct->bounds, player_ent->comp_transform.bounds)) {
+		if(CheckCollisionBoxes(ct->bounds, player_ent->comp_transform->bounds)) {
 			ai->state = BUG_DEFAULT;
 		}
 
@@ -556,30 +604,30 @@ void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt)
 }
 
 void BugDraw(Entity *ent) {
-	if(ent->comp_ai.state == 0)
+	if(ent->comp_ai->state == 0)
 		return;
 
 	if(launch_timer >= 0.4725f)
 		return;
 
-	float angle = atan2f(-ent->comp_transform.forward.x, ent->comp_transform.forward.y);
-	ent->model.transform = MatrixRotateY(angle);
-	ent->model.transform = MatrixMultiply(ent->model.transform, MatrixRotateX(90*DEG2RAD));
+	float angle = atan2f(-ent->comp_transform->forward.x, ent->comp_transform->forward.y);
+	ent->comp_render->model.transform = MatrixRotateY(angle);
+	ent->comp_render->model.transform = MatrixMultiply(ent->comp_render->model.transform, MatrixRotateX(90*DEG2RAD));
 
-	if(ent->comp_ai.state == STATE_DEAD) {
-		model_dead.transform = ent->model.transform;
-		DrawModel(model_dead, ent->comp_transform.position, 3, LIGHTGRAY);	
+	if(ent->comp_ai->state == STATE_DEAD) {
+		model_dead.transform = ent->comp_render->model.transform;
+		DrawModel(model_dead, EntRenderPosition(ent->comp_transform), 3, LIGHTGRAY);	
  	} else {
-		DrawModel(ent->model, ent->comp_transform.position, 3, WHITE);	
+		DrawModel(ent->comp_render->model, EntRenderPosition(ent->comp_transform), 3, WHITE);	
 	}
-	//DrawBoundingBox(ent->comp_transform.bounds, GREEN);
+	//DrawBoundingBox(ent->comp_transform->bounds, GREEN);
 }
 
 void DisruptEntity(EntityHandler *handler, u16 ent_id, MapSection *sect) {
 	//printf("dirsrupted entity [%d]\n", ent_id);
 	Entity *ent = &handler->ents[ent_id];
-	comp_Ai *ai = &ent->comp_ai;	
-	comp_Transform *ct = &ent->comp_transform;
+	comp_Ai *ai = ent->comp_ai;	
+	comp_Transform *ct = ent->comp_transform;
 
 	if(ai->input_mask & AI_INPUT_SELF_GLITCHED)
 		return;
@@ -592,8 +640,8 @@ void DisruptEntity(EntityHandler *handler, u16 ent_id, MapSection *sect) {
 		case ENT_TURRET: {
 			ai->disrupt_timer = 100;
 			ai->task_data.timer = 0;
-			ent->comp_weapon.ammo = 60;
-			ent->comp_weapon.cooldown = 0;
+			ent->comp_weapon->ammo = 60;
+			ent->comp_weapon->cooldown = 0;
 			ai->task_data.task_id = TASK_FIRE_WEAPON;
 
 			ct->forward = ct->start_forward;
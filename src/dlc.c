@@ -0,0 +1,537 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "raylib.h"
+#include "dlc.h"
+#include "../include/log_message.h"
+
+#define FNV_OFFSET 	0xcbf29ce484222325ULL
+#define FNV_PRIME 	0x100000001b3ULL
+
+u64 FnvHash(u64 hash, void *data, u64 size) {
+	u8 *bytes = data;
+
+	for(u64 i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+u64 DlcHashFiles(char **paths, u8 count) {
+	u64 hash = FNV_OFFSET;
+
+	// Layout of cached structs is part of the key
+	u32 layout[] = {
+		DLC_VERSION, sizeof(TriIndex), sizeof(BvhNode), sizeof(Hull), sizeof(HullBvhNode), sizeof(EntSpawn), sizeof(NavNode), sizeof(NavEdge),
+		sizeof(NavAbstractEdge), sizeof(NavPoly), sizeof(NavLink)
+	};
+	hash = FnvHash(hash, layout, sizeof(layout));
+
+	Vector3 volumes[] = { BODY_VOLUME_MEDIUM, BODY_VOLUME_SMALL };
+	hash = FnvHash(hash, volumes, sizeof(volumes));
+
+	// So are the grid sizes nav data was built with
+	float cells[] = { NAV_CLUSTER_SIZE, NAV_INDEX_CELL, NAVMESH_CELL_SIZE, NAVMESH_CELL_HEIGHT, NAVMESH_TILE_CELLS };
+	hash = FnvHash(hash, cells, sizeof(cells));
+
+	for(u8 i = 0; i < count; i++) {
+		if(!paths[i] || !FileExists(paths[i]))
+			continue;
+
+		int size = 0;
+		u8 *data = LoadFileData(paths[i], &size);
+		if(!data)
+			continue;
+
+		hash = FnvHash(hash, data, size);
+		UnloadFileData(data);
+	}
+
+	return hash;
+}
+
+void DlcSetup(MapSection *sect, char *map_path, char *bsp_path) {
+	char *paths[2] = { map_path, bsp_path };
+
+	sect->cache = (LevelCache) {0};
+	sect->cache.hash = DlcHashFiles(paths, 2);
+
+	snprintf(sect->cache.path, sizeof(sect->cache.path), "%s/%s.dlc", GetDirectoryPath(map_path), GetFileNameWithoutExt(map_path));
+}
+
+bool DlcBlockValid(DlcBlock *block, u64 file_size, u64 stride) {
+	if(block->count == 0)
+		return true;
+
+	if(block->stride != stride)
+		return false;
+
+	return (block->offset + (u64)block->count * stride <= file_size);
+}
+
+void *DlcBlockPtr(DlcHeader *header, DlcBlock *block) {
+	if(block->count == 0)
+		return NULL;
+
+	return (u8*)header + block->offset;
+}
+
+// Queries index tiles, polys and links straight from the mapping, so every index is checked once here.
+// Blocks must already have passed DlcBlockValid
+static bool DlcNavMeshValid(DlcHeader *header) {
+	DlcNavMesh *mesh = &header->navmesh;
+
+	u32 poly_count = mesh->polys.count;
+	u32 link_count = mesh->links.count;
+
+	if(!mesh->tile_first.count)
+		return (poly_count == 0 && link_count == 0);
+
+	if(poly_count >= NAVMESH_NULL_POLY || !(mesh->tile_size > 0))
+		return false;
+
+	u32 tile_count = (u32)mesh->tiles_x * mesh->tiles_y;
+	if(mesh->tile_first.count != tile_count + 1)
+		return false;
+
+	u32 *tile_first = DlcBlockPtr(header, &mesh->tile_first);
+	if(tile_first[0] != 0 || tile_first[tile_count] != poly_count)
+		return false;
+
+	for(u32 i = 0; i < tile_count; i++) {
+		if(tile_first[i] > tile_first[i + 1])
+			return false;
+	}
+
+	NavPoly *polys = DlcBlockPtr(header, &mesh->polys);
+	for(u32 i = 0; i < poly_count; i++) {
+		if((u64)polys[i].first_link + polys[i].link_count > link_count)
+			return false;
+	}
+
+	NavLink *links = DlcBlockPtr(header, &mesh->links);
+	for(u32 i = 0; i < link_count; i++) {
+		if(links[i].poly >= poly_count)
+			return false;
+	}
+
+	return true;
+}
+
+bool DlcLoad(MapSection *sect, SpawnList *spawn_list) {
+	LevelCache *cache = &sect->cache;
+
+	int fd = open(cache->path, O_RDONLY);
+	if(fd < 0)
+		return false;
+
+	struct stat st;
+	if(fstat(fd, &st) < 0 || (u64)st.st_size < sizeof(DlcHeader)) {
+		close(fd);
+		return false;
+	}
+
+	// Private mapping, pages are copied on write so runtime code may still modify the data
+	void *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if(base == MAP_FAILED) {
+		MessageError("ERROR: Could not map level cache", cache->path);
+		return false;
+	}
+
+	DlcHeader *header = base;
+	u64 size = st.st_size;
+
+	bool valid = (
+		memcmp(header->magic, DLC_MAGIC, 4) == 0 &&
+		header->version == DLC_VERSION &&
+		header->hash == cache->hash &&
+		header->file_size == size &&
+		header->graph_count <= DLC_MAX_GRAPHS
+	);
+
+	for(short i = 0; i < 3 && valid; i++) {
+		valid &= DlcBlockValid(&header->tris[i], size, sizeof(TriIndex));
+		valid &= DlcBlockValid(&header->tri_verts[i], size, sizeof(Vector3));
+		valid &= DlcBlockValid(&header->tri_planes[i], size, sizeof(Plane));
+		valid &= DlcBlockValid(&header->bvh_ids[i], size, sizeof(u16));
+		valid &= DlcBlockValid(&header->bvh_nodes[i], size, sizeof(BvhNode));
+		valid &= DlcBlockValid(&header->hulls[i], size, sizeof(Hull));
+	}
+
+	valid = valid && DlcBlockValid(&header->hull_nodes, size, sizeof(HullBvhNode));
+	valid = valid && DlcBlockValid(&header->spawns, size, sizeof(EntSpawn));
+	valid = valid && DlcBlockValid(&header->base_graph.nodes, size, sizeof(NavNode));
+	valid = valid && DlcBlockValid(&header->base_graph.edges, size, sizeof(NavEdge));
+
+	for(u32 i = 0; i < header->graph_count && valid; i++) {
+		DlcGraph *graph = &header->graphs[i];
+
+		valid &= DlcBlockValid(&graph->nodes, size, sizeof(NavNode));
+		valid &= DlcBlockValid(&graph->edges, size, sizeof(NavEdge));
+
+		valid &= DlcBlockValid(&graph->node_cluster, size, sizeof(u16));
+		valid &= DlcBlockValid(&graph->node_entrance, size, sizeof(u16));
+		valid &= DlcBlockValid(&graph->entrances, size, sizeof(u16));
+		valid &= DlcBlockValid(&graph->cluster_first, size, sizeof(u32));
+		valid &= DlcBlockValid(&graph->cluster_edges, size, sizeof(NavAbstractEdge));
+		valid &= DlcBlockValid(&graph->edge_first, size, sizeof(u32));
+		valid &= DlcBlockValid(&graph->bucket_first, size, sizeof(u32));
+		valid &= DlcBlockValid(&graph->bucket_ids, size, sizeof(u16));
+
+		// Prefix arrays have one entry past the last cluster, entrance and bucket
+		if(graph->node_cluster.count) {
+			valid &= (graph->node_cluster.count == graph->nodes.count);
+			valid &= (graph->cluster_first.count == (u32)graph->cluster_count + 1);
+			valid &= (graph->edge_first.count == (u32)graph->entrance_count + 1);
+		}
+
+		if(graph->bucket_first.count)
+			valid &= (graph->bucket_first.count == graph->bucket_mask + 2);
+	}
+
+	valid = valid && DlcBlockValid(&header->navmesh.polys, size, sizeof(NavPoly));
+	valid = valid && DlcBlockValid(&header->navmesh.links, size, sizeof(NavLink));
+	valid = valid && DlcBlockValid(&header->navmesh.tile_first, size, sizeof(u32));
+
+	// Failing any of these rebuilds the navmesh along with the rest of the cache
+	valid = valid && DlcNavMeshValid(header);
+
+	if(!valid) {
+		Message("Level cache is stale, rebuilding", ANSI_YELLOW);
+		munmap(base, size);
+		return false;
+	}
+
+	// Pointer fix-ups
+	for(short i = 0; i < 3; i++) {
+		sect->_tris[i] = (TriPool) {
+			.arr = DlcBlockPtr(header, &header->tris[i]),
+			.verts = DlcBlockPtr(header, &header->tri_verts[i]),
+			.planes = DlcBlockPtr(header, &header->tri_planes[i]),
+			.count = header->tris[i].count,
+			.vert_count = header->tri_verts[i].count,
+			.plane_count = header->tri_planes[i].count
+		};
+
+		BvhTree *bvh = &sect->bvh[i];
+		*bvh = (BvhTree) {
+			.tris = &sect->_tris[i],
+			.tri_ids = DlcBlockPtr(header, &header->bvh_ids[i]),
+			.nodes = DlcBlockPtr(header, &header->bvh_nodes[i]),
+			.shape = header->bvh_shape[i],
+			.count = header->bvh_nodes[i].count,
+			.capacity = header->bvh_nodes[i].count
+		};
+
+		sect->_hulls[i] = (HullPool) {
+			.arr = DlcBlockPtr(header, &header->hulls[i]),
+			.count = header->hulls[i].count
+		};
+	}
+
+	sect->hull_bvh = (HullBvh) {
+		.hulls = &sect->_hulls[0],
+		.nodes = DlcBlockPtr(header, &header->hull_nodes),
+		.count = header->hull_nodes.count,
+		.capacity = header->hull_nodes.count
+	};
+
+	*spawn_list = (SpawnList) {
+		.arr = DlcBlockPtr(header, &header->spawns),
+		.count = header->spawns.count,
+		.capacity = header->spawns.count
+	};
+
+	sect->base_navgraph = (NavGraph) {
+		.nodes = DlcBlockPtr(header, &header->base_graph.nodes),
+		.edges = DlcBlockPtr(header, &header->base_graph.edges),
+		.node_count = header->base_graph.nodes.count,
+		.edge_count = header->base_graph.edges.count,
+		.node_cap = header->base_graph.nodes.count,
+		.edge_cap = header->base_graph.edges.count
+	};
+
+	sect->navgraphs = malloc(sizeof(NavGraph) * DLC_MAX_GRAPHS);
+	sect->navgraph_count = header->graph_count;
+	for(u32 i = 0; i < header->graph_count; i++) {
+		DlcGraph *graph = &header->graphs[i];
+
+		sect->navgraphs[i] = (NavGraph) {
+			.nodes = DlcBlockPtr(header, &graph->nodes),
+			.edges = DlcBlockPtr(header, &graph->edges),
+			.node_count = graph->nodes.count,
+			.edge_count = graph->edges.count,
+			.node_cap = graph->nodes.count,
+			.edge_cap = graph->edges.count
+		};
+
+		// Only query scratch is allocated, everything else stays in the mapping
+		if(graph->node_cluster.count) {
+			NavClusters *cl = calloc(1, sizeof(NavClusters));
+
+			*cl = (NavClusters) {
+				.node_cluster = DlcBlockPtr(header, &graph->node_cluster),
+				.node_entrance = DlcBlockPtr(header, &graph->node_entrance),
+				.entrances = DlcBlockPtr(header, &graph->entrances),
+				.cluster_first = DlcBlockPtr(header, &graph->cluster_first),
+				.edges = DlcBlockPtr(header, &graph->cluster_edges),
+				.edge_first = DlcBlockPtr(header, &graph->edge_first),
+				.start_cost = malloc(sizeof(float) * (graph->max_cluster_entrances + 1)),
+				.goal_cost = malloc(sizeof(float) * (graph->max_cluster_entrances + 1)),
+				.edge_count = graph->cluster_edges.count,
+				.cluster_count = graph->cluster_count,
+				.entrance_count = graph->entrance_count,
+				.max_cluster_entrances = graph->max_cluster_entrances
+			};
+
+			sect->navgraphs[i].clusters = cl;
+		}
+
+		if(graph->bucket_first.count) {
+			NavIndex *index = calloc(1, sizeof(NavIndex));
+
+			*index = (NavIndex) {
+				.bucket_first = DlcBlockPtr(header, &graph->bucket_first),
+				.ids = DlcBlockPtr(header, &graph->bucket_ids),
+				.bucket_mask = graph->bucket_mask
+			};
+
+			sect->navgraphs[i].index = index;
+		}
+	}
+
+	DlcNavMesh *mesh = &header->navmesh;
+	sect->navmesh = (NavMesh) {
+		.polys = DlcBlockPtr(header, &mesh->polys),
+		.links = DlcBlockPtr(header, &mesh->links),
+		.tile_first = DlcBlockPtr(header, &mesh->tile_first),
+		.origin = mesh->origin,
+		.tile_size = mesh->tile_size,
+		.link_count = mesh->links.count,
+		.poly_count = mesh->polys.count,
+		.tiles_x = mesh->tiles_x,
+		.tiles_y = mesh->tiles_y,
+		.region_count = mesh->region_count
+	};
+
+	cache->base = base;
+	cache->size = size;
+	sect->flags |= MAP_SECT_CACHED;
+
+	MessageDiag("Loaded level cache", cache->path, ANSI_GREEN);
+	return true;
+}
+
+// Reserve an aligned block in the file image
+DlcBlock DlcPlaceBlock(u64 *cursor, u32 count, u32 stride) {
+	DlcBlock block = (DlcBlock) { .count = count, .stride = stride };
+	if(!count)
+		return block;
+
+	*cursor = (*cursor + DLC_ALIGN - 1) & ~(u64)(DLC_ALIGN - 1);
+	block.offset = *cursor;
+	*cursor += (u64)count * stride;
+
+	return block;
+}
+
+void DlcCopyBlock(u8 *image, DlcBlock *block, void *src) {
+	if(block->count && src)
+		memcpy(image + block->offset, src, (u64)block->count * block->stride);
+}
+
+bool DlcWrite(MapSection *sect, SpawnList *spawn_list) {
+	LevelCache *cache = &sect->cache;
+
+	if(cache->path[0] == '\0')
+		return false;
+
+	if(sect->navgraph_count > DLC_MAX_GRAPHS) {
+		MessageError("ERROR: Too many nav graphs to cache", NULL);
+		return false;
+	}
+
+	DlcHeader header = (DlcHeader) {0};
+	memcpy(header.magic, DLC_MAGIC, 4);
+	header.version = DLC_VERSION;
+	header.hash = cache->hash;
+
+	// 1. Layout
+	u64 cursor = sizeof(DlcHeader);
+	for(short i = 0; i < 3; i++) {
+		BvhTree *bvh = &sect->bvh[i];
+
+		header.tris[i] = DlcPlaceBlock(&cursor, sect->_tris[i].count, sizeof(TriIndex));
+		header.tri_verts[i] = DlcPlaceBlock(&cursor, sect->_tris[i].vert_count, sizeof(Vector3));
+		header.tri_planes[i] = DlcPlaceBlock(&cursor, sect->_tris[i].plane_count, sizeof(Plane));
+
+		header.bvh_ids[i] = DlcPlaceBlock(&cursor, (bvh->tris) ? bvh->tris->count : 0, sizeof(u16));
+		header.bvh_nodes[i] = DlcPlaceBlock(&cursor, bvh->count, sizeof(BvhNode));
+		header.bvh_shape[i] = bvh->shape;
+
+		header.hulls[i] = DlcPlaceBlock(&cursor, sect->_hulls[i].count, sizeof(Hull));
+	}
+
+	header.hull_nodes = DlcPlaceBlock(&cursor, sect->hull_bvh.count, sizeof(HullBvhNode));
+	header.spawns = DlcPlaceBlock(&cursor, spawn_list->count, sizeof(EntSpawn));
+
+	header.base_graph.nodes = DlcPlaceBlock(&cursor, sect->base_navgraph.node_count, sizeof(NavNode));
+	header.base_graph.edges = DlcPlaceBlock(&cursor, sect->base_navgraph.edge_count, sizeof(NavEdge));
+
+	header.graph_count = sect->navgraph_count;
+	for(u8 i = 0; i < sect->navgraph_count; i++) {
+		NavGraph *navgraph = &sect->navgraphs[i];
+		DlcGraph *graph = &header.graphs[i];
+
+		graph->nodes = DlcPlaceBlock(&cursor, navgraph->node_count, sizeof(NavNode));
+		graph->edges = DlcPlaceBlock(&cursor, navgraph->edge_count, sizeof(NavEdge));
+
+		NavClusters *cl = navgraph->clusters;
+		if(cl) {
+			graph->node_cluster = DlcPlaceBlock(&cursor, navgraph->node_count, sizeof(u16));
+			graph->node_entrance = DlcPlaceBlock(&cursor, navgraph->node_count, sizeof(u16));
+			graph->entrances = DlcPlaceBlock(&cursor, cl->entrance_count, sizeof(u16));
+			graph->cluster_first = DlcPlaceBlock(&cursor, cl->cluster_count + 1, sizeof(u32));
+			graph->cluster_edges = DlcPlaceBlock(&cursor, cl->edge_count, sizeof(NavAbstractEdge));
+			graph->edge_first = DlcPlaceBlock(&cursor, cl->entrance_count + 1, sizeof(u32));
+
+			graph->cluster_count = cl->cluster_count;
+			graph->entrance_count = cl->entrance_count;
+			graph->max_cluster_entrances = cl->max_cluster_entrances;
+		}
+
+		NavIndex *index = navgraph->index;
+		if(index) {
+			graph->bucket_first = DlcPlaceBlock(&cursor, index->bucket_mask + 2, sizeof(u32));
+			graph->bucket_ids = DlcPlaceBlock(&cursor, navgraph->node_count, sizeof(u16));
+			graph->bucket_mask = index->bucket_mask;
+		}
+	}
+
+	NavMesh *mesh = &sect->navmesh;
+	header.navmesh = (DlcNavMesh) {
+		.polys = DlcPlaceBlock(&cursor, mesh->poly_count, sizeof(NavPoly)),
+		.links = DlcPlaceBlock(&cursor, mesh->link_count, sizeof(NavLink)),
+		.tile_first = DlcPlaceBlock(&cursor, (mesh->tile_first) ? mesh->tiles_x * mesh->tiles_y + 1 : 0, sizeof(u32)),
+		.origin = mesh->origin,
+		.tile_size = mesh->tile_size,
+		.tiles_x = mesh->tiles_x,
+		.tiles_y = mesh->tiles_y,
+		.region_count = mesh->region_count
+	};
+
+	header.file_size = cursor;
+
+	// 2. Fill image
+	u8 *image = calloc(header.file_size, 1);
+	if(!image)
+		return false;
+
+	memcpy(image, &header, sizeof(DlcHeader));
+
+	for(short i = 0; i < 3; i++) {
+		DlcCopyBlock(image, &header.tris[i], sect->_tris[i].arr);
+		DlcCopyBlock(image, &header.tri_verts[i], sect->_tris[i].verts);
+		DlcCopyBlock(image, &header.tri_planes[i], sect->_tris[i].planes);
+		DlcCopyBlock(image, &header.bvh_ids[i], sect->bvh[i].tri_ids);
+		DlcCopyBlock(image, &header.bvh_nodes[i], sect->bvh[i].nodes);
+		DlcCopyBlock(image, &header.hulls[i], sect->_hulls[i].arr);
+	}
+
+	DlcCopyBlock(image, &header.hull_nodes, sect->hull_bvh.nodes);
+	DlcCopyBlock(image, &header.spawns, spawn_list->arr);
+	DlcCopyBlock(image, &header.base_graph.nodes, sect->base_navgraph.nodes);
+	DlcCopyBlock(image, &header.base_graph.edges, sect->base_navgraph.edges);
+
+	for(u8 i = 0; i < sect->navgraph_count; i++) {
+		NavGraph *navgraph = &sect->navgraphs[i];
+		DlcGraph *graph = &header.graphs[i];
+
+		DlcCopyBlock(image, &graph->nodes, navgraph->nodes);
+		DlcCopyBlock(image, &graph->edges, navgraph->edges);
+
+		NavClusters *cl = navgraph->clusters;
+		if(cl) {
+			DlcCopyBlock(image, &graph->node_cluster, cl->node_cluster);
+			DlcCopyBlock(image, &graph->node_entrance, cl->node_entrance);
+			DlcCopyBlock(image, &graph->entrances, cl->entrances);
+			DlcCopyBlock(image, &graph->cluster_first, cl->cluster_first);
+			DlcCopyBlock(image, &graph->cluster_edges, cl->edges);
+			DlcCopyBlock(image, &graph->edge_first, cl->edge_first);
+		}
+
+		NavIndex *index = navgraph->index;
+		if(index) {
+			DlcCopyBlock(image, &graph->bucket_first, index->bucket_first);
+			DlcCopyBlock(image, &graph->bucket_ids, index->ids);
+		}
+	}
+
+	DlcCopyBlock(image, &header.navmesh.polys, sect->navmesh.polys);
+	DlcCopyBlock(image, &header.navmesh.links, sect->navmesh.links);
+	DlcCopyBlock(image, &header.navmesh.tile_first, sect->navmesh.tile_first);
+
+	// 3. Write to temp file then swap, a crash mid write never leaves a half written cache
+	char temp_path[sizeof(cache->path) + 4];
+	snprintf(temp_path, sizeof(temp_path), "%s.tmp", cache->path);
+
+	FILE *pf = fopen(temp_path, "wb");
+	if(!pf) {
+		MessageError("ERROR: Could not write level cache", temp_path);
+		free(image);
+		return false;
+	}
+
+	bool ok = (fwrite(image, header.file_size, 1, pf) == 1);
+	ok = (fclose(pf) == 0) && ok;
+	free(image);
+
+	if(!ok || rename(temp_path, cache->path) != 0) {
+		MessageError("ERROR: Could not write level cache", cache->path);
+		remove(temp_path);
+		return false;
+	}
+
+	MessageDiag("Wrote level cache", cache->path, ANSI_GREEN);
+	return true;
+}
+
+void DlcClose(MapSection *sect) {
+	LevelCache *cache = &sect->cache;
+
+	if(cache->base)
+		munmap(cache->base, cache->size);
+
+	for(u8 i = 0; i < sect->navgraph_count; i++) {
+		NavGraph *graph = &sect->navgraphs[i];
+
+		if(graph->clusters) {
+			free(graph->clusters->start_cost);
+			free(graph->clusters->goal_cost);
+			free(graph->clusters);
+		}
+
+		if(graph->index)
+			free(graph->index);
+	}
+
+	if(sect->navgraphs)
+		free(sect->navgraphs);
+
+	sect->navmesh = (NavMesh) {0};
+
+	cache->base = NULL;
+	cache->size = 0;
+
+	sect->navgraphs = NULL;
+	sect->navgraph_count = 0;
+	sect->flags &= ~MAP_SECT_CACHED;
+}
@@ -0,0 +1,107 @@
+#include "../include/num_redefs.h"
+#include "geo.h"
+#include "map.h"
+
+#ifndef DLC_H_
+#define DLC_H_
+
+// * NOTE:
+// Compiled level cache (.dlc), holds all derived collision and nav data for a map section:
+// tris, BVHs, hulls, spawns, nav graphs with their clusters and lookup grids, and the navmesh.
+// File is one contiguous image: header, then 16 byte aligned blocks addressed by offset.
+// Loading maps the whole file once and patches section pointers to point into the mapping
+
+#define DLC_MAGIC 		"DLC"
+#define DLC_VERSION 	5
+#define DLC_ALIGN 		16
+#define DLC_MAX_GRAPHS 	32
+
+typedef struct {
+	u64 offset;
+	u32 count;
+	u32 stride;
+
+} DlcBlock;
+
+typedef struct {
+	DlcBlock nodes;
+	DlcBlock edges;
+
+	// Cluster abstraction, empty if the graph has none
+	DlcBlock node_cluster;
+	DlcBlock node_entrance;
+	DlcBlock entrances;
+	DlcBlock cluster_first;
+	DlcBlock cluster_edges;
+	DlcBlock edge_first;
+
+	// Node lookup grid, empty if the graph has none
+	DlcBlock bucket_first;
+	DlcBlock bucket_ids;
+
+	u32 bucket_mask;
+
+	u16 cluster_count;
+	u16 entrance_count;
+	u16 max_cluster_entrances;
+
+} DlcGraph;
+
+typedef struct {
+	DlcBlock polys;
+	DlcBlock links;
+	DlcBlock tile_first;
+
+	Vector3 origin;
+	float tile_size;
+
+	u16 tiles_x, tiles_y;
+	u16 region_count;
+
+} DlcNavMesh;
+
+typedef struct {
+	char magic[4];
+	u32 version;
+
+	u64 hash;
+	u64 file_size;
+
+	DlcBlock tris[3];
+	DlcBlock tri_verts[3];
+	DlcBlock tri_planes[3];
+
+	DlcBlock bvh_ids[3];
+	DlcBlock bvh_nodes[3];
+	Vector3 bvh_shape[3];
+
+	DlcBlock hulls[3];
+	DlcBlock hull_nodes;
+
+	DlcBlock spawns;
+
+	DlcGraph base_graph;
+	DlcGraph graphs[DLC_MAX_GRAPHS];
+	u32 graph_count;
+
+	DlcNavMesh navmesh;
+
+} DlcHeader;
+
+// Hash contents of source files, missing files are skipped
+u64 DlcHashFiles(char **paths, u8 count);
+
+// Set cache path and hash for a section, call before DlcLoad/DlcWrite
+void DlcSetup(MapSection *sect, char *map_path, char *bsp_path);
+
+// Map cached data into section, returns false if cache is missing or stale
+bool DlcLoad(MapSection *sect, SpawnList *spawn_list);
+
+// Write section collision, spawn and nav data to cache file.
+// Call once graph clusters and lookup grids are built so they're cached too
+bool DlcWrite(MapSection *sect, SpawnList *spawn_list);
+
+// Release mapping, and the cluster and lookup grid headers made on load
+void DlcClose(MapSection *sect);
+
+#endif
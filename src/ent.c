@@ -9,20 +9,55 @@
 #include "ent.h"
 #include "geo.h"
 #include "ai.h"
+#include "nav.h"
+#include "navmesh.h"
+#include "job.h"
+#include "snapshot.h"
 #include "../include/log_message.h"
 #include "../include/sort.h"
 #include "pm.h"
 
 #define STEP_SIZE 8.0f
 
-float grid_tick = 0.0f;
-
 Vector3 debug_bullet_dest;
 Vector3 debug_bullet_norm;
 
 MapSection *ptr_handler_sect = NULL;
 EntityHandler *ptr_handler_self = NULL;
 
+// Path searches requested by AI schedules
+NavQueue nav_queue = {0};
+
+// Threads for the step task graph and the AI sense phase
+JobPool ent_jobs = {0};
+
+// Flow fields toward the player, one per graph
+NavFlowField player_flows[MAX_NAVGRAPHS] = {0};
+
+// World as it was when the active checkpoint was reached, restored on death
+WorldSnapshot checkpoint_snapshot = {0};
+i16 checkpoint_saved = -1;
+
+// Checkpoint snapshots also go to disk, off the main thread
+SnapshotWriter save_writer = {0};
+
+// Entities to draw this frame, grouped by type
+typedef struct {
+	u16 *ids;
+	u16 count;
+	u16 capacity;
+
+	// Ids of type t are ids[first[t]..end[t]], empty for types that aren't drawn
+	u16 first[ENT_TYPE_COUNT];
+	u16 end[ENT_TYPE_COUNT];
+
+	// Decompressed PVS of camera leaf
+	u8 *vis;
+	int vis_capacity;
+
+} RenderList;
+RenderList render_list = {0};
+
 typedef void (*OnHitFunc)(Entity *ent, short damage);
 OnHitFunc on_hit_funcs[] = {
 	&OnHitPlayer,
@@ -50,9 +85,27 @@ Model projectile_models[4];
 void EntHandlerInit(EntityHandler *handler, vEffect_Manager *effect_manager) {
 
 	handler->count = 0;
-	handler->capacity = 128;
-	handler->ents = calloc(handler->capacity, sizeof(Entity));
+	handler->capacity = 0;
 	handler->player_id = 0;
+	handler->sim_tick = 0;
+
+	handler->ents = NULL;
+	handler->transforms = NULL;
+	handler->ais = NULL;
+	handler->healths = NULL;
+	handler->weapons = NULL;
+	handler->renders = NULL;
+	handler->type_ids = NULL;
+	handler->generations = NULL;
+	handler->free_ids = NULL;
+	handler->live = NULL;
+	handler->live_index = NULL;
+
+	handler->free_count = 0;
+	handler->live_count = 0;
+
+	memset(handler->type_first, 0, sizeof(handler->type_first));
+	handler->type_lists_dirty = false;
 
 	LoadEntityBaseModels(handler);
 	LoadEntityBaseAnims();
@@ -60,253 +113,475 @@ void EntHandlerInit(EntityHandler *handler, vEffect_Manager *effect_manager) {
 	handler->ai_tick = 0;
 
 	EntGridInit(handler);
+	EntReserve(handler, ENT_START_CAPACITY);
 	handler->checkpoint_list = (CheckPointList) {0}; 
 	handler->checkpoint_list.active = -1;
 
 	handler->effect_manager = effect_manager;
 
+	handler->projectile_count = 0;
 	handler->projectile_capacity = 128;
 	handler->projectiles = calloc(handler->projectile_capacity, sizeof(Projectile));
+
+	NavQueueInit(&nav_queue, NAV_DEFAULT_BUDGET_EXPANSIONS);
+	JobPoolInit(&ent_jobs, 0);
+
+	checkpoint_saved = -1;
+	SnapshotWriterInit(&save_writer, SNAPSHOT_SAVE_PATH);
 }
 
 void EntHandlerClose(EntityHandler *handler) {
 	if(handler->ents) 
 		free(handler->ents);
 
+	if(handler->transforms) free(handler->transforms);
+	if(handler->ais) free(handler->ais);
+	if(handler->healths) free(handler->healths);
+	if(handler->weapons) free(handler->weapons);
+	if(handler->renders) free(handler->renders);
+	if(handler->type_ids) free(handler->type_ids);
+	if(handler->generations) free(handler->generations);
+	if(handler->free_ids) free(handler->free_ids);
+	if(handler->live) free(handler->live);
+	if(handler->live_index) free(handler->live_index);
+	if(handler->ai_ids) free(handler->ai_ids);
+
 	if(handler->spawn_list.arr)
 		free(handler->spawn_list.arr);
 
 	if(handler->projectiles)
 		free(handler->projectiles);
 
-	if(handler->grid.cells)
-		free(handler->grid.cells);
+	EntGridClose(&handler->grid);
 
 	if(handler->checkpoint_list.points)
 		free(handler->checkpoint_list.points);
 
-	if(handler->checkpoint_list.cells)
-		free(handler->checkpoint_list.cells);
-}
 
-// **
-// This struct stores IDs of entities to draw
-#define MAX_RENDERED_ENTS	128
-#define MIN_VIEW_RADIUS		(64.0*64.0)
-#define MAX_VIEW_DOT		(-0.107f * DEG2RAD)
-typedef struct {
-	u16 ids[MAX_RENDERED_ENTS];
-	u16 count;	
+	NavQueueClose(&nav_queue);
+	JobPoolClose(&ent_jobs);
 
-} RenderList;
-RenderList render_list = {0};
+	SnapshotWriterClose(&save_writer);
+	SnapshotFree(&checkpoint_snapshot);
 
-void UpdateRenderList(EntityHandler *handler, MapSection *sect) {
-	render_list.count = 0;
+	if(render_list.ids) free(render_list.ids);
+	if(render_list.vis) free(render_list.vis);
+	render_list = (RenderList) {0};
+
+	for(u8 i = 0; i < MAX_NAVGRAPHS; i++)
+		NavFlowFree(&player_flows[i]);
+}
+
+Entity EntBind(EntityHandler *handler, u16 id) {
+	handler->transforms[id] = (comp_Transform) {0};
+	handler->ais[id] = (comp_Ai) {0};
+	handler->healths[id] = (comp_Health) {0};
+	handler->weapons[id] = (comp_Weapon) {0};
+	handler->renders[id] = (comp_Render) {0};
+
+	return (Entity) {
+		.comp_transform = &handler->transforms[id],
+		.comp_ai = &handler->ais[id],
+		.comp_health = &handler->healths[id],
+		.comp_weapon = &handler->weapons[id],
+		.comp_render = &handler->renders[id],
+		.id = id,
+		.cell_id = -1
+	};
 }
 
-float prev_pos_tick = 0.0f;
+void EntReserve(EntityHandler *handler, u16 capacity) {
+	if(capacity <= handler->capacity)
+		return;
 
-void UpdateEntities(EntityHandler *handler, MapSection *sect, float dt) {
-	if(!ptr_handler_self)
-		ptr_handler_self = handler;
+	u16 prev = handler->capacity;
+	handler->capacity = capacity;
 
-	if(!ptr_handler_sect)
-		ptr_handler_sect = sect;
+	handler->ents = realloc(handler->ents, sizeof(Entity) * capacity);
+	handler->transforms = realloc(handler->transforms, sizeof(comp_Transform) * capacity);
+	handler->ais = realloc(handler->ais, sizeof(comp_Ai) * capacity);
+	handler->healths = realloc(handler->healths, sizeof(comp_Health) * capacity);
+	handler->weapons = realloc(handler->weapons, sizeof(comp_Weapon) * capacity);
+	handler->renders = realloc(handler->renders, sizeof(comp_Render) * capacity);
 
-	prev_pos_tick -= dt;
-	if(prev_pos_tick < 0.0f) {
-		for(u16 i = 0; i < handler->count; i++) {
-			Entity *ent = &handler->ents[i];
-			ent->comp_transform.prev_pos = ent->comp_transform.position;
+	handler->type_ids = realloc(handler->type_ids, sizeof(u16) * capacity);
+	handler->generations = realloc(handler->generations, sizeof(u16) * capacity);
+	handler->free_ids = realloc(handler->free_ids, sizeof(u16) * capacity);
+	handler->live = realloc(handler->live, sizeof(u16) * capacity);
+	handler->live_index = realloc(handler->live_index, sizeof(u16) * capacity);
+	handler->ai_ids = realloc(handler->ai_ids, sizeof(u16) * capacity);
+
+	for(u16 i = prev; i < capacity; i++) {
+		handler->ents[i] = EntBind(handler, i);
+		handler->ents[i].type = -1;
+
+		handler->generations[i] = 1;
+		handler->live_index[i] = ENT_NOT_LIVE;
+	}
+
+	// Arrays may have moved
+	for(u16 i = 0; i < prev; i++) {
+		Entity *ent = &handler->ents[i];
+		ent->comp_transform = &handler->transforms[i];
+		ent->comp_ai = &handler->ais[i];
+		ent->comp_health = &handler->healths[i];
+		ent->comp_weapon = &handler->weapons[i];
+		ent->comp_render = &handler->renders[i];
+	}
+
+	EntGridReserve(&handler->grid, capacity);
+}
+
+u16 EntAlloc(EntityHandler *handler) {
+	u16 id;
+
+	if(handler->free_count) {
+		id = handler->free_ids[--handler->free_count];
+
+	} else {
+		if(handler->count >= handler->capacity) {
+			u32 capacity = (u32)handler->capacity << 1;
+			EntReserve(handler, (capacity > ENT_MAX_COUNT) ? ENT_MAX_COUNT : capacity);
 		}
 
-		prev_pos_tick = 4*dt;
+		id = handler->count++;
 	}
 
-	Entity *player_ent = &handler->ents[handler->player_id];
-	PlayerUpdate(player_ent, dt);
+	handler->live_index[id] = handler->live_count;
+	handler->live[handler->live_count++] = id;
 
-	if(player_ent->comp_ai.state == STATE_DEAD && player_ent->comp_ai.task_data.timer >= 2) {
-		ReloadEntities(handler, sect, 1);
+	handler->type_lists_dirty = true;
+
+	return id;
+}
+
+void EntFree(EntityHandler *handler, u16 id) {
+	if(id >= handler->count || handler->live_index[id] == ENT_NOT_LIVE)
 		return;
+
+	// Swap last live id into the gap
+	u16 index = handler->live_index[id];
+	u16 last = handler->live[--handler->live_count];
+	handler->live[index] = last;
+	handler->live_index[last] = index;
+	handler->live_index[id] = ENT_NOT_LIVE;
+
+	// Skip 0 on wrap so handles stay non zero
+	if(++handler->generations[id] == 0)
+		handler->generations[id] = 1;
+
+	handler->ents[id].flags = 0;
+	handler->ents[id].type = -1;
+
+	EntGridRemove(&handler->grid, id);
+
+	handler->free_ids[handler->free_count++] = id;
+	handler->type_lists_dirty = true;
+}
+
+void EntPoolReset(EntityHandler *handler) {
+	for(u16 i = 0; i < handler->live_count; i++) {
+		u16 id = handler->live[i];
+		handler->live_index[id] = ENT_NOT_LIVE;
+
+		if(++handler->generations[id] == 0)
+			handler->generations[id] = 1;
 	}
 
-	render_list.count = 0;
-	Vector3 view_dir = player_ent->comp_transform.forward;
+	handler->live_count = 0;
+	handler->free_count = 0;
+	handler->count = 0;
 
-	for(u16 i = 0; i < handler->count; i++) {
-		Entity *ent = &handler->ents[i];
+	handler->type_lists_dirty = true;
+}
 
-		if(ent->type <= 0)
-			continue;
+EntHandle EntHandleOf(EntityHandler *handler, u16 id) {
+	return ((u32)handler->generations[id] << 16) | id;
+}
 
-		if(!(ent->flags & ENT_ACTIVE))
-			continue;
+Entity *EntGet(EntityHandler *handler, EntHandle handle) {
+	u16 id = (handle & 0xFFFF);
+	u16 generation = (handle >> 16);
 
-		if(ent->type == ENT_PLAYER)
+	if(handle == ENT_NULL_HANDLE || id >= handler->count)
+		return NULL;
+
+	if(handler->generations[id] != generation || handler->live_index[id] == ENT_NOT_LIVE)
+		return NULL;
+
+	return &handler->ents[id];
+}
+
+void EntBuildTypeLists(EntityHandler *handler) {
+	handler->type_lists_dirty = false;
+
+	u16 counts[ENT_TYPE_COUNT] = {0};
+	for(u16 n = 0; n < handler->live_count; n++) {
+		i8 type = handler->ents[handler->live[n]].type;
+		if(type >= 0 && type < ENT_TYPE_COUNT) 
+			counts[type]++;
+	}
+
+	handler->type_first[0] = 0;
+	for(u8 t = 0; t < ENT_TYPE_COUNT; t++) 
+		handler->type_first[t + 1] = handler->type_first[t] + counts[t];
+
+	// Fill in id order so each list stays sorted
+	u16 fill[ENT_TYPE_COUNT];
+	memcpy(fill, handler->type_first, sizeof(fill));
+	for(u16 n = 0; n < handler->live_count; n++) {
+		u16 id = handler->live[n];
+		i8 type = handler->ents[id].type;
+		if(type >= 0 && type < ENT_TYPE_COUNT) 
+			handler->type_ids[fill[type]++] = id;
+	}
+}
+
+// Run an update for every active entity of a type
+typedef void (*EntUpdateFunc)(Entity *ent, EntityHandler *handler, MapSection *sect, float dt);
+void EntTypeUpdate(EntityHandler *handler, u8 type, EntUpdateFunc func, MapSection *sect, float dt) {
+	for(u16 i = handler->type_first[type]; i < handler->type_first[type + 1]; i++) {
+		Entity *ent = &handler->ents[handler->type_ids[i]];
+
+		if(!(ent->flags & ENT_ACTIVE))
 			continue;
 
-		switch(ent->type) {
-			case ENT_TURRET: 
-				TurretUpdate(ent, handler, sect, dt);
-				break;
+		func(ent, handler, sect, dt);
+	}
+}
 
-			case ENT_MAINTAINER:
-				MaintainerUpdate(ent, handler, sect, dt);
-				break;
+// Move bug hitboxes and tick damage cooldowns, only reads positions and health
+void HealthSystemUpdate(EntityHandler *handler, float dt) {
+	for(u16 i = handler->type_first[ENT_PLAYER + 1]; i < handler->type_first[ENT_TYPE_COUNT]; i++) {
+		u16 id = handler->type_ids[i];
 
-			case ENT_DISRUPTOR:
-				BugUpdate(ent, handler, sect, dt);
-				break;
-		}
+		if(!(handler->ents[id].flags & ENT_ACTIVE))
+			continue;
 
-		ent->comp_health.bug_box = BoxTranslate(
-			ent->comp_health.bug_box,
-			Vector3Add(ent->comp_transform.position, ent->comp_health.bug_point)	
-		);
-		ent->comp_health.damage_cooldown -= dt;
+		comp_Health *health = &handler->healths[id];
+		health->bug_box = BoxTranslate(health->bug_box, Vector3Add(handler->transforms[id].position, health->bug_point));
+		health->damage_cooldown -= dt;
 
-		comp_Health *health = &ent->comp_health;
 		if(health->component_valid) {
 			health->damage_cooldown -= dt;
 
 			if(health->damage_cooldown < 0)
 				health->damage_cooldown = 0;
 		}
+	}
+}
 
+// **
+// Boxes are for collision, models stick out of them a bit
+#define RENDER_CULL_MARGIN 32.0f
 
-		// *** Render visibility checking ***
+// Types with a draw function, in draw order
+u8 drawn_types[] = { ENT_TURRET, ENT_MAINTAINER, ENT_DISRUPTOR };
 
-		/*
-		Vector3 view_pos = player_ent->comp_transform.position;
-		Vector3 to_player = Vector3Subtract(view_pos, ent->comp_transform.position);
+void UpdateRenderList(EntityHandler *handler, MapSection *sect, Camera3D camera, float aspect) {
+	render_list.count = 0;
+	memset(render_list.first, 0, sizeof(render_list.first));
+	memset(render_list.end, 0, sizeof(render_list.end));
 
-		float dist = Vector3LengthSqr(to_player);
-		to_player = Vector3Normalize(to_player);
+	if(render_list.capacity < handler->capacity) {
+		render_list.capacity = handler->capacity;
+		render_list.ids = realloc(render_list.ids, sizeof(u16) * render_list.capacity);
+	}
 
-		if(dist > 2000.0f*2000.0f)
-			continue;
+	Bsp_Data *bsp = &sect->bsp_data;
+	bool use_pvs = (bsp->num_models && bsp->num_leaves > 1);
+
+	int view_leaf = 0;
+	if(use_pvs) {
+		int bytes = Bsp_VisBytes(bsp);
+		if(render_list.vis_capacity < bytes) {
+			render_list.vis_capacity = bytes;
+			render_list.vis = realloc(render_list.vis, bytes);
+		}
+
+		view_leaf = Bsp_FindLeaf(bsp, camera.position);
+		Bsp_DecompressVis(bsp, view_leaf, render_list.vis);
+	}
+
+	Frustum frustum = FrustumFromCamera(camera, aspect);
+	Vector3 margin = (Vector3) { RENDER_CULL_MARGIN, RENDER_CULL_MARGIN, RENDER_CULL_MARGIN };
+
+	if(handler->type_lists_dirty)
+		EntBuildTypeLists(handler);
+
+	for(u8 t = 0; t < sizeof(drawn_types); t++) {
+		u8 type = drawn_types[t];
+		render_list.first[type] = render_list.count;
+
+		for(u16 j = handler->type_first[type]; j < handler->type_first[type + 1]; j++) {
+			u16 i = handler->type_ids[j];
+			Entity *ent = &handler->ents[i];
+
+			if(!(ent->flags & ENT_ACTIVE))
+				continue;
+
+			// Leaf 0 is solid, entities in it or not linked yet skip the PVS test
+			i32 leaf = ent->leaf_id;
+			if(use_pvs && leaf > 0 && leaf != view_leaf && !(render_list.vis[(leaf - 1) >> 3] & (1 << ((leaf - 1) & 7))))
+				continue;
+
+			BoundingBox bounds = ent->comp_transform->bounds;
+			if(bounds.max.x >= bounds.min.x) {
+				bounds.min = Vector3Subtract(bounds.min, margin);
+				bounds.max = Vector3Add(bounds.max, margin);
+
+				if(!FrustumBoxVisible(&frustum, bounds))
+					continue;
+			}
 
-		// Entities that are very close will always be rendered
-		if(dist <= MIN_VIEW_RADIUS) {
 			render_list.ids[render_list.count++] = i;
-			continue;
 		}
 
-		// Cull behind camera
-		float vis_dot = Vector3DotProduct(to_player, view_dir);
-		if(vis_dot > MAX_VIEW_DOT) 
-			continue;
+		render_list.end[type] = render_list.count;
+	}
+}
 
-		Vector3 right = Vector3CrossProduct(view_dir, UP);
-		short visible = 3;
-		*/
+typedef struct {
+	EntityHandler *handler;
+	MapSection *sect;
+	float dt;
 
-		/*
-		Ray ray = (Ray) { .position = view_pos, .direction = Vector3Negate(to_player) };
+} EntStep;
 
-		EntTraceData ent_tr = EntTraceDataEmpty();
-		TraceEntities(ray, handler, 2000.0f, -1, &ent_tr);
+void EntStepTypes(void *data) {
+	EntStep *step = data;
 
-		BvhTraceData tr = TraceDataEmpty();
-		BvhTracePointEx(ray, sect, &sect->bvh[0], 0, &tr, dist);
+	EntTypeUpdate(step->handler, ENT_TURRET, TurretUpdate, step->sect, step->dt);
+	EntTypeUpdate(step->handler, ENT_MAINTAINER, MaintainerUpdate, step->sect, step->dt);
+	EntTypeUpdate(step->handler, ENT_DISRUPTOR, BugUpdate, step->sect, step->dt);
+}
 
-		if(Vector3DistanceSqr(ray.position, tr.point) < (dist + (MIN_VIEW_RADIUS*0.25f)))
-			visible = 0;
-		*/
+void EntStepHealth(void *data) {
+	EntStep *step = data;
+	HealthSystemUpdate(step->handler, step->dt);
+}
 
-		/*
-		for(short j = 0; j < 3; j++) {
-			short offset = (j & 1) ? -1 : 1;
-			if(j == 0) offset = 0;
+void EntStepGrid(void *data) {
+	EntStep *step = data;
+	UpdateGrid(step->handler);
+}
 
-			Vector3 test_point = Vector3Subtract(ent->comp_transform.position, Vector3Scale(right, 72 * offset));
-			if(view_pos.y > ent->comp_transform.position.y) test_point.y = ent->comp_transform.bounds.max.y;
+void EntStepNav(void *data) {
+	EntStep *step = data;
+	AiNavUpdate(step->handler, step->sect);
+}
 
-			to_player = Vector3Normalize(Vector3Subtract(view_pos, test_point));
-				
-			Ray ray = (Ray) { .position = view_pos, .direction = Vector3Negate(to_player) };
+void EntStepAi(void *data) {
+	EntStep *step = data;
+	AiSystemUpdate(step->handler, step->sect, step->dt);
+}
 
-			BvhTraceData tr = TraceDataEmpty();
-			BvhTracePointEx(ray, sect, &sect->bvh[0], 0, &tr, dist);
+void EntStepProjectiles(void *data) {
+	EntStep *step = data;
+	ManageProjectiles(step->handler, step->sect, step->dt);
+}
 
-			if(Vector3DistanceSqr(ray.position, tr.point) < (dist + (MIN_VIEW_RADIUS*0.25f)))
-				visible--;
-		}
-		*/
+void UpdateEntities(EntityHandler *handler, MapSection *sect, float dt) {
+	if(!ptr_handler_self)
+		ptr_handler_self = handler;
 
-		// * NOTE:
-		// Special case for bug 
-		// fix visibility for when player is below entity,
-		// won't be needed after
-		/*
-		if(i == handler->bug_id)
-			visible = 3;
-		*/
+	if(!ptr_handler_sect)
+		ptr_handler_sect = sect;
 
-		// ******* remove later!!! ********
-		//visible = 3;
+	handler->sim_tick++;
 
-		/*
-		if(visible <= 0)
-			continue;
+	// Start of step, rendering blends from here to where this step ends up
+	for(u16 n = 0; n < handler->live_count; n++) {
+		u16 i = handler->live[n];
+		handler->transforms[i].prev_pos = handler->transforms[i].position;
+	}
 
-		render_list.ids[render_list.count++] = i;
-		*/
+	Entity *player_ent = &handler->ents[handler->player_id];
+	PlayerUpdate(player_ent, dt);
+
+	if(player_ent->comp_ai->state == STATE_DEAD && player_ent->comp_ai->task_data.timer >= 2) {
+		if(!RestoreCheckpoint(handler))
+			ReloadEntities(handler, sect, 1);
+
+		return;
 	}
 
+	if(handler->type_lists_dirty)
+		EntBuildTypeLists(handler);
+
 	handler->ai_tick -= dt;
-	if(handler->ai_tick < 0.0f) {
-		// Do next ai update in ~11 frames
-		handler->ai_tick = (AI_TICK_RATE*dt);
+	bool ai_due = (handler->ai_tick < 0.0f);
+	if(ai_due) {
+		// Do next ai update in 11 steps, dt is fixed so this is a set rate in simulation time
+		handler->ai_tick += (AI_TICK_RATE*dt);
+		if(handler->ai_tick < 0.0f)
+			handler->ai_tick = 0.0f;
+	}
+
+	// Rest of the step, added in the order side effects happen.
+	// Per type updates, AI schedules and projectiles touch nearly everything and use raylib, so they stay
+	// serial on this thread. Health, grid relinking and path searches only share positions read-only,
+	// those run at the same time
+	EntStep step = (EntStep) { .handler = handler, .sect = sect, .dt = dt };
+
+	JobGraph graph;
+	JobGraphBegin(&graph);
 
-		AiSystemUpdate(handler, sect, dt);
+	JobGraphAdd(&graph, "types", EntStepTypes, &step, RES_WORLD, RES_WORLD, JOB_TASK_MAIN_THREAD);
+	JobGraphAdd(&graph, "health", EntStepHealth, &step, RES_TRANSFORMS | RES_HEALTH, RES_HEALTH, 0);
+
+	// Relink whatever moved, AI and projectiles below see this frame's positions
+	JobGraphAdd(&graph, "grid", EntStepGrid, &step, RES_TRANSFORMS, RES_GRID, 0);
+
+	if(ai_due) {
+		JobGraphAdd(&graph, "nav", EntStepNav, &step, RES_TRANSFORMS | RES_NAV, RES_NAV | RES_AI, 0);
+		JobGraphAdd(&graph, "ai", EntStepAi, &step, RES_WORLD, RES_WORLD, JOB_TASK_MAIN_THREAD);
 	}
 
-	ManageProjectiles(handler, sect, dt);
+	JobGraphAdd(&graph, "projectiles", EntStepProjectiles, &step, RES_WORLD, RES_WORLD, JOB_TASK_MAIN_THREAD);
+
+	JobGraphRun(&graph, &ent_jobs);
 
-	grid_tick -= dt;
-	if(grid_tick < 0.0f) {
-		// Do next grid update in ~3 frames
-		grid_tick = (3*dt);
+	// Save once when a checkpoint becomes active, the step is complete here
+	if(handler->checkpoint_list.active != checkpoint_saved) {
+		checkpoint_saved = handler->checkpoint_list.active;
 
-		UpdateGrid(handler);
+		if(checkpoint_saved > -1) {
+			SnapshotCapture(&checkpoint_snapshot, handler, sect->cache.hash);
+			SnapshotWriteAsync(&save_writer, &checkpoint_snapshot);
+		}
 	}
 }
 
-void RenderEntities(EntityHandler *handler, float dt) {
-	EntGrid *grid = &handler->grid;
+float render_alpha = 1.0f;
 
-	//for(u16 i = 0; i < render_list.count; i++) {
-	for(u16 i = 0; i < handler->count; i++) {;
-		Entity *ent = &handler->ents[i];
+Vector3 EntRenderPosition(comp_Transform *ct) {
+	return Vector3Lerp(ct->prev_pos, ct->position, render_alpha);
+}
 
-		if(!(ent->flags & ENT_ACTIVE)) 
-			continue;
+void RenderEntities(EntityHandler *handler, float dt) {
+	EntGrid *grid = &handler->grid;
+	render_alpha = handler->render_alpha;
 
-		switch(ent->type) {
-			case ENT_TURRET:
-				TurretDraw(ent);
-				break;
+	// Built by UpdateRenderList, ids are valid until the next step
+	for(u16 n = render_list.first[ENT_TURRET]; n < render_list.end[ENT_TURRET]; n++)
+		TurretDraw(&handler->ents[render_list.ids[n]]);
 
-			case ENT_MAINTAINER:
-				MaintainerDraw(ent, dt);
-				break;
+	for(u16 n = render_list.first[ENT_MAINTAINER]; n < render_list.end[ENT_MAINTAINER]; n++)
+		MaintainerDraw(&handler->ents[render_list.ids[n]], dt);
 
-			case ENT_DISRUPTOR:
-				BugDraw(ent);
-				break;
-		}
+	for(u16 n = render_list.first[ENT_DISRUPTOR]; n < render_list.end[ENT_DISRUPTOR]; n++)
+		BugDraw(&handler->ents[render_list.ids[n]]);
 
-		/*
+	/*
+	for(u16 n = 0; n < handler->live_count; n++) {
+		u16 i = handler->live[n];
+		Entity *ent = &handler->ents[i];
 		EntGridCell *cell = &grid->cells[ent->cell_id];
-		DrawBoundingBox(ent->comp_transform.bounds, PURPLE);
+		DrawBoundingBox(ent->comp_transform->bounds, PURPLE);
 		DrawBoundingBox(cell->aabb, GREEN);
-		*/
-
-		//DrawBoundingBox(ent->comp_transform.bounds, RED);
 	}
+	*/
 
 	//DrawSphere(debug_bullet_dest, 10, RED);
 	//DrawLine3D(debug_bullet_dest, Vector3Add(debug_bullet_dest, Vector3Scale(debug_bullet_norm, 20)), PURPLE);
@@ -336,51 +611,52 @@ void TurretUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float d
 	float angle_min = -70;
 	float angle_max =  70;
 
-	if((ent->comp_ai.input_mask & AI_INPUT_SELF_GLITCHED)) {
-		ent->comp_ai.task_data.timer = 0;
-		ent->comp_ai.task_data.task_id = TASK_FIRE_WEAPON;
+	if((ent->comp_ai->input_mask & AI_INPUT_SELF_GLITCHED)) {
+		ent->comp_ai->task_data.timer = 0;
+		ent->comp_ai->task_data.task_id = TASK_FIRE_WEAPON;
 		
-		float angle = sinf(GetTime() * 1.5f);
+		float angle = sinf(handler->sim_tick * dt * 1.5f);
 		angle = Clamp(angle, angle_min, angle_max);
 
-		//angle = angle + ent->comp_transform.start_angle;
+		//angle = angle + ent->comp_transform->start_angle;
 
-		//if(ent->comp_ai.disrupt_timer > 0)
-		if(ent->comp_weapon.ammo > 0) {
-			ent->comp_transform.forward = Vector3RotateByAxisAngle(ent->comp_transform.targ_look, UP, angle);		
+		//if(ent->comp_ai->disrupt_timer > 0)
+		if(ent->comp_weapon->ammo > 0) {
+			ent->comp_transform->forward = Vector3RotateByAxisAngle(ent->comp_transform->targ_look, UP, angle);		
 		} else {
-			//ent->comp_transform.targ_look = ent->comp_transform.forward;		
-			ent->comp_ai.task_data.task_id = TASK_WAIT_TIME;
+			//ent->comp_transform->targ_look = ent->comp_transform->forward;		
+			ent->comp_ai->task_data.task_id = TASK_WAIT_TIME;
 		}
 
 	} else {
-		ent->comp_transform.forward = Vector3Lerp(ent->comp_transform.forward, ent->comp_transform.targ_look, 10*dt);
+		ent->comp_transform->forward = Vector3Lerp(ent->comp_transform->forward, ent->comp_transform->targ_look, 10*dt);
 	}
 
-	if(ent->comp_ai.task_data.task_id == TASK_FIRE_WEAPON) {
+	if(ent->comp_ai->task_data.task_id == TASK_FIRE_WEAPON) {
 		TurretShoot(ent, handler, sect, dt);
 	}
 }
 
 void TurretDraw(Entity *ent) {
-	comp_Transform *ct = &ent->comp_transform;
+	comp_Transform *ct = ent->comp_transform;
 
 	float yaw = atan2f(ct->forward.x, -ct->forward.y);
 
 	float xz_len = Vector2Length( (Vector2) { ct->forward.x, ct->forward.y } );
 	float pitch = atan2f(-ct->forward.z, xz_len);
 
-	Matrix mat_base = MatrixMultiply(ent->model.transform, MatrixTranslate(ct->position.x, ct->position.y, ct->position.z));
+	Vector3 pos = EntRenderPosition(ct);
+	Matrix mat_base = MatrixMultiply(ent->comp_render->model.transform, MatrixTranslate(pos.x, pos.y, pos.z));
 
 	Matrix mat_gun = MatrixMultiply(MatrixRotateX(pitch), MatrixRotateY(yaw));
 	mat_gun = MatrixMultiply(mat_gun, MatrixRotateX(90*DEG2RAD));
-	mat_gun = MatrixMultiply(mat_gun, MatrixTranslate(ct->position.x, ct->position.y, ct->position.z));
+	mat_gun = MatrixMultiply(mat_gun, MatrixTranslate(pos.x, pos.y, pos.z));
 
-	DrawMesh(ent->model.meshes[1], ent->model.materials[1], mat_gun);
-	DrawMesh(ent->model.meshes[0], ent->model.materials[1], mat_base);
+	DrawMesh(ent->comp_render->model.meshes[1], ent->comp_render->model.materials[1], mat_gun);
+	DrawMesh(ent->comp_render->model.meshes[0], ent->comp_render->model.materials[1], mat_base);
 
 	/*
-	comp_Transform *ct = &ent->comp_transform;
+	comp_Transform *ct = ent->comp_transform;
 
 	float yaw = atan2f(-ct->forward.x, -ct->forward.z);
 
@@ -397,46 +673,47 @@ void TurretDraw(Entity *ent) {
 	mat_gun = MatrixMultiply(MatrixRotate(right, pitch), mat_gun);
 	mat_gun = MatrixMultiply(mat_gun, mat_base);
 
-	DrawMesh(ent->model.meshes[1], ent->model.materials[1], mat_base);
-	DrawMesh(ent->model.meshes[0], ent->model.materials[1], mat_gun);
+	DrawMesh(ent->comp_render->model.meshes[1], ent->comp_render->model.materials[1], mat_base);
+	DrawMesh(ent->comp_render->model.meshes[0], ent->comp_render->model.materials[1], mat_gun);
 	*/
 
 	/*
-	Vector3 center = BoxCenter(ent->comp_transform.bounds);
-	Vector3 forward = ent->comp_transform.forward;
+	Vector3 center = BoxCenter(ent->comp_transform->bounds);
+	Vector3 forward = ent->comp_transform->forward;
 
 	DrawLine3D(center, Vector3Add(center, Vector3Scale(forward, 60)), PURPLE);
 	*/
 	//DrawBoundingBox(ct->bounds, RED);
 	
-	//DrawModel(ent->model, ent->comp_transform.position, 1, WHITE);
+	//DrawModel(ent->comp_render->model, ent->comp_transform->position, 1, WHITE);
 }
 
 void TurretShoot(Entity *ent, EntityHandler *handler, MapSection *sect, float dt) {
-	comp_Weapon *weap = &ent->comp_weapon;
-	comp_Transform *ct = &ent->comp_transform;
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Weapon *weap = ent->comp_weapon;
+	comp_Transform *ct = ent->comp_transform;
+	comp_Ai *ai = ent->comp_ai;
 
 	weap->cooldown -= dt;
 	if(weap->cooldown > 0)
 		return; 
 
 	if( (ai->input_mask & AI_INPUT_SELF_GLITCHED) == 0) {
-		if(ai->input_mask & AI_INPUT_SEE_PLAYER) {
-			Entity *targ_ent = &handler->ents[ai->task_data.target_entity];
+		// Turrets only ever go after the player, fall back to it before a target is set
+		Entity *targ_ent = EntGet(handler, ai->task_data.target_entity);
+		if(!targ_ent) 
+			targ_ent = &handler->ents[handler->player_id];
 
-			Vector3 look_point = targ_ent->comp_transform.position;
-			look_point = Vector3Add(look_point, Vector3Scale(targ_ent->comp_transform.velocity, 10*dt));
+		if(ai->input_mask & AI_INPUT_SEE_PLAYER) {
+			Vector3 look_point = targ_ent->comp_transform->position;
+			look_point = Vector3Add(look_point, Vector3Scale(targ_ent->comp_transform->velocity, 10*dt));
 
 			Vector3 targ = Vector3Normalize(Vector3Subtract(look_point, ct->position));
 			if(Vector3DotProduct(targ, ct->start_forward) >= -0.1f)
 				ct->targ_look = targ;
 
 		} else {
-			Entity *targ_ent = &handler->ents[ai->task_data.target_entity];
-
 			Vector3 look_point = ai->task_data.known_target_position;
-			look_point = Vector3Add(look_point, Vector3Scale(targ_ent->comp_transform.velocity, 10*dt));
+			look_point = Vector3Add(look_point, Vector3Scale(targ_ent->comp_transform->velocity, 10*dt));
 
 			Vector3 targ = Vector3Normalize(Vector3Subtract(look_point, ct->position));
 
@@ -448,7 +725,7 @@ void TurretShoot(Entity *ent, EntityHandler *handler, MapSection *sect, float dt
 	} else {
 		ct->targ_look.z = Lerp(ct->targ_look.z, 0, dt * 5);
 
-		if(ent->comp_ai.disrupt_timer >= 99.9f)
+		if(ent->comp_ai->disrupt_timer >= 99.9f)
 			weap->ammo = weap->clip_size;
 	}
 
@@ -476,7 +753,7 @@ void TurretShoot(Entity *ent, EntityHandler *handler, MapSection *sect, float dt
 	// Change this from hardcoded to data specific when ammo clip system implemented.
 	// Purpose of the dummy value is to cause no dammage on the first few shots,
 	// gives the player a warning for fairness.
-	bool dummy = (ent->comp_weapon.ammo > ent->comp_weapon.clip_size - 2 && !(ai->input_mask & AI_INPUT_LOST_PLAYER));
+	bool dummy = (ent->comp_weapon->ammo > ent->comp_weapon->clip_size - 2 && !(ai->input_mask & AI_INPUT_LOST_PLAYER));
 	Vector3 bullet_dest = TraceBullet(handler, sect, trace_start, dir, ent->id, &hit, dummy);
 
 	//Vector3 trail_start = Vector3Add(trace_start, Vector3Scale(ct->forward, 12));
@@ -502,30 +779,30 @@ void TurretShoot(Entity *ent, EntityHandler *handler, MapSection *sect, float dt
 }
 
 void MaintainerUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt) {
-	comp_Ai *ai = &ent->comp_ai;
-	comp_Transform *ct = &ent->comp_transform;
+	comp_Ai *ai = ent->comp_ai;
+	comp_Transform *ct = ent->comp_transform;
 
 	switch(ai->state) {
 		case STATE_IDLE:
-			ent->curr_anim = 0;
+			ent->comp_render->curr_anim = 0;
 			break;
 
 		case STATE_MOVE:
-			ent->curr_anim = 1;
+			ent->comp_render->curr_anim = 1;
 			break;
 	}
 
 	if((ai->input_mask & AI_INPUT_SELF_GLITCHED) && ai->state != STATE_DEAD) {
 		ai->curr_schedule = SCHED_IDLE;
-		float angle = sinf(GetTime()*20) * PI;
-		ent->comp_transform.forward = Vector3RotateByAxisAngle(ent->comp_transform.forward, UP, angle);
-		ent->model.transform = MatrixMultiply(MatrixRotateX(90*DEG2RAD), MatrixRotateZ(angle)); 
+		float angle = sinf(handler->sim_tick * dt * 20) * PI;
+		ent->comp_transform->forward = Vector3RotateByAxisAngle(ent->comp_transform->forward, UP, angle);
+		ent->comp_render->model.transform = MatrixMultiply(MatrixRotateX(90*DEG2RAD), MatrixRotateZ(angle)); 
 	}
 
 	if(ai->input_mask & AI_INPUT_SEE_GLITCHED)
 		ai->curr_schedule = SCHED_FIX_FRIEND;
 
-	ent->comp_health.hit_box = BoxTranslate(ent->comp_health.hit_box, ent->comp_transform.position);
+	ent->comp_health->hit_box = BoxTranslate(ent->comp_health->hit_box, ent->comp_transform->position);
 
 	if(ai->curr_schedule == SCHED_MAINTAINER_ATTACK) {
 		if(ai->input_mask & AI_INPUT_SEE_PLAYER) {
@@ -534,25 +811,26 @@ void MaintainerUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, flo
 			ct->forward = Vector3Normalize(ct->forward);
 
 			float angle = atan2f(-ct->forward.x, ct->forward.y);
-			ent->model.transform = MatrixMultiply(MatrixRotateX(90*DEG2RAD), MatrixRotateZ(angle+(90*DEG2RAD)*-1));
+			ent->comp_render->model.transform = MatrixMultiply(MatrixRotateX(90*DEG2RAD), MatrixRotateZ(angle+(90*DEG2RAD)*-1));
 		}
 	}
 
 	EntMove(ent, sect, handler, dt);
-	//ent->anim_frame = (ent->anim_frame + 1) % ent->animations[ent->curr_anim].frameCount;
+	//ent->comp_render->anim_frame = (ent->comp_render->anim_frame + 1) % ent->comp_render->animations[ent->comp_render->curr_anim].frameCount;
 }
 
 void MaintainerDraw(Entity *ent, float dt) {
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Ai *ai = ent->comp_ai;
+
+	Vector3 pos = EntRenderPosition(ent->comp_transform);
 
 	if(ai->state == STATE_DEAD) {
-		Vector3 pos = ent->comp_transform.position;		
 		pos.z -= 20;
 
 		DrawModelEx(
-			ent->model,
+			ent->comp_render->model,
 			pos,
-			Vector3CrossProduct(ent->comp_transform.forward, UP),
+			Vector3CrossProduct(ent->comp_transform->forward, UP),
 			90,
 			Vector3Scale(Vector3One(), 0.1f),
 			LIGHTGRAY 
@@ -560,18 +838,17 @@ void MaintainerDraw(Entity *ent, float dt) {
 		return;
 	}
 	
-	Vector3 pos = ent->comp_transform.position;
 	//pos.z -= 10;
-	DrawModel(ent->model, pos, 0.1f, LIGHTGRAY);
+	DrawModel(ent->comp_render->model, pos, 0.1f, LIGHTGRAY);
 
-	//Vector3 center = BoxCenter(ent->comp_transform.bounds);
+	//Vector3 center = BoxCenter(ent->comp_transform->bounds);
 	//center.y += 10;
-	//Vector3 forward = ent->comp_transform.forward;
-	//DrawBoundingBox(ent->comp_health.hit_box, PURPLE);
+	//Vector3 forward = ent->comp_transform->forward;
+	//DrawBoundingBox(ent->comp_health->hit_box, PURPLE);
 }
 
 void AiComponentUpdate(Entity *ent, EntityHandler *handler, comp_Ai *ai, Ai_TaskData *task_data, MapSection *sect, float dt) {
-	if(ent->comp_ai.state == STATE_DEAD)
+	if(ent->comp_ai->state == STATE_DEAD)
 		return;
 
 	// Handle interrupts
@@ -582,7 +859,6 @@ void AiComponentUpdate(Entity *ent, EntityHandler *handler, comp_Ai *ai, Ai_Task
 		}
 	}
 
-	AiCheckInputs(ent, handler, sect);
 	AiDoSchedule(ent, handler, sect, ai, task_data, dt);
 
 	ai->task_data.timer--;
@@ -592,39 +868,81 @@ void AiComponentUpdate(Entity *ent, EntityHandler *handler, comp_Ai *ai, Ai_Task
 	}
 }
 
-void AiSystemUpdate(EntityHandler *handler, MapSection *sect, float dt) {
+typedef struct {
+	EntityHandler *handler;
+	MapSection *sect;
+	u16 *ids;
+
+} AiSenseJob;
+
+void AiSenseRun(void *data, u32 first, u32 count, u8 worker) {
+	AiSenseJob *job = data;
+
+	for(u32 i = first; i < first + count; i++)
+		AiCheckInputs(&job->handler->ents[job->ids[i]], job->handler, job->sect);
+}
+
+void AiNavUpdate(EntityHandler *handler, MapSection *sect) {
 	Entity *player = &handler->ents[handler->player_id];
-	player->comp_ai.navgraph_id = -1;
+	player->comp_ai->navgraph_id = -1;
 	for(u16 j = 0; j < sect->navgraph_count; j++) {
 		NavGraph *graph = &sect->navgraphs[j];
 
-		int closest_node = FindClosestNavNodeInGraph(player->comp_transform.position, graph);
+		int closest_node = FindReachableNavNodeInGraph(player->comp_transform->position, graph, sect);
 		if(closest_node > -1) {
-			player->comp_ai.navgraph_id = j;
-			player->comp_ai.curr_navnode_id = closest_node;
+			player->comp_ai->navgraph_id = j;
+			player->comp_ai->curr_navnode_id = closest_node;
 			break;
 		}
 	}
 
-	for(u16 i = 0; i < handler->count; i++) {
-		Entity *ent = &handler->ents[i];
+	// One flood toward the player's node is shared by every chasing entity on that graph
+	if(player->comp_ai->navgraph_id > -1) {
+		NavFlowField *flow = &player_flows[player->comp_ai->navgraph_id];
+
+		NavFlowSetTarget(flow, player->comp_ai->curr_navnode_id);
+		NavFlowUpdate(flow, NAV_FLOW_BUDGET_CELLS);
+	}
+
+	// Advance queued path searches, schedules see results this frame
+	NavQueueUpdate(&nav_queue);
+}
+
+void AiSystemUpdate(EntityHandler *handler, MapSection *sect, float dt) {
+	AiDeliverPaths(handler, sect);
+
+	u16 *ids = handler->ai_ids;
+	u16 id_count = 0;
+
+	for(u16 n = 0; n < handler->live_count; n++) {
+		u16 i = handler->live[n];
 		if(handler->player_id == i)
 			continue;
 
-		if(!ent->comp_ai.component_valid)
+		comp_Ai *ai = &handler->ais[i];
+		if(!ai->component_valid || ai->state == STATE_DEAD)
 			continue;
 
-		comp_Ai *ai = &ent->comp_ai;
-		AiComponentUpdate(ent, handler, ai, &ai->task_data, sect, dt);
+		ids[id_count++] = i;
+	}
+
+	// Sense
+	AiSenseJob job = (AiSenseJob) { .handler = handler, .sect = sect, .ids = ids };
+	JobParallelFor(&ent_jobs, id_count, AI_SENSE_CHUNK, AiSenseRun, &job);
+
+	// Apply
+	for(u16 n = 0; n < id_count; n++) {
+		comp_Ai *ai = &handler->ais[ids[n]];
+		AiComponentUpdate(&handler->ents[ids[n]], handler, ai, &ai->task_data, sect, dt);
 	}
 }
 
 // Update senses inputs for an entitie's AI component,
 // executed once per frame for every entity with a valid component.
 void AiCheckInputs(Entity *ent, EntityHandler *handler, MapSection *sect) {
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Ai *ai = ent->comp_ai;
 
-	comp_Transform *ct = &ent->comp_transform;
+	comp_Transform *ct = ent->comp_transform;
 	BvhTree *bvh = &sect->bvh[0];
 
 	// ** Check if player is visible **	
@@ -639,7 +957,7 @@ void AiCheckInputs(Entity *ent, EntityHandler *handler, MapSection *sect) {
 	Entity *player_ent = &handler->ents[handler->player_id];
 
 	Vector3 eye_pos = Vector3Add(ct->position, Vector3Scale(UP, 0.0f));
-	Vector3 to_player = Vector3Normalize(Vector3Subtract(player_ent->comp_transform.position, eye_pos));
+	Vector3 to_player = Vector3Normalize(Vector3Subtract(player_ent->comp_transform->position, eye_pos));
 	float d_to_player = Vector3LengthSqr(to_player);
 
 	// Player is in ai's sight cone
@@ -648,12 +966,12 @@ void AiCheckInputs(Entity *ent, EntityHandler *handler, MapSection *sect) {
 		Ray ray = (Ray) { .position = eye_pos, .direction = to_player };
 
 		EntTraceData ent_tr = EntTraceDataEmpty();
-		TraceEntities(ray, handler, 1000.0f, ent->id, &ent_tr);
+		TraceEntitiesShared(ray, handler, 1000.0f, ent->id, &ent_tr);
 
 		// Trace map geometry
 		// Small affordance to account for spatial partition structure (+32)
 		BvhTraceData tr = TraceDataEmpty();
-		BvhTracePointEx(ray, sect, bvh, 0, &tr, ent_tr.dist + BoundsToRadius(player_ent->comp_transform.bounds));
+		BvhTracePointEx(ray, sect, bvh, 0, &tr, ent_tr.dist + BoundsToRadius(player_ent->comp_transform->bounds));
 
 		// Player hitbox collision closer than possible surface collision.
 		// No obstruction, player is visible 
@@ -665,7 +983,7 @@ void AiCheckInputs(Entity *ent, EntityHandler *handler, MapSection *sect) {
 		/*
 		// Check for obstructions
 		Ray ray = (Ray) { .position = ct->position, .direction = to_player };
-		RayCollision player_coll = GetRayCollisionBox(ray, player_ent->comp_transform.bounds);
+		RayCollision player_coll = GetRayCollisionBox(ray, player_ent->comp_transform->bounds);
 
 		// Trace map geometry
 		// Small affordance to account for spatial partition structure (+32)
@@ -681,18 +999,18 @@ void AiCheckInputs(Entity *ent, EntityHandler *handler, MapSection *sect) {
 		*/
 	}
 
-	if(ai->task_data.target_entity == handler->player_id && (ai->input_mask & AI_INPUT_SEE_PLAYER)) {
-		ai->task_data.known_target_position = player_ent->comp_transform.position;
+	if(ai->task_data.target_entity == EntHandleOf(handler, handler->player_id) && (ai->input_mask & AI_INPUT_SEE_PLAYER)) {
+		ai->task_data.known_target_position = player_ent->comp_transform->position;
 	}
 	// ***
 
 	ai->input_mask &= ~AI_INPUT_HEAR_PLAYER;
 	bool in_hearing_range = (d_to_player < ai->hear_distance*ai->hear_distance);
-	if(in_hearing_range && Vector3LengthSqr(player_ent->comp_transform.velocity) >= 0.1f) {
+	if(in_hearing_range && Vector3LengthSqr(player_ent->comp_transform->velocity) >= 0.1f) {
 		ai->input_mask |= AI_INPUT_HEAR_PLAYER;
 
 		if(!(ai->input_mask & AI_INPUT_LOST_PLAYER)) {
-			ai->task_data.known_target_position = player_ent->comp_transform.position;
+			ai->task_data.known_target_position = player_ent->comp_transform->position;
 		}
 	}
 }
@@ -767,19 +1085,31 @@ int FindClosestNavNode(Vector3 ent_position, MapSection *sect) {
 	return id;
 }
 
+void AiNavGraphChanged(NavGraph *graph) {
+	NavPathCacheInvalidate(&nav_queue.cache, graph);
+}
+
 void AiNavSetup(EntityHandler *handler, MapSection *sect) {
-	for(u16 i = 0; i < handler->count; i++) {
+	// Cached node pairs are dropped on every setup,
+	// paths only when their graph changes (AiNavGraphChanged) so they outlive respawns
+	NavLosCacheClear(sect);
+
+	for(u8 i = 0; i < MAX_NAVGRAPHS; i++)
+		NavFlowReset(&player_flows[i], (i < sect->navgraph_count) ? &sect->navgraphs[i] : NULL);
+
+	for(u16 n = 0; n < handler->live_count; n++) {
+		u16 i = handler->live[n];
 		Entity *ent = &handler->ents[i];	
 
-		comp_Ai *ai = &ent->comp_ai;
+		comp_Ai *ai = ent->comp_ai;
 		if(!ai->component_valid) continue;
 
-		comp_Transform *ct = &ent->comp_transform;
+		comp_Transform *ct = ent->comp_transform;
 
 		for(u16 j = 0; j < sect->navgraph_count; j++) {
 			NavGraph *graph = &sect->navgraphs[j];
 
-			int closest_node = FindClosestNavNodeInGraph(ct->position, graph);
+			int closest_node = FindReachableNavNodeInGraph(ct->position, graph, sect);
 			if(closest_node > -1) {
 				ai->navgraph_id = j;
 				ai->curr_navnode_id = closest_node;
@@ -793,29 +1123,31 @@ void AiNavSetup(EntityHandler *handler, MapSection *sect) {
 		}
 	}
 
-	for(u16 i = 0; i < handler->count; i++) {
+	for(u16 n = 0; n < handler->live_count; n++) {
+		u16 i = handler->live[n];
 		Entity *ent = &handler->ents[i];	
-		comp_Ai *ai = &ent->comp_ai;
+		comp_Ai *ai = ent->comp_ai;
 
 		if(ent->type == ENT_MAINTAINER) {
 			//printf("graph: %d\n", ai->navgraph_id);
 			//printf("node: %d\n", ai->curr_navnode_id);
 
-			//MakeNavPath(ent, &sect->navgraphs[ent->comp_ai.navgraph_id], 6);
+			//MakeNavPath(ent, &sect->navgraphs[ent->comp_ai->navgraph_id], 6);
 			//ai->curr_schedule = SCHED_PATROL;
 			//ai->task_data.task_id = TASK_MAKE_PATROL_PATH;
 		}
 	}
 }
 
-#define NULL_NODE -1
+// Search state for paths made on the main thread, local is for searches inside clusters
+NavSearch main_nav_search = {0};
+NavSearch main_nav_local = {0};
+
 bool MakeNavPath(Entity *ent, NavGraph *graph, i16 target_id) {
 	if(target_id == -1)	
 		return false;
 
-	bool dest_found = false;
-
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Ai *ai = ent->comp_ai;
 
 	NavPath *path = &ai->task_data.path;
 
@@ -823,122 +1155,141 @@ bool MakeNavPath(Entity *ent, NavGraph *graph, i16 target_id) {
 	ai->task_data.path_set = false;
 
 	i16 start = ai->curr_navnode_id;
-	u16 node_count = graph->node_count;
-
-	float g_cost[node_count], f_cost[node_count];
-	bool open[node_count], closed[node_count];
-	i16 parent[node_count];
+	if(start < 0 || start >= graph->node_count)
+		return false;
 
-	for(i16 i = 0; i < node_count; i++) {
-		g_cost[i] = FLT_MAX, f_cost[i] = FLT_MAX;
-		open[i] = false, closed[i] = false;
-		parent[i] = NULL_NODE;
+	if(!NavRouteFind(graph, &main_nav_search, &main_nav_local, &ai->task_data.route, path, start, target_id)) {
+		path->targ = ai->curr_navnode_id;
+		return false;
 	}
 
-	g_cost[start] = 0.0f;
-	f_cost[start] = Vector3Distance(graph->nodes[start].position, graph->nodes[target_id].position);
+	if(ptr_handler_sect)
+		SmoothNavPath(ptr_handler_sect, graph, path);
 
-	open[start] = true;
+	path->curr = 0;
+	ai->task_data.path_set = true;
+	ai->curr_navnode_id = path->nodes[0];
 
-	parent[start] = NULL_NODE;
+	return true;
+}
 
-	while(true) {
-		i16 curr = NULL_NODE;
-		float best = FLT_MAX;		
+bool AiRequestPath(Entity *ent, NavGraph *graph, i16 target_id, u8 priority) {
+	comp_Ai *ai = ent->comp_ai;
+	Ai_TaskData *task = &ai->task_data;
 
-		for(u16 i = 0; i < node_count; i++) {
-			if(open[i] && f_cost[i] < best) {
-				best = f_cost[i];
-				curr = i;
-			}
-		}
+	AiCancelPath(ent);
 
-		if(curr == NULL_NODE) {
-			ai->task_data.path_set = false;
-			path->count = 0;
-			path->targ = ai->curr_navnode_id;
-			return false;
-		}
+	task->path.count = 0;
+	task->route.count = 0;
+	task->path_set = false;
 
-		if(curr == target_id)
-			break;
+	i16 start = ai->curr_navnode_id;
+	if(target_id < 0 || target_id >= graph->node_count || start < 0 || start >= graph->node_count)
+		return false;
 
-		open[curr] = false;
-		closed[curr] = true;
+	task->path_request = NavRequestSubmit(&nav_queue, graph, start, target_id, priority, EntHandleOf(ptr_handler_self, ent->id));
+	if(task->path_request == NAV_NULL_REQUEST)
+		return false;
 
-		u8 adj_count = 0;
-		u16 adj[MAX_EDGES_PER_NODE] = { 0 };
-		GetConnectedNodes(&graph->nodes[curr], adj, &adj_count, graph);
+	task->path_status = NAV_SEARCH_RUNNING;
+	return true;
+}
 
-		for(u8 j = 0; j < adj_count; j++) {
-			i16 neighbour = adj[j];
+void AiCancelPath(Entity *ent) {
+	Ai_TaskData *task = &ent->comp_ai->task_data;
 
-			if(closed[neighbour])
-				continue;
+	NavRequestCancel(&nav_queue, task->path_request);
 
-			float step_cost = Vector3Distance(graph->nodes[curr].position, graph->nodes[neighbour].position);
-			float tentative = g_cost[curr] + step_cost;
+	task->path_request = NAV_NULL_REQUEST;
+	task->path_status = NAV_SEARCH_IDLE;
+}
 
-			if(!open[neighbour] || tentative < g_cost[neighbour]) {
-				parent[neighbour] = curr;
-				g_cost[neighbour] = tentative;
+void AiDropPaths(EntityHandler *handler) {
+	for(u16 i = 0; i < NAV_MAX_REQUESTS; i++)
+		NavRequestCancel(&nav_queue, NavRequestHandle(&nav_queue, i));
 
-				f_cost[neighbour] = tentative + Vector3Distance(graph->nodes[neighbour].position, graph->nodes[target_id].position);
-				open[neighbour] = true;
-			}
-		}
+	for(u16 n = 0; n < handler->live_count; n++) {
+		u16 i = handler->live[n];
+		Ai_TaskData *task = &handler->ais[i].task_data;
+
+		task->path_request = NAV_NULL_REQUEST;
+
+		// Finished results were delivered already and are still usable, only searches in flight are lost
+		if(task->path_status == NAV_SEARCH_RUNNING)
+			task->path_status = NAV_SEARCH_IDLE;
 	}
+}
 
-	path->count = 0;
-	i16 curr = target_id;
+void AiDeliverPaths(EntityHandler *handler, MapSection *sect) {
+	for(u16 i = 0; i < NAV_MAX_REQUESTS; i++) {
+		NavRequest *req = &nav_queue.requests[i];
+		if(req->status != NAV_SEARCH_FOUND && req->status != NAV_SEARCH_FAILED)
+			continue;
 
-	bool reached_start = false;
-	i16 test = target_id;
-	while(test != NULL_NODE) {
-		if(test == start) {
-			reached_start = true;
-			break;
+		u32 handle = NavRequestHandle(&nav_queue, i);
+
+		// Owner was freed while searching
+		Entity *owner = EntGet(handler, req->owner);
+		if(!owner) {
+			NavRequestCancel(&nav_queue, handle);
+			continue;
 		}
-		test = parent[test];
-	}
 
-	if(!reached_start) {
-		//printf("did not reach start\n");
-		dest_found = false;
-		return dest_found;
-	}
+		comp_Ai *ai = owner->comp_ai;
+		Ai_TaskData *task = &ai->task_data;
 
-	while(curr != NULL_NODE && path->count < MAX_PATH_NODES - 1) {
-		path->nodes[path->count++] = curr;
-		curr = parent[curr];
-	}
+		// Owner moved on to another request
+		if(task->path_request != handle) {
+			NavRequestCancel(&nav_queue, handle);
+			continue;
+		}
 
-	for(u16 i = 0; i < (path->count >> 1); i++) {
-		u16 temp = path->nodes[i];
-		path->nodes[i] = path->nodes[path->count - 1 - i];
-		path->nodes[path->count - 1 - i] = temp;
-	}
-	
-	path->curr = 0;
-	ai->task_data.path_set = true;
-	ai->curr_navnode_id = path->nodes[0];
+		task->path_status = req->status;
+
+		if(req->status == NAV_SEARCH_FOUND) {
+			task->path = req->path;
+			task->path.curr = 0;
+			task->route = req->route;
+			task->path_set = true;
+
+			SmoothNavPath(sect, req->graph, &task->path);
+
+			ai->curr_navnode_id = task->path.nodes[0];
 
-	dest_found = true;
-	return dest_found;
+		} else {
+			task->path.count = 0;
+			task->path.targ = ai->curr_navnode_id;
+		}
+
+		// Releases slot, handle is now stale
+		NavRequestCancel(&nav_queue, handle);
+		task->path_request = NAV_NULL_REQUEST;
+	}
 }
 
 bool AiMoveToNode(Entity *ent, NavGraph *graph, u16 path_id) {
-	comp_Transform *ct = &ent->comp_transform;
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Ai *ai = ent->comp_ai;
 
 	Ai_TaskData *task = &ai->task_data;
 	NavPath *path = &task->path;
 
 	if(path_id >= path->count) {
-		//printf("move not possible, path max overflow\n");
-		//ct->velocity = Vector3Zero();
-		ai->wish_dir = Vector3Zero();
-		return false;
+		// Route has more segments, refine the next one from the end of this path.
+		// First node of the new segment is where we are, continue from the second
+		u16 from = (path->count) ? path->nodes[path->count - 1] : ai->curr_navnode_id;
+		if(NavRouteAdvance(graph, &main_nav_search, &main_nav_local, &task->route, path, from)) {
+			if(ptr_handler_sect)
+				SmoothNavPath(ptr_handler_sect, graph, path);
+
+			path_id = (path->count > 1) ? 1 : 0;
+			path->curr = path_id + 1;
+
+		} else {
+			//printf("move not possible, path max overflow\n");
+			//ct->velocity = Vector3Zero();
+			ai->wish_dir = Vector3Zero();
+			return false;
+		}
 	}
 
 	if(path_id >= graph->node_count) {
@@ -948,8 +1299,21 @@ bool AiMoveToNode(Entity *ent, NavGraph *graph, u16 path_id) {
 		return false;
 	}
 
-	Vector3 point = graph->nodes[path->nodes[path_id]].position;
-	task->target_position = point;
+	AiSteerToNode(ent, graph, path->nodes[path_id]);
+
+	return true;
+}
+
+void AiSteerToNode(Entity *ent, NavGraph *graph, u16 node_id) {
+	AiSteerToPoint(ent, graph->nodes[node_id].position);
+	ent->comp_ai->curr_navnode_id = node_id;
+}
+
+void AiSteerToPoint(Entity *ent, Vector3 point) {
+	comp_Transform *ct = ent->comp_transform;
+	comp_Ai *ai = ent->comp_ai;
+
+	ai->task_data.target_position = point;
 	
 	Vector3 dir = (Vector3Subtract(point, ct->position));
 	dir.y = 0;
@@ -958,24 +1322,36 @@ bool AiMoveToNode(Entity *ent, NavGraph *graph, u16 path_id) {
 
 	/*
 	float angle = atan2f(ct->forward.x, ct->forward.z);
-	ent->model.transform = MatrixRotateY(angle + 90 * DEG2RAD);
+	ent->comp_render->model.transform = MatrixRotateY(angle + 90 * DEG2RAD);
 	*/
 	float angle = atan2f(ct->forward.x, ct->forward.y);
-	ent->model.transform = MatrixRotateZ(angle + 90 * DEG2RAD);
+	ent->comp_render->model.transform = MatrixRotateZ(angle + 90 * DEG2RAD);
 	ai->wish_dir = Vector3Add(Vector3Scale(ai->wish_dir, 0.1f), dir); 
 	ai->wish_dir = Vector3Normalize(ai->wish_dir);
- 
-	ai->curr_navnode_id = path->nodes[path_id];
 
 	ai->state = STATE_MOVE;
+}
+
+// Navmesh queries from schedules, they run on the main thread
+NavSearch main_mesh_search = {0};
+
+#define AI_MESH_CORNERS 8
+bool AiSteerOnMesh(Entity *ent, NavMesh *mesh, Vector3 target) {
+	Vector3 corners[AI_MESH_CORNERS];
+	u16 count = NavMeshFindPath(mesh, &main_mesh_search, ent->comp_transform->position, target, corners, AI_MESH_CORNERS);
 
+	// First corner is where we are
+	if(count < 2)
+		return false;
+
+	AiSteerToPoint(ent, corners[1]);
 	return true;
 }
 
 #define NODE_REACH_RADIUS (32.0f*32.0f)
 void AiPatrol(Entity *ent, MapSection *sect, float dt) {
-	comp_Transform *ct = &ent->comp_transform;
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Transform *ct = ent->comp_transform;
+	comp_Ai *ai = ent->comp_ai;
 
 	Ai_TaskData *task = &ai->task_data;
 	NavPath *path = &task->path;
@@ -983,9 +1359,20 @@ void AiPatrol(Entity *ent, MapSection *sect, float dt) {
 	NavGraph *graph = &sect->navgraphs[ai->navgraph_id];
 
 	if(task->task_id == TASK_MAKE_PATROL_PATH) {
-		//printf("setting path...\n");
-		u16 new_targ = GetRandomValue(0, graph->node_count-1);
-		if(MakeNavPath(ent, graph, new_targ) == true) {
+		// Wait for queued search
+		if(task->path_status == NAV_SEARCH_RUNNING)
+			return;
+
+		if(task->path_status == NAV_SEARCH_IDLE) {
+			//printf("setting path...\n");
+			u16 new_targ = GetRandomValue(0, graph->node_count-1);
+			if(AiRequestPath(ent, graph, new_targ, NAV_PRIORITY_LOW))
+				return;
+		}
+
+		task->path_status = NAV_SEARCH_IDLE;
+
+		if(task->path_set) {
 			task->task_id = TASK_GOTO_POINT;
 			ai->state = STATE_MOVE;
 
@@ -1035,24 +1422,38 @@ void AiPatrol(Entity *ent, MapSection *sect, float dt) {
 }
 
 void AiFixFriendSchedule(Entity *ent, EntityHandler *handler, MapSection *sect, float dt) {
-	comp_Transform *ct = &ent->comp_transform;
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Transform *ct = ent->comp_transform;
+	comp_Ai *ai = ent->comp_ai;
 
 	Ai_TaskData *task = &ai->task_data;
 	NavPath *path = &task->path;
 
 	NavGraph *graph = &sect->navgraphs[ai->navgraph_id];
 
-	Entity *friend = &handler->ents[ai->task_data.target_entity];
+	Entity *friend = EntGet(handler, ai->task_data.target_entity);
+
+	// Friend was freed, nothing left to fix
+	if(!friend) {
+		AiCancelPath(ent);
+		ai->curr_schedule = SCHED_MAINTAINER_ATTACK;
+		return;
+	}
 
 	// **
 	// Move to target entity
-	if(task->task_id == TASK_GOTO_POINT && (friend->comp_ai.input_mask & AI_INPUT_SELF_GLITCHED)) {
-		if(friend->comp_ai.navgraph_id != ai->navgraph_id)
+	if(task->task_id == TASK_GOTO_POINT && (friend->comp_ai->input_mask & AI_INPUT_SELF_GLITCHED)) {
+		if(friend->comp_ai->navgraph_id != ai->navgraph_id)
 			return;
 
 		if(!task->path_set) {
-			MakeNavPath(ent, graph, FindClosestNavNodeInGraph(friend->comp_transform.position, graph));	
+			if(task->path_status == NAV_SEARCH_IDLE)
+				AiRequestPath(ent, graph, FindClosestNavNodeInGraph(friend->comp_transform->position, graph), NAV_PRIORITY_HIGH);
+
+			if(task->path_status == NAV_SEARCH_RUNNING)
+				return;
+
+			// Failed searches leave an empty path, same as before
+			task->path_status = NAV_SEARCH_IDLE;
 			task->path_set = true;
 			task->task_id = TASK_GOTO_POINT;
 			return;
@@ -1067,7 +1468,7 @@ void AiFixFriendSchedule(Entity *ent, EntityHandler *handler, MapSection *sect,
 		}
 
 		Vector3 to_targ = (Vector3Subtract(task->target_position, ct->position));
-		if(Vector3LengthSqr(to_targ) <= NODE_REACH_RADIUS || CheckCollisionBoxes(ct->bounds, friend->comp_transform.bounds) ) { 
+		if(Vector3LengthSqr(to_targ) <= NODE_REACH_RADIUS || CheckCollisionBoxes(ct->bounds, friend->comp_transform->bounds) ) { 
 			if(!AiMoveToNode(ent, graph, path->curr++)) {
 				ct->velocity = Vector3Zero();
 
@@ -1078,7 +1479,7 @@ void AiFixFriendSchedule(Entity *ent, EntityHandler *handler, MapSection *sect,
 			}
 		}
 
-		if(CheckCollisionBoxes(ct->bounds, friend->comp_transform.bounds)) {
+		if(CheckCollisionBoxes(ct->bounds, friend->comp_transform->bounds)) {
 			ct->velocity = Vector3Zero();
 
 			task->task_id = TASK_DO_FIX;
@@ -1086,7 +1487,13 @@ void AiFixFriendSchedule(Entity *ent, EntityHandler *handler, MapSection *sect,
 			
 			return;
 		}
-	} else if (task->task_id == TASK_GOTO_POINT && !(friend->comp_ai.input_mask & AI_INPUT_SELF_GLITCHED)) {
+	} else if (task->task_id == TASK_GOTO_POINT && !(friend->comp_ai->input_mask & AI_INPUT_SELF_GLITCHED)) {
+		// Wait for backoff path
+		if(task->path_status == NAV_SEARCH_RUNNING)
+			return;
+
+		task->path_status = NAV_SEARCH_IDLE;
+
 		if(Vector3Length(ct->velocity) == 0 && task->task_id == TASK_GOTO_POINT && path->curr == 0) {
 			AiMoveToNode(ent, graph, path->curr++);
 			task->task_id = TASK_GOTO_POINT;
@@ -1113,7 +1520,7 @@ void AiFixFriendSchedule(Entity *ent, EntityHandler *handler, MapSection *sect,
 	if(task->task_id == TASK_DO_FIX) {
 		if(task->timer < 0) {
 			// Perform fix action
-			DoFix(&handler->ents[task->target_entity]);
+			DoFix(friend);
 
 			// End schedule
 			//ai->curr_schedule = SCHED_PATROL;	
@@ -1127,14 +1534,14 @@ void AiFixFriendSchedule(Entity *ent, EntityHandler *handler, MapSection *sect,
 
 			Vector3 targ_point = Vector3Subtract(ct->position, Vector3Scale(ct->forward, 128)); 
 			i16 targ_node = FindClosestNavNodeInGraph(targ_point, graph);
-			MakeNavPath(ent, graph, targ_node);
+			AiRequestPath(ent, graph, targ_node, NAV_PRIORITY_NORMAL);
 		}
 	}
 }
 
 void AiSentrySchedule(Entity *ent, EntityHandler *handler, MapSection *sect, float dt) {
-	comp_Transform *ct = &ent->comp_transform;
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Transform *ct = ent->comp_transform;
+	comp_Ai *ai = ent->comp_ai;
 
 	Ai_TaskData *task = &ai->task_data;
 
@@ -1144,7 +1551,7 @@ void AiSentrySchedule(Entity *ent, EntityHandler *handler, MapSection *sect, flo
 	}
 
 	if(task->task_id == TASK_FIRE_WEAPON) {
-		if(ent->comp_weapon.ammo <= 0) {
+		if(ent->comp_weapon->ammo <= 0) {
 			task->task_id = TASK_RELOAD_WEAPON;
 			task->timer = 10.01f;
 			//printf("reload start\n");
@@ -1154,8 +1561,8 @@ void AiSentrySchedule(Entity *ent, EntityHandler *handler, MapSection *sect, flo
 
 	if(task->task_id == TASK_RELOAD_WEAPON) {
 		if(task->timer <= 0) {
-			ent->comp_weapon.ammo = ent->comp_weapon.clip_size;
-			ent->comp_weapon.cooldown = 10.45f;
+			ent->comp_weapon->ammo = ent->comp_weapon->clip_size;
+			ent->comp_weapon->cooldown = 10.45f;
 			task->task_id = TASK_WAIT_TIME;
 			task->timer = 20.01f;
 			//printf("reload done\n");
@@ -1166,8 +1573,8 @@ void AiSentrySchedule(Entity *ent, EntityHandler *handler, MapSection *sect, flo
 
 	if(ai->input_mask & AI_INPUT_SEE_PLAYER) {
 		task->task_id = TASK_LOOK_AT_ENTITY;
-		task->target_entity = handler->player_id;
-	} else if((ai->task_data.task_id != TASK_FIRE_WEAPON) && ent->comp_weapon.ammo <= 0) {
+		task->target_entity = EntHandleOf(handler, handler->player_id);
+	} else if((ai->task_data.task_id != TASK_FIRE_WEAPON) && ent->comp_weapon->ammo <= 0) {
 		Vector3 targ = Vector3Lerp(ct->forward, ct->start_forward, 0.1f);
 		/*
 		if(ai->input_mask & AI_INPUT_HEAR_PLAYER && ai->input_mask & AI_INPUT_LOST_PLAYER)
@@ -1183,11 +1590,13 @@ void AiSentrySchedule(Entity *ent, EntityHandler *handler, MapSection *sect, flo
 	if(task->task_id == TASK_LOOK_AT_ENTITY) {
 		Vector3 look_point = Vector3Add(ct->position, ct->forward);
 
-		if(ai->input_mask & AI_INPUT_SEE_PLAYER) {
-			look_point = handler->ents[task->target_entity].comp_transform.position;
+		Entity *targ_ent = EntGet(handler, task->target_entity);
+
+		if((ai->input_mask & AI_INPUT_SEE_PLAYER) && targ_ent) {
+			look_point = targ_ent->comp_transform->position;
 			//ai->task_data.known_target_position = look_point;
 
-			Vector3 target_vel = handler->ents[task->target_entity].comp_transform.velocity;
+			Vector3 target_vel = targ_ent->comp_transform->velocity;
 			look_point = Vector3Add(look_point, target_vel);
 		} else if(ai->input_mask & AI_INPUT_LOST_PLAYER) {
 			look_point = ai->task_data.known_target_position;
@@ -1198,16 +1607,16 @@ void AiSentrySchedule(Entity *ent, EntityHandler *handler, MapSection *sect, flo
 
 		if(ai->input_mask & AI_INPUT_SEE_PLAYER) {
 			task->task_id = TASK_FIRE_WEAPON;
-			ent->comp_weapon.ammo = ent->comp_weapon.clip_size;
-			ent->comp_weapon.cooldown = 0.05f;
+			ent->comp_weapon->ammo = ent->comp_weapon->clip_size;
+			ent->comp_weapon->cooldown = 0.05f;
 		} else if(ai->input_mask & AI_INPUT_LOST_PLAYER) {
 			task->task_id = TASK_WAIT_TIME;
 			task->timer = 25.0f;
 		}
 		
 		/*
-		Vector3 look_point = handler->ents[task->target_entity].comp_transform.position;
-		Vector3 target_vel = handler->ents[task->target_entity].comp_transform.velocity;
+		Vector3 look_point = handler->ents[task->target_entity].comp_transform->position;
+		Vector3 target_vel = handler->ents[task->target_entity].comp_transform->velocity;
 		look_point = Vector3Add(look_point, target_vel);
 
 		Vector3 targ = Vector3Normalize(Vector3Subtract(look_point, ct->position));
@@ -1215,8 +1624,8 @@ void AiSentrySchedule(Entity *ent, EntityHandler *handler, MapSection *sect, flo
 
 		if(ai->input_mask & AI_INPUT_SEE_PLAYER) {
 			task->task_id = TASK_FIRE_WEAPON;
-			ent->comp_weapon.ammo = 40;
-			ent->comp_weapon.cooldown = 0.05f;
+			ent->comp_weapon->ammo = 40;
+			ent->comp_weapon->cooldown = 0.05f;
 		} else {
 			task->task_id = TASK_WAIT_TIME;
 			task->timer = 1.0f;
@@ -1226,9 +1635,9 @@ void AiSentrySchedule(Entity *ent, EntityHandler *handler, MapSection *sect, flo
 }
 
 void AiSentryDisruptionSchedule(Entity *ent, EntityHandler *handler, MapSection *sect, float dt) {
-	comp_Transform *ct = &ent->comp_transform;
-	comp_Ai *ai = &ent->comp_ai;
-	comp_Weapon *weap = &ent->comp_weapon;
+	comp_Transform *ct = ent->comp_transform;
+	comp_Ai *ai = ent->comp_ai;
+	comp_Weapon *weap = ent->comp_weapon;
 
 	Ai_TaskData *task = &ai->task_data;
 
@@ -1242,57 +1651,62 @@ void AiSentryDisruptionSchedule(Entity *ent, EntityHandler *handler, MapSection
 }
 
 void AiChasePlayerSchedule(Entity *ent, EntityHandler *handler, MapSection *sect, float dt) {
-	comp_Transform *ct = &ent->comp_transform;
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Transform *ct = ent->comp_transform;
+	comp_Ai *ai = ent->comp_ai;
 
 	Ai_TaskData *task = &ai->task_data;
-	NavPath *path = &task->path;
 
 	NavGraph *graph = &sect->navgraphs[ai->navgraph_id];
 
 	Entity *player = &handler->ents[handler->player_id];
 
-	if(player->comp_ai.navgraph_id != ai->navgraph_id) {
+	if(player->comp_ai->navgraph_id != ai->navgraph_id) {
 		//ct->velocity = Vector3Zero();
 		return;
 	}
 
+	// Hops come from the shared flow field, a search left over from another schedule isn't needed
+	if(task->path_status != NAV_SEARCH_IDLE)
+		AiCancelPath(ent);
+
 	// **
 	// Move to target entity
 	if(task->task_id == TASK_GOTO_POINT) {
+		// Head to the node we're on first
 		if(!task->path_set) {
-			MakeNavPath(ent, graph, FindClosestNavNodeInGraph(player->comp_transform.position, graph));	
+			AiSteerToNode(ent, graph, ai->curr_navnode_id);
 			task->path_set = true;
-			task->task_id = TASK_GOTO_POINT;
-			return;
-		}
-
-		if(Vector3Length(ct->velocity) == 0 && task->task_id == TASK_GOTO_POINT && path->curr == 0) {
-			AiMoveToNode(ent, graph, path->curr++);
-			task->task_id = TASK_GOTO_POINT;
-
-			ai->state = STATE_MOVE;
 			return;
 		}
 
 		Vector3 to_targ = (Vector3Subtract(task->target_position, ct->position));
 		if(Vector3LengthSqr(to_targ) <= NODE_REACH_RADIUS) {
-			if(!AiMoveToNode(ent, graph, path->curr++)) {
-				task->path_set = false;
+			i32 next = NavFlowNext(&player_flows[ai->navgraph_id], ai->curr_navnode_id);
+
+			// At the player's node, or flood hasn't reached this node yet
+			if(next == NAV_NULL_NODE) {
+				// Nodes are sparse, close the rest of the way over the navmesh
+				if(ai->curr_navnode_id == player->comp_ai->curr_navnode_id && 
+				   AiSteerOnMesh(ent, &sect->navmesh, player->comp_transform->position))
+					return;
+
+				ai->wish_dir = Vector3Zero();
 				return;
 			}
+
+			AiSteerToNode(ent, graph, next);
 		}
 	}
 }
 
 void AiMaintainerAttackSchedule(Entity *ent, EntityHandler *handler, MapSection *sect, float dt) {
-	comp_Transform *ct = &ent->comp_transform;
+	comp_Transform *ct = ent->comp_transform;
 
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Ai *ai = ent->comp_ai;
 	Ai_TaskData *task = &ai->task_data;
 
 	if(ai->input_mask & AI_INPUT_SEE_PLAYER) {
-		task->known_target_position = handler->ents[handler->player_id].comp_transform.position;
+		task->known_target_position = handler->ents[handler->player_id].comp_transform->position;
 
 		if(task->task_id == TASK_THROW_PROJECTILE) {
 			Vector3 dir = ct->forward;
@@ -1318,7 +1732,7 @@ void AiMaintainerAttackSchedule(Entity *ent, EntityHandler *handler, MapSection
 }
 
 void AiMaintainerMakeNewSchedule(Entity *ent, EntityHandler *handler, MapSection *sect, float dt) {
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Ai *ai = ent->comp_ai;
 
 	ai->curr_schedule = ai->prev_schedule;
 	ai->prev_schedule = ai->curr_schedule;
@@ -1332,37 +1746,25 @@ EntTraceData EntTraceDataEmpty() {
 	};
 }
 
-Vector3 TraceEntities(Ray ray, EntityHandler *handler, float max_dist, u16 sender, EntTraceData *trace_data) {
+Vector3 TraceEntitiesEx(Ray ray, EntityHandler *handler, float max_dist, u16 sender, EntTraceData *trace_data, bool shared) {
 	EntGrid *grid = &handler->grid;
-	Coords cell = Vec3ToCoords(ray.position, grid); 
-
-	int step_x = (ray.direction.x > 0) ? 1 : -1;
-	int step_y = (ray.direction.y > 0) ? 1 : -1;
-	int step_z = (ray.direction.z > 0) ? 1 : -1;
-
-	float td_x = fabsf(ENT_GRID_CELL_EXTENTS.x / ray.direction.x); 
-	float td_y = fabsf(ENT_GRID_CELL_EXTENTS.y / ray.direction.y); 
-	float td_z = fabsf(ENT_GRID_CELL_EXTENTS.z / ray.direction.z); 
-
-	Vector3 cell_min = CoordsToVec3(cell, grid);
-	Vector3 cell_max = Vector3Add(cell_min, ENT_GRID_CELL_EXTENTS);
-
-	float tmax_X = (ray.direction.x > 0) ? (cell_max.x - ray.position.x) / ray.direction.x : (cell_min.x - ray.position.x) / ray.direction.x;
-	float tmax_Y = (ray.direction.y > 0) ? (cell_max.y - ray.position.y) / ray.direction.y : (cell_min.y - ray.position.y) / ray.direction.y;
-	float tmax_Z = (ray.direction.z > 0) ? (cell_max.z - ray.position.z) / ray.direction.z : (cell_min.z - ray.position.z) / ray.direction.z;
-
-	float t = 0.0f;
 
 	float ent_hit_dist = max_dist;
 	Vector3 ent_hit_point = ray.position;
 	Vector3 ent_hit_norm = Vector3Zero();
 
-	while(CoordsInBounds(cell, grid) && t < max_dist) {
-		i16 cell_id = CellCoordsToId(cell, grid);
-		EntGridCell *pCell = &grid->cells[cell_id];
+	EntGridRay it;
+	if(shared)
+		EntGridRayBeginShared(&it, grid, ray, max_dist);
+	else
+		EntGridRayBegin(&it, grid, ray, max_dist);
 
-		for(short i = 0; i < pCell->ent_count; i++) {
-			Entity *ent = &handler->ents[pCell->ents[i]];
+	EntGridCell *cell;
+	while((cell = EntGridRayNext(&it, grid, ent_hit_dist))) {
+		u16 *cell_ents = EntGridCellEnts(grid, cell);
+
+		for(u16 i = 0; i < cell->ent_count; i++) {
+			Entity *ent = &handler->ents[cell_ents[i]];
 
 			// Skip collision checks with shooting entity  
 			if(ent->id == sender)
@@ -1374,13 +1776,18 @@ Vector3 TraceEntities(Ray ray, EntityHandler *handler, float max_dist, u16 sende
 			if(!(ent->flags & ENT_COLLIDERS))
 				continue;
 
-			Vector3 to_ent = Vector3Subtract(ent->comp_transform.position, ray.position);
+			// Already tested in a previous cell.
+			// Shared traces can't mark ids, testing one twice gives the same distance anyway
+			if(!shared && !EntGridVisit(grid, ent->id))
+				continue;
+
+			Vector3 to_ent = Vector3Subtract(ent->comp_transform->position, ray.position);
 			if(Vector3DotProduct(to_ent, ray.direction) < 0) 
 				continue;
 			
 			// * NOTE:
 			// Change from transform bounds to actual damage hit box later 
-			RayCollision coll = GetRayCollisionBox(ray, ent->comp_transform.bounds);
+			RayCollision coll = GetRayCollisionBox(ray, ent->comp_transform->bounds);
 				
 			if(coll.hit && coll.distance < ent_hit_dist && coll.distance < max_dist) {
 				ent_hit_dist = coll.distance;
@@ -1390,28 +1797,6 @@ Vector3 TraceEntities(Ray ray, EntityHandler *handler, float max_dist, u16 sende
 				trace_data->hit_ent = ent->id;
 			}
 		}
-
-		if(tmax_X < tmax_Y) {
-			if(tmax_X < tmax_Z) {
-				cell.c += step_x;
-				t = tmax_X;
-				tmax_X += td_x;
-			} else {
-				cell.t += step_z;
-				t = tmax_Z;
-				tmax_Z += td_z;
-			}
-		} else {
-			if(tmax_X < tmax_Z) {
-				cell.r += step_y;
-				t = tmax_Y;
-				tmax_Y += td_z;
-			} else {
-				cell.t += step_z;
-				t = tmax_Z;
-				tmax_Z += td_z;
-			}
-		}
 	}
 
 	trace_data->dist = ent_hit_dist;
@@ -1421,6 +1806,14 @@ Vector3 TraceEntities(Ray ray, EntityHandler *handler, float max_dist, u16 sende
 	return ent_hit_point;
 }
 
+Vector3 TraceEntities(Ray ray, EntityHandler *handler, float max_dist, u16 sender, EntTraceData *trace_data) {
+	return TraceEntitiesEx(ray, handler, max_dist, sender, trace_data, false);
+}
+
+Vector3 TraceEntitiesShared(Ray ray, EntityHandler *handler, float max_dist, u16 sender, EntTraceData *trace_data) {
+	return TraceEntitiesEx(ray, handler, max_dist, sender, trace_data, true);
+}
+
 Vector3 TraceBullet(EntityHandler *handler, MapSection *sect, Vector3 origin, Vector3 dir, u16 sender, bool *hit, bool dummy) {
 	// Two steps: 
 	// 1. Trace surfaces of the level 
@@ -1437,86 +1830,17 @@ Vector3 TraceBullet(EntityHandler *handler, MapSection *sect, Vector3 origin, Ve
 	BvhTracePointEx(ray, sect, bvh, 0, &tr, FLT_MAX);
 	if(tr.hit) *hit = true;
 
-	// 2. DDA for entities using static grid
-	EntGrid *grid = &handler->grid;
-	Coords cell = Vec3ToCoords(origin, grid); 
-
-	int step_x = (dir.x > 0) ? 1 : -1;
-	int step_y = (dir.y > 0) ? 1 : -1;
-	int step_z = (dir.z > 0) ? 1 : -1;
-
-	float td_x = fabsf((ENT_GRID_CELL_EXTENTS.x) / dir.x); 
-	float td_y = fabsf((ENT_GRID_CELL_EXTENTS.y) / dir.y); 
-	float td_z = fabsf((ENT_GRID_CELL_EXTENTS.z) / dir.z); 
-
-	Vector3 cell_min = CoordsToVec3(cell, grid);
-	Vector3 cell_max = Vector3Add(cell_min, ENT_GRID_CELL_EXTENTS);
-
-	float tmax_X = (dir.x > 0) ? (cell_max.x - origin.x) / dir.x : (cell_min.x - origin.x) / dir.x;
-	float tmax_Y = (dir.y > 0) ? (cell_max.y - origin.y) / dir.y : (cell_min.y - origin.y) / dir.y;
-	float tmax_Z = (dir.z > 0) ? (cell_max.z - origin.z) / dir.z : (cell_min.z - origin.z) / dir.z;
-
-	float t = 0.0f;
-
-	float ent_hit_dist = FLT_MAX;
-	Vector3 ent_hit_point = ray.position;
-
-	i16 ent_hit_id = -1;
-
-	while(CoordsInBounds(cell, grid) && t < tr.distance) {
-		i16 cell_id = CellCoordsToId(cell, grid);
-		EntGridCell *pCell = &grid->cells[cell_id];
-
-		for(short i = 0; i < pCell->ent_count; i++) {
-			Entity *ent = &handler->ents[pCell->ents[i]];
-
-			// Skip collision checks with shooting entity  
-			if(ent->id == sender)
-				continue;
-
-			if(!(ent->flags & ENT_ACTIVE))
-				continue;
-				
-			if(!(ent->flags & ENT_COLLIDERS))
-				continue;
-			
-			// * NOTE:
-			// Change from transform bounds to actual damage hit box later 
-			RayCollision coll = GetRayCollisionBox(ray, ent->comp_transform.bounds);
-				
-			if(coll.hit && coll.distance <= ent_hit_dist) {
-				ent_hit_dist = coll.distance;
-				ent_hit_point = coll.point;
+	// 2. 
+	// Entities up to the level hit, using grid
+	EntTraceData ent_tr = EntTraceDataEmpty();
+	TraceEntities(ray, handler, tr.distance, sender, &ent_tr);
 
-				ent_hit_id = ent->id;
+	float ent_hit_dist = ent_tr.dist;
+	Vector3 ent_hit_point = ent_tr.point;
+	i16 ent_hit_id = ent_tr.hit_ent;
 
-				*hit = true;
-			}
-		}
+	if(ent_hit_id > -1) *hit = true;
 
-		if(tmax_X < tmax_Y) {
-			if(tmax_X < tmax_Z) {
-				cell.c += step_x;
-				t = tmax_X;
-				tmax_X += td_x;
-			} else {
-				cell.t += step_z;
-				t = tmax_Z;
-				tmax_Z += td_z;
-			}
-		} else {
-			if(tmax_X < tmax_Z) {
-				cell.r += step_y;
-				t = tmax_Y;
-				tmax_Y += td_z;
-			} else {
-				cell.t += step_z;
-				t = tmax_Z;
-				tmax_Z += td_z;
-			}
-		}
-	}
-	
 	bool ent_first = (ent_hit_dist < tr.distance);
 	if(ent_first) {
 		dest = ent_hit_point;	
@@ -1527,7 +1851,7 @@ Vector3 TraceBullet(EntityHandler *handler, MapSection *sect, Vector3 origin, Ve
 
 	if(*hit && ent_hit_id > -1 && !dummy) {
 		Entity *hit_ent = &handler->ents[ent_hit_id];
-		OnHitEnt(hit_ent, handler->ents[sender].comp_weapon.damage);
+		OnHitEnt(hit_ent, handler->ents[sender].comp_weapon->damage);
 	}
 
 	debug_bullet_dest = dest;
@@ -1555,10 +1879,10 @@ Vector3 TraceBullet(EntityHandler *handler, MapSection *sect, Vector3 origin, Ve
 void DebugDrawEntText(EntityHandler *handler, Camera3D cam) {
 	Vector3 cam_dir = Vector3Normalize(Vector3Subtract(cam.target, cam.position));
 
-	for(u16 i = 0; i < handler->count; i++) {
-
+	for(u16 n = 0; n < handler->live_count; n++) {
+		u16 i = handler->live[n];
 		Entity *ent = &handler->ents[i];
-		comp_Transform *ct = &ent->comp_transform;
+		comp_Transform *ct = ent->comp_transform;
 
 		Vector3 to_cam = Vector3Normalize(Vector3Subtract(cam.position, ct->position));
 		if(Vector3DotProduct(to_cam, cam_dir) > 0) continue;
@@ -1580,11 +1904,12 @@ void AlertMaintainers(EntityHandler *handler, u16 disrupted_id) {
 	//puts("AlertMaintainers");
 
 	Entity *disrupted_ent = &handler->ents[disrupted_id];
-	comp_Ai *disrupted_ai = &disrupted_ent->comp_ai;
+	comp_Ai *disrupted_ai = disrupted_ent->comp_ai;
 
-	for(u16 i = 0; i < handler->count; i++) {
+	for(u16 n = 0; n < handler->live_count; n++) {
+		u16 i = handler->live[n];
 		Entity *ent = &handler->ents[i];
-		comp_Ai *ai = &ent->comp_ai;
+		comp_Ai *ai = ent->comp_ai;
 
 		if(!ai->component_valid)	
 			continue;
@@ -1595,7 +1920,7 @@ void AlertMaintainers(EntityHandler *handler, u16 disrupted_id) {
 		if(ent->type == ENT_DISRUPTOR)
 			continue;
 
-		if(ent->comp_ai.state == STATE_DEAD)
+		if(ent->comp_ai->state == STATE_DEAD)
 			return;
 	
 		if(ai->navgraph_id != disrupted_ai->navgraph_id)	
@@ -1615,13 +1940,16 @@ void AlertMaintainers(EntityHandler *handler, u16 disrupted_id) {
 		ai->curr_schedule = SCHED_FIX_FRIEND;
 		ai->task_data.schedule_id = SCHED_FIX_FRIEND;
 		ai->task_data.task_id = TASK_GOTO_POINT;
-		ai->task_data.target_entity = disrupted_id;
+		ai->task_data.target_entity = EntHandleOf(handler, disrupted_id);
 		ai->task_data.path_set = false;
+
+		// Drop any search started by the previous schedule
+		AiCancelPath(ent);
 	}
 }
 
 void OnHitEnt(Entity *ent, short damage) {
-	comp_Health *health = &ent->comp_health;
+	comp_Health *health = ent->comp_health;
 	
 	if(health->damage_cooldown > 0)
 		return;
@@ -1629,11 +1957,11 @@ void OnHitEnt(Entity *ent, short damage) {
 	health->amount -= damage;
 	health->damage_cooldown = 0.1f;
 
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Ai *ai = ent->comp_ai;
 
 	if(health->amount <= 0) {
-		ent->comp_ai.state = STATE_DEAD;
-		ent->comp_ai.curr_schedule = SCHED_DEAD;
+		ent->comp_ai->state = STATE_DEAD;
+		ent->comp_ai->curr_schedule = SCHED_DEAD;
 
 		ent->flags &= ~ENT_COLLIDERS;
 	}
@@ -1650,15 +1978,15 @@ void OnHitTurret(Entity *ent, short damage) {
 }
 
 void OnHitMaintainer(Entity *ent, short damage) {
-	comp_Transform *ct = &ent->comp_transform;
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Transform *ct = ent->comp_transform;
+	comp_Ai *ai = ent->comp_ai;
 
 	if(ai->input_mask & AI_INPUT_SELF_GLITCHED) {
-		ent->comp_health.amount = 0;
+		ent->comp_health->amount = 0;
 		ai->state = STATE_DEAD;
 	}
 
-	Vector3 to_player = Vector3Subtract(ptr_handler_self->ents[ptr_handler_self->player_id].comp_transform.position, ct->position);
+	Vector3 to_player = Vector3Subtract(ptr_handler_self->ents[ptr_handler_self->player_id].comp_transform->position, ct->position);
 	to_player = Vector3Normalize(to_player);
 
 	Vector3 prev_wish = ai->wish_dir;
@@ -1697,7 +2025,7 @@ void OnHitRegulator(Entity *ent, short damage) {
 }
 
 void DoFix(Entity *ent) {
-	ent->comp_ai.input_mask &= ~AI_INPUT_SELF_GLITCHED;
+	ent->comp_ai->input_mask &= ~AI_INPUT_SELF_GLITCHED;
 
 	switch(ent->type) {
 		case ENT_TURRET:
@@ -1715,7 +2043,7 @@ void DoFix(Entity *ent) {
 }
 
 void OnFixTurret(Entity *ent) {
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Ai *ai = ent->comp_ai;
 
 	ai->curr_schedule = SCHED_SENTRY;
 	ai->task_data.schedule_id = SCHED_SENTRY;
@@ -1730,10 +2058,11 @@ void OnFixRegulator(Entity *ent) {
 }
 
 void EntMove(Entity *ent, MapSection *sect, EntityHandler *handler, float dt) {
-	comp_Transform *ct = &ent->comp_transform;
-	comp_Ai *ai = &ent->comp_ai;
+	comp_Transform *ct = ent->comp_transform;
+	comp_Ai *ai = ent->comp_ai;
 
 	ct->bounds = BoxTranslate(ct->bounds, ct->position);
+	EntGridMarkDirty(&handler->grid, ent->id);
 
 	ct->on_ground = pm_CheckGround(ct, ct->position);
 	pm_ApplyGravity(ct, dt);
@@ -1873,39 +2202,19 @@ void ProjectileUpdate(Projectile *projectile, EntityHandler *handler, MapSection
 
 	ct->bounds = BoxTranslate(ct->bounds, ct->position);
 
-	EntGrid *grid = &handler->grid;
-	Coords coords = Vec3ToCoords(ct->position, grid);
-
-	Coords cell_coords[] = {
-		coords,
-		(Coords) { coords.c - 1, coords.r, coords.t - 1 },
-		(Coords) { coords.c + 0, coords.r, coords.t - 1 },
-		(Coords) { coords.c + 1, coords.r, coords.t - 1 },
-		(Coords) { coords.c - 1, coords.r, coords.t + 0 },
-		(Coords) { coords.c + 1, coords.r, coords.t + 0 },
-		(Coords) { coords.c - 1, coords.r, coords.t + 1 },
-		(Coords) { coords.c + 0, coords.r, coords.t + 1 },
-		(Coords) { coords.c + 1, coords.r, coords.t + 1 },
-	};
-	short adj_count = sizeof(cell_coords) / sizeof(cell_coords[0]);
-
-	for(short i = 0; i < adj_count; i++) {
-		if(!CoordsInBounds(cell_coords[i], grid))
-			continue;
-
-		EntGridCell *cell = &grid->cells[CellCoordsToId(cell_coords[i], grid)];
+	u16 near_ents[MAX_ENTS_PER_QUERY];
+	u16 near_count = EntGridQueryBox(&handler->grid, ct->bounds, near_ents, MAX_ENTS_PER_QUERY);
 
-		for(short j = 0; j < cell->ent_count; j++) {
-			i16 ent_id = cell->ents[j]; 
-			Entity *ent = &handler->ents[ent_id];
+	for(u16 i = 0; i < near_count; i++) {
+		Entity *ent = &handler->ents[near_ents[i]];
 
-			if(ent->id == projectile->sender)
-				continue;
+		if(EntHandleOf(handler, ent->id) == projectile->sender)
+			continue;
 
-			if(CheckCollisionBoxes(ct->bounds, ent->comp_transform.bounds)) {
-				// Impact entity
-				ProjectileImpact(projectile, handler, ent_id);
-			}
+		if(CheckCollisionBoxes(ct->bounds, ent->comp_transform->bounds)) {
+			// Impact entity, projectile is cleared
+			ProjectileImpact(projectile, handler, ent->id);
+			return;
 		}
 	}
 
@@ -1919,7 +2228,7 @@ void ProjectileUpdate(Projectile *projectile, EntityHandler *handler, MapSection
 }
 
 void ProjectileDraw(Projectile *projectile) {
-	DrawCubeV(projectile->ct.position, (Vector3) { 8, 8, 8 }, RED);	
+	DrawCubeV(EntRenderPosition(&projectile->ct), (Vector3) { 8, 8, 8 }, RED);	
 	//DrawBoundingBox(projectile->ct.bounds, RED);
 }
 
@@ -1927,10 +2236,11 @@ void ProjectileThrow(Entity *ent, Vector3 pos, Vector3 dir, float force, u8 type
 	Projectile projectile = (Projectile) {0};
 
 	projectile.type = type;
-	projectile.sender = ent->id;
+	projectile.sender = EntHandleOf(handler, ent->id);
 	
 	comp_Transform *ct = &projectile.ct;
 	ct->position = pos;
+	ct->prev_pos = pos;
 
 	ct->bounds = (BoundingBox) { .min = Vector3Scale(Vector3One(), -8), .max = Vector3Scale(Vector3One(), 8) };
 	ct->bounds = BoxTranslate(ct->bounds, ct->position);
@@ -1943,16 +2253,15 @@ void ProjectileThrow(Entity *ent, Vector3 pos, Vector3 dir, float force, u8 type
 
 	projectile.active = true;
 
-	u16 slot = 0;
-	for(u16 i = 0; i < handler->projectile_capacity; i++) {
-		Projectile *p = &handler->projectiles[i];
-		if(!p->active) {
-			slot = i;
-			break;
-		}
+	if(handler->projectile_count >= handler->projectile_capacity) {
+		if(handler->projectile_capacity >= UINT16_MAX / 2)
+			return;
+
+		handler->projectile_capacity <<= 1;
+		handler->projectiles = realloc(handler->projectiles, sizeof(Projectile) * handler->projectile_capacity);
 	}
 
-	handler->projectiles[slot] = projectile;
+	handler->projectiles[handler->projectile_count++] = projectile;
 }
 
 void ProjectileImpact(Projectile *projectile, EntityHandler *handler, i16 ent_id) {
@@ -1976,47 +2285,52 @@ void ProjectileImpact(Projectile *projectile, EntityHandler *handler, i16 ent_id
 	Vector3 knockback = (Vector3) { projectile->ct.velocity.x, projectile->ct.velocity.z, 0 };
 	knockback = Vector3Scale(knockback, 0.33f);
 
-	ent->comp_transform.velocity = Vector3Add(ent->comp_transform.velocity, knockback);
+	ent->comp_transform->velocity = Vector3Add(ent->comp_transform->velocity, knockback);
 
 	*projectile = (Projectile) {0};
 }
 
 void ManageProjectiles(EntityHandler *handler, MapSection *sect, float dt) {
-	for(u16 i = 0; i < handler->projectile_capacity; i++) {
+	u16 i = 0;
+	while(i < handler->projectile_count) {
 		Projectile *projectile = &handler->projectiles[i];
+		projectile->ct.prev_pos = projectile->ct.position;
+		ProjectileUpdate(projectile, handler, sect, dt);
 
-		if(!projectile->active) 
+		// Swap last one in, same slot is checked again
+		if(!projectile->active) {
+			*projectile = handler->projectiles[--handler->projectile_count];
 			continue;
+		}
 
-		ProjectileUpdate(projectile, handler, sect, dt);
+		i++;
 	}
 }
 
 void RenderProjectiles(EntityHandler *handler) {
-	for(u16 i = 0; i < handler->projectile_capacity; i++) {
+	for(u16 i = 0; i < handler->projectile_count; i++) {
 		Projectile *projectile = &handler->projectiles[i];
-
-		if(!projectile->active)
-			continue;
-
 		ProjectileDraw(projectile);
 	}
 }
 
 void ReloadEntities(EntityHandler *handler, MapSection *sect, short with_states) {
-	u8 states[handler->count];
-	for(u16 i = 0; i < handler->count; i++) {
-		states[i] = handler->ents[i].comp_ai.state;
+	// Slots are handed out in spawn order again after the reset, so old states line up by id
+	u16 state_count = handler->count;
+	u8 states[state_count + 1];
+	for(u16 i = 0; i < state_count; i++) {
+		states[i] = handler->ents[i].comp_ai->state;
 	}
 
-	handler->count = 0;
+	EntPoolReset(handler);
 
 	for(u16 i = 0; i < handler->spawn_list.count; i++) {
 		ProcessEntity(&handler->spawn_list.arr[i], handler, NULL);
 
-		if(with_states) {
-			if(states[handler->count-1] == STATE_DEAD)
-				handler->ents[handler->count-1].comp_ai.state = STATE_DEAD;
+		if(with_states && handler->live_count) {
+			u16 id = handler->live[handler->live_count-1];
+			if(id < state_count && states[id] == STATE_DEAD)
+				handler->ents[id].comp_ai->state = STATE_DEAD;
 		}
 	}
 
@@ -2028,10 +2342,40 @@ void ReloadEntities(EntityHandler *handler, MapSection *sect, short with_states)
 		handler->player_start = handler->checkpoint_list.points[handler->checkpoint_list.active];
 
 	SpawnPlayer(&handler->ents[handler->player_id], handler->player_start);
-	handler->ents[handler->bug_id].comp_ai.state = 0;	
+	handler->ents[handler->bug_id].comp_ai->state = 0;	
+
+	EntBuildTypeLists(handler);
+
+	handler->grid.bsp = &sect->bsp_data;
+	EntGridRebuild(handler);
+
+	// Everything was placed, don't blend from where it was before
+	for(u16 n = 0; n < handler->live_count; n++) {
+		u16 i = handler->live[n];
+		handler->transforms[i].prev_pos = handler->transforms[i].position;
+	}
 
 	AiNavSetup(handler, sect);
 
 	handler->ai_tick = 1.0f; 
 }
 
+bool RestoreCheckpoint(EntityHandler *handler) {
+	if(handler->checkpoint_list.active < 0 || handler->checkpoint_list.active != checkpoint_saved)
+		return false;
+
+	return SnapshotRestore(&checkpoint_snapshot, handler);
+}
+
+bool LoadCheckpoint(EntityHandler *handler, MapSection *sect, char *path) {
+	if(!SnapshotReadFile(&checkpoint_snapshot, path, sect->cache.hash))
+		return false;
+
+	if(!SnapshotRestore(&checkpoint_snapshot, handler))
+		return false;
+
+	// Dying goes back here too, and reaching it again doesn't save over the file
+	checkpoint_saved = handler->checkpoint_list.active;
+
+	return true;
+}
@@ -19,34 +19,152 @@ typedef struct {
 
 } Coords;
 
-#define ENT_GRID_CELL_EXTENTS (Vector3) { 512, 512, 512 } 
-#define MAX_ENTS_PER_CELL	32
+#define ENT_GRID_CELL_SIZE		512.0f
+#define ENT_GRID_MIN_CELL_SIZE	128.0f
+#define ENT_GRID_MAX_CELL_SIZE	2048.0f
+
+// Entities per occupied cell the cell size is tuned for
+#define ENT_GRID_TARGET_DENSITY	4
+
+// Size of id buffers for grid queries
+#define MAX_ENTS_PER_QUERY		64
+
+// Most cells one entity's bounds can be linked into
+#define ENT_GRID_MAX_LINKS		8
+
+// Cell spans hold (4 << class) ids
+#define ENT_GRID_SIZE_CLASSES	14
+#define ENT_GRID_NO_SPAN		UINT32_MAX
+
 typedef struct {
 	BoundingBox aabb;
+	Coords coords;
 
-	i16 ents[MAX_ENTS_PER_CELL];
-	u8 ent_count;
+	// Span of the grid id pool
+	u32 first;
+	u16 ent_cap;
+	u16 ent_count;
 
 } EntGridCell;
 
+// Cells an entity is linked into, slots are its index in each cell's span
+typedef struct {
+	i32 cells[ENT_GRID_MAX_LINKS];
+	u16 slots[ENT_GRID_MAX_LINKS];
+
+	// Cell range of bounds when last linked
+	Coords min, max;
+
+	u8 count;
+	bool dirty;
+
+} EntGridLinks;
+
+// * NOTE:
+// Sparse hash grid, cells are only created where something has been, so there is no world limit
+// other than i16 coords. Entity ids of a cell are a span in one shared pool, spans are
+// taken from per size free lists and move to a bigger class when a cell fills up.
+// Cells are never removed, an id stays valid until cell size changes.
+// Entities are linked into every cell their bounds overlap. Code that moves bounds marks the
+// entity dirty, UpdateGrid relinks only dirty entities whose cell range changed
 typedef struct {
 	EntGridCell *cells;
+	i32 *table;		// Open addressing, cell index or -1
+
+	// Per entity, indexed by id
+	EntGridLinks *links;
+	u32 *query_stamp;
+	u16 ent_cap;
 
-	Vector3 origin;
-	Coords size;
+	u16 *dirty;
+	u16 dirty_count;
 
-	i16 cell_count;	
+	u32 query_generation;
+
+	u16 *pool;
+	u32 pool_count;
+	u32 pool_cap;
+
+	u32 free_spans[ENT_GRID_SIZE_CLASSES];
+
+	// Map entities are placed in, relinked entities look up their leaf in it. NULL before a map is loaded
+	Bsp_Data *bsp;
+
+	float cell_size;
+
+	// Extent of created cells
+	Coords min, max;
+
+	u32 cell_count;
+	u32 cell_cap;
+	u32 table_cap;
 
 } EntGrid;
 
-int16_t CellCoordsToId(Coords coords, EntGrid *grid);
-Coords CellIdToCoords(int16_t id, EntGrid *grid);
+// Id of cell at coords, creates the cell if it's missing
+i32 CellCoordsToId(Coords coords, EntGrid *grid);
+Coords CellIdToCoords(i32 id, EntGrid *grid);
 
 Coords Vec3ToCoords(Vector3 v, EntGrid *grid);
+
+// Min corner of cell
 Vector3 CoordsToVec3(Coords coords, EntGrid *grid);
 
+// True if coords are inside the extent of created cells
 bool CoordsInBounds(Coords coords, EntGrid *grid);
 
+// Returns NULL when no cell exists at coords
+EntGridCell *EntGridFind(EntGrid *grid, Coords coords);
+
+// Ids of entities in a cell, invalidated by any grid insert
+u16 *EntGridCellEnts(EntGrid *grid, EntGridCell *cell);
+
+// Queue entity for relinking, call after changing its bounds
+void EntGridMarkDirty(EntGrid *grid, u16 id);
+
+// Write ids of entities linked into any cell box overlaps, each id once. Returns count.
+// Entities still need their own bounds checked
+u16 EntGridQueryBox(EntGrid *grid, BoundingBox box, u16 *out, u16 max);
+
+// Walks cells along a ray in order (3D-DDA), distances are in units of ray direction
+typedef struct {
+	Ray ray;
+
+	Vector3 t_max;		// Distance to next cell boundary on each axis
+	Vector3 t_delta;	// Distance between boundaries on each axis
+
+	Coords cell;
+	Coords step;
+
+	float t;			// Distance where ray enters current cell
+	float t_end;		// Max distance or where ray leaves created cells
+
+	bool done;
+
+} EntGridRay;
+
+// Start a ray walk, also starts a new query for EntGridVisit
+void EntGridRayBegin(EntGridRay *it, EntGrid *grid, Ray ray, float max_dist);
+
+// Same as above without touching the grid, safe for several threads walking at once.
+// EntGridVisit can't be used with it, entities in more than one cell come up more than once
+void EntGridRayBeginShared(EntGridRay *it, EntGrid *grid, Ray ray, float max_dist);
+
+// Next cell holding entities, NULL once the ray is done.
+// Stops early when best_dist is closer than the next cell, nothing past that can be closer
+EntGridCell *EntGridRayNext(EntGridRay *it, EntGrid *grid, float best_dist);
+
+// True the first time an id is seen in current query, entities in several cells get tested once
+bool EntGridVisit(EntGrid *grid, u16 id);
+
+void EntGridClose(EntGrid *grid);
+
+// Empty every cell, cells and ids are kept
+void EntGridClear(EntGrid *grid);
+
+// Drop every cell and switch to a new size
+void EntGridSetCellSize(EntGrid *grid, float cell_size);
+
 typedef struct  {
 	BoundingBox bounds;
 
@@ -58,7 +176,7 @@ typedef struct  {
 	Vector3 targ_look;
 
 	Vector3 ground_normal;
-	Vector3 prev_pos;
+	Vector3 prev_pos;	// Position at start of the last simulation step, for render interpolation
 
 	Vector3 last_safe_pos;
 
@@ -157,20 +275,44 @@ enum ENT_TYPES : u8 {
 	ENT_DISRUPTOR	 	= 	9,
 };
 
+#define ENT_TYPE_COUNT 10
+
 typedef struct {
 	Model model;
 	ModelAnimation *animations;
 
-	comp_Ai comp_ai;
-	comp_Transform comp_transform;
-	comp_Health comp_health;
-	comp_Weapon comp_weapon;
-	
 	int anim_count, curr_anim,  anim_frame;
 	float anim_timer;
 
+} comp_Render;
+
+// * NOTE:
+// Handles pack slot id (low 16 bits) and slot generation (high 16 bits).
+// Freeing a slot bumps its generation, so handles to whatever used it stop resolving.
+// Generations start at 1, a handle is never 0
+typedef u32 EntHandle;
+#define ENT_NULL_HANDLE	0
+
+#define ENT_START_CAPACITY		128
+#define ENT_MAX_COUNT			(UINT16_MAX - 1)
+#define ENT_NOT_LIVE			UINT16_MAX
+
+// * NOTE:
+// Components live in dense arrays owned by the handler, indexed by entity id.
+// Entity only points at its slots so loops over ents stay small,
+// systems that need one component can walk its array directly
+typedef struct {
+	comp_Transform *comp_transform;
+	comp_Ai *comp_ai;
+	comp_Health *comp_health;
+	comp_Weapon *comp_weapon;
+	comp_Render *comp_render;
+
 	u16 id;
-	i16 cell_id;
+	i32 cell_id;
+
+	// BSP leaf at center, updated with grid links. 0 (solid) until linked
+	i32 leaf_id;
 
 	i8 type;
 
@@ -189,7 +331,7 @@ typedef struct {
 
 	short base_damage;	
 
-	u16 sender;
+	EntHandle sender;
 	
 	u8 state;
 	u8 type;
@@ -202,8 +344,38 @@ typedef struct {
 	Model base_ent_models[16];
 
 	Entity *ents;
+
+	// Live projectiles are packed at the front, dead ones are swapped out
 	Projectile *projectiles;
 
+	// Component storage, grows with ents. Entity pointers are rebound when it does,
+	// so don't hold component pointers across a spawn
+	comp_Transform *transforms;
+	comp_Ai *ais;
+	comp_Health *healths;
+	comp_Weapon *weapons;
+	comp_Render *renders;
+
+	// Entity ids grouped by type, ids of type t are type_ids[type_first[t]..type_first[t+1]]
+	u16 *type_ids;
+	u16 type_first[ENT_TYPE_COUNT + 1];
+	bool type_lists_dirty;
+
+	// Per slot, generation of current occupant
+	u16 *generations;
+
+	// Freed slots, reused before count grows
+	u16 *free_ids;
+	u16 free_count;
+
+	// Ids of live entities in no particular order, live_index is each slot's position or ENT_NOT_LIVE
+	u16 *live;
+	u16 *live_index;
+	u16 live_count;
+
+	// Scratch list of AI ids for the sense and apply passes, sized with the pool
+	u16 *ai_ids;
+
 	EntGrid grid;
 	SpawnList spawn_list;
 	CheckPointList checkpoint_list;
@@ -214,7 +386,13 @@ typedef struct {
 
 	float ai_tick;
 
-	u16 count;
+	// Steps run since the handler was set up, sim time is sim_tick * step length
+	u32 sim_tick;
+
+	// Fraction of a simulation step since the last one ran, set before rendering
+	float render_alpha;
+
+	u16 count;		// Slots ever used, ids are below this
 	u16 capacity;
 
 	u16 projectile_count;
@@ -230,14 +408,67 @@ void LoadEntityBaseModels(EntityHandler *handler);
 void EntHandlerInit(EntityHandler *handler, vEffect_Manager *effect_manager);
 void EntHandlerClose(EntityHandler *handler);
 
+// Point entity at its component slots and clear them
+Entity EntBind(EntityHandler *handler, u16 id);
+
+// Grow entity and component storage
+void EntReserve(EntityHandler *handler, u16 capacity);
+
+// Take a free slot and make it live, slot contents are left as they were
+u16 EntAlloc(EntityHandler *handler);
+
+// Release a slot, handles to it go stale
+void EntFree(EntityHandler *handler, u16 id);
+
+// Release every slot so ids are handed out from 0 again, slot contents are kept
+void EntPoolReset(EntityHandler *handler);
+
+EntHandle EntHandleOf(EntityHandler *handler, u16 id);
+
+// Returns NULL for null or stale handles
+Entity *EntGet(EntityHandler *handler, EntHandle handle);
+
+// Rebuild per-type id lists, done lazily when entities were spawned or freed.
+// Call after changing an entity's type
+void EntBuildTypeLists(EntityHandler *handler);
+
+// Data touched by simulation step stages, for dependencies in the step's task graph
+#define RES_TRANSFORMS	0x01
+#define RES_AI			0x02
+#define RES_HEALTH		0x04
+#define RES_GRID		0x08
+#define RES_NAV			0x10	// Path queue and flow fields
+#define RES_OTHER		0x20	// Weapons, projectiles, effects, raylib state
+#define RES_WORLD		0x3F
+
+// Runs one fixed simulation step
 void UpdateEntities(EntityHandler *handler, MapSection *sect, float dt);
 void RenderEntities(EntityHandler *handler, float dt);
 
-void UpdateRenderList(EntityHandler *handler, MapSection *sect);
+// Position blended between the last two simulation steps, only valid inside RenderEntities
+Vector3 EntRenderPosition(comp_Transform *ct);
+
+// Pick entities to draw from camera, leaves outside its PVS and boxes outside its frustum are skipped.
+// Build once a frame before drawing, every pass drawing entities uses the same list
+void UpdateRenderList(EntityHandler *handler, MapSection *sect, Camera3D camera, float aspect);
 
 void EntGridInit(EntityHandler *handler);
+
+// Grow per entity arrays, called by EntReserve
+void EntGridReserve(EntGrid *grid, u16 capacity);
+
+// Unlink an entity from every cell, called by EntFree
+void EntGridRemove(EntGrid *grid, u16 id);
+
+// Relink entities marked dirty
 void UpdateGrid(EntityHandler *handler);
 
+// Empty grid and insert every entity again
+void EntGridRebuild(EntityHandler *handler);
+
+// Pick a cell size from the spread of spawned entities
+float EntGridTuneCellSize(EntityHandler *handler);
+
 void DrawEntsDebugInfo();
 
 void SpawnPlayer(Entity *ent, Vector3 position);
@@ -262,6 +493,9 @@ typedef struct {
 void PlayerInit(Camera3D *camera, InputHandler *input, MapSection *test_section, PlayerDebugData *debug_data, EntityHandler *ent_handler);
 
 void PlayerUpdate(Entity *player, float dt);
+
+// Input handler the player reads from, for other entities driven by player input
+InputHandler *PlayerGetInput();
 void PlayerDraw(Entity *player);
 
 void PlayerDamage(Entity *player, short amount);
@@ -271,6 +505,11 @@ void PlayerDisplayDebugInfo(Entity *player);
 void PlayerDebugText(Entity *player);
 
 void PlayerMove(Entity *player, float dt);
+
+// Module globals for world snapshots, stored as raw bytes of PlayerStateSize()
+u32 PlayerStateSize();
+void PlayerStateSave(void *out);
+void PlayerStateLoad(void *in);
 // ----------------------------------------------------------------------------------------------------------------------------
 
 void ProcessEntity(EntSpawn *spawn_point, EntityHandler *handler, NavGraph *nav_graph);
@@ -289,9 +528,25 @@ void MaintainerDraw(Entity *ent, float dt);
 // ----------------------------------------------------------------------------------------------------------------------------
 // **** AI ****
 
+// Entities sensed per job chunk
+#define AI_SENSE_CHUNK 8
+
+// * NOTE:
+// AI ticks run in two phases.
+// Sense: AiCheckInputs for every entity in parallel on the AI job pool. Nothing else runs meanwhile,
+// so the world is a read-only snapshot of the start of the tick, and each entity only writes its own inputs.
+// Apply: schedules run serially in live list order, they move entities, shoot, throw projectiles, 
+// alert others and queue path searches. Same order every tick so results don't depend on thread timing
 void AiSystemUpdate(EntityHandler *handler, MapSection *sect, float dt);
+
+// Player's nav node, flow fields and queued path searches. Only writes nav data and the player's nav node,
+// runs before AiSystemUpdate
+void AiNavUpdate(EntityHandler *handler, MapSection *sect);
+
+// Apply phase for one entity, inputs have to be sensed already
 void AiComponentUpdate(Entity *ent, EntityHandler *handler, comp_Ai *ai, Ai_TaskData *task_data, MapSection *sect, float dt);
 
+// Sense phase for one entity, thread safe while nothing writes to the world
 void AiCheckInputs(Entity *ent, EntityHandler *handler, MapSection *sect);
 void AiDoSchedule(Entity *ent, EntityHandler *handler, MapSection *sect, comp_Ai *ai, Ai_TaskData *task_data, float dt);
 void AiDoState(Entity *ent, comp_Ai *ai, Ai_TaskData *task_data, float dt);
@@ -299,10 +554,32 @@ void AiDoState(Entity *ent, comp_Ai *ai, Ai_TaskData *task_data, float dt);
 int FindClosestNavNode(Vector3 position, MapSection *sect);
 void AiNavSetup(EntityHandler *handler, MapSection *sect);
 
+// Drop cached paths through a graph, call after it's rebuilt or its edges change
+void AiNavGraphChanged(NavGraph *graph);
+
 int FindClosestNavNodeInGraph(Vector3 position, NavGraph *graph);
 bool MakeNavPath(Entity *ent, NavGraph *graph, i16 target_id);
 
+// Queue a path search, result is delivered into task_data.path by AiDeliverPaths
+bool AiRequestPath(Entity *ent, NavGraph *graph, i16 target_id, u8 priority);
+void AiCancelPath(Entity *ent);
+void AiDeliverPaths(EntityHandler *handler, MapSection *sect);
+
+// Drop every queued search and reset path status of all AI, they ask again on their next tick
+void AiDropPaths(EntityHandler *handler);
+
 bool AiMoveToNode(Entity *ent, NavGraph *graph, u16 path_id);
+
+// Turn toward a graph node and make it the current node
+void AiSteerToNode(Entity *ent, NavGraph *graph, u16 node_id);
+
+// Turn toward a point, current node is left as is
+void AiSteerToPoint(Entity *ent, Vector3 point);
+
+// Path over the navmesh to a point and turn toward the first corner,
+// for the stretch past the last graph node. Returns false if either end is off the mesh or there's no path
+bool AiSteerOnMesh(Entity *ent, NavMesh *mesh, Vector3 target);
+
 void AiPatrol(Entity *ent, MapSection *sect, float dt);
 
 void AiFixFriendSchedule(Entity *ent, EntityHandler *handler, MapSection *sect, float dt);
@@ -332,6 +609,9 @@ EntTraceData EntTraceDataEmpty();
 
 Vector3 TraceEntities(Ray ray, EntityHandler *handler, float max_dist, u16 sender, EntTraceData *trace_data);
 
+// Same as above but doesn't write to the grid, safe to call from several threads at once
+Vector3 TraceEntitiesShared(Ray ray, EntityHandler *handler, float max_dist, u16 sender, EntTraceData *trace_data);
+
 Vector3 TraceBullet(EntityHandler *handler, MapSection *sect, Vector3 origin, Vector3 dir, u16 sender, bool *hit, bool dummy);
 
 void DebugDrawEntText(EntityHandler *handler, Camera3D cam); 
@@ -357,6 +637,11 @@ void BugInit(Entity *ent, EntityHandler *handler, MapSection *sect);
 void BugUpdate(Entity *ent, EntityHandler *handler, MapSection *sect, float dt);
 void BugDraw(Entity *ent);
 
+// Same as player state above
+u32 BugStateSize();
+void BugStateSave(void *out);
+void BugStateLoad(void *in);
+
 void DisruptEntity(EntityHandler *handler, u16 ent_id, MapSection *sect);
 void AlertMaintainers(EntityHandler *handler, u16 disrupted_id);
 
@@ -394,6 +679,12 @@ void RenderProjectiles(EntityHandler *handler);
 // ----------------------------------------------------------------------------------------------------------------------------
 
 void ReloadEntities(EntityHandler *handler, MapSection *sect, short with_states);
+
+// Put world back the way it was when the active checkpoint was reached, false if there's no snapshot of it
+bool RestoreCheckpoint(EntityHandler *handler);
+
+// Continue from a checkpoint saved to disk, false if there's none for this map
+bool LoadCheckpoint(EntityHandler *handler, MapSection *sect, char *path);
 void ReloadEntitiesPartial(EntityHandler *handler, MapSection *sect);
 
 #endif
@@ -10,6 +10,10 @@
 #include "geo.h"
 #include "../include/log_message.h"
 #include "map.h"
+#include "dlc.h"
+#include "navmesh.h"
+#include "nav.h"
+#include "snapshot.h"
 
 void VirtCameraControls(Camera3D *cam, float dt, Vector3 target_point);
 
@@ -63,6 +67,7 @@ void GameClose(Game *game) {
 
 	MapSectionClose(&game->test_section);
 	EntHandlerClose(&game->ent_handler);
+	ReplayFree(&game->recording);
 }
 
 void GameRenderSetup(Game *game) {
@@ -74,6 +79,8 @@ void GameRenderSetup(Game *game) {
 		.fovy = 90,
 		.projection = CAMERA_PERSPECTIVE
 	};
+	game->camera_prev_pos = game->camera.position;
+	game->camera_prev_look = Vector3Subtract(game->camera.target, game->camera.position);
 
 	game->camera_debug = (Camera3D) {
 		.position = (Vector3) { -1500, 1000, -1500 },
@@ -111,35 +118,42 @@ void GameRenderSetup(Game *game) {
 void GameLoadTestScene1(Game *game, char *path) {
 	SpawnList spawn_list = (SpawnList) {0}; 
 	game->test_section = BuildMapSect(path, &spawn_list);
-	game->test_section.navgraphs = malloc(sizeof(NavGraph) * 32);
+	strncpy(game->map_path, path, sizeof(game->map_path) - 1);
 
-	// ----------------------------------------------------------------------------------------
-	Entity player = (Entity) {0};
-	player.type = ENT_PLAYER;
-	player.flags |= ENT_ACTIVE;
-
-	Entity bug = (Entity) {0};
-	bug.type = ENT_DISRUPTOR;
-	bug.flags |= ENT_ACTIVE;
+	// Nav graphs come from the level cache when it's valid
+	bool cached = (game->test_section.flags & MAP_SECT_CACHED);
+	if(!cached)
+		game->test_section.navgraphs = malloc(sizeof(NavGraph) * MAX_NAVGRAPHS);
 
 	// ----------------------------------------------------------------------------------------
 
-	game->test_section.base_navgraph = (NavGraph) {
-		.nodes = calloc(128, sizeof(NavNode)),
-		.edges = calloc(128, sizeof(NavEdge)),
-		.node_cap = 128, .edge_cap = 128,
-		.node_count = 0, .edge_count = 0
-	};
+	if(!cached) {
+		game->test_section.base_navgraph = (NavGraph) {
+			.nodes = calloc(128, sizeof(NavNode)),
+			.edges = calloc(128, sizeof(NavEdge)),
+			.node_cap = 128, .edge_cap = 128,
+			.node_count = 0, .edge_count = 0
+		};
+	}
 
-	game->ent_handler.count = 0;
+	EntPoolReset(&game->ent_handler);
 	for(int i = 0; i < spawn_list.count; i++) 
-		ProcessEntity(&spawn_list.arr[i], &game->ent_handler, &game->test_section.base_navgraph);
+		ProcessEntity(&spawn_list.arr[i], &game->ent_handler, (cached) ? NULL : &game->test_section.base_navgraph);
 	
-	player.id = game->ent_handler.player_id;
+	// ----------------------------------------------------------------------------------------
+	Entity player = EntBind(&game->ent_handler, game->ent_handler.player_id);
+	player.type = ENT_PLAYER;
+	player.flags |= ENT_ACTIVE;
 	game->ent_handler.ents[game->ent_handler.player_id] = player;
-	bug.id = game->ent_handler.bug_id;
+
+	Entity bug = EntBind(&game->ent_handler, game->ent_handler.bug_id);
+	bug.type = ENT_DISRUPTOR;
+	bug.flags |= ENT_ACTIVE;
 	game->ent_handler.ents[game->ent_handler.bug_id] = bug;
 
+	EntBuildTypeLists(&game->ent_handler);
+	// ----------------------------------------------------------------------------------------
+
 	PlayerInit(&game->camera, &game->input_handler, &game->test_section, &player_data, &game->ent_handler);
 
 	game->player_gun = (PlayerGun) {0};
@@ -148,23 +162,28 @@ void GameLoadTestScene1(Game *game, char *path) {
 		&game->ent_handler.ents[game->ent_handler.player_id],
 		&game->ent_handler,
 		&game->test_section,
-		&game->effect_manager
+		&game->effect_manager,
+		&game->input_handler
 	);
 
 	BugInit(&game->ent_handler.ents[game->ent_handler.bug_id], &game->ent_handler, &game->test_section);
 
-	BuildNavEdges(&game->test_section.base_navgraph);
+	if(!cached) {
+		BuildNavEdges(&game->test_section.base_navgraph);
+		SubdivideNavGraph(&game->test_section, &game->test_section.base_navgraph);
 
-	game->test_section.navgraphs[0] = (NavGraph) {
-		.node_count = game->test_section.base_navgraph.node_count,
-		.edge_count = game->test_section.base_navgraph.edge_count,
-		.node_cap = game->test_section.base_navgraph.node_cap,
-		.edge_cap = game->test_section.base_navgraph.edge_cap
-	};
-	game->test_section.navgraphs[0].nodes = calloc(game->test_section.navgraphs[0].node_count, sizeof(NavNode));
-	game->test_section.navgraphs[0].edges = calloc(game->test_section.navgraphs[0].edge_count, sizeof(NavEdge));
+		// Cluster abstraction for hierarchical search and node lookup grids, cached with the graphs
+		for(u8 i = 0; i < game->test_section.navgraph_count; i++) {
+			NavClustersBuild(&game->test_section.navgraphs[i]);
+			NavIndexBuild(&game->test_section.navgraphs[i]);
+		}
+
+		DlcWrite(&game->test_section, &spawn_list);
+	}
+
+	for(u8 i = 0; i < game->test_section.navgraph_count; i++)
+		AiNavGraphChanged(&game->test_section.navgraphs[i]);
 
-	SubdivideNavGraph(&game->test_section, &game->test_section.base_navgraph);
 	AiNavSetup(&game->ent_handler, &game->test_section);
 
 	SpawnPlayer(&game->ent_handler.ents[game->ent_handler.player_id], game->ent_handler.player_start);
@@ -173,25 +192,51 @@ void GameLoadTestScene1(Game *game, char *path) {
 	game->ent_handler.spawn_list.arr = calloc(spawn_list.count, sizeof(EntSpawn));
 	memcpy(game->ent_handler.spawn_list.arr, spawn_list.arr, sizeof(EntSpawn) * spawn_list.count);
 
+	// Size grid cells for how spread out this map's entities are
+	EntGridSetCellSize(&game->ent_handler.grid, EntGridTuneCellSize(&game->ent_handler));
+
 	ReloadEntities(&game->ent_handler, &game->test_section, 0);
 
-	// Setup checkpoints	
-	for(u16 i = 0; i < game->ent_handler.checkpoint_list.count; i++) {
-		game->ent_handler.checkpoint_list.cells[i] = CellCoordsToId(
-			Vec3ToCoords(game->ent_handler.checkpoint_list.points[i], &game->ent_handler.grid), &game->ent_handler.grid);	
-	}
+	// Pick up from the last checkpoint reached in this map
+	if(LoadCheckpoint(&game->ent_handler, &game->test_section, SNAPSHOT_SAVE_PATH))
+		MessageDiag("Continuing from checkpoint", SNAPSHOT_SAVE_PATH, ANSI_GREEN);
 }
 
 void GameUpdate(Game *game, float dt) {
 	if(IsKeyPressed(KEY_ESCAPE))
 		game->flags |= FLAG_EXIT_REQUEST;
 
-	VirtCameraControls(&game->camera_debug, dt, game->ent_handler.ents[0].comp_transform.position);
+	VirtCameraControls(&game->camera_debug, dt, game->ent_handler.ents[0].comp_transform->position);
 
 	PollInput(&game->input_handler);
-	PlayerGunUpdate(&game->player_gun, dt);
 
-	UpdateEntities(&game->ent_handler, &game->test_section, dt);
+	// Written on stop, play back with: game --replay replay.rec
+	if(IsKeyPressed(KEY_F9)) {
+		Entity *player = &game->ent_handler.ents[game->ent_handler.player_id];
+
+		if(!game->recording.recording)
+			ReplayRecordBegin(&game->recording, player, game->map_path);
+		else
+			ReplayRecordEnd(&game->recording, player, REPLAY_SAVE_PATH);
+	}
+
+	game->sim_accumulator += fminf(dt, SIM_MAX_STEPS * SIM_DT);
+
+	while(game->sim_accumulator >= SIM_DT) {
+		game->camera_prev_pos = game->camera.position;
+		game->camera_prev_look = Vector3Subtract(game->camera.target, game->camera.position);
+
+		ReplayRecordTick(&game->recording, &game->input_handler, SIM_DT);
+		UpdateEntities(&game->ent_handler, &game->test_section, SIM_DT);
+
+		// Fires traces that damage entities, so it steps with them on the same input
+		PlayerGunUpdate(&game->player_gun, SIM_DT);
+		InputConsume(&game->input_handler);
+
+		game->sim_accumulator -= SIM_DT;
+	}
+
+	game->ent_handler.render_alpha = game->sim_accumulator / SIM_DT;
 }
 
 #define DEBUG_ENABLE			0x01
@@ -199,17 +244,28 @@ void GameUpdate(Game *game, float dt) {
 #define DEBUG_DRAW_BIG	 		0x04
 #define DEBUG_DRAW_FULL_MODEL	0x08
 #define DEBUG_DRAW_BVH			0x10
+#define DEBUG_DRAW_NAVMESH		0x20
 u8 debug_draw_flags = (0);
 
 void GameDraw(Game *game, float dt) {
 	Entity *player_ent = &game->ent_handler.ents[game->ent_handler.player_id];
 
+	// Blend camera between steps same as entities, look direction too so turning stays smooth above 60 fps
+	Camera3D view = game->camera;
+	Vector3 look = Vector3Subtract(game->camera.target, game->camera.position);
+	view.position = Vector3Lerp(game->camera_prev_pos, game->camera.position, game->ent_handler.render_alpha);
+	view.target = Vector3Add(view.position, Vector3Lerp(game->camera_prev_look, look, game->ent_handler.render_alpha));
+
+	// Same entity list for every pass below
+	float aspect = (float)game->render_target3D.texture.width / game->render_target3D.texture.height;
+	UpdateRenderList(&game->ent_handler, &game->test_section, view, aspect);
+
 	// 3D Rendering, main
 	BeginDrawing();
 	BeginTextureMode(game->render_target3D);
 	
 	ClearBackground(BLACK);
-		BeginMode3D(game->camera);
+		BeginMode3D(view);
 
 			//DrawModel(game->test_section.model, Vector3Zero(), 1, WHITE);
 			//DrawModel(game->test_section.model, Vector3Zero(), 1, ColorAlpha(WHITE, 0.95f));
@@ -217,7 +273,7 @@ void GameDraw(Game *game, float dt) {
 
 			//PlayerDisplayDebugInfo(&game->ent_handler.ents[0]);
 			RenderEntities(&game->ent_handler, GetFrameTime());
-			DrawMap(&game->test_section, game->camera.position);
+			DrawMap(&game->test_section, view.position);
 
 			/*
 			for(u16 i = 0; i < tri_count; i++) {
@@ -229,17 +285,17 @@ void GameDraw(Game *game, float dt) {
 			*/
 
 			/*
-			for(u16 j = 0; j < game->test_section.bvh[1].tris.count; j++) {
-				//Tri *tri = &game->test_section.bvh[1].tris.arr[j];
-				Tri *tri = &game->test_section.bvh[1].tris.arr[j];
+			for(u16 j = 0; j < game->test_section.bvh[1].tris->count; j++) {
+				Tri tri = TriPoolGet(game->test_section.bvh[1].tris, j);
 				Color color = colors[j % 6];
-				DrawTriangle3D(tri->vertices[0], tri->vertices[1], tri->vertices[2], ColorAlpha(color, 0.5f));
+				DrawTriangle3D(tri.vertices[0], tri.vertices[1], tri.vertices[2], ColorAlpha(color, 0.5f));
 			}
 			*/
 			
 			if(debug_draw_flags & DEBUG_DRAW_HULLS) { 
-				for(u16 j = 0; j < game->test_section.bvh[1].tris.count; j++) {
-					Tri *tri = &game->test_section.bvh[1].tris.arr[j];
+				for(u16 j = 0; j < game->test_section.bvh[1].tris->count; j++) {
+					Tri unpacked = TriPoolGet(game->test_section.bvh[1].tris, j);
+					Tri *tri = &unpacked;
 					Color color = colors[tri->hull_id % 7];
 					/*
 					Color color = {
@@ -268,7 +324,6 @@ void GameDraw(Game *game, float dt) {
 				}
 				*/
 			}
-			RenderEntities(&game->ent_handler, GetFrameTime());
 			//DebugDrawNavGraphs(&game->test_section, sphere_model);
 
 			vEffectsRun(&game->effect_manager, dt);
@@ -277,10 +332,10 @@ void GameDraw(Game *game, float dt) {
 
 		//DebugDrawNavGraphsText(&game->test_section, game->camera_debug, (Vector2) {VIRT_W, VIRT_H} );
 
-		if(player_ent->comp_ai.state == STATE_DEAD) {
-			float deathscreen_alpha = player_ent->comp_ai.task_data.timer*0.5f;
+		if(player_ent->comp_ai->state == STATE_DEAD) {
+			float deathscreen_alpha = player_ent->comp_ai->task_data.timer*0.5f;
 			if(deathscreen_alpha > 1) deathscreen_alpha = 1;
-			DrawRectangleRec((Rectangle) { 0, 0, VIRT_W, VIRT_H } , ColorAlpha(BLACK, player_ent->comp_ai.task_data.timer*0.5f));
+			DrawRectangleRec((Rectangle) { 0, 0, VIRT_W, VIRT_H } , ColorAlpha(BLACK, player_ent->comp_ai->task_data.timer*0.5f));
 		}
 
 	EndTextureMode();
@@ -321,8 +376,9 @@ void GameDraw(Game *game, float dt) {
 
 			if(IsKeyPressed(KEY_H)) debug_draw_flags ^= DEBUG_DRAW_HULLS;
 			if(debug_draw_flags & DEBUG_DRAW_HULLS) { 
-				for(u16 j = 0; j < game->test_section.bvh[1].tris.count; j++) {
-					Tri *tri = &game->test_section.bvh[1].tris.arr[j];
+				for(u16 j = 0; j < game->test_section.bvh[1].tris->count; j++) {
+					Tri unpacked = TriPoolGet(game->test_section.bvh[1].tris, j);
+					Tri *tri = &unpacked;
 					Color color = colors[tri->hull_id % 7];
 					DrawTriangle3D(tri->vertices[0], tri->vertices[1], tri->vertices[2], ColorTint(color, BROWN));
 				}
@@ -345,6 +401,10 @@ void GameDraw(Game *game, float dt) {
 				}
 			}
 
+			if(IsKeyPressed(KEY_N)) debug_draw_flags ^= DEBUG_DRAW_NAVMESH;
+			if(debug_draw_flags & DEBUG_DRAW_NAVMESH) 
+				NavMeshDraw(&game->test_section.navmesh);
+
 		DebugDrawNavGraphs(&game->test_section, sphere_model);
 
 		EndMode3D();
@@ -402,7 +462,7 @@ void GameDraw(Game *game, float dt) {
 
 	if(game->ent_handler.checkpoint_list.active == 5 && 
 	   CheckCollisionSpheres(
-			game->ent_handler.ents[game->ent_handler.player_id].comp_transform.position, 32, 
+			game->ent_handler.ents[game->ent_handler.player_id].comp_transform->position, 32, 
 			game->ent_handler.checkpoint_list.points[5], 128)) {
 
 		DrawText("That's all!  Thank you for playing!", VIRT_W/2 - 300, VIRT_H/2, 32, DARKPURPLE);
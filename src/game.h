@@ -6,12 +6,22 @@
 #include "ent.h"
 #include "player_gun.h"
 #include "v_effect.h"
+#include "replay.h"
 
 #ifndef GAME_H_
 #define GAME_H_
 
 #define FLAG_EXIT_REQUEST	0x01
 
+// * NOTE:
+// Simulation runs in fixed steps, frames run as many steps as fit in the accumulated time
+// and rendering blends positions between the last two steps.
+// Frame time is clamped to SIM_MAX_STEPS steps, after a long hitch the simulation slows down
+// instead of trying to catch up (which would only make the next frame longer)
+#define SIM_RATE			60
+#define SIM_DT				(1.0f / SIM_RATE)
+#define SIM_MAX_STEPS		5
+
 typedef struct {
 	MapSection test_section;
 
@@ -30,6 +40,16 @@ typedef struct {
 	Camera3D camera;
 	Camera3D camera_debug;
 
+	// Camera position and look offset before the last step, for interpolation
+	Vector3 camera_prev_pos;
+	Vector3 camera_prev_look;
+
+	float sim_accumulator;
+
+	// F9 starts and stops recording input for headless replays
+	InputRecording recording;
+	char map_path[128];
+
 	Config *conf;
 
 	u8 flags;
@@ -43,6 +63,7 @@ void GameRenderSetup(Game *game);
 void GameLoadTestScene(Game *game, char *path);
 void GameLoadTestScene1(Game *game, char *path);
 
+// Poll input and run however many simulation steps are due
 void GameUpdate(Game *game, float dt);
 void GameDraw(Game *game, float dt);
 
@@ -6,9 +6,14 @@
 #include <float.h>
 #include "raylib.h"
 #include "raymath.h"
+#include "rlgl.h"
 #include "../include/num_redefs.h"
 #include "../include/log_message.h"
 #include "geo.h"
+#include "navmesh.h"
+#include "dlc.h"
+
+CollisionStats coll_stats = {0};
 
 // Swap triangle indices
 void SwapTriIds(u16 *a, u16 *b) {
@@ -178,6 +183,66 @@ BoxNormals BoxGetFaceNormals(BoundingBox box) {
 	return normals;
 }
 
+Frustum FrustumFromCamera(Camera3D camera, float aspect) {
+	float near = rlGetCullDistanceNear();
+	float far = rlGetCullDistanceFar();
+
+	// Same projection BeginMode3D sets up
+	Matrix proj;
+	if(camera.projection == CAMERA_ORTHOGRAPHIC) {
+		float top = camera.fovy * 0.5f;
+		float right = top * aspect;
+		proj = MatrixOrtho(-right, right, -top, top, near, far);
+	} else 
+		proj = MatrixPerspective(camera.fovy * DEG2RAD, aspect, near, far);
+
+	Matrix view = MatrixLookAt(camera.position, camera.target, camera.up);
+	float16 m = MatrixToFloatV(MatrixMultiply(view, proj));
+
+	// Rows of view projection matrix, clip = row dot (x, y, z, 1)
+	Vector4 rows[4];
+	for(u8 i = 0; i < 4; i++) 
+		rows[i] = (Vector4) { m.v[i], m.v[i + 4], m.v[i + 8], m.v[i + 12] };
+
+	// Point is inside when -w <= x, y, z <= w
+	Vector4 planes[6] = {
+		Vector4Add(rows[3], rows[0]),
+		Vector4Subtract(rows[3], rows[0]),
+		Vector4Add(rows[3], rows[1]),
+		Vector4Subtract(rows[3], rows[1]),
+		Vector4Add(rows[3], rows[2]),
+		Vector4Subtract(rows[3], rows[2])
+	};
+
+	Frustum frustum;
+	for(u8 i = 0; i < 6; i++) {
+		Vector3 normal = (Vector3) { planes[i].x, planes[i].y, planes[i].z };
+		float len = Vector3Length(normal);
+
+		frustum.planes[i] = (Plane) { .normal = Vector3Scale(normal, 1.0f / len), .d = planes[i].w / len };
+	}
+
+	return frustum;
+}
+
+bool FrustumBoxVisible(Frustum *frustum, BoundingBox box) {
+	for(u8 i = 0; i < 6; i++) {
+		Plane *plane = &frustum->planes[i];
+
+		// Corner furthest along plane normal
+		Vector3 corner = (Vector3) {
+			(plane->normal.x >= 0) ? box.max.x : box.min.x,
+			(plane->normal.y >= 0) ? box.max.y : box.min.y,
+			(plane->normal.z >= 0) ? box.max.z : box.min.z
+		};
+
+		if(PlaneDistance(*plane, corner) < 0)
+			return false;
+	}
+
+	return true;
+}
+
 BoxPoints BoxGetPoints(BoundingBox box) {
 	BoxPoints box_points = (BoxPoints) {0};
 
@@ -272,6 +337,153 @@ Tri *ModelToTris(Model model, u16 *tri_count, u16 **tri_ids) {
 	return tris;
 }
 
+// Quantized key used for welding vertices and planes
+typedef struct {
+	i32 k[4];
+
+} WeldKey;
+
+typedef struct {
+	WeldKey *keys;
+	u32 *slots;
+
+	u32 count;
+	u32 capacity;
+
+} WeldTable;
+
+WeldTable WeldTableInit(u32 max_entries) {
+	WeldTable table = (WeldTable) {0};
+
+	table.capacity = 64;
+	while(table.capacity < max_entries * 2)
+		table.capacity = (table.capacity << 1);
+
+	table.keys = malloc(sizeof(WeldKey) * max_entries);
+	table.slots = calloc(table.capacity, sizeof(u32));
+
+	return table;
+}
+
+void WeldTableFree(WeldTable *table) {
+	free(table->keys);
+	free(table->slots);
+}
+
+// Return id of entry matching key, inserting it if missing
+u32 WeldTableFetch(WeldTable *table, WeldKey key, bool *inserted) {
+	u64 hash = 14695981039346656037ULL;
+	for(short i = 0; i < 4; i++) {
+		hash ^= (u32)key.k[i];
+		hash *= 1099511628211ULL;
+	}
+
+	u32 mask = table->capacity - 1;
+	u32 slot = hash & mask;
+
+	// Slots store id + 1, zero is empty
+	while(table->slots[slot]) {
+		u32 id = table->slots[slot] - 1;
+
+		if(memcmp(&table->keys[id], &key, sizeof(WeldKey)) == 0) {
+			*inserted = false;
+			return id;
+		}
+
+		slot = (slot + 1) & mask;
+	}
+
+	u32 id = table->count++;
+	table->keys[id] = key;
+	table->slots[slot] = id + 1;
+
+	*inserted = true;
+	return id;
+}
+
+void TriPoolBuild(TriPool *pool, Tri *tris, u16 count) {
+	*pool = (TriPool) {0};
+	pool->count = count;
+
+	if(!count)
+		return;
+
+	pool->arr = malloc(sizeof(TriIndex) * count);
+	pool->verts = malloc(sizeof(Vector3) * count * 3);
+	pool->planes = malloc(sizeof(Plane) * count);
+
+	WeldTable vert_table = WeldTableInit(count * 3);
+	WeldTable plane_table = WeldTableInit(count);
+
+	float vert_scale = 1.0f / TRI_WELD_EPS;
+
+	for(u16 i = 0; i < count; i++) {
+		Tri *tri = &tris[i];
+		TriIndex *out = &pool->arr[i];
+
+		*out = (TriIndex) { .hull_id = tri->hull_id };
+		bool inserted;
+
+		for(short j = 0; j < 3; j++) {
+			Vector3 v = tri->vertices[j];
+
+			WeldKey key = (WeldKey) { .k = { 
+				(i32)floorf(v.x * vert_scale + 0.5f), 
+				(i32)floorf(v.y * vert_scale + 0.5f), 
+				(i32)floorf(v.z * vert_scale + 0.5f), 
+				0 
+			}};
+
+			out->v[j] = WeldTableFetch(&vert_table, key, &inserted);
+			if(inserted) 
+				pool->verts[out->v[j]] = v;
+		}
+
+		// Planes are keyed on normal and distance to the first vertex, coplanar faces share an entry
+		Plane plane = (Plane) { .normal = tri->normal, .d = -Vector3DotProduct(tri->normal, tri->vertices[0]) };
+
+		WeldKey key = (WeldKey) { .k = { 
+			(i32)floorf(plane.normal.x * 10000.0f + 0.5f), 
+			(i32)floorf(plane.normal.y * 10000.0f + 0.5f), 
+			(i32)floorf(plane.normal.z * 10000.0f + 0.5f), 
+			(i32)floorf(plane.d * vert_scale + 0.5f) 
+		}};
+
+		u32 plane_id = WeldTableFetch(&plane_table, key, &inserted);
+		if(inserted) 
+			pool->planes[plane_id] = plane;
+
+		if(plane_id >= TRI_MAX_PLANES) {
+			MessageError("ERROR: Tri pool plane table overflow", NULL);
+			plane_id = 0;
+		}
+
+		out->plane_id = plane_id;
+	}
+
+	pool->vert_count = vert_table.count;
+	pool->plane_count = plane_table.count;
+
+	pool->verts = realloc(pool->verts, sizeof(Vector3) * pool->vert_count);
+	pool->planes = realloc(pool->planes, sizeof(Plane) * pool->plane_count);
+
+	WeldTableFree(&vert_table);
+	WeldTableFree(&plane_table);
+}
+
+void TriPoolFree(TriPool *pool) {
+	if(pool->arr)
+		free(pool->arr);
+
+	if(pool->verts)
+		free(pool->verts);
+
+	if(pool->planes)
+		free(pool->planes);
+
+	*pool = (TriPool) {0};
+}
+
 // Calculate cost of a node
 float BvhNodeCost(BvhNode *node) {
 	return BoxSurfaceArea(node->bounds) * node->tri_count;
@@ -286,8 +498,8 @@ void BvhNodeUpdateBounds(MapSection *sect, BvhTree *bvh, u16 node_id) {
 	for(u16 i = 0; i < node->tri_count; i++) {
 		//u16 tri_id = bvh->tri_ids[node->first_tri + i];
 		//Tri tri = sect->tris[tri_id];
-		u16 tri_id = bvh->tris.ids[node->first_tri + i];
-		Tri tri = bvh->tris.arr[tri_id];
+		u16 tri_id = bvh->tri_ids[node->first_tri + i];
+		Tri tri = TriPoolGet(bvh->tris, tri_id);
 
 		for(short j = 0; j < 3; j++) {
 			node->bounds.min = (Vector3) {
@@ -339,6 +551,11 @@ void BvhConstruct(MapSection *sect, BvhTree *bvh, Vector3 volume, TriPool *tri_p
 	bvh->shape = volume;
 	Vector3 shape_half = Vector3Scale(bvh->shape, 0.5f);
 
+	// Reference section geometry, only primitive order is owned by the tree
+	bvh->tris = tri_pool;
+	bvh->tri_ids = malloc(sizeof(u16) * tri_pool->count);
+	for(u16 i = 0; i < tri_pool->count; i++) bvh->tri_ids[i] = i;
+
 	//bvh->tri_ids = malloc(sect->tri_count * sizeof(u16));
 	//memcpy(bvh->tri_ids, sect->tri_ids, sizeof(u16) * sect->tri_count);
 	//memcpy(tri_pool->ids, bvh->tri_ids, sizeof(u16) * tri_pool->count); 
@@ -349,8 +566,8 @@ void BvhConstruct(MapSection *sect, BvhTree *bvh, Vector3 volume, TriPool *tri_p
 	root.first_tri = 0;
 
 	// Grow bounds of root to contain all section geoemetry  
-	for(u16 i = 0; i < bvh->tris.count; i++) {
-		Tri tri = tri_pool->arr[tri_pool->ids[i]];
+	for(u16 i = 0; i < tri_pool->count; i++) {
+		Tri tri = TriPoolGet(tri_pool, i);
 
 		float diff = MinkowskiDiff(tri.normal, shape_half);
 
@@ -365,7 +582,7 @@ void BvhConstruct(MapSection *sect, BvhTree *bvh, Vector3 volume, TriPool *tri_p
 
 	// Assign root to array, increment node count 
 	//root.tri_count = sect->tri_count;
-	root.tri_count = bvh->tris.count;
+	root.tri_count = tri_pool->count;
 	bvh->nodes[bvh->count++] = root;
 
 	// Start recursive node splitting
@@ -388,11 +605,8 @@ void BvhClose(BvhTree *bvh) {
 	if(bvh->nodes)
 		free(bvh->nodes);
 
-	if(bvh->tris.arr) 
-		free(bvh->tris.arr);
-
-	if(bvh->tris.ids)
-		free(bvh->tris.ids);
+	if(bvh->tri_ids)
+		free(bvh->tri_ids);
 }
 
 // Compute optimal axis and position for node subdivision  
@@ -403,8 +617,8 @@ float FindBestSplit(MapSection *sect, BvhTree *bvh, BvhNode *node, short *axis,
 		float vmin = FLT_MAX, vmax = -FLT_MAX;
 
 		for(u16 i = 0; i < node->tri_count; i++) {
-			u16 tri_id = bvh->tris.ids[node->first_tri + i];
-			Tri tri = bvh->tris.arr[tri_id];
+			u16 tri_id = bvh->tri_ids[node->first_tri + i];
+			Tri tri = TriPoolGet(bvh->tris, tri_id);
 
 			float3 centroid = Vector3ToFloatV(TriCentroid(tri));
 
@@ -420,7 +634,7 @@ float FindBestSplit(MapSection *sect, BvhTree *bvh, BvhNode *node, short *axis,
 		float scale = BVH_BIN_COUNT / (vmax - vmin);
 
 		for(u16 i = 0; i < node->tri_count; i++) {
-			Tri tri = bvh->tris.arr[bvh->tris.ids[node->first_tri + i]];
+			Tri tri = TriPoolGet(bvh->tris, bvh->tri_ids[node->first_tri + i]);
 			float3 centroid = Vector3ToFloatV(TriCentroid(tri));
 
 			int bin_id = fmin(BVH_BIN_COUNT - 1, (int)((centroid.v[a] - vmin) * scale));
@@ -490,15 +704,15 @@ void BvhNodeSubdivide(MapSection *sect, BvhTree *bvh, u16 node_id) {
 	u16 i = node->first_tri;
 	u16 j = i + node->tri_count - 1;
 	while(i <= j) {
-		u16 tri_id = bvh->tris.ids[i];
-		Tri tri = bvh->tris.arr[tri_id];
+		u16 tri_id = bvh->tri_ids[i];
+		Tri tri = TriPoolGet(bvh->tris, tri_id);
 
 		float3 centroid = Vector3ToFloatV(TriCentroid(tri));
 
 		if(centroid.v[split_axis] < split_pos)
 			i++;
 		else
-			SwapTriIds(&bvh->tris.ids[i], &bvh->tris.ids[j--]);
+			SwapTriIds(&bvh->tri_ids[i], &bvh->tri_ids[j--]);
 	}
 
 	u16 count_lft = i - node->first_tri;
@@ -512,6 +726,9 @@ void BvhNodeSubdivide(MapSection *sect, BvhTree *bvh, u16 node_id) {
 		bvh->capacity = (bvh->capacity << 1);
 		BvhNode *realloc_ptr = realloc(bvh->nodes, sizeof(BvhNode) * bvh->capacity); 
 		bvh->nodes = realloc_ptr;
+
+		// Moved with the array
+		node = &bvh->nodes[node_id];
 	}
 
 	// Create child nodes	
@@ -562,16 +779,37 @@ void MapSectionInit(MapSection *sect, Model model) {
 
 // Unload map section data
 void MapSectionClose(MapSection *sect) {
+	if(sect->nav_los.entries)
+		free(sect->nav_los.entries);
+
+	sect->nav_los = (NavLosCache) {0};
+
+	// Collision and nav data live in the cache mapping
+	if(sect->flags & MAP_SECT_CACHED) {
+		DlcClose(sect);
+		UnloadBsp(&sect->bsp_data);
+		UnloadModel(sect->model);
+		return;
+	}
+
+	NavMeshClose(&sect->navmesh);
+
+	for(u8 i = 0; i < sect->navgraph_count; i++) {
+		NavClustersFree(&sect->navgraphs[i]);
+		NavIndexFree(&sect->navgraphs[i]);
+	}
+
 	for(short i = 0; i < 3; i++) {
 		BvhClose(&sect->bvh[i]);
 
 		if(sect->_hulls[i].arr)
 			free(sect->_hulls[i].arr);
 
-		if(sect->_tris[i].arr)
-			free(sect->_tris[i].arr);
+		TriPoolFree(&sect->_tris[i]);
 	}
 
+	HullBvhClose(&sect->hull_bvh);
+
 	for(u8 i = 0; i < sect->navgraph_count; i++) {
 		if(sect->navgraphs[i].nodes)
 			free(sect->navgraphs[i].nodes);
@@ -641,10 +879,10 @@ void BvhTracePoint(Ray ray, MapSection *sect, BvhTree *bvh, u16 node_id, float *
 	};
 
 	for(u16 i = 0; i < node->tri_count; i++) {
-		u16 tri_id = bvh->tris.ids[node->first_tri + i];
-		Tri *tri = &bvh->tris.arr[tri_id];
+		u16 tri_id = bvh->tri_ids[node->first_tri + i];
+		Tri tri = TriPoolGet(bvh->tris, tri_id);
 
-		coll = GetRayCollisionTriangle(ray, tri->vertices[0], tri->vertices[1], tri->vertices[2]);
+		coll = GetRayCollisionTriangle(ray, tri.vertices[0], tri.vertices[1], tri.vertices[2]);
 		if(!coll.hit) continue;
 
 		if(coll.distance < *smallest_dist) {
@@ -676,6 +914,7 @@ void BvhTracePoint(Ray ray, MapSection *sect, BvhTree *bvh, u16 node_id, float *
 
 void BvhTracePointEx(Ray ray, MapSection *sect, BvhTree *bvh, u16 node_id, BvhTraceData *data, float max_dist) {
 	BvhNode *node = &bvh->nodes[node_id];
+	COLL_STAT(nodes);
 
 	RayCollision coll;
 
@@ -687,8 +926,9 @@ void BvhTracePointEx(Ray ray, MapSection *sect, BvhTree *bvh, u16 node_id, BvhTr
 	};
 
 	for(u16 i = 0; i < node->tri_count; i++) {
-		u16 tri_id = bvh->tris.ids[node->first_tri + i];
-		Tri tri = bvh->tris.arr[tri_id];
+		u16 tri_id = bvh->tri_ids[node->first_tri + i];
+		Tri tri = TriPoolGet(bvh->tris, tri_id);
+		COLL_STAT(prims);
 
 		if(Vector3DotProduct(ray.direction, tri.normal) >= 0)
 			continue;
@@ -751,8 +991,8 @@ void BvhSweepPointEx(Ray ray, MapSection *sect, BvhTree *bvh, u16 node_id, BvhTr
 	};
 
 	for(u16 i = 0; i < node->tri_count; i++) {
-		u16 tri_id = bvh->tris.ids[node->first_tri + i];
-		Tri tri = bvh->tris.arr[tri_id];
+		u16 tri_id = bvh->tri_ids[node->first_tri + i];
+		Tri tri = TriPoolGet(bvh->tris, tri_id);
 
 		if(Vector3DotProduct(ray.direction, tri.normal) >= 0)
 			continue;
@@ -814,6 +1054,7 @@ void BvhSphereSweep(Ray ray, MapSection *sect, BvhTree *bvh, u16 node_id, BvhTra
 
 void BvhBoxSweep(Ray ray, MapSection *sect, BvhTree *bvh, u16 node_id, BoundingBox box, BvhTraceData *data) {
 	BvhNode *node = &bvh->nodes[node_id];
+	COLL_STAT(nodes);
 
 	RayCollision coll;
 	Vector3 h = Vector3Scale(BoxExtent(box), 0.5f);
@@ -829,8 +1070,9 @@ void BvhBoxSweep(Ray ray, MapSection *sect, BvhTree *bvh, u16 node_id, BoundingB
 	};
 
 	for(u16 i = 0; i < node->tri_count; i++) {
-		u16 tri_id = bvh->tris.ids[node->first_tri + i];
-		Tri tri = bvh->tris.arr[tri_id];
+		u16 tri_id = bvh->tri_ids[node->first_tri + i];
+		Tri tri = TriPoolGet(bvh->tris, tri_id);
+		COLL_STAT(prims);
 
 		//if(Vector3DotProduct(tri.normal, ray.direction) > 0) tri.normal = Vector3Negate(tri.normal);
 		if(Vector3DotProduct(tri.normal, ray.direction) > 0) continue;
@@ -937,3 +1179,301 @@ bool IsPointInHull(Vector3 point, Hull *hull) {
 	return true;
 }
 
+
+HullTraceData HullTraceDataEmpty() {
+	return (HullTraceData) {
+		.fraction = 1.0f,
+		.hull_id = 0,
+		.hit = false,
+		.start_solid = false,
+		.all_solid = false
+	};
+}
+
+// Hull centroid cached for sorting, so splits don't recompute it per comparison
+typedef struct {
+	float center[3];
+	u16 id;
+
+} HullBvhKey;
+
+static int HullBvhKeyOrder(const HullBvhKey *ka, const HullBvhKey *kb, short axis) {
+	if(ka->center[axis] != kb->center[axis]) return (ka->center[axis] < kb->center[axis]) ? -1 : 1;
+
+	// Ties by id, qsort isn't stable and builds should come out the same every time
+	return (ka->id < kb->id) ? -1 : (ka->id > kb->id);
+}
+
+static int HullBvhKeyCompareX(const void *a, const void *b) { return HullBvhKeyOrder(a, b, 0); }
+static int HullBvhKeyCompareY(const void *a, const void *b) { return HullBvhKeyOrder(a, b, 1); }
+static int HullBvhKeyCompareZ(const void *a, const void *b) { return HullBvhKeyOrder(a, b, 2); }
+
+static u16 HullBvhSubdivide(HullBvh *bvh, HullBvhKey *keys, u16 count) {
+	u16 node_id = bvh->count++;
+	HullBvhNode *node = &bvh->nodes[node_id];
+
+	*node = (HullBvhNode) { .bounds = EmptyBox() };
+
+	BoundingBox centroid_bounds = EmptyBox();
+	for(u16 i = 0; i < count; i++) {
+		Hull *hull = &bvh->hulls->arr[keys[i].id];
+
+		node->bounds.min = Vector3Min(node->bounds.min, hull->aabb.min);
+		node->bounds.max = Vector3Max(node->bounds.max, hull->aabb.max);
+		centroid_bounds = BoxExpandToPoint(centroid_bounds, BoxCenter(hull->aabb));
+	}
+
+	// Leaf
+	if(count == 1) {
+		node->hull_id = keys[0].id;
+		return node_id;
+	}
+
+	// Split on longest centroid axis at median
+	Vector3 ext = BoxExtent(centroid_bounds);
+	short axis = 0;
+	if(ext.y > ext.x) axis = 1;
+	if(ext.z > ((axis == 0) ? ext.x : ext.y)) axis = 2;
+
+	int (*compare[3])(const void*, const void*) = { HullBvhKeyCompareX, HullBvhKeyCompareY, HullBvhKeyCompareZ };
+	qsort(keys, count, sizeof(HullBvhKey), compare[axis]);
+
+	u16 half = count >> 1;
+
+	u16 child_lft = HullBvhSubdivide(bvh, keys, half);
+	u16 child_rgt = HullBvhSubdivide(bvh, keys + half, count - half);
+
+	// Node pointer may not be used here, children were appended after it
+	bvh->nodes[node_id].child_lft = child_lft;
+	bvh->nodes[node_id].child_rgt = child_rgt;
+
+	return node_id;
+}
+
+void HullBvhBuild(HullBvh *bvh, HullPool *hulls) {
+	*bvh = (HullBvh) { .hulls = hulls };
+
+	if(!hulls->count)
+		return;
+
+	// Binary tree with one hull per leaf, node ids are u16
+	u32 capacity = (u32)hulls->count * 2 - 1;
+	if(capacity > 0xFFFF) {
+		MessageError("HullBvhBuild", "too many hulls for one tree");
+		return;
+	}
+
+	bvh->capacity = capacity;
+	bvh->nodes = malloc(sizeof(HullBvhNode) * bvh->capacity);
+
+	HullBvhKey *keys = malloc(sizeof(HullBvhKey) * hulls->count);
+	for(u16 i = 0; i < hulls->count; i++) {
+		Vector3 center = BoxCenter(hulls->arr[i].aabb);
+		keys[i] = (HullBvhKey) { .center = { center.x, center.y, center.z }, .id = i };
+	}
+
+	HullBvhSubdivide(bvh, keys, hulls->count);
+
+	free(keys);
+}
+
+void HullBvhClose(HullBvh *bvh) {
+	if(bvh->nodes)
+		free(bvh->nodes);
+
+	bvh->nodes = NULL;
+	bvh->count = 0;
+	bvh->capacity = 0;
+}
+
+// Clip against one plane, returns false if the whole move is in front of it
+bool HullClipPlane(Vector3 normal, float d, Vector3 start, Vector3 end, Vector3 h, float *enter, float *leave, Vector3 *enter_normal, bool *start_out, bool *end_out) {
+	float offset = MinkowskiDiff(normal, h);
+
+	float d1 = Vector3DotProduct(normal, start) + d - offset;
+	float d2 = Vector3DotProduct(normal, end) + d - offset;
+
+	if(d1 > 0) *start_out = true;
+	if(d2 > 0) *end_out = true;
+
+	// Completely in front of face, no intersection with hull
+	if(d1 > 0 && (d2 >= HULL_SURF_EPS || d2 >= d1))
+		return false;
+
+	// Completely behind face
+	if(d1 <= 0 && d2 <= 0)
+		return true;
+
+	if(d1 > d2) {
+		// Entering
+		float f = (d1 - HULL_SURF_EPS) / (d1 - d2);
+		if(f < 0) f = 0;
+
+		if(f > *enter) {
+			*enter = f;
+			*enter_normal = normal;
+		}
+
+	} else {
+		// Leaving
+		float f = (d1 + HULL_SURF_EPS) / (d1 - d2);
+		if(f > 1) f = 1;
+
+		if(f < *leave)
+			*leave = f;
+	}
+
+	return true;
+}
+
+void HullClipBox(Hull *hull, Vector3 start, Vector3 end, Vector3 half_extents, HullTraceData *trace) {
+	float enter = -1.0f;
+	float leave = 1.0f;
+
+	Vector3 enter_normal = Vector3Zero();
+
+	bool start_out = false;
+	bool end_out = false;
+
+	for(u16 i = 0; i < hull->plane_count; i++) {
+		Plane *plane = &hull->planes[i];
+
+		if(!HullClipPlane(plane->normal, plane->d, start, end, half_extents, &enter, &leave, &enter_normal, &start_out, &end_out))
+			return;
+	}
+
+	// Axial bevels, hull faces alone leave gaps at edges and corners when pushed out by a box
+	float3 min = Vector3ToFloatV(hull->aabb.min);
+	float3 max = Vector3ToFloatV(hull->aabb.max);
+	for(short a = 0; a < 3; a++) {
+		float3 n = {0};
+
+		n.v[a] = 1;
+		if(!HullClipPlane((Vector3) { n.v[0], n.v[1], n.v[2] }, -max.v[a], start, end, half_extents, &enter, &leave, &enter_normal, &start_out, &end_out))
+			return;
+
+		n.v[a] = -1;
+		if(!HullClipPlane((Vector3) { n.v[0], n.v[1], n.v[2] }, min.v[a], start, end, half_extents, &enter, &leave, &enter_normal, &start_out, &end_out))
+			return;
+	}
+
+	if(!start_out) {
+		trace->start_solid = true;
+		trace->hull_id = hull->id;
+
+		if(!end_out) {
+			trace->all_solid = true;
+			trace->fraction = 0;
+			trace->hit = true;
+		}
+
+		return;
+	}
+
+	if(enter < leave && enter > -1 && enter < trace->fraction) {
+		trace->fraction = (enter < 0) ? 0 : enter;
+		trace->normal = enter_normal;
+		trace->hull_id = hull->id;
+		trace->hit = true;
+	}
+}
+
+// Slab test, returns entry fraction of segment into box or a value > 1 on miss
+float HullBvhNodeEnter(BoundingBox box, Vector3 start, Vector3 inv_delta) {
+	float3 s = Vector3ToFloatV(start);
+	float3 inv = Vector3ToFloatV(inv_delta);
+	float3 min = Vector3ToFloatV(box.min);
+	float3 max = Vector3ToFloatV(box.max);
+
+	float t_min = 0.0f, t_max = 1.0f;
+
+	for(short a = 0; a < 3; a++) {
+		// Axis is not moving
+		if(inv.v[a] == 0) {
+			if(s.v[a] < min.v[a] || s.v[a] > max.v[a])
+				return FLT_MAX;
+
+			continue;
+		}
+
+		float t0 = (min.v[a] - s.v[a]) * inv.v[a];
+		float t1 = (max.v[a] - s.v[a]) * inv.v[a];
+
+		if(t0 > t1) {
+			float temp = t0;
+			t0 = t1;
+			t1 = temp;
+		}
+
+		t_min = fmaxf(t_min, t0);
+		t_max = fminf(t_max, t1);
+
+		if(t_min > t_max)
+			return FLT_MAX;
+	}
+
+	return t_min;
+}
+
+void HullSweepBox(HullBvh *bvh, Vector3 start, Vector3 end, Vector3 extents, HullTraceData *trace) {
+	trace->end = end;
+	if(!bvh->count)
+		return;
+
+	Vector3 h = Vector3Scale(extents, 0.5f);
+	Vector3 delta = Vector3Subtract(end, start);
+
+	float3 d = Vector3ToFloatV(delta);
+	Vector3 inv_delta = (Vector3) {
+		(fabsf(d.v[0]) > EPSILON) ? 1.0f / d.v[0] : 0,
+		(fabsf(d.v[1]) > EPSILON) ? 1.0f / d.v[1] : 0,
+		(fabsf(d.v[2]) > EPSILON) ? 1.0f / d.v[2] : 0
+	};
+
+	u16 stack[HULL_BVH_STACK_SIZE];
+	u16 stack_count = 0;
+	stack[stack_count++] = 0;
+
+	while(stack_count) {
+		HullBvhNode *node = &bvh->nodes[stack[--stack_count]];
+
+		// Node bounds grown by box half extents 
+		BoundingBox box = (BoundingBox) { Vector3Subtract(node->bounds.min, h), Vector3Add(node->bounds.max, h) };
+
+		// Skip if entered after current closest hit
+		if(HullBvhNodeEnter(box, start, inv_delta) > trace->fraction)
+			continue;
+
+		bool leaf = (node->child_lft == 0 && node->child_rgt == 0);
+		if(leaf) {
+			HullClipBox(&bvh->hulls->arr[node->hull_id], start, end, h, trace);
+
+			if(trace->all_solid)
+				break;
+
+			continue;
+		}
+
+		if(stack_count + 2 > HULL_BVH_STACK_SIZE) {
+			MessageError("ERROR: Hull BVH stack overflow", NULL);
+			break;
+		}
+
+		// Push far child first so near child is visited first
+		BoundingBox box_l = bvh->nodes[node->child_lft].bounds;
+		BoundingBox box_r = bvh->nodes[node->child_rgt].bounds;
+
+		float dl = Vector3DotProduct(Vector3Subtract(BoxCenter(box_l), start), delta);
+		float dr = Vector3DotProduct(Vector3Subtract(BoxCenter(box_r), start), delta);
+
+		if(dl < dr) {
+			stack[stack_count++] = node->child_rgt;
+			stack[stack_count++] = node->child_lft;
+		} else {
+			stack[stack_count++] = node->child_lft;
+			stack[stack_count++] = node->child_rgt;
+		}
+	}
+
+	trace->end = Vector3Add(start, Vector3Scale(delta, trace->fraction));
+}
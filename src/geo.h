@@ -85,20 +85,71 @@ typedef struct {
 
 BoxNormals BoxGetFaceNormals(BoundingBox box);
 
+// View frustum, plane normals face inward
+typedef struct {
+	Plane planes[6];
+
+} Frustum;
+
+// Get frustum planes from a camera, aspect is width over height of the target drawn to
+Frustum FrustumFromCamera(Camera3D camera, float aspect);
+
+// False if box is fully behind any plane. 
+// Boxes just outside a corner can still pass, fine for culling
+bool FrustumBoxVisible(Frustum *frustum, BoundingBox box);
+
 // Create a primitive array from mesh
 Tri *MeshToTris(Mesh mesh, u16 *tri_count);
 
 // Create a primitive array from model (with indexing)
 Tri *ModelToTris(Model model, u16 *tri_count, u16 **tri_ids);
 
+// Indexed triangle, vertices and plane are stored in the owning TriPool
+typedef struct {
+	u32 v[3];						// 12 bytes
+
+	u16 plane_id;					// 2 bytes
+	u16 hull_id;					// 2 bytes
+
+} TriIndex;							// 16 bytes total
+
+// Max distance between two vertices to be welded 
+#define TRI_WELD_EPS 	0.01f
+#define TRI_MAX_PLANES 	0xFFFF
+
 // Tri primitive collection
+// Welded vertex buffer and plane table shared by all tris of a collision volume
 typedef struct { 
-	Tri *arr;
-	u16 *ids;
+	Vector3 *verts;
+	Plane *planes;
+	TriIndex *arr;
+
+	u32 vert_count;
+	u32 plane_count;
+
 	u16 count;
 
 } TriPool;
 
+// Build indexed pool from a tri array, welding shared vertices and planes
+void TriPoolBuild(TriPool *pool, Tri *tris, u16 count);
+
+// Free pool storage
+void TriPoolFree(TriPool *pool);
+
+// Unpack an indexed tri
+static inline Tri TriPoolGet(TriPool *pool, u32 id) {
+	TriIndex *t = &pool->arr[id];
+
+	return (Tri) {
+		.vertices[0] = pool->verts[t->v[0]],
+		.vertices[1] = pool->verts[t->v[1]],
+		.vertices[2] = pool->verts[t->v[2]],
+		.normal = pool->planes[t->plane_id].normal,
+		.hull_id = t->hull_id
+	};
+}
+
 #define MAX_TRIS_PER_NODE	4
 // BVH node struct
 typedef struct {
@@ -116,8 +167,7 @@ typedef struct {
 
 } BvhNode;							// 32 byte total
 
-// *
-// Not used 
+// Hull BVH node, leaves hold a single hull and have no children
 typedef struct {
 	BoundingBox bounds;
 
@@ -139,7 +189,9 @@ typedef struct {
 // Separate from nodes for indexed based approach
 // Using pointers means at least 2x node size, slowing search
 typedef struct {
-	TriPool tris;
+	// Geometry is owned by the map section, tree only keeps it's own primitive order
+	TriPool *tris;
+	u16 *tri_ids;
 
 	BvhNode *nodes;
 
@@ -173,12 +225,68 @@ typedef struct {
 
 } HullPool;
 
+// BVH over convex hulls, used for box sweeps of any size
+typedef struct {
+	// Hulls are owned by the map section 
+	HullPool *hulls;
+
+	HullBvhNode *nodes;
+
+	u16 count;
+	u16 capacity;
+
+} HullBvh;
+
+#define HULL_BVH_STACK_SIZE 64
+#define HULL_SURF_EPS 		0.03125f
+
+typedef struct {
+	Vector3 end;
+	Vector3 normal;
+
+	float fraction;
+
+	u16 hull_id;
+
+	bool hit;
+	bool start_solid;
+	bool all_solid;
+
+} HullTraceData;
+
+HullTraceData HullTraceDataEmpty();
+
+// Build tree over a hull pool
+void HullBvhBuild(HullBvh *bvh, HullPool *hulls);
+
+void HullBvhClose(HullBvh *bvh);
+
+// Clip a box moving from start to end against a single hull, 
+// plane test against hull planes pushed out by box support plus axial bevels 
+void HullClipBox(Hull *hull, Vector3 start, Vector3 end, Vector3 half_extents, HullTraceData *trace);
+
+// Sweep a box of any extents through hull BVH 
+void HullSweepBox(HullBvh *bvh, Vector3 start, Vector3 end, Vector3 extents, HullTraceData *trace);
+
+// Compiled level cache mapping, see dlc.c
+typedef struct {
+	char path[256];
+
+	void *base;
+	u64 size;
+
+	u64 hash;
+
+} LevelCache;
+
 #define MAP_SECT_LOADED	0x01
 #define MAP_SECT_QUEUED	0x02
+#define MAP_SECT_CACHED	0x04
 typedef struct {
 	BvhTree bvh[4];
 	TriPool _tris[4];
 	HullPool _hulls[4];
+	HullBvh hull_bvh;
 
 	Bsp_Hull bsp[4];
 	Bsp_Data bsp_data;
@@ -186,8 +294,13 @@ typedef struct {
 	NavGraph base_navgraph;
 	NavGraph *navgraphs;
 
+	NavMesh navmesh;
+	NavLosCache nav_los;
+
 	Model model;
 
+	LevelCache cache;
+
 	u16 hull_count;
 
 	u8 navgraph_count;
@@ -255,6 +368,24 @@ typedef struct {
 
 BvhTraceData TraceDataEmpty();
 
+// * NOTE:
+// Work counters for the collision benchmark (make bench-collision).
+// Only counted in builds with -DCOLLISION_STATS so the game's traces pay nothing,
+// counting isn't atomic either so numbers are only good from a single thread
+typedef struct {
+	u64 nodes;		// BVH nodes or clip nodes visited
+	u64 prims;		// Triangles or planes tested
+
+} CollisionStats;
+
+extern CollisionStats coll_stats;
+
+#ifdef COLLISION_STATS
+#define COLL_STAT(field) (coll_stats.field++)
+#else
+#define COLL_STAT(field)
+#endif
+
 void BvhTraceNodes(Ray ray, MapSection *sect, BvhTree *bvh, u16 node_id, float smallest_dist, BvhNode *node_hit);
 
 // Trace a point through world space
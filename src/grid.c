@@ -1,150 +1,575 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
 #include "raylib.h"
+#include "raymath.h"
 #include "ent.h"
+#include "../include/log_message.h"
 
-void EntGridInit(EntityHandler *handler) {
-	//printf("grid init\n");
+#define ENT_GRID_MIN_TABLE 256
 
-	EntGrid grid = (EntGrid) {0};
+u32 GridHashCoords(Coords coords) {
+	return ((u32)coords.c * 73856093u) ^ ((u32)coords.r * 19349663u) ^ ((u32)coords.t * 83492791u);
+}
+
+bool CoordsEqual(Coords a, Coords b) {
+	return (a.c == b.c && a.r == b.r && a.t == b.t);
+}
+
+void GridTableInsert(EntGrid *grid, i32 cell_id) {
+	u32 mask = grid->table_cap - 1;
+	u32 slot = GridHashCoords(grid->cells[cell_id].coords) & mask;
 
-	grid.size = (Coords) { .c = 32, .r = 32, .t = 12 };
+	while(grid->table[slot] != -1)
+		slot = (slot + 1) & mask;
+
+	grid->table[slot] = cell_id;
+}
+
+void GridTableGrow(EntGrid *grid) {
+	grid->table_cap = (grid->table_cap) ? (grid->table_cap << 1) : ENT_GRID_MIN_TABLE;
+	grid->table = realloc(grid->table, sizeof(i32) * grid->table_cap);
+	memset(grid->table, -1, sizeof(i32) * grid->table_cap);
+
+	for(u32 i = 0; i < grid->cell_count; i++)
+		GridTableInsert(grid, i);
+}
+
+i32 GridTableFind(EntGrid *grid, Coords coords) {
+	if(!grid->table_cap)
+		return -1;
+
+	u32 mask = grid->table_cap - 1;
+	u32 slot = GridHashCoords(coords) & mask;
+
+	while(grid->table[slot] != -1) {
+		i32 cell_id = grid->table[slot];
+		if(CoordsEqual(grid->cells[cell_id].coords, coords))
+			return cell_id;
+
+		slot = (slot + 1) & mask;
+	}
+
+	return -1;
+}
+
+u8 GridSizeClass(u16 cap) {
+	u8 size_class = 0;
+	while((4u << size_class) < cap) size_class++;
+
+	return size_class;
+}
 
-	grid.cell_count = grid.size.c * grid.size.r * grid.size.t;
-	grid.cells = calloc(grid.cell_count, sizeof(EntGridCell));
+// Take a span of (4 << size_class) ids from the pool
+u32 GridSpanAlloc(EntGrid *grid, u8 size_class) {
+	u32 first = grid->free_spans[size_class];
+
+	// Free spans store the next free span in their first two slots
+	if(first != ENT_GRID_NO_SPAN) {
+		memcpy(&grid->free_spans[size_class], &grid->pool[first], sizeof(u32));
+		return first;
+	}
+
+	u32 size = (4u << size_class);
+	if(grid->pool_count + size > grid->pool_cap) {
+		while(grid->pool_count + size > grid->pool_cap)
+			grid->pool_cap = (grid->pool_cap) ? (grid->pool_cap << 1) : 1024;
+
+		grid->pool = realloc(grid->pool, sizeof(u16) * grid->pool_cap);
+	}
+
+	first = grid->pool_count;
+	grid->pool_count += size;
+
+	return first;
+}
+
+void GridSpanFree(EntGrid *grid, u32 first, u16 cap) {
+	u8 size_class = GridSizeClass(cap);
+
+	memcpy(&grid->pool[first], &grid->free_spans[size_class], sizeof(u32));
+	grid->free_spans[size_class] = first;
+}
+
+// Returns slot of entity in cell, -1 if cell can't grow
+i32 GridCellAdd(EntGrid *grid, i32 cell_id, u16 ent_id) {
+	EntGridCell *cell = &grid->cells[cell_id];
+
+	if(cell->ent_count >= cell->ent_cap) {
+		u8 size_class = (cell->ent_cap) ? GridSizeClass(cell->ent_cap) + 1 : 0;
+		if(size_class >= ENT_GRID_SIZE_CLASSES) {
+			MessageError("ERROR: Grid cell full", NULL);
+			return -1;
+		}
+
+		u32 first = GridSpanAlloc(grid, size_class);
+		if(cell->ent_cap) {
+			memcpy(&grid->pool[first], &grid->pool[cell->first], sizeof(u16) * cell->ent_count);
+			GridSpanFree(grid, cell->first, cell->ent_cap);
+		}
+
+		cell->first = first;
+		cell->ent_cap = (4u << size_class);
+	}
+
+	grid->pool[cell->first + cell->ent_count] = ent_id;
+	return cell->ent_count++;
+}
 
-	/*
-	printf("cols: %d\n", grid.size.c);
-	printf("rows: %d\n", grid.size.r);
-	printf("tabs: %d\n", grid.size.t);
-	printf("cell count: %d\n", (grid.size.c * grid.size.r * grid.size.t));
-	*/
+// Swap last id of cell into slot, and point its owner's link at the new slot
+void GridCellRemove(EntGrid *grid, i32 cell_id, u16 slot) {
+	EntGridCell *cell = &grid->cells[cell_id];
+	u16 *ents = &grid->pool[cell->first];
 
-	Vector3 origin = (Vector3) {
-		(-grid.size.c * ENT_GRID_CELL_EXTENTS.x) * 0.5f,
-		(-grid.size.r * ENT_GRID_CELL_EXTENTS.y) * 0.5f, 
-		(-grid.size.t * ENT_GRID_CELL_EXTENTS.z) * 0.5f 
-	};  
-	grid.origin = origin;
+	u16 last = --cell->ent_count;
+	if(slot == last)
+		return;
 
-	for(u16 i = 0; i < grid.cell_count; i++) {
-		Coords coords = CellIdToCoords(i, &grid); 
+	u16 moved = ents[last];
+	ents[slot] = moved;
 
-		BoundingBox box = (BoundingBox) { .min = Vector3Scale(ENT_GRID_CELL_EXTENTS, -0.5f), .max = Vector3Scale(ENT_GRID_CELL_EXTENTS, 0.5f) };
-		grid.cells[i].aabb = BoxTranslate(box, CoordsToVec3(coords, &grid));
-		
-		grid.cells[i].ent_count = 0;
-		for(u8 j = 0; j < MAX_ENTS_PER_CELL; j++) grid.cells[i].ents[j] = 0;
+	EntGridLinks *links = &grid->links[moved];
+	for(u8 i = 0; i < links->count; i++) {
+		if(links->cells[i] == cell_id) {
+			links->slots[i] = slot;
+			break;
+		}
 	}
+}
+
+void GridUnlink(EntGrid *grid, u16 id) {
+	EntGridLinks *links = &grid->links[id];
+
+	for(u8 i = 0; i < links->count; i++)
+		GridCellRemove(grid, links->cells[i], links->slots[i]);
+
+	links->count = 0;
+}
+
+void GridLink(EntGrid *grid, u16 id, i32 cell_id) {
+	EntGridLinks *links = &grid->links[id];
+
+	i32 slot = GridCellAdd(grid, cell_id, id);
+	if(slot < 0)
+		return;
+
+	links->cells[links->count] = cell_id;
+	links->slots[links->count] = slot;
+	links->count++;
+}
+
+void EntGridInit(EntityHandler *handler) {
+	EntGrid grid = (EntGrid) {0};
+
+	// Per entity arrays are sized by EntGridReserve as the entity pool grows
+	EntGridSetCellSize(&grid, ENT_GRID_CELL_SIZE);
 
 	handler->grid = grid;
 }
 
+void EntGridReserve(EntGrid *grid, u16 capacity) {
+	if(capacity <= grid->ent_cap)
+		return;
+
+	u16 prev = grid->ent_cap;
+	grid->ent_cap = capacity;
+
+	grid->links = realloc(grid->links, sizeof(EntGridLinks) * capacity);
+	grid->query_stamp = realloc(grid->query_stamp, sizeof(u32) * capacity);
+	grid->dirty = realloc(grid->dirty, sizeof(u16) * capacity);
+
+	memset(&grid->links[prev], 0, sizeof(EntGridLinks) * (capacity - prev));
+	memset(&grid->query_stamp[prev], 0, sizeof(u32) * (capacity - prev));
+}
+
+void EntGridRemove(EntGrid *grid, u16 id) {
+	if(id >= grid->ent_cap)
+		return;
+
+	// Left in dirty list if it's there, UpdateGrid skips ids that aren't live
+	GridUnlink(grid, id);
+}
+
+void EntGridClose(EntGrid *grid) {
+	if(grid->cells) free(grid->cells);
+	if(grid->table) free(grid->table);
+	if(grid->pool) free(grid->pool);
+
+	if(grid->links) free(grid->links);
+	if(grid->query_stamp) free(grid->query_stamp);
+	if(grid->dirty) free(grid->dirty);
+
+	*grid = (EntGrid) {0};
+}
+
+void EntGridClear(EntGrid *grid) {
+	grid->pool_count = 0;
+	for(u8 i = 0; i < ENT_GRID_SIZE_CLASSES; i++)
+		grid->free_spans[i] = ENT_GRID_NO_SPAN;
+
+	for(u32 i = 0; i < grid->cell_count; i++) {
+		grid->cells[i].ent_count = 0;
+		grid->cells[i].ent_cap = 0;
+	}
+
+	for(u16 i = 0; i < grid->ent_cap; i++) {
+		grid->links[i].count = 0;
+		grid->links[i].dirty = false;
+	}
+	grid->dirty_count = 0;
+}
+
+void EntGridSetCellSize(EntGrid *grid, float cell_size) {
+	grid->cell_size = Clamp(cell_size, ENT_GRID_MIN_CELL_SIZE, ENT_GRID_MAX_CELL_SIZE);
+	grid->cell_count = 0;
+
+	grid->min = (Coords) { INT16_MAX, INT16_MAX, INT16_MAX };
+	grid->max = (Coords) { INT16_MIN, INT16_MIN, INT16_MIN };
+
+	if(grid->table_cap)
+		memset(grid->table, -1, sizeof(i32) * grid->table_cap);
+
+	EntGridClear(grid);
+}
+
+void EntGridMarkDirty(EntGrid *grid, u16 id) {
+	if(id >= grid->ent_cap || grid->links[id].dirty)
+		return;
+
+	grid->links[id].dirty = true;
+	grid->dirty[grid->dirty_count++] = id;
+}
+
 void UpdateGrid(EntityHandler *handler) {
 	EntGrid *grid = &handler->grid;
 
-	for(u16 i = 0; i < handler->count; i++) {
-		Entity *ent = &handler->ents[i];
-		comp_Transform *ct = &ent->comp_transform;
+	for(u16 i = 0; i < grid->dirty_count; i++) {
+		u16 id = grid->dirty[i];
+		Entity *ent = &handler->ents[id];
+		EntGridLinks *links = &grid->links[id];
+		comp_Transform *ct = ent->comp_transform;
 
-		i16 src_id = ent->cell_id; 	
+		links->dirty = false;
 
-		Coords dest_coords = Vec3ToCoords(ct->position, grid);
-		if(!CoordsInBounds(dest_coords, grid)) {
-			//puts("dest coords out of bounds");
+		// Freed after being marked
+		if(handler->live_index[id] == ENT_NOT_LIVE)
 			continue;
+
+		ent->cell_id = CellCoordsToId(Vec3ToCoords(ct->position, grid), grid);
+
+		if(grid->bsp && grid->bsp->num_models) {
+			bool has_bounds = (ct->bounds.max.x >= ct->bounds.min.x);
+			ent->leaf_id = Bsp_FindLeaf(grid->bsp, has_bounds ? BoxCenter(ct->bounds) : ct->position);
 		}
 
-		i16 dest_id = CellCoordsToId(dest_coords, grid);
+		Coords min = Vec3ToCoords(ct->bounds.min, grid);
+		Coords max = Vec3ToCoords(ct->bounds.max, grid);
+
+		// Still overlapping the same cells
+		if(links->count && CoordsEqual(min, links->min) && CoordsEqual(max, links->max))
+			continue;
+
+		GridUnlink(grid, id);
+		links->min = min;
+		links->max = max;
 
-		EntGridCell *dest_cell = &grid->cells[dest_id];
+		i32 range = (max.c - min.c + 1) * (max.r - min.r + 1) * (max.t - min.t + 1);
 
-		if(src_id == -1) {
-			ent->cell_id = dest_id;
-			dest_cell->ents[dest_cell->ent_count++] = ent->id;
+		// Bounds not set up yet
+		if(max.c < min.c || max.r < min.r || max.t < min.t) {
+			GridLink(grid, id, ent->cell_id);
 			continue;
 		}
-	
-		EntGridCell *src_cell = &grid->cells[src_id];
-			
-		if(src_id == dest_id)
-			continue;
 
-		/*
-		if(!CheckCollisionBoxes(ct->bounds, src_cell->aabb)) {
-			for(u8 j = 0; j < src_cell->ent_count; j++) {
-				if(src_cell->ents[j] == ent->id) { 
-					for(u8 n = j; n < src_cell->ent_count-1; n++)
-						src_cell->ents[n] = src_cell->ents[n+1];
+		if(range > ENT_GRID_MAX_LINKS) {
+			// Runs on a job thread, TextFormat's static buffer isn't safe here
+			char id_text[8];
+			snprintf(id_text, sizeof(id_text), "%d", id);
 
-					src_cell->ent_count--;
-					break;
-				}
+			MessageError("Entity bounds span too many grid cells, linking position only", id_text);
+			GridLink(grid, id, ent->cell_id);
+			continue;
+		}
+
+		for(i16 t = min.t; t <= max.t; t++) {
+			for(i16 r = min.r; r <= max.r; r++) {
+				for(i16 c = min.c; c <= max.c; c++) 
+					GridLink(grid, id, CellCoordsToId((Coords) { c, r, t }, grid));
 			}
 		}
-		*/
+	}
 
-		if(!CheckCollisionBoxes(src_cell->aabb, ct->bounds)) {
-			for(u8 j = 0; j < src_cell->ent_count; j++) {
-				if(src_cell->ents[j] == ent->id) { 
-					for(u8 n = j; n < src_cell->ent_count-1; n++) {
-						src_cell->ents[n] = src_cell->ents[n+1];
-					}
+	grid->dirty_count = 0;
+}
 
-					src_cell->ent_count--;
-					break;
+void EntGridRebuild(EntityHandler *handler) {
+	EntGridClear(&handler->grid);
+
+	for(u16 n = 0; n < handler->live_count; n++) {
+		u16 id = handler->live[n];
+		handler->ents[id].cell_id = -1;
+		EntGridMarkDirty(&handler->grid, id);
+	}
+
+	UpdateGrid(handler);
+}
+
+// Stamps mark ids already seen, bumping generation forgets all of them
+void GridQueryBegin(EntGrid *grid) {
+	if(++grid->query_generation == 0) {
+		memset(grid->query_stamp, 0, sizeof(u32) * grid->ent_cap);
+		grid->query_generation = 1;
+	}
+}
+
+bool EntGridVisit(EntGrid *grid, u16 id) {
+	if(grid->query_stamp[id] == grid->query_generation)
+		return false;
+
+	grid->query_stamp[id] = grid->query_generation;
+	return true;
+}
+
+u16 EntGridQueryBox(EntGrid *grid, BoundingBox box, u16 *out, u16 max) {
+	GridQueryBegin(grid);
+
+	Coords min = Vec3ToCoords(box.min, grid);
+	Coords max_coords = Vec3ToCoords(box.max, grid);
+
+	u16 count = 0;
+	for(i16 t = min.t; t <= max_coords.t; t++) {
+		for(i16 r = min.r; r <= max_coords.r; r++) {
+			for(i16 c = min.c; c <= max_coords.c; c++) {
+				EntGridCell *cell = EntGridFind(grid, (Coords) { c, r, t });
+				if(!cell)
+					continue;
+
+				u16 *ents = EntGridCellEnts(grid, cell);
+				for(u16 i = 0; i < cell->ent_count; i++) {
+					if(EntGridVisit(grid, ents[i]) && count < max)
+						out[count++] = ents[i];
 				}
 			}
 		}
+	}
+
+	return count;
+}
+
+void EntGridRayBegin(EntGridRay *it, EntGrid *grid, Ray ray, float max_dist) {
+	GridQueryBegin(grid);
+	EntGridRayBeginShared(it, grid, ray, max_dist);
+}
+
+void EntGridRayBeginShared(EntGridRay *it, EntGrid *grid, Ray ray, float max_dist) {
+	*it = (EntGridRay) { .ray = ray, .done = true };
+
+	// No cells yet
+	if(grid->min.c > grid->max.c)
+		return;
+
+	// Clip ray to the box around created cells, so rays starting outside still walk in
+	Vector3 box_min = CoordsToVec3(grid->min, grid);
+	Vector3 box_max = Vector3AddValue(CoordsToVec3(grid->max, grid), grid->cell_size);
+
+	float orig[3] = { ray.position.x, ray.position.y, ray.position.z };
+	float dir[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
+	float lo[3] = { box_min.x, box_min.y, box_min.z };
+	float hi[3] = { box_max.x, box_max.y, box_max.z };
+
+	float t_enter = 0.0f;
+	float t_exit = max_dist;
+
+	for(u8 a = 0; a < 3; a++) {
+		if(dir[a] == 0.0f) {
+			if(orig[a] < lo[a] || orig[a] > hi[a])
+				return;
+
+			continue;
+		}
+
+		float t0 = (lo[a] - orig[a]) / dir[a];
+		float t1 = (hi[a] - orig[a]) / dir[a];
+		if(t0 > t1) { float tmp = t0; t0 = t1; t1 = tmp; }
+
+		t_enter = fmaxf(t_enter, t0);
+		t_exit = fminf(t_exit, t1);
+	}
+
+	if(t_enter > t_exit)
+		return;
+
+	Vector3 start = Vector3Add(ray.position, Vector3Scale(ray.direction, t_enter));
+	Coords cell = Vec3ToCoords(start, grid);
 
-		if(dest_cell->ent_count + 1 > MAX_ENTS_PER_CELL)
+	// Entry point can round into the cell just outside
+	cell.c = Clamp(cell.c, grid->min.c, grid->max.c);
+	cell.r = Clamp(cell.r, grid->min.r, grid->max.r);
+	cell.t = Clamp(cell.t, grid->min.t, grid->max.t);
+
+	i16 cell_arr[3] = { cell.c, cell.r, cell.t };
+	i16 step[3];
+	float t_max[3], t_delta[3];
+
+	for(u8 a = 0; a < 3; a++) {
+		// Axis aligned rays never cross boundaries on the other axes
+		if(dir[a] == 0.0f) {
+			step[a] = 0;
+			t_max[a] = FLT_MAX;
+			t_delta[a] = FLT_MAX;
 			continue;
+		}
 
-		ent->cell_id = dest_id;
-		dest_cell->ents[dest_cell->ent_count++] = ent->id;
+		step[a] = (dir[a] > 0) ? 1 : -1;
+
+		float boundary = (cell_arr[a] + ((dir[a] > 0) ? 1 : 0)) * grid->cell_size;
+		t_max[a] = (boundary - orig[a]) / dir[a];
+		t_delta[a] = fabsf(grid->cell_size / dir[a]);
 	}
+
+	it->cell = cell;
+	it->step = (Coords) { step[0], step[1], step[2] };
+	it->t_max = (Vector3) { t_max[0], t_max[1], t_max[2] };
+	it->t_delta = (Vector3) { t_delta[0], t_delta[1], t_delta[2] };
+	it->t = t_enter;
+	it->t_end = t_exit;
+	it->done = false;
 }
 
-int16_t CellCoordsToId(Coords coords, EntGrid *grid) {
-	//return (coords.c + coords.r * + coords.t * grid->size.c * grid->size.r);
-	return (
-		coords.c + 
-		coords.r * grid->size.c + 
-		coords.t * grid->size.c * grid->size.r
-	);
+EntGridCell *EntGridRayNext(EntGridRay *it, EntGrid *grid, float best_dist) {
+	while(!it->done) {
+		if(it->t > it->t_end || it->t > best_dist) {
+			it->done = true;
+			break;
+		}
+
+		Coords curr = it->cell;
+
+		// Step across the closest boundary
+		if(it->t_max.x <= it->t_max.y && it->t_max.x <= it->t_max.z) {
+			it->t = it->t_max.x;
+			it->t_max.x += it->t_delta.x;
+			it->cell.c += it->step.c;
+
+		} else if(it->t_max.y <= it->t_max.z) {
+			it->t = it->t_max.y;
+			it->t_max.y += it->t_delta.y;
+			it->cell.r += it->step.r;
+
+		} else {
+			it->t = it->t_max.z;
+			it->t_max.z += it->t_delta.z;
+			it->cell.t += it->step.t;
+		}
+
+		EntGridCell *cell = EntGridFind(grid, curr);
+		if(cell && cell->ent_count)
+			return cell;
+	}
+
+	return NULL;
 }
 
-Coords CellIdToCoords(int16_t id, EntGrid *grid) {
-	return (Coords) {
-		.c = id % grid->size.c,						// x,
-		.r = (id / grid->size.c) % grid->size.r,	// y,
-		.t = id / (grid->size.c * grid->size.r)		// z
+float EntGridTuneCellSize(EntityHandler *handler) {
+	Vector3 min = (Vector3) {  FLT_MAX,  FLT_MAX,  FLT_MAX };
+	Vector3 max = (Vector3) { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	u16 count = 0;
+
+	for(u16 n = 0; n < handler->live_count; n++) {
+		Vector3 pos = handler->ents[handler->live[n]].comp_transform->position;
+		min = Vector3Min(min, pos);
+		max = Vector3Max(max, pos);
+		count++;
+	}
+
+	if(count < ENT_GRID_TARGET_DENSITY)
+		return ENT_GRID_CELL_SIZE;
+
+	// Levels are mostly spread out horizontally, so size cells by floor area
+	Vector3 extents = Vector3Subtract(max, min);
+	float area = fmaxf(extents.x, 1.0f) * fmaxf(extents.y, 1.0f);
+
+	float cell_size = sqrtf(area * ENT_GRID_TARGET_DENSITY / count);
+	return Clamp(cell_size, ENT_GRID_MIN_CELL_SIZE, ENT_GRID_MAX_CELL_SIZE);
+}
+
+i32 CellCoordsToId(Coords coords, EntGrid *grid) {
+	i32 cell_id = GridTableFind(grid, coords);
+	if(cell_id > -1)
+		return cell_id;
+
+	// Keep table at most half full
+	if((grid->cell_count + 1) * 2 > grid->table_cap)
+		GridTableGrow(grid);
+
+	if(grid->cell_count >= grid->cell_cap) {
+		grid->cell_cap = (grid->cell_cap) ? (grid->cell_cap << 1) : 256;
+		grid->cells = realloc(grid->cells, sizeof(EntGridCell) * grid->cell_cap);
+	}
+
+	cell_id = grid->cell_count++;
+
+	Vector3 cell_min = CoordsToVec3(coords, grid);
+	grid->cells[cell_id] = (EntGridCell) {
+		.aabb = (BoundingBox) { .min = cell_min, .max = Vector3AddValue(cell_min, grid->cell_size) },
+		.coords = coords,
+		.first = 0,
+		.ent_cap = 0,
+		.ent_count = 0
+	};
+
+	GridTableInsert(grid, cell_id);
+
+	grid->min = (Coords) {
+		(coords.c < grid->min.c) ? coords.c : grid->min.c,
+		(coords.r < grid->min.r) ? coords.r : grid->min.r,
+		(coords.t < grid->min.t) ? coords.t : grid->min.t
+	};
+	grid->max = (Coords) {
+		(coords.c > grid->max.c) ? coords.c : grid->max.c,
+		(coords.r > grid->max.r) ? coords.r : grid->max.r,
+		(coords.t > grid->max.t) ? coords.t : grid->max.t
 	};
+
+	return cell_id;
+}
+
+Coords CellIdToCoords(i32 id, EntGrid *grid) {
+	return grid->cells[id].coords;
+}
+
+EntGridCell *EntGridFind(EntGrid *grid, Coords coords) {
+	i32 cell_id = GridTableFind(grid, coords);
+	return (cell_id > -1) ? &grid->cells[cell_id] : NULL;
+}
+
+u16 *EntGridCellEnts(EntGrid *grid, EntGridCell *cell) {
+	return &grid->pool[cell->first];
 }
 
 Coords Vec3ToCoords(Vector3 v, EntGrid *grid) {
-	Vector3 local = Vector3Subtract(v, grid->origin);
+	float inv = 1.0f / grid->cell_size;
 
 	return (Coords) {
-		.c = ( (local.x) / ENT_GRID_CELL_EXTENTS.x ),
-		.r = ( (local.y) / ENT_GRID_CELL_EXTENTS.y ),
-		.t = ( (local.z) / ENT_GRID_CELL_EXTENTS.z )
+		.c = (i16)Clamp(floorf(v.x * inv), INT16_MIN, INT16_MAX),
+		.r = (i16)Clamp(floorf(v.y * inv), INT16_MIN, INT16_MAX),
+		.t = (i16)Clamp(floorf(v.z * inv), INT16_MIN, INT16_MAX)
 	};
 }
 
 Vector3 CoordsToVec3(Coords coords, EntGrid *grid) {
-	//return Vector3Scale((Vector3) { coords.c, coords.r, coords.t }, ENT_GRID_CELL_EXTENTS.x);
-	Vector3 local = (Vector3) {
-		coords.c * ENT_GRID_CELL_EXTENTS.x,
-		coords.r * ENT_GRID_CELL_EXTENTS.y,
-		coords.t * ENT_GRID_CELL_EXTENTS.z
+	return (Vector3) {
+		coords.c * grid->cell_size,
+		coords.r * grid->cell_size,
+		coords.t * grid->cell_size
 	};
-	return Vector3Add(local, grid->origin);
 }
 
 bool CoordsInBounds(Coords coords, EntGrid *grid) {
-	return ( coords.c > -1 && coords.c < grid->size.c &&
-			 coords.r > -1 && coords.r < grid->size.r &&
-			 coords.t > -1 && coords.t < grid->size.t );
+	return ( coords.c >= grid->min.c && coords.c <= grid->max.c &&
+			 coords.r >= grid->min.r && coords.r <= grid->max.r &&
+			 coords.t >= grid->min.t && coords.t <= grid->max.t );
 }
 
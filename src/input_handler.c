@@ -10,47 +10,92 @@ void InputInit(InputHandler *handler) {
 	//handler->mouse_sensitivity = 0.0195f;
 	//handler->mouse_sensitivity = 0.0035f;
 
+	for(u8 i = 0; i < INPUT_ACTION_COUNT; i++)
+		handler->actions[i].button = -1;
+
 	handler->actions[ACTION_MOVE_L].key 	= KEY_A;
 	handler->actions[ACTION_MOVE_R].key 	= KEY_D;
 	handler->actions[ACTION_MOVE_U].key 	= KEY_W;
 	handler->actions[ACTION_MOVE_D].key 	= KEY_S;
 
 	handler->actions[ACTION_JUMP].key = KEY_SPACE;
+
+	handler->actions[ACTION_SHOOT].button = MOUSE_BUTTON_LEFT;
+	handler->actions[ACTION_RECALL].button = MOUSE_BUTTON_RIGHT;
+
+	handler->actions[ACTION_PREV_WEAPON].key = KEY_Q;
+	handler->actions[ACTION_NEXT_WEAPON].key = KEY_E;
+}
+
+// Edges stay latched until consumed. 
+// Nothing replaces a press, a press replaces a release
+static void InputActionLatch(InputAction *action, bool down, bool pressed, bool released) {
+	if(pressed) {
+		action->state = INPUT_PRESSED;
+		return;
+	}
+
+	if(action->state == INPUT_PRESSED)
+		return;
+
+	if(released) {
+		action->state = INPUT_RELEASED;
+		return;
+	}
+
+	if(action->state == INPUT_RELEASED)
+		return;
+
+	action->state = (down) ? INPUT_DOWN : INPUT_UP;
 }
 
 void PollInput(InputHandler *handler) {
 	handler->mouse_position = GetMousePosition();
 
-	float dt = GetFrameTime();
-
-	// Get mouse delta, scale by sensitivity setting
+	// Get mouse delta, scale by sensitivity setting.
+	// Adds up until consumed by a simulation step
 	Vector2 d = GetMouseDelta();
-	handler->mouse_delta = Vector2Scale(d, handler->mouse_sensitivity);
+	handler->mouse_delta = Vector2Add(handler->mouse_delta, Vector2Scale(d, handler->mouse_sensitivity));
+	handler->mouse_wheel += GetMouseWheelMove();
 
 	for(u8 i = 0; i < INPUT_ACTION_COUNT; i++) {
 		InputAction *action = &handler->actions[i];
 
 		i32 key = action->key;
-		if(!key) continue;
+		i32 button = action->button;
 
-		if(IsKeyUp(key))
-			action->state = INPUT_UP;
+		if(!key && button < 0) continue;
 
-		if(IsKeyDown(key)) 
-			action->state = INPUT_DOWN;
+		bool down = false, pressed = false, released = false;
+
+		if(key) {
+			down |= IsKeyDown(key);
+			pressed |= IsKeyPressed(key);
+			released |= IsKeyReleased(key);
+		}
 
-		if(IsKeyPressed(key))
-			action->state = INPUT_PRESSED;
+		if(button > -1) {
+			down |= IsMouseButtonDown(button);
+			pressed |= IsMouseButtonPressed(button);
+			released |= IsMouseButtonReleased(button);
+		}
 
-		if(IsKeyReleased(key))
-			action->state = INPUT_RELEASED;
+		InputActionLatch(action, down, pressed, released);
 	}
+}
+
+void InputConsume(InputHandler *handler) {
+	handler->mouse_delta = Vector2Zero();
+	handler->mouse_wheel = 0;
 
 	for(u8 i = 0; i < INPUT_ACTION_COUNT; i++) {
 		InputAction *action = &handler->actions[i];
 
-		i32 button = action->button;
-		if(!action->button) continue;
+		if(action->state == INPUT_PRESSED)
+			action->state = INPUT_DOWN;
+
+		if(action->state == INPUT_RELEASED)
+			action->state = INPUT_UP;
 	}
 }
 
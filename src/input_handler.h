@@ -16,8 +16,8 @@ enum INPUT_METHODS : u8 {
 #define INPUT_RELEASED		3
 
 typedef struct {
-	int key;		// Keyboard key 		
-	int button;		// Mouse button
+	int key;		// Keyboard key, 0 if unbound
+	int button;		// Mouse button, -1 if unbound (left button is 0)
 
 	short state;	// up, down, press, release
 	
@@ -34,6 +34,10 @@ typedef struct {
 
 #define ACTION_SHOOT		5
 #define ACTION_SHOOT_ALT 	6
+#define ACTION_RECALL		7
+
+#define ACTION_PREV_WEAPON	8
+#define ACTION_NEXT_WEAPON	9
 
 typedef struct {
 	InputAction actions[INPUT_ACTION_COUNT];
@@ -41,14 +45,24 @@ typedef struct {
 	Vector2 mouse_position;
 	Vector2 mouse_delta;
 
+	float mouse_wheel;
+
 	float mouse_sensitivity;
 
 	u8 input_method;
 
 } InputHandler;
 
+// * NOTE:
+// Input is polled once per frame but read by fixed simulation steps, a frame can run zero or several steps.
+// Pressed/released states, mouse delta and wheel are held until a step consumes them,
+// so nothing is dropped on frames without a step or applied twice on frames with more than one.
+// A latched press is never replaced by a release before a step sees it, taps shorter than a step still register
 void InputInit(InputHandler *handler);
 void PollInput(InputHandler *handler);
 
+// Call after every simulation step, clears mouse delta and wheel and turns pressed/released into down/up
+void InputConsume(InputHandler *handler);
+
 #endif
 
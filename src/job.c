@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "job.h"
+
+#define JOB_RANGE(first, end) (((u64)(end) << 32) | (u64)(first))
+#define JOB_RANGE_FIRST(range) ((u32)((range) & 0xFFFFFFFF))
+#define JOB_RANGE_END(range) ((u32)((range) >> 32))
+
+// Take next chunk from the front of own queue
+bool JobPop(JobQueue *queue, u32 *chunk) {
+	u64 range = atomic_load(&queue->range);
+
+	while(JOB_RANGE_FIRST(range) < JOB_RANGE_END(range)) {
+		u64 next = JOB_RANGE(JOB_RANGE_FIRST(range) + 1, JOB_RANGE_END(range));
+
+		if(atomic_compare_exchange_weak(&queue->range, &range, next)) {
+			*chunk = JOB_RANGE_FIRST(range);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Move back half of victim's chunks into own queue.
+// Own queue is empty here and only its owner ever adds to it, so a plain store is enough
+bool JobSteal(JobQueue *victim, JobQueue *own) {
+	u64 range = atomic_load(&victim->range);
+
+	while(JOB_RANGE_FIRST(range) < JOB_RANGE_END(range)) {
+		u32 first = JOB_RANGE_FIRST(range);
+		u32 end = JOB_RANGE_END(range);
+		u32 take = (end - first + 1) >> 1;
+
+		if(atomic_compare_exchange_weak(&victim->range, &range, JOB_RANGE(first, end - take))) {
+			atomic_store(&own->range, JOB_RANGE(end - take, end));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobWork(JobPool *pool, u8 self) {
+	JobQueue *own = &pool->queues[self];
+
+	for(;;) {
+		u32 chunk;
+
+		if(!JobPop(own, &chunk)) {
+			// Start at neighbour so thieves spread out
+			bool stolen = false;
+			for(u8 i = 1; i < pool->worker_count && !stolen; i++)
+				stolen = JobSteal(&pool->queues[(self + i) % pool->worker_count], own);
+
+			if(!stolen)
+				return;
+
+			atomic_fetch_add(&pool->steals, 1);
+			continue;
+		}
+
+		u32 first = chunk * pool->chunk_size;
+		u32 count = pool->count - first;
+		if(count > pool->chunk_size)
+			count = pool->chunk_size;
+
+		pool->func(pool->data, first, count, self);
+	}
+}
+
+void *JobWorkerRun(void *arg) {
+	JobWorker *worker = arg;
+	JobPool *pool = worker->pool;
+
+	u32 seen = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for(;;) {
+		while(pool->batch == seen && !pool->quit)
+			pthread_cond_wait(&pool->wake, &pool->lock);
+
+		if(pool->quit)
+			break;
+
+		seen = pool->batch;
+		pthread_mutex_unlock(&pool->lock);
+
+		JobWork(pool, worker->index);
+
+		pthread_mutex_lock(&pool->lock);
+		if(--pool->active == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	return NULL;
+}
+
+void JobPoolInit(JobPool *pool, u8 thread_count) {
+	*pool = (JobPool) {0};
+
+	if(thread_count == 0) {
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		thread_count = (cores < 1) ? 1 : (cores > JOB_MAX_WORKERS) ? JOB_MAX_WORKERS : cores;
+	}
+
+	if(thread_count > JOB_MAX_WORKERS)
+		thread_count = JOB_MAX_WORKERS;
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	pool->worker_count = 1;
+	pool->workers[0] = (JobWorker) { .pool = pool, .index = 0 };
+
+	// Worker 0 is the calling thread
+	for(u8 i = 1; i < thread_count; i++) {
+		pool->workers[i] = (JobWorker) { .pool = pool, .index = i };
+
+		if(pthread_create(&pool->threads[i], NULL, JobWorkerRun, &pool->workers[i]) != 0) {
+			printf("ERROR: Could not start job worker %d, continuing with %d\n", i, i);
+			break;
+		}
+
+		pool->worker_count++;
+	}
+}
+
+void JobPoolClose(JobPool *pool) {
+	if(!pool->worker_count)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	for(u8 i = 1; i < pool->worker_count; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	pthread_mutex_destroy(&pool->lock);
+	pthread_cond_destroy(&pool->wake);
+	pthread_cond_destroy(&pool->done);
+
+	pool->worker_count = 0;
+}
+
+void JobParallelFor(JobPool *pool, u32 count, u32 chunk_size, JobFunc func, void *data) {
+	if(!count)
+		return;
+
+	if(!chunk_size)
+		chunk_size = 1;
+
+	u32 chunk_count = (count + chunk_size - 1) / chunk_size;
+
+	if(pool->worker_count <= 1 || chunk_count == 1) {
+		func(data, 0, count, 0);
+		return;
+	}
+
+	pool->func = func;
+	pool->data = data;
+	pool->count = count;
+	pool->chunk_size = chunk_size;
+
+	for(u8 i = 0; i < pool->worker_count; i++) {
+		u32 first = (u64)chunk_count * i / pool->worker_count;
+		u32 end = (u64)chunk_count * (i + 1) / pool->worker_count;
+		atomic_store(&pool->queues[i].range, JOB_RANGE(first, end));
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->batch++;
+	pool->active = pool->worker_count - 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	JobWork(pool, 0);
+
+	pthread_mutex_lock(&pool->lock);
+	while(pool->active)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void JobGraphBegin(JobGraph *graph) {
+	graph->task_count = 0;
+	graph->level_count = 0;
+}
+
+void JobGraphAdd(JobGraph *graph, char *name, JobTaskFunc func, void *data, u32 reads, u32 writes, u8 flags) {
+	if(graph->task_count >= JOB_MAX_TASKS) {
+		printf("ERROR: Job graph is full, can't add %s\n", name);
+		return;
+	}
+
+	u8 level = 0;
+	for(u8 i = 0; i < graph->task_count; i++) {
+		JobTask *prev = &graph->tasks[i];
+
+		bool conflict = (prev->writes & (reads | writes)) || (writes & prev->reads);
+		if(conflict && prev->level + 1 > level)
+			level = prev->level + 1;
+	}
+
+	graph->tasks[graph->task_count++] = (JobTask) {
+		.func = func,
+		.data = data,
+		.name = name,
+		.reads = reads,
+		.writes = writes,
+		.flags = flags,
+		.level = level
+	};
+
+	if(level + 1 > graph->level_count)
+		graph->level_count = level + 1;
+}
+
+void JobGraphRunTasks(void *data, u32 first, u32 count, u8 worker) {
+	JobTask **tasks = data;
+
+	for(u32 i = first; i < first + count; i++)
+		tasks[i]->func(tasks[i]->data);
+}
+
+void JobGraphRun(JobGraph *graph, JobPool *pool) {
+	JobTask *level_tasks[JOB_MAX_TASKS];
+
+	for(u8 level = 0; level < graph->level_count; level++) {
+		u8 count = 0;
+
+		for(u8 i = 0; i < graph->task_count; i++) {
+			JobTask *task = &graph->tasks[i];
+			if(task->level == level && !(task->flags & JOB_TASK_MAIN_THREAD))
+				level_tasks[count++] = task;
+		}
+
+		JobParallelFor(pool, count, 1, JobGraphRunTasks, level_tasks);
+
+		for(u8 i = 0; i < graph->task_count; i++) {
+			JobTask *task = &graph->tasks[i];
+			if(task->level == level && (task->flags & JOB_TASK_MAIN_THREAD))
+				task->func(task->data);
+		}
+	}
+}
@@ -0,0 +1,114 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "../include/num_redefs.h"
+
+#ifndef JOB_H_
+#define JOB_H_
+
+// Upper limit of threads in a pool, calling thread included
+#define JOB_MAX_WORKERS 16
+
+// Runs items [first, first + count) of a batch, worker is the index of the thread running it (0 is the caller)
+typedef void (*JobFunc)(void *data, u32 first, u32 count, u8 worker);
+
+// Range of chunks left in a worker's queue, low 32 bits next chunk, high 32 bits end.
+// Owner takes from the front, thieves take half from the back, both with CAS on the whole range.
+// Padded so queues don't share cache lines
+typedef struct {
+	_Atomic u64 range;
+	u8 pad[56];
+
+} JobQueue;
+
+typedef struct JobPool JobPool;
+
+typedef struct {
+	JobPool *pool;
+	u8 index;
+
+} JobWorker;
+
+// * NOTE:
+// Persistent threads that sleep between batches.
+// A batch is split into chunks, spread evenly over every worker's queue up front.
+// Workers that run out steal half of what's left in another queue, so uneven chunks still balance.
+// Calling thread works as worker 0 and returns once every chunk is done and every worker is back asleep,
+// so batch data can live on the caller's stack
+struct JobPool {
+	JobQueue queues[JOB_MAX_WORKERS];
+	JobWorker workers[JOB_MAX_WORKERS];
+	pthread_t threads[JOB_MAX_WORKERS];
+
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+
+	// Current batch
+	JobFunc func;
+	void *data;
+	u32 count;
+	u32 chunk_size;
+
+	u32 batch;			// Bumped for each batch, sleeping workers wait for it to change
+	u8 active;			// Workers still inside the batch
+
+	u8 worker_count;
+	bool quit;
+
+	_Atomic u32 steals;
+
+};
+
+// Start pool, thread_count includes the calling thread. 0 uses one thread per core
+void JobPoolInit(JobPool *pool, u8 thread_count);
+void JobPoolClose(JobPool *pool);
+
+// Run func over [0, count) in chunks of chunk_size and wait for it to finish.
+// Small batches run on the calling thread without waking anyone
+void JobParallelFor(JobPool *pool, u32 count, u32 chunk_size, JobFunc func, void *data);
+
+// ** Task graph ** //
+//
+#define JOB_MAX_TASKS 32
+
+// Task runs on the calling thread, for anything using raylib or running batches of its own
+#define JOB_TASK_MAIN_THREAD 0x01
+
+typedef void (*JobTaskFunc)(void *data);
+
+typedef struct {
+	JobTaskFunc func;
+	void *data;
+	char *name;
+
+	// Bit per resource, meaning of bits is up to the caller
+	u32 reads;
+	u32 writes;
+
+	u8 flags;
+	u8 level;
+
+} JobTask;
+
+// * NOTE:
+// Tasks are added in the order their side effects should happen.
+// A task depends on every earlier task it conflicts with (one writes what the other reads or writes),
+// and is put one level past the latest of them. Levels run one after another, tasks in a level run at the same time.
+// Conflicting tasks always run in the order they were added, tasks that don't conflict touch
+// different data, so results are the same on any number of threads.
+// Main thread tasks of a level run after the rest of it, in order added
+typedef struct {
+	JobTask tasks[JOB_MAX_TASKS];
+	u8 task_count;
+	u8 level_count;
+
+} JobGraph;
+
+void JobGraphBegin(JobGraph *graph);
+void JobGraphAdd(JobGraph *graph, char *name, JobTaskFunc func, void *data, u32 reads, u32 writes, u8 flags);
+
+// Run every task and wait for them, graph can be run again
+void JobGraphRun(JobGraph *graph, JobPool *pool);
+
+#endif
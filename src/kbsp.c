@@ -527,6 +527,48 @@ Bsp_Data LoadBsp(char *path, bool print_output) {
 	return data;
 }
 
+// Read whole lump into a new array
+void *Bsp_ReadLump(FILE *pF, Bsp_Lump lump, u32 item_size, u32 *count) {
+	*count = lump.file_size / item_size;
+
+	void *items = malloc(lump.file_size);
+	fseek(pF, lump.file_offset, SEEK_SET);
+	fread(items, lump.file_size, 1, pF);
+
+	return items;
+}
+
+Bsp_Data LoadBspCollision(char *path) {
+	Bsp_Data data = (Bsp_Data) {0};
+
+	FILE *pF = fopen(path, "rb");
+
+	if(!pF) {
+		MessageError("ERROR: Could not load file ", path);
+		return data;
+	}
+
+	Bsp_Header header = {0};
+	fread(&header, sizeof(header), 1, pF);
+
+	if(header.version != BSP_VERSION) {
+		MessageError("ERROR: BSP version mismatch", NULL);
+		fclose(pF);
+		return data;
+	}
+
+	data.planes = Bsp_ReadLump(pF, header.lumps[LUMP_PLANES], sizeof(Bsp_Plane), &data.num_planes);
+	data.vis = Bsp_ReadLump(pF, header.lumps[LUMP_VIS], 1, &data.num_vis);
+	data.nodes = Bsp_ReadLump(pF, header.lumps[LUMP_NODES], sizeof(Bsp_Node), &data.num_nodes);
+	data.clipnodes = Bsp_ReadLump(pF, header.lumps[LUMP_CLIPNODES], sizeof(Bsp_ClipNode), &data.num_clipnodes);
+	data.leaves = Bsp_ReadLump(pF, header.lumps[LUMP_LEAVES], sizeof(Bsp_Leaf), &data.num_leaves);
+	data.models = Bsp_ReadLump(pF, header.lumps[LUMP_MODELS], sizeof(Bsp_Model), &data.num_models);
+
+	fclose(pF);
+
+	return data;
+}
+
 void UnloadBsp(Bsp_Data *data) {
 	if(data->planes)		free(data->planes);
 	if(data->miptex)		free(data->miptex);
@@ -534,11 +576,13 @@ void UnloadBsp(Bsp_Data *data) {
 	if(data->vis)			free(data->vis);
 	if(data->nodes)			free(data->nodes);
 	if(data->clipnodes)		free(data->clipnodes);
+	if(data->hull0_clipnodes)	free(data->hull0_clipnodes);
 	if(data->edges)			free(data->edges);
 	if(data->ledges)		free(data->ledges);
 	if(data->faces)			free(data->faces);
 	if(data->surfaces)		free(data->surfaces);
 	if(data->models)		free(data->models);
+	if(data->leaves)		free(data->leaves);
 
 	if(data->textures) {
 		for(int i = 0; i < data->num_miptex; i++)
@@ -551,6 +595,33 @@ void UnloadBsp(Bsp_Data *data) {
 Bsp_Hull Bsp_BuildHull(Bsp_Data *data, int hull_index) {
 	Bsp_Hull hull = (Bsp_Hull) {0};
 
+	// Hull 0 has no clipnodes, its head node is in the draw tree.
+	// Nodes are copied into clipnodes once, with leaf contents for children like the clip hulls have
+	if(hull_index == 0) {
+		if(!data->hull0_clipnodes) {
+			data->hull0_clipnodes = malloc(sizeof(Bsp_ClipNode) * data->num_nodes);
+
+			for(u32 i = 0; i < data->num_nodes; i++) {
+				Bsp_Node *node = &data->nodes[i];
+				Bsp_ClipNode *clipnode = &data->hull0_clipnodes[i];
+
+				clipnode->planenum = node->planenum;
+
+				for(short j = 0; j < 2; j++) {
+					i16 child = node->children[j];
+					clipnode->children[j] = (child >= 0) ? child : data->leaves[-1 - child].type;
+				}
+			}
+		}
+
+		hull.nodes = data->hull0_clipnodes;
+		hull.first_node = data->models[0].head_nodes[0];
+		hull.last_node = data->num_nodes - 1;
+		hull.planes = data->planes;
+
+		return hull;
+	}
+
 	hull.nodes = data->clipnodes;
 	hull.first_node = data->models[0].head_nodes[hull_index];
 	hull.last_node = data->num_clipnodes - 1;
@@ -575,6 +646,8 @@ int Bsp_PointContents(Bsp_Hull *hull, int num, Vector3 point) {
 
 		node = &hull->nodes[num];
 		plane = &hull->planes[node->planenum];
+		COLL_STAT(nodes);
+		COLL_STAT(prims);
 
 		Vector3 normal = (Vector3) { plane->normal[0], plane->normal[1], plane->normal[2] };
 		d = Vector3DotProduct(normal, point) - plane->dist;
@@ -676,6 +749,8 @@ bool Bsp_RecursiveTraceEx(Bsp_Hull *hull, int node_num, float p1_frac, float p2_
 
 	node = &hull->nodes[node_num];
 	plane = &hull->planes[node->planenum];
+	COLL_STAT(nodes);
+	COLL_STAT(prims);
 
 	Vector3 norm = (Vector3) { plane->normal[0], plane->normal[1], plane->normal[2] };
 	if(plane->type < 3) {
@@ -822,6 +897,49 @@ bool Bsp_LeafVisible(Bsp_Data *bsp, int curr_leaf, int test_leaf) {
 	return false;
 }
 
+int Bsp_VisBytes(Bsp_Data *bsp) {
+	// Leaf 0 is shared solid leaf and has no bit
+	return (bsp->num_leaves + 6) >> 3;
+}
+
+void Bsp_DecompressVis(Bsp_Data *bsp, int leaf, u8 *out) {
+	int bytes = Bsp_VisBytes(bsp);
+
+	// No vis data, default to drawing
+	if(bsp->leaves[leaf].visofs < 0 || (u32)bsp->leaves[leaf].visofs >= bsp->num_vis) {
+		memset(out, 0xFF, bytes);
+		return;
+	}
+
+	u8 *vis = bsp->vis + bsp->leaves[leaf].visofs;
+	u8 *vis_end = bsp->vis + bsp->num_vis;
+
+	// Runs of zero bytes are stored as 0 and run length
+	int i = 0;
+	while(i < bytes && vis < vis_end) {
+		if(*vis == 0) {
+			// Run length cut off by the end of the lump
+			if(vis + 1 >= vis_end)
+				break;
+
+			int run = vis[1];
+			if(run > bytes - i)
+				run = bytes - i;
+
+			memset(out + i, 0, run);
+			i += run;
+			vis += 2;
+			continue;
+		}
+
+		out[i++] = *vis++;
+	}
+
+	// Truncated lump, treat whatever it didn't cover as visible
+	if(i < bytes)
+		memset(out + i, 0xFF, bytes - i);
+}
+
 void Bsp_PrintStructSizes() {
 	printf("box: %zu bytes\n", sizeof(Bsp_Box32));
 	printf("face: %zu bytes\n", sizeof(Bsp_Face));
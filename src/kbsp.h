@@ -207,6 +207,7 @@ typedef struct {
 	Bsp_Lightmap lightmap;
 	Bsp_Lightmap *lightmaps;
 	Bsp_ClipNode *clipnodes;
+	Bsp_ClipNode *hull0_clipnodes;	// Draw tree as clipnodes, made by Bsp_BuildHull
 	Bsp_Leaf *leaves;
 	u16 *lfaces;
 	Bsp_Edge *edges;
@@ -235,6 +236,9 @@ typedef struct {
 } Bsp_Data;
 
 Bsp_Data LoadBsp(char *path, bool print_output);
+
+// Only lumps used by collision and vis queries, no textures or materials so it works without a window
+Bsp_Data LoadBspCollision(char *path);
 void UnloadBsp(Bsp_Data *data);
 
 void Bsp_PrintStructSizes();
@@ -282,6 +286,13 @@ bool Bsp_RecursiveTraceEx(Bsp_Hull *hull, int node_num, float p1_frac, float p2_
 int Bsp_FindLeaf(Bsp_Data *bsp, Vector3 point);
 bool Bsp_LeafVisible(Bsp_Data *bsp, int curr_leaf, int test_leaf);
 
+// Bytes of one decompressed vis row, bit (leaf - 1) is set for each leaf visible from the row's leaf
+int Bsp_VisBytes(Bsp_Data *bsp);
+
+// Decompress vis row of a leaf into out, for testing many leaves against one.
+// Leaves without vis data see everything
+void Bsp_DecompressVis(Bsp_Data *bsp, int leaf, u8 *out);
+
 
 Model *BspLeafToModels(Bsp_Data *bsp, Bsp_Leaf *leaf, int *out_count);
 
@@ -4,8 +4,17 @@
 #include "raymath.h"
 #include "config.h"
 #include "game.h"
+#include "bench.h"
+
+int main(int argc, char **argv) {
+	// Headless player movement replay: game --replay <file> [per tick csv]
+	if(argc > 2 && streq(argv[1], "--replay"))
+		return ReplayRunHeadless(argv[2], (argc > 3) ? argv[3] : NULL);
+
+	// Headless collision query benchmark: game --bench-collision <map directory> [query count]
+	if(argc > 2 && streq(argv[1], "--bench-collision"))
+		return BenchCollision(argv[2], (argc > 3) ? atoi(argv[3]) : 0);
 
-int main() {
 	Config conf = (Config) {0};
 	ConfigInit(&conf);
 	ConfigRead(&conf, "options.conf");
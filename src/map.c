@@ -3,10 +3,17 @@
 #include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "raylib.h"
 #include "raymath.h"
 #include "map.h"
 #include "geo.h"
+#include "dlc.h"
+#include "nav.h"
+#include "pm.h"
+#include "navmesh.h"
 #include "../include/sort.h"
 #include "../include/log_message.h"
 #include "config.h"
@@ -317,41 +324,44 @@ void LoadMapFile(BrushPool *brush_pool, char *path, Model *map_model, SpawnList
 	}
 }
 
+// Expand a single brush by the half extents of a volume, dst is fully overwritten
+void BrushExpand(Brush *src, Brush *dst, Vector3 half_extents) {
+	*dst = (Brush) { .plane_count = src->plane_count, .vert_count = src->vert_count };
+
+	memcpy(dst->planes, src->planes, sizeof(Plane) * dst->plane_count);
+	memcpy(dst->verts, src->verts, sizeof(Vector3) * dst->vert_count);
+
+	// 1. Extend plane by it's normal
+	for(u8 j = 0; j < dst->plane_count; j++) {
+		Plane *plane = &dst->planes[j];
+
+		float diff = MinkowskiDiff(plane->normal, half_extents);
+		plane->d -= diff;
+	}
+
+	// 2. Rebuild vertices, AABBs
+	BrushGetVertices(dst);
+	for(u16 j = 0; j < dst->vert_count; j++) {
+		dst->bounds.min = Vector3Min(dst->bounds.min, dst->verts[j]);
+		dst->bounds.max = Vector3Max(dst->bounds.max, dst->verts[j]);
+	}
+}
+
 // Expand brushes to use as fitting collision volumes 
 BrushPool ExpandBrushes(BrushPool *brush_pool, Vector3 aabb_extents) {
 	BrushPool exp = (BrushPool) {0};
 	exp.count = brush_pool->count;
 	exp.brushes = calloc(brush_pool->count, sizeof(Brush));
 
-	// 1. Extend plane by it's normal
 	Vector3 half_extents = Vector3Scale(aabb_extents, 0.5f);
-	for(u16 i = 0; i < brush_pool->count; i++) {
-		exp.brushes[i] = (Brush) { .plane_count = brush_pool->brushes[i].plane_count, .vert_count = brush_pool->brushes[i].vert_count };
-		Brush *brush = &exp.brushes[i];
-
-		memcpy(brush->planes, brush_pool->brushes[i].planes, sizeof(Plane) * brush->plane_count);
-		memcpy(brush->verts, brush_pool->brushes[i].verts, sizeof(Vector3) * brush->vert_count);
-
-		for(u8 j = 0; j < brush->plane_count; j++) {
-			Plane *plane = &brush->planes[j];
-
-			float diff = MinkowskiDiff(plane->normal, half_extents);
-			plane->d -= diff;
-		}
-
-		// 2. Rebuild vertices, AABBs
-		BrushGetVertices(brush);
-		for(u16 j = 0; j < brush->vert_count; j++) {
-			brush->bounds.min = Vector3Min(brush->bounds.min, brush->verts[j]);
-			brush->bounds.max = Vector3Max(brush->bounds.max, brush->verts[j]);
-		}
-	}	
+	for(u16 i = 0; i < brush_pool->count; i++) 
+		BrushExpand(&brush_pool->brushes[i], &exp.brushes[i], half_extents);
 	
 	return exp;
 }
 
-Tri *BrushToTris(Brush *brush, u16 *count, u16 brush_id) {
-	Tri *tris = calloc(128, sizeof(Tri));
+// Triangulate brush faces into out, which must hold at least BRUSH_MAX_TRIS
+u16 BrushToTrisEx(Brush *brush, u16 brush_id, Tri *tris) {
 	u16 tri_count = 0;
 
 	for(u8 i = 0; i < brush->plane_count; i++) {
@@ -410,6 +420,13 @@ Tri *BrushToTris(Brush *brush, u16 *count, u16 brush_id) {
 			};
 		}
 	}
+
+	return tri_count;
+}
+
+Tri *BrushToTris(Brush *brush, u16 *count, u16 brush_id) {
+	Tri *tris = calloc(BRUSH_MAX_TRIS, sizeof(Tri));
+	u16 tri_count = BrushToTrisEx(brush, brush_id, tris);
 	
 	*count = tri_count;
 
@@ -447,65 +464,190 @@ Tri *TrisFromBrushPool(BrushPool *brush_pool, u16 *count) {
 	return tris;
 }
 
-void BrushTestView(BrushPool *brush_pool, Color color) {
-	for(u16 i = 0; i < brush_pool->count; i++) {
-		Brush *brush = &brush_pool->brushes[i];
+// * NOTE:
+// Collision geometry job, work items are (volume, brush) pairs flattened as volume * brush_count + brush.
+// Each worker takes a contiguous range of items and writes tris to it's own arena, 
+// per item counts are prefix summed afterwards so tri order matches the serial path exactly 
+typedef struct {
+	BrushPool *brush_pool;
+	Vector3 *half_extents;
 
-		//DrawBoundingBox(brush->bounds, SKYBLUE);
-		
-		for(short j = 0; j < brush->vert_count; j++) {
-			//DrawSphere( (Vector3) { brush->verts[j].x, brush->verts[j].y, brush->verts[j].z }, 5, SKYBLUE);
-			//Vector3 v = Vector3Negate(brush->verts[j]);
-			Vector3 v = brush->verts[j];
+	Tri *arena;
+	u16 *item_counts;
+
+	u32 arena_count;
+	u32 arena_cap;
+
+	u32 item_start;
+	u32 item_end;
+
+} BrushJobWorker;
+
+void *BrushJobRun(void *arg) {
+	BrushJobWorker *worker = arg;
+	BrushPool *bp = worker->brush_pool;
+
+	Tri temp[BRUSH_MAX_TRIS];
+
+	for(u32 item = worker->item_start; item < worker->item_end; item++) {
+		u8 vol = item / bp->count;
+		u16 brush_id = item % bp->count;
+
+		Brush *brush = &bp->brushes[brush_id];
+
+		// Zero volumes keep the unexpanded brush
+		Brush exp;
+		if(Vector3LengthSqr(worker->half_extents[vol]) > 0) {
+			BrushExpand(brush, &exp, worker->half_extents[vol]);
+			brush = &exp;
 		}
+
+		u16 tri_count = BrushToTrisEx(brush, brush_id, temp);
+		worker->item_counts[item] = tri_count;
+
+		if(worker->arena_count + tri_count > worker->arena_cap) {
+			while(worker->arena_count + tri_count > worker->arena_cap)
+				worker->arena_cap = (worker->arena_cap << 1);
+
+			worker->arena = realloc(worker->arena, sizeof(Tri) * worker->arena_cap);
+		}
+
+		memcpy(worker->arena + worker->arena_count, temp, sizeof(Tri) * tri_count);
+		worker->arena_count += tri_count;
 	}
+
+	return NULL;
 }
 
-// * NOTE:
-// The plane math for expanding the hulls is completely unsusable and fucked for use in in-game tracing. 
-// However, the tris do build correctly it's just the end planes (terrible coordinate coversion from id format /:)
-// A hacky solution could be to reconstruct the planes *post* tri construction and remove the duplicates...  2 tris = 1 plane
-MapSection BuildMapSect(char *path, SpawnList *spawn_list) {
-	MessageDiag("Constructing map section", path, ANSI_BLUE);
+void BuildCollisionTris(BrushPool *brush_pool, Vector3 *volumes, u8 volume_count, TriPool *out) {
+	u32 item_count = volume_count * brush_pool->count;
 
-	MapSection sect = (MapSection) {0};
+	Vector3 half_extents[volume_count];
+	for(u8 i = 0; i < volume_count; i++) 
+		half_extents[i] = Vector3Scale(volumes[i], 0.5f);
 
-	if(!DirectoryExists(path)) {
-		MessageError("Missing directory", path);
-		return sect;
+	for(u8 i = 0; i < volume_count; i++) 
+		out[i] = (TriPool) {0};
+
+	if(!item_count) 
+		return;
+
+	int thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+	if(thread_count < 1) thread_count = 1;
+	if(thread_count > MAX_BUILD_THREADS) thread_count = MAX_BUILD_THREADS;
+	if((u32)thread_count > item_count) thread_count = item_count;
+
+	u16 *item_counts = calloc(item_count, sizeof(u16));
+
+	BrushJobWorker workers[MAX_BUILD_THREADS] = {0};
+	pthread_t threads[MAX_BUILD_THREADS];
+	bool spawned[MAX_BUILD_THREADS] = {0};
+
+	u32 per_worker = (item_count + thread_count - 1) / thread_count;
+	for(int i = 0; i < thread_count; i++) {
+		BrushJobWorker *worker = &workers[i];
+
+		u32 start = i * per_worker;
+		u32 end = start + per_worker;
+		if(start > item_count) start = item_count;
+		if(end > item_count) end = item_count;
+
+		*worker = (BrushJobWorker) {
+			.brush_pool = brush_pool,
+			.half_extents = half_extents,
+			.item_counts = item_counts,
+			.arena_cap = 1024,
+			.item_start = start,
+			.item_end = end
+		};
+		worker->arena = malloc(sizeof(Tri) * worker->arena_cap);
+
+		// Worker 0 runs on the calling thread
+		if(i > 0) 
+			spawned[i] = (pthread_create(&threads[i], NULL, BrushJobRun, worker) == 0);
 	}
 
-	FilePathList path_list = LoadDirectoryFiles(path);
+	BrushJobRun(&workers[0]);
 
-	// 1. Load 3d model, rendering
-	Message("Loading model...", ANSI_BLUE);
-	short model_id = -1;
-	for(short i = 0; i < path_list.count; i++) if(strcmp(GetFileExtension(path_list.paths[i]), ".glb") == 0) model_id = i;
-	//for(short i = 0; i < path_list.count; i++) if(strcmp(GetFileExtension(path_list.paths[i]), ".obj") == 0) model_id = i;
+	for(int i = 1; i < thread_count; i++) {
+		// Thread creation failed, fall back to running the range here 
+		if(!spawned[i]) {
+			BrushJobRun(&workers[i]);
+			continue;
+		}
 
-	// No model, exit
-	if(model_id == -1) {
-		MessageError("Missing model", NULL);
-		return sect;
+		pthread_join(threads[i], NULL);
 	}
-	
-	Model model = LoadModel(path_list.paths[model_id]);
-	model.transform = MatrixRotateX(90*DEG2RAD);
-	sect.model = model;
 
-	if(GetLogState()) printf("model tri_count: %d\n", sect._tris[0].count);
+	// Prefix sum per volume
+	u32 *item_offsets = malloc(sizeof(u32) * item_count);
+	u32 vol_counts[volume_count];
+	Tri *vol_tris[volume_count];
 
-	// 2. Load .map file, collision, physics, ai logic, etc. 
-	Message("Loading map file...", ANSI_BLUE);
-	short mpf_id = -1;
-	for(short i = 0; i < path_list.count; i++) if(strcmp(GetFileExtension(path_list.paths[i]), ".map") == 0) mpf_id = i;
+	for(u8 v = 0; v < volume_count; v++) {
+		u32 sum = 0;
 
-	// No .map, exit
-	if(mpf_id == -1) { 
-		MessageError("Missing .map file", NULL);
-		return sect;
+		for(u16 j = 0; j < brush_pool->count; j++) {
+			u32 item = v * brush_pool->count + j;
+			item_offsets[item] = sum;
+			sum += item_counts[item];
+		}
+
+		if(sum > UINT16_MAX) {
+			MessageError("ERROR: Collision tri count exceeds limit", NULL);
+			sum = UINT16_MAX;
+		}
+
+		vol_counts[v] = sum;
+		vol_tris[v] = malloc(sizeof(Tri) * sum);
+	}
+
+	// Scatter worker arenas into per volume arrays 
+	for(int i = 0; i < thread_count; i++) {
+		BrushJobWorker *worker = &workers[i];
+		u32 src = 0;
+
+		for(u32 item = worker->item_start; item < worker->item_end; item++) {
+			u8 vol = item / brush_pool->count;
+			u32 dst = item_offsets[item];
+			u32 n = item_counts[item];
+
+			if(dst + n > vol_counts[vol]) 
+				n = (dst < vol_counts[vol]) ? vol_counts[vol] - dst : 0;
+
+			memcpy(vol_tris[vol] + dst, worker->arena + src, sizeof(Tri) * n);
+			src += item_counts[item];
+		}
+
+		free(worker->arena);
 	}
 
+	// Weld into indexed pools
+	for(u8 v = 0; v < volume_count; v++) {
+		TriPoolBuild(&out[v], vol_tris[v], vol_counts[v]);
+		free(vol_tris[v]);
+	}
+
+	free(item_offsets);
+	free(item_counts);
+}
+
+void BrushTestView(BrushPool *brush_pool, Color color) {
+	for(u16 i = 0; i < brush_pool->count; i++) {
+		Brush *brush = &brush_pool->brushes[i];
+
+		//DrawBoundingBox(brush->bounds, SKYBLUE);
+		
+		for(short j = 0; j < brush->vert_count; j++) {
+			//DrawSphere( (Vector3) { brush->verts[j].x, brush->verts[j].y, brush->verts[j].z }, 5, SKYBLUE);
+			//Vector3 v = Vector3Negate(brush->verts[j]);
+			Vector3 v = brush->verts[j];
+		}
+	}
+}
+
+// Parse .map and build collision geometry, BVHs and hulls for each volume
+void BuildMapCollision(MapSection *sect, char *map_path, Model *model, SpawnList *spawn_list) {
 	*spawn_list = (SpawnList) {
 		.count = 0,
 		.capacity = 255,
@@ -513,50 +655,30 @@ MapSection BuildMapSect(char *path, SpawnList *spawn_list) {
 	spawn_list->arr = calloc(spawn_list->capacity, sizeof(EntSpawn));
 
 	BrushPool brush_pools[3] = {0};
-	LoadMapFile(&brush_pools[0], path_list.paths[mpf_id], &model, spawn_list);
-
-	sect._tris[0].arr = TrisFromBrushPool(&brush_pools[0], &sect._tris[0].count);
-	sect._tris[0].ids = calloc(sect._tris[0].count, sizeof(u16));
-	for(u16 j = 0; j < sect._tris[0].count; j++) sect._tris[0].ids[j] = j;
+	LoadMapFile(&brush_pools[0], map_path, model, spawn_list);
 
 	// 3. Build expanded geometry for character to world collsions 
+	Vector3 volumes[3] = { Vector3Zero(), BODY_VOLUME_MEDIUM, BODY_VOLUME_SMALL };
+	BuildCollisionTris(&brush_pools[0], volumes, 3, sect->_tris);
+
 	for(short i = 1; i < 3; i++) {
 		brush_pools[i].count = brush_pools[0].count;
 		brush_pools[i].brushes = calloc(brush_pools[i].count, sizeof(Brush));
 		memcpy(brush_pools[i].brushes, brush_pools[0].brushes, sizeof(Brush) * brush_pools[0].count);
-
-		// Expand brush planes/vertices
-		Vector3 volume = (i == 1) ? BODY_VOLUME_MEDIUM : BODY_VOLUME_SMALL;
-		BrushPool exp = ExpandBrushes(&brush_pools[i], volume);
-
-		// Extract tris
-		sect._tris[i].arr = TrisFromBrushPool(&exp, &sect._tris[i].count);
-		sect._tris[i].ids = calloc(sect._tris[i].count, sizeof(u16));
-		for(u16 j = 0; j < sect._tris[i].count; j++) sect._tris[i].ids[j] = j;
 	}
 
 	// 3. Construct BVH trees for each geometry set
 	for(short i = 0; i < 3; i++) {
-		BvhTree *bvh = &sect.bvh[i];
-		bvh->tris = (TriPool) {0};
-		bvh->tris.count = sect._tris[i].count;
-		bvh->tris.arr = calloc(sect._tris[i].count, sizeof(Tri));
-		bvh->tris.ids = calloc(sect._tris[i].count, sizeof(u16));
-		for(u16 j = 0; j < sect._tris[i].count; j++) {
-			bvh->tris.arr[j] = sect._tris[i].arr[j];
-			bvh->tris.ids[j] = sect._tris[i].ids[j];
-		}
-
 		Vector3 volume = Vector3Zero();
 		if(i == 1)
 			volume = BODY_VOLUME_MEDIUM;
 
-		BvhConstruct(&sect, &sect.bvh[i], volume, &sect._tris[i]);
-		if(GetLogState()) printf("bvh[%d] node count: %d\n", i, sect.bvh->count);
+		BvhConstruct(sect, &sect->bvh[i], volume, &sect->_tris[i]);
+		if(GetLogState()) printf("bvh[%d] node count: %d\n", i, sect->bvh->count);
 	}
 
 	//rmeshes_collection.rmeshes = calloc(model.meshCount, sizeof(MapMesh)); 
-	BoundingBox model_bounds = GetModelBoundingBox(model);
+	BoundingBox model_bounds = GetModelBoundingBox(*model);
 	Vector3 model_center = BoxCenter(model_bounds);
 
 	/*
@@ -577,7 +699,7 @@ MapSection BuildMapSect(char *path, SpawnList *spawn_list) {
 	for(short i = 0; i < 3; i++) {
 		BrushPool *bp = &brush_pools[i];
 
-		sect._hulls[i] = (HullPool) {
+		sect->_hulls[i] = (HullPool) {
 			.arr = malloc(sizeof(Brush) * bp->count),
 			.count = bp->count
 		};
@@ -596,17 +718,77 @@ MapSection BuildMapSect(char *path, SpawnList *spawn_list) {
 			memcpy(hull.planes, brush->planes, sizeof(Plane) * brush->plane_count);
 			memcpy(hull.verts, brush->verts, sizeof(Vector3) * brush->vert_count);
 
-			sect._hulls[i].arr[j] = hull;
+			sect->_hulls[i].arr[j] = hull;
 		}
 
 		free(bp->brushes);
 	}
 
-	Message("Loading bsp", ANSI_BLUE);
+	// 5. Hull BVH over unexpanded brushes, for box sweeps of any size
+	HullBvhBuild(&sect->hull_bvh, &sect->_hulls[0]);
+}
+
+// * NOTE:
+// The plane math for expanding the hulls is completely unsusable and fucked for use in in-game tracing. 
+// However, the tris do build correctly it's just the end planes (terrible coordinate coversion from id format /:)
+// A hacky solution could be to reconstruct the planes *post* tri construction and remove the duplicates...  2 tris = 1 plane
+MapSection BuildMapSect(char *path, SpawnList *spawn_list) {
+	MessageDiag("Constructing map section", path, ANSI_BLUE);
+
+	MapSection sect = (MapSection) {0};
+
+	if(!DirectoryExists(path)) {
+		MessageError("Missing directory", path);
+		return sect;
+	}
+
+	FilePathList path_list = LoadDirectoryFiles(path);
+
+	// 1. Load 3d model, rendering
+	Message("Loading model...", ANSI_BLUE);
+	short model_id = -1;
+	for(short i = 0; i < path_list.count; i++) if(strcmp(GetFileExtension(path_list.paths[i]), ".glb") == 0) model_id = i;
+	//for(short i = 0; i < path_list.count; i++) if(strcmp(GetFileExtension(path_list.paths[i]), ".obj") == 0) model_id = i;
+
+	// No model, exit
+	if(model_id == -1) {
+		MessageError("Missing model", NULL);
+		return sect;
+	}
+	
+	Model model = LoadModel(path_list.paths[model_id]);
+	model.transform = MatrixRotateX(90*DEG2RAD);
+	sect.model = model;
+
+	if(GetLogState()) printf("model tri_count: %d\n", sect._tris[0].count);
+
+	// 2. Load .map file, collision, physics, ai logic, etc. 
+	Message("Loading map file...", ANSI_BLUE);
+	short mpf_id = -1;
+	for(short i = 0; i < path_list.count; i++) if(strcmp(GetFileExtension(path_list.paths[i]), ".map") == 0) mpf_id = i;
+
+	// No .map, exit
+	if(mpf_id == -1) { 
+		MessageError("Missing .map file", NULL);
+		return sect;
+	}
+
 	short bsp_id = -1;
 	for(short i = 0; i < path_list.count; i++)
 		if(strcmp(GetFileExtension(path_list.paths[i]), ".bsp") == 0) bsp_id = i;
 
+	// Skip every build stage if the compiled cache matches the source files
+	DlcSetup(&sect, path_list.paths[mpf_id], (bsp_id != -1) ? path_list.paths[bsp_id] : NULL);
+	if(!DlcLoad(&sect, spawn_list)) {
+		BuildMapCollision(&sect, path_list.paths[mpf_id], &model, spawn_list);
+
+		Message("Building navmesh...", ANSI_BLUE);
+		NavMeshBuild(&sect.navmesh, &sect._tris[0]);
+	}
+
+	if(GetLogState()) printf("navmesh polys: %d, links: %d\n", sect.navmesh.poly_count, sect.navmesh.link_count);
+
+	Message("Loading bsp", ANSI_BLUE);
 	if(bsp_id == -1) { 
 		MessageError("Missing .bsp file", NULL);
 		return sect;
@@ -665,6 +847,25 @@ void BuildNavGraph(MapSection *sect) {
 }
 
 #define MAX_EDGE_LENGTH (64.0f*64.0f)
+
+// Hash grid cell size, matches max edge length so edges only connect nodes in neighbouring cells
+#define NAV_HASH_CELL 64.0f
+
+typedef struct {
+	i32 x, y, z;
+
+} NavHashCell;
+
+typedef struct {
+	float length;
+	u16 id;
+
+} NavEdgeCandidate;
+
+static u32 NavHashCellKey(i32 x, i32 y, i32 z, u32 mask) {
+	return (((u32)x * 73856093u) ^ ((u32)y * 19349663u) ^ ((u32)z * 83492791u)) & mask;
+}
+
 void BuildNavEdges(NavGraph *navgraph) {
 	navgraph->edge_count = 0;
 	navgraph->edge_cap = 128;
@@ -675,62 +876,152 @@ void BuildNavEdges(NavGraph *navgraph) {
 		navgraph->edges = calloc(navgraph->edge_cap, sizeof(NavEdge));
 	}
 
-	for(u16 i = 0; i < navgraph->node_count; i++) {
+	u16 node_count = navgraph->node_count;
+	if(!node_count)
+		return;
+
+	// * NOTE:
+	// Nodes are bucketed into a uniform grid, hashed so sparse levels don't need a dense array.
+	// Buckets are chained through next, cells are stored per node to skip hash collisions
+	u32 bucket_count = 1;
+	while(bucket_count < (u32)node_count * 2)
+		bucket_count <<= 1;
+
+	u32 mask = bucket_count - 1;
+
+	i32 *bucket_first = malloc(sizeof(i32) * bucket_count);
+	for(u32 i = 0; i < bucket_count; i++)
+		bucket_first[i] = -1;
+
+	i32 *next = malloc(sizeof(i32) * node_count);
+	NavHashCell *cells = malloc(sizeof(NavHashCell) * node_count);
+
+	for(u16 i = 0; i < node_count; i++) {
+		Vector3 pos = navgraph->nodes[i].position;
+		navgraph->nodes[i].edge_count = 0;
+
+		cells[i] = (NavHashCell) {
+			.x = (i32)floorf(pos.x / NAV_HASH_CELL),
+			.y = (i32)floorf(pos.y / NAV_HASH_CELL),
+			.z = (i32)floorf(pos.z / NAV_HASH_CELL)
+		};
+
+		u32 key = NavHashCellKey(cells[i].x, cells[i].y, cells[i].z, mask);
+		next[i] = bucket_first[key];
+		bucket_first[key] = i;
+	}
+
+	u16 cand_cap = 32;
+	NavEdgeCandidate *cands = malloc(sizeof(NavEdgeCandidate) * cand_cap);
+
+	u32 dropped = 0;
+	u32 over_limit = 0;
+	i32 first_dropped = -1;
+
+	for(u16 i = 0; i < node_count; i++) {
 		NavNode *node_A = &navgraph->nodes[i];
+		NavHashCell cell = cells[i];
+
+		// Gather nodes in range, only higher ids so each pair is found once
+		u16 cand_count = 0;
+		for(i32 z = cell.z - 1; z <= cell.z + 1; z++) {
+			for(i32 y = cell.y - 1; y <= cell.y + 1; y++) {
+				for(i32 x = cell.x - 1; x <= cell.x + 1; x++) {
+					for(i32 j = bucket_first[NavHashCellKey(x, y, z, mask)]; j != -1; j = next[j]) {
+						if(j <= i)
+							continue;
+
+						if(cells[j].x != x || cells[j].y != y || cells[j].z != z)
+							continue;
+
+						// Using vector subtraction to get distance,
+						// doing this in case I want to integrate actual level geometry later 
+						Vector3 v = Vector3Subtract(node_A->position, navgraph->nodes[j].position);
+						float length = Vector3LengthSqr(v);	
+
+						// Don't build edges if nodes are too far apart
+						if(length > MAX_EDGE_LENGTH)
+							continue;
+
+						if(cand_count >= cand_cap) {
+							cand_cap = cand_cap << 1;
+							cands = realloc(cands, sizeof(NavEdgeCandidate) * cand_cap);
+						}
 
-		for(u16 j = 0; j < navgraph->node_count; j++) {
-			NavNode *node_B = &navgraph->nodes[j];
+						cands[cand_count++] = (NavEdgeCandidate) { .id = j, .length = sqrtf(length) };
+					}
+				}
+			}
+		}
 
-			if(j == i)
-				continue;
+		// Keep edges ordered by node id so output doesn't depend on hashing
+		for(u16 j = 1; j < cand_count; j++) {
+			NavEdgeCandidate cand = cands[j];
 
-			// Using vector subtraction to get distance,
-			// doing this in case I want to integrate actual level geometry later 
-			Vector3 v = Vector3Subtract(node_A->position, node_B->position);
-			float length = Vector3LengthSqr(v);	
-		
-			// Don't build edges if nodes are too far apart
-			if(length > MAX_EDGE_LENGTH)
+			i32 k = j - 1;
+			while(k >= 0 && cands[k].id > cand.id) {
+				cands[k + 1] = cands[k];
+				k--;
+			}
+
+			cands[k + 1] = cand;
+		}
+
+		for(u16 j = 0; j < cand_count; j++) {
+			NavNode *node_B = &navgraph->nodes[cands[j].id];
+
+			// Node edge lists are fixed size, report instead of writing past them
+			if(node_A->edge_count >= MAX_EDGES_PER_NODE || node_B->edge_count >= MAX_EDGES_PER_NODE) {
+				if(first_dropped == -1)
+					first_dropped = (node_A->edge_count >= MAX_EDGES_PER_NODE) ? i : cands[j].id;
+
+				dropped++;
 				continue;
+			}
 
-			// All checks passed, create edge
-			NavEdge edge = (NavEdge) { .id_A = i, .id_B = j };
+			// Edge ids are u16
+			if(navgraph->edge_count == UINT16_MAX) {
+				over_limit++;
+				continue;
+			}
 
 			// Resize edge array if needed
 			if(navgraph->edge_count >= navgraph->edge_cap) {
-				navgraph->edge_cap = navgraph->edge_cap << 1;
+				u32 cap = (u32)navgraph->edge_cap << 1;
+				navgraph->edge_cap = (cap > UINT16_MAX) ? UINT16_MAX : cap;
 				navgraph->edges = realloc(navgraph->edges, sizeof(NavEdge) * navgraph->edge_cap);	
 			}
 
-			// Skip creating edge if the reverse of it already exists 
-			bool duplicate = false;
-			for(u16 k = 0; k < navgraph->edge_count; k++) {
-				NavEdge *edge = &navgraph->edges[k];
-				//if((edge->node_A == i && edge->node_B == j) || (edge->node_B == i && edge->node_A == j)) {
-				if((edge->id_A == node_A->id && edge->id_B == node_B->id) || (edge->id_B == node_A->id && edge->id_A == node_B->id)) {
-					duplicate = true;
-					break;
-				}
-			}
-			if(duplicate)
-				continue;
+			u16 edge_id = navgraph->edge_count++;
+			navgraph->edges[edge_id] = (NavEdge) { .id_A = i, .id_B = cands[j].id, .length = cands[j].length };
 
-			// Copy to array	
-			navgraph->edges[navgraph->edge_count++] = edge;
+			node_A->edges[node_A->edge_count++] = edge_id;
+			node_B->edges[node_B->edge_count++] = edge_id;
 		}
 	}
 
-	for(u16 i = 0; i < navgraph->edge_count; i++) {
-		NavEdge *edge = &navgraph->edges[i];
+	if(dropped) {
+		Vector3 pos = navgraph->nodes[first_dropped].position;
+		MessageError(
+			"ERROR: Nav nodes exceed max edge count, edges dropped", 
+			(char*)TextFormat("%d dropped, first at node %d { %.0f %.0f %.0f }", dropped, first_dropped, pos.x, pos.y, pos.z)
+		);
+	}
 
-		NavNode *node_A = &navgraph->nodes[edge->id_A];
-		NavNode *node_B = &navgraph->nodes[edge->id_B];
+	if(over_limit)
+		MessageError("ERROR: Nav graph exceeds max edge count, edges dropped", (char*)TextFormat("%d dropped", over_limit));
+
+	free(cands);
+	free(cells);
+	free(next);
+	free(bucket_first);
 
-		node_A->edges[node_A->edge_count++] = i;
-		node_B->edges[node_B->edge_count++] = i;
+	if(navgraph->edge_count) {
+		navgraph->edge_cap = navgraph->edge_count;
+		navgraph->edges = realloc(navgraph->edges, sizeof(NavEdge) * navgraph->edge_count);
 	}
 
-	navgraph->edges = realloc(navgraph->edges, sizeof(NavEdge) * navgraph->edge_count);
+	navgraph->node_cap = navgraph->node_count;
 	navgraph->nodes = realloc(navgraph->nodes, sizeof(NavNode) * navgraph->node_count);
 }
 
@@ -738,135 +1029,202 @@ void GetConnectedNodes(NavNode *node, u16 connected[MAX_EDGES_PER_NODE], u8 *cou
 	for(u16 i = 0; i < node->edge_count; i++) {
 		NavEdge *edge = &navgraph->edges[node->edges[i]];
 
-		NavNode *node_A = &navgraph->nodes[edge->id_A];
-		NavNode *node_B = &navgraph->nodes[edge->id_B];
-
-		u16 next_node = (node_A->id == node->id) ? node_B->id : node_A->id;
+		u16 next_node = (edge->id_A == node->id) ? edge->id_B : edge->id_A;
 		
-		for(u8 i = 0; i < *count; i++) {
-			if(connected[i] == next_node)
-				return;
+		bool duplicate = false;
+		for(u8 j = 0; j < *count; j++) {
+			if(connected[j] == next_node) {
+				duplicate = true;
+				break;
+			}
 		}
+
+		if(duplicate || *count >= MAX_EDGES_PER_NODE)
+			continue;
 		
 		connected[(*count)++] = next_node; 
 	}	
 }
 
+// Breadth first, walked doubles as the queue so it must fit every node in the graph
 void WalkNavGraph(NavGraph *navgraph, u16 start_node, u16 *walked, u16 *count) {
-	NavNode *node = &navgraph->nodes[start_node];	
+	bool *visited = calloc(navgraph->node_count, sizeof(bool));
+
+	for(u16 i = 0; i < *count; i++)
+		visited[walked[i]] = true;
 
+	if(visited[start_node]) {
+		free(visited);
+		return;
+	}
+
+	u16 head = *count;
+	visited[start_node] = true;
 	walked[(*count)++] = start_node;
-	
-	u16 next_nodes[MAX_EDGES_PER_NODE];
-	u8 next_count = 0;
 
-	GetConnectedNodes(node, next_nodes, &next_count, navgraph);
-	
-	for(u8 i = 0; i < next_count; i++) {
-		bool duplicate = false;
-		for(u16 j = 0; j < *count; j++) {
-			if(walked[j] == next_nodes[i]) {
-				duplicate = true;
-			}
+	while(head < *count) {
+		NavNode *node = &navgraph->nodes[walked[head++]];	
+
+		for(u16 i = 0; i < node->edge_count; i++) {
+			NavEdge *edge = &navgraph->edges[node->edges[i]];
+			u16 next_node = (edge->id_A == node->id) ? edge->id_B : edge->id_A;
+
+			if(visited[next_node])
+				continue;
+
+			visited[next_node] = true;
+			walked[(*count)++] = next_node;
 		}
+	}
+
+	free(visited);
+}
+
+static u16 NavFindRoot(u16 *parent, u16 id) {
+	// Path halving
+	while(parent[id] != id) {
+		parent[id] = parent[parent[id]];
+		id = parent[id];
+	}
+
+	return id;
+}
+
+u16 FindNavComponents(NavGraph *navgraph, u16 *component) {
+	u16 node_count = navgraph->node_count;
 
-		if(duplicate) 
+	u16 *parent = malloc(sizeof(u16) * node_count);
+	u16 *size = malloc(sizeof(u16) * node_count);
+
+	for(u16 i = 0; i < node_count; i++) {
+		parent[i] = i;
+		size[i] = 1;
+	}
+
+	for(u32 i = 0; i < navgraph->edge_count; i++) {
+		NavEdge *edge = &navgraph->edges[i];
+
+		u16 root_A = NavFindRoot(parent, edge->id_A);
+		u16 root_B = NavFindRoot(parent, edge->id_B);
+		if(root_A == root_B)
 			continue;
 
-		WalkNavGraph(navgraph, next_nodes[i], walked, count);
+		// Union by size, smaller tree goes under larger
+		if(size[root_A] < size[root_B]) {
+			u16 temp = root_A;
+			root_A = root_B;
+			root_B = temp;
+		}
+
+		parent[root_B] = root_A;
+		size[root_A] += size[root_B];
+	}
+
+	// Number components by lowest node id, reusing size as root -> component map
+	u16 component_count = 0;
+	for(u16 i = 0; i < node_count; i++)
+		size[i] = 0xFFFF;
+
+	for(u16 i = 0; i < node_count; i++) {
+		u16 root = NavFindRoot(parent, i);
+
+		if(size[root] == 0xFFFF)
+			size[root] = component_count++;
+
+		component[i] = size[root];
 	}
+
+	free(size);
+	free(parent);
+
+	return component_count;
 }
 
 // Split navigation graphs so the spatial separation is reflected in data
 // Only having one graph would break pathfinding, 
 // graph/edge construction is distance based
 void SubdivideNavGraph(MapSection *sect, NavGraph *navgraph) {
-	u16 walked_total = 0;
-	bool *traveled = calloc(navgraph->node_count, sizeof(bool));
+	u16 node_count = navgraph->node_count;
+	if(!node_count)
+		return;
 
-	u16 splits[128];
-	u16 split_count = 0;
+	u16 *component = malloc(sizeof(u16) * node_count);
+	u16 *local_id = malloc(sizeof(u16) * node_count);
 
-	u16 next = 0;
+	u16 split_count = FindNavComponents(navgraph, component);
 
-	while(walked_total < navgraph->node_count) {
-		while(next < navgraph->node_count && traveled[next])
-			next++;
+	if(sect->navgraph_count + split_count > MAX_NAVGRAPHS) {
+		MessageError("ERROR: Too many nav graphs, extra graphs dropped", (char*)TextFormat("%d graphs", split_count));
+		split_count = MAX_NAVGRAPHS - sect->navgraph_count;
+	}
 
-		if(next >= navgraph->node_count)
-			break;
+	NavGraph *graphs = &sect->navgraphs[sect->navgraph_count];
+	for(u16 i = 0; i < split_count; i++)
+		graphs[i] = (NavGraph) {0};
 
-		u16 walk_count = 0;
-		u16 temp[navgraph->node_count];
-		WalkNavGraph(navgraph, next, temp, &walk_count);
+	// Count nodes and edges per graph, node order within a graph is kept
+	for(u16 i = 0; i < node_count; i++) {
+		u16 c = component[i];
+		if(c < split_count)
+			local_id[i] = graphs[c].node_count++;
+	}
 
-		for(u16 i = 0; i < walk_count; i++) {
-			u16 j = temp[i];
-			if(!traveled[j]) {
-				traveled[j] = true;
-				walked_total++;
-			}
-		}
+	for(u32 i = 0; i < navgraph->edge_count; i++) {
+		u16 c = component[navgraph->edges[i].id_A];
+		if(c < split_count)
+			graphs[c].edge_count++;
+	}
 
-		splits[split_count++] = next;
+	for(u16 i = 0; i < split_count; i++) {
+		NavGraph *graph = &graphs[i];
 
-		//for(u16 i = 0; i < walk_count; i++) printf("[%d]: -> %d\n", i, temp[i]);
-	}
+		graph->node_cap = graph->node_count;
+		graph->edge_cap = graph->edge_count;
+		graph->nodes = calloc(graph->node_count, sizeof(NavNode));
+		graph->edges = calloc(graph->edge_count, sizeof(NavEdge));
 
-	/*
-	printf("split count: %d\n", split_count);
-	for(short i = 0; i < split_count; i++) {
-		printf("split[%d] = %d \n", i, splits[i]);
+		graph->node_count = 0;
+		graph->edge_count = 0;
 	}
-	*/
 
-	for(short i = 0; i < split_count; i++) {
-		u16 split_id = splits[i];
+	for(u16 i = 0; i < node_count; i++) {
+		u16 c = component[i];
+		if(c >= split_count)
+			continue;
 
-		u16 walk_count = 0;
-		u16 node_ids[navgraph->node_count];
+		NavNode *node = &graphs[c].nodes[graphs[c].node_count++];
+		*node = navgraph->nodes[i];
+		node->id = local_id[i];
+		node->edge_count = 0;
+	}
 
-		WalkNavGraph(navgraph, split_id, node_ids, &walk_count);
+	// Edges come out in the same order as building them from scratch would give
+	for(u32 i = 0; i < navgraph->edge_count; i++) {
+		NavEdge edge = navgraph->edges[i];
 
-		NavGraph graph = (NavGraph) {0};
-		graph.node_count = walk_count;
-		graph.nodes = calloc(graph.node_count, sizeof(NavNode));
-		for(u16 j = 0; j < walk_count; j++) {
-			graph.nodes[j] = navgraph->nodes[node_ids[j]];
-			graph.nodes[j].id = j;
-			graph.nodes[j].edge_count = 0;
-		}
-		BuildNavEdges(&graph);
-		for(u16 j = 0; j < graph.edge_count; j++) {
-			NavEdge *edge = &graph.edges[j];
+		u16 c = component[edge.id_A];
+		if(c >= split_count)
+			continue;
 
-			NavNode *a = &graph.nodes[edge->id_A];
-			NavNode *b = &graph.nodes[edge->id_B];
+		NavGraph *graph = &graphs[c];
 
-			a->edges[a->edge_count++] = j;
-			b->edges[b->edge_count++] = j;
-		}
+		edge.id_A = local_id[edge.id_A];
+		edge.id_B = local_id[edge.id_B];
 
-		sect->navgraphs[sect->navgraph_count++] = graph;
+		u16 edge_id = graph->edge_count++;
+		graph->edges[edge_id] = edge;
 
-		/*
-		NavGraph *graph = &sect->navgraphs[sect->navgraph_count++];
-		graph->node_count = walk_count;
-		graph->nodes = calloc(graph->node_count, sizeof(NavNode));
-		for(u16 j = 0; j < walk_count; j++) {
-			graph->nodes[j] = navgraph->nodes[node_ids[j]];
-			graph->nodes[j].id = j;
-		}
+		NavNode *a = &graph->nodes[edge.id_A];
+		NavNode *b = &graph->nodes[edge.id_B];
 
-		graph->edge_cap = 128;
-		graph->edges = calloc(graph->edge_cap, sizeof(NavEdge));
-		BuildNavEdges(graph);
-		*/
+		a->edges[a->edge_count++] = edge_id;
+		b->edges[b->edge_count++] = edge_id;
 	}
 
-	//printf("graph count: %d\n", sect->navgraph_count);
+	sect->navgraph_count += split_count;
 
-	free(traveled);
+	free(local_id);
+	free(component);
 }
 
 bool IsNodeInGraph(NavGraph *graph, NavNode *node) {
@@ -898,28 +1256,163 @@ bool IsNodeInGraph(NavGraph *graph, NavNode *node) {
 }
 
 int FindClosestNavNodeInGraph(Vector3 position, NavGraph *graph) {
-	int id = -1;
+	return NavIndexNearest(graph, position, NAV_NODE_SEARCH_RADIUS);
+}
 
-	float closest_dist = FLT_MAX;
+int FindReachableNavNodeInGraph(Vector3 position, NavGraph *graph, MapSection *sect) {
+	u16 near[NAV_MAX_NEAR_NODES];
+	u16 near_count = NavIndexQueryRadius(graph, position, NAV_NODE_SEARCH_RADIUS, near, NAV_MAX_NEAR_NODES);
 
-	for(u16 i = 0; i < graph->node_count; i++) {
-		NavNode *node = &graph->nodes[i];
+	if(!near_count)
+		return -1;
 
-		float dist = Vector3DistanceSqr(node->position, position);	
-		if(dist > closest_dist) 
-			continue;
+	// No clip hulls loaded, can't check
+	Bsp_Hull *hull = &sect->bsp[1];
+	if(!hull->nodes)
+		return FindClosestNavNodeInGraph(position, graph);
+
+	// Query hands them back closest first, stop at the first clear one
+	for(u16 i = 0; i < near_count; i++) {
+		Bsp_TraceData trace = Bsp_TraceDataEmpty();
+		Bsp_RecursiveTraceEx(hull, hull->first_node, 0, 1, position, graph->nodes[near[i]].position, &trace);
+
+		if(trace.fraction >= 1 && !trace.start_solid)
+			return near[i];
+	}
+
+	// Everything is blocked, closest is still better than nothing
+	return near[0];
+}
+
+void NavLosCacheClear(MapSection *sect) {
+	NavLosCache *cache = &sect->nav_los;
+
+	if(!cache->entries)
+		cache->entries = calloc(NAV_LOS_CACHE_SIZE, sizeof(NavLosEntry));
+
+	// Stale stamps could match again after wrapping
+	if(++cache->generation == 0) {
+		memset(cache->entries, 0, sizeof(NavLosEntry) * NAV_LOS_CACHE_SIZE);
+		cache->generation = 1;
+	}
+
+	cache->hits = 0;
+	cache->misses = 0;
+}
+
+#define NAV_LOS_GROUND_STEP 16.0f
+
+// Center of a medium body standing under a node, raised by step height so sweeps go over steps like movement does
+static Vector3 NavLosBodyCenter(MapSection *sect, Vector3 position) {
+	Vector3 body = BODY_VOLUME_MEDIUM;
+	Vector3 point = (Vector3) { 0.01f, 0.01f, 0.01f };
+
+	HullTraceData trace = HullTraceDataEmpty();
+	HullSweepBox(&sect->hull_bvh, position, Vector3Add(position, (Vector3) { 0, 0, -body.z }), point, &trace);
+
+	if(trace.hit && !trace.start_solid)
+		position.z = trace.end.z;
+
+	position.z += body.z * 0.5f + PM_STEP_Z;
+	return position;
+}
+
+static bool NavLosTrace(MapSection *sect, Vector3 start, Vector3 end) {
+	Vector3 body = BODY_VOLUME_MEDIUM;
+	Vector3 point = (Vector3) { 0.01f, 0.01f, 0.01f };
+
+	start = NavLosBodyCenter(sect, start);
+	end = NavLosBodyCenter(sect, end);
+
+	HullTraceData trace = HullTraceDataEmpty();
+	HullSweepBox(&sect->hull_bvh, start, end, body, &trace);
+
+	if(trace.hit || trace.start_solid)
+		return false;
+
+	// Clear line can still run over a gap, probe for ground along it.
+	// Drops of up to a step are fine
+	float probe = body.z * 0.5f + PM_STEP_Z * 2;
+
+	float length = Vector3Distance(start, end);
+	u16 steps = (u16)ceilf(length / NAV_LOS_GROUND_STEP);
+
+	for(u16 i = 1; i < steps; i++) {
+		Vector3 sample = Vector3Lerp(start, end, (float)i / steps);
+
+		trace = HullTraceDataEmpty();
+		HullSweepBox(&sect->hull_bvh, sample, Vector3Add(sample, (Vector3) { 0, 0, -probe }), point, &trace);
+
+		if(!trace.hit)
+			return false;
+	}
+
+	return true;
+}
 
-		if(!CheckCollisionSpheres(position, 32, node->position, 32))
+bool NavNodesVisible(MapSection *sect, NavGraph *graph, u16 node_A, u16 node_B) {
+	NavLosCache *cache = &sect->nav_los;
+	if(!cache->entries)
+		NavLosCacheClear(sect);
+
+	// Symmetric, store lower id first
+	if(node_A > node_B) {
+		u16 temp = node_A;
+		node_A = node_B;
+		node_B = temp;
+	}
+
+	u64 graph_id = (graph >= sect->navgraphs && graph < sect->navgraphs + sect->navgraph_count) ? (u64)(graph - sect->navgraphs) + 1 : 0;
+	u64 key = (graph_id << 32) | ((u64)node_A << 16) | node_B;
+
+	u32 hash = (u32)((key * 0x9E3779B97F4A7C15ull) >> 32) & (NAV_LOS_CACHE_SIZE - 1);
+
+	// Take the first free or stale slot if the pair isn't cached, evict the home slot if none are
+	NavLosEntry *slot = NULL;
+	for(u32 i = 0; i < NAV_LOS_CACHE_PROBES; i++) {
+		NavLosEntry *entry = &cache->entries[(hash + i) & (NAV_LOS_CACHE_SIZE - 1)];
+
+		if(entry->stamp != cache->generation) {
+			if(!slot) slot = entry;
 			continue;
+		}
+
+		if(entry->key == key) {
+			cache->hits++;
+			return entry->visible;
+		}
+	}
+
+	if(!slot)
+		slot = &cache->entries[hash];
 
-		closest_dist = dist;
-		id = i;
+	cache->misses++;
 
-		if(dist < 4*4)
-			break;
+	bool visible = NavLosTrace(sect, graph->nodes[node_A].position, graph->nodes[node_B].position);
+	*slot = (NavLosEntry) { .key = key, .stamp = cache->generation, .visible = visible };
+
+	return visible;
+}
+
+void SmoothNavPath(MapSection *sect, NavGraph *graph, NavPath *path) {
+	if(path->count < 3 || !sect->hull_bvh.count)
+		return;
+
+	u16 count = 1;
+	u16 anchor = 0;
+
+	// Greedy, from each kept node skip ahead while the next node is still in sight
+	while(anchor < path->count - 1) {
+		u16 next = anchor + 1;
+
+		while(next + 1 < path->count && NavNodesVisible(sect, graph, path->nodes[anchor], path->nodes[next + 1]))
+			next++;
+
+		path->nodes[count++] = path->nodes[next];
+		anchor = next;
 	}
 
-	return id;
+	path->count = count;
 }
 
 void DebugDrawNavGraphs(MapSection *sect, Model model) {
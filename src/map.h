@@ -77,9 +77,13 @@ typedef struct {
 
 } SpawnList;
 
+// Checkpoints trigger when the player is inside a box this wide around the point,
+// and no more than CHECKPOINT_HEIGHT above or below it
+#define CHECKPOINT_SIZE		512.0f
+#define CHECKPOINT_HEIGHT	32.0f
+
 typedef struct {
 	Vector3 *points;
-	i16 *cells;
 
 	u16 count;
 	u16 capacity;
@@ -88,7 +92,14 @@ typedef struct {
 
 } CheckPointList;
 
+// Worst case tri output of a single brush
+#define BRUSH_MAX_TRIS 128
+
+// Upper limit of worker threads used when building collision geometry
+#define MAX_BUILD_THREADS 16
+
 void LoadMapFile(BrushPool *brush_pool, char *path, Model *map_model, SpawnList *spawn_list);
+void BrushExpand(Brush *src, Brush *dst, Vector3 half_extents);
 BrushPool ExpandBrushes(BrushPool *brush_pool, Vector3 aabb_extents);
 
 typedef struct {
@@ -97,24 +108,58 @@ typedef struct {
 
 } FaceVert;
 
+u16 BrushToTrisEx(Brush *brush, u16 brush_id, Tri *tris);
 Tri *BrushToTris(Brush *brush, u16 *count, u16 brush_id);
 Tri *TrisFromBrushPool(BrushPool *brush_pool, u16 *count);
 
+// Expand and triangulate every brush for each volume in parallel, out must hold volume_count pools.
+// A zero volume, at any index, gives the unexpanded brush geometry. Tri order matches TrisFromBrushPool
+void BuildCollisionTris(BrushPool *brush_pool, Vector3 *volumes, u8 volume_count, TriPool *out);
+
 void BrushTestView(BrushPool *brush_pool, Color color);
 
+// Parse .map and build collision geometry, BVHs and hulls for each volume
+void BuildMapCollision(MapSection *sect, char *map_path, Model *model, SpawnList *spawn_list);
+
 MapSection BuildMapSect(char *file_path, SpawnList *spawn_list);
 
+#define MAX_NAVGRAPHS 32
+
 void InitNavGraph(MapSection *sect);
 void BuildNavGraph(MapSection *sect);
 void BuildNavEdges(NavGraph *navgraph);
 void SplitNavGraph(NavGraph *navgraph, MapSection *sect);
 void SubdivideNavGraph(MapSection *sect, NavGraph *navgraph);
 
+// Label connected components with union-find, writes component per node and returns component count.
+// Components are numbered in order of their lowest node id
+u16 FindNavComponents(NavGraph *navgraph, u16 *component);
+
 void GetConnectedNodes(NavNode *node, u16 connected[MAX_EDGES_PER_NODE], u8 *count, NavGraph *navgraph);
 void WalkNavGraph(NavGraph *navgraph, u16 start_node, u16 *walked, u16 *count);
 void WalkNavGraphEx(NavGraph *navgraph, u16 start_node, u16 *walked, u16 *count, u16 prev_node, u16 targ_node);
 
+// Node search radius, old lookup took nodes whose 32 unit sphere touched the position's
+#define NAV_NODE_SEARCH_RADIUS 64.0f
+// Closest nodes traced to before giving up, lookups run per graph every AI tick
+#define NAV_MAX_NEAR_NODES 8
+
+// Drop cached node line of sight results, call when level geometry changes
+void NavLosCacheClear(MapSection *sect);
+
+// Can a medium body move in a straight line between two nodes, over ground the whole way.
+// Results are cached per node pair
+bool NavNodesVisible(MapSection *sect, NavGraph *graph, u16 node_A, u16 node_B);
+
+// String-pull a path in place, dropping nodes that can be skipped in a straight line.
+// First and last nodes are kept
+void SmoothNavPath(MapSection *sect, NavGraph *graph, NavPath *path);
+
+// Closest node within search radius, -1 if there's none
 int FindClosestNavNodeInGraph(Vector3 position, NavGraph *graph);
+
+// Same as above but prefers the closest node the player clip hull can trace to in a straight line
+int FindReachableNavNodeInGraph(Vector3 position, NavGraph *graph, MapSection *sect);
 bool IsNodeInGraph(NavGraph *graph, NavNode *node);
 
 void DebugDrawNavGraphs(MapSection *sect, Model model);
@@ -0,0 +1,1370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "nav.h"
+#include "../include/log_message.h"
+
+void NavSearchReserve(NavSearch *search, u16 node_count) {
+	if(node_count <= search->capacity)
+		return;
+
+	search->capacity = node_count;
+
+	search->g_cost = realloc(search->g_cost, sizeof(float) * node_count);
+	search->f_cost = realloc(search->f_cost, sizeof(float) * node_count);
+	search->parent = realloc(search->parent, sizeof(i16) * node_count);
+	search->heap_index = realloc(search->heap_index, sizeof(u16) * node_count);
+	search->flags = realloc(search->flags, sizeof(u8) * node_count);
+	search->heap = realloc(search->heap, sizeof(u16) * node_count);
+
+	// Stamps must start out stale, new slots are zeroed and generation never returns to 0
+	search->stamp = realloc(search->stamp, sizeof(u32) * node_count);
+	memset(search->stamp, 0, sizeof(u32) * node_count);
+}
+
+void NavSearchFree(NavSearch *search) {
+	free(search->g_cost);
+	free(search->f_cost);
+	free(search->parent);
+	free(search->stamp);
+	free(search->heap_index);
+	free(search->flags);
+	free(search->heap);
+
+	*search = (NavSearch) {0};
+}
+
+// Reset node state on first touch this generation
+void NavSearchTouch(NavSearch *search, u16 node) {
+	if(search->stamp[node] == search->generation)
+		return;
+
+	search->stamp[node] = search->generation;
+	search->g_cost[node] = FLT_MAX;
+	search->f_cost[node] = FLT_MAX;
+	search->parent[node] = NAV_NULL_NODE;
+	search->flags[node] = 0;
+}
+
+void HeapSwap(NavSearch *search, u16 a, u16 b) {
+	u16 node_a = search->heap[a];
+	u16 node_b = search->heap[b];
+
+	search->heap[a] = node_b;
+	search->heap[b] = node_a;
+
+	search->heap_index[node_a] = b;
+	search->heap_index[node_b] = a;
+}
+
+void HeapSiftUp(NavSearch *search, u16 i) {
+	while(i > 0) {
+		u16 up = (i - 1) >> 1;
+
+		if(search->f_cost[search->heap[up]] <= search->f_cost[search->heap[i]])
+			break;
+
+		HeapSwap(search, i, up);
+		i = up;
+	}
+}
+
+void HeapSiftDown(NavSearch *search, u16 i) {
+	while(true) {
+		u32 lft = (i << 1) + 1;
+		u32 rgt = lft + 1;
+		u16 best = i;
+
+		if(lft < search->heap_count && search->f_cost[search->heap[lft]] < search->f_cost[search->heap[best]])
+			best = lft;
+
+		if(rgt < search->heap_count && search->f_cost[search->heap[rgt]] < search->f_cost[search->heap[best]])
+			best = rgt;
+
+		if(best == i)
+			break;
+
+		HeapSwap(search, i, best);
+		i = best;
+	}
+}
+
+void HeapPush(NavSearch *search, u16 node) {
+	u16 i = search->heap_count++;
+
+	search->heap[i] = node;
+	search->heap_index[node] = i;
+
+	HeapSiftUp(search, i);
+}
+
+u16 HeapPop(NavSearch *search) {
+	u16 node = search->heap[0];
+
+	search->heap_count--;
+	if(search->heap_count) {
+		search->heap[0] = search->heap[search->heap_count];
+		search->heap_index[search->heap[0]] = 0;
+		HeapSiftDown(search, 0);
+	}
+
+	return node;
+}
+
+void NavSearchBeginEx(NavSearch *search, u16 node_count, u16 start, u16 target, Vector3 start_position, Vector3 target_position) {
+	NavSearchReserve(search, node_count);
+
+	// Wrapped around, stamps from 4 billion searches ago would look valid
+	if(++search->generation == 0) {
+		memset(search->stamp, 0, sizeof(u32) * search->capacity);
+		search->generation = 1;
+	}
+
+	search->graph = NULL;
+	search->node_cluster = NULL;
+	search->start = start;
+	search->target = target;
+	search->target_position = target_position;
+	search->heap_count = 0;
+	search->expanded = 0;
+	search->status = NAV_SEARCH_RUNNING;
+
+	NavSearchTouch(search, start);
+	search->g_cost[start] = 0.0f;
+	search->f_cost[start] = Vector3Distance(start_position, target_position);
+	search->flags[start] = NAV_NODE_OPEN;
+
+	HeapPush(search, start);
+}
+
+void NavSearchBegin(NavSearch *search, NavGraph *graph, u16 start, u16 target) {
+	NavSearchBeginEx(search, graph->node_count, start, target, graph->nodes[start].position, graph->nodes[target].position);
+	search->graph = graph;
+}
+
+i32 NavSearchPop(NavSearch *search) {
+	if(!search->heap_count)
+		return NAV_NULL_NODE;
+
+	u16 node = HeapPop(search);
+
+	search->flags[node] = NAV_NODE_CLOSED;
+	search->expanded++;
+
+	return node;
+}
+
+void NavSearchRelax(NavSearch *search, u16 curr, u16 neighbour, float cost, Vector3 neighbour_position) {
+	NavSearchTouch(search, neighbour);
+
+	if(search->flags[neighbour] & NAV_NODE_CLOSED)
+		return;
+
+	float tentative = search->g_cost[curr] + cost;
+	if(tentative >= search->g_cost[neighbour])
+		return;
+
+	// Heuristic is only computed on first visit, it doesn't change with g
+	float h = (search->target == NAV_FLOOD_TARGET) ? 0.0f :
+		(search->f_cost[neighbour] == FLT_MAX) ?
+		Vector3Distance(neighbour_position, search->target_position) :
+		search->f_cost[neighbour] - search->g_cost[neighbour];
+
+	search->parent[neighbour] = curr;
+	search->g_cost[neighbour] = tentative;
+	search->f_cost[neighbour] = tentative + h;
+
+	if(search->flags[neighbour] & NAV_NODE_OPEN) {
+		// Decrease-key
+		HeapSiftUp(search, search->heap_index[neighbour]);
+
+	} else {
+		search->flags[neighbour] = NAV_NODE_OPEN;
+		HeapPush(search, neighbour);
+	}
+}
+
+u8 NavSearchStep(NavSearch *search, u32 max_expansions) {
+	if(search->status != NAV_SEARCH_RUNNING)
+		return search->status;
+
+	NavGraph *graph = search->graph;
+
+	for(u32 n = 0; n < max_expansions; n++) {
+		i32 curr = NavSearchPop(search);
+
+		if(curr == NAV_NULL_NODE) {
+			search->status = NAV_SEARCH_FAILED;
+			break;
+		}
+
+		if(curr == search->target) {
+			search->status = NAV_SEARCH_FOUND;
+			break;
+		}
+
+		NavNode *node = &graph->nodes[curr];
+
+		for(u16 i = 0; i < node->edge_count; i++) {
+			NavEdge *edge = &graph->edges[node->edges[i]];
+			u16 neighbour = (edge->id_A == curr) ? edge->id_B : edge->id_A;
+
+			if(search->node_cluster) {
+				u16 cluster = search->node_cluster[neighbour];
+				if(cluster != search->cluster_A && cluster != search->cluster_B)
+					continue;
+			}
+
+			NavSearchRelax(search, curr, neighbour, edge->length, graph->nodes[neighbour].position);
+		}
+	}
+
+	return search->status;
+}
+
+bool NavSearchRun(NavSearch *search, NavGraph *graph, u16 start, u16 target) {
+	NavSearchBegin(search, graph, start, target);
+	return (NavSearchStep(search, UINT32_MAX) == NAV_SEARCH_FOUND);
+}
+
+u16 NavSearchExtractPath(NavSearch *search, u16 *out, u16 max) {
+	if(search->status != NAV_SEARCH_FOUND)
+		return 0;
+
+	u32 length = 0;
+	for(i16 curr = search->target; curr != NAV_NULL_NODE; curr = search->parent[curr])
+		length++;
+
+	u16 count = (length < max) ? length : max;
+
+	i16 curr = search->target;
+	for(u16 i = 0; i < count; i++) {
+		out[count - 1 - i] = curr;
+		curr = search->parent[curr];
+	}
+
+	return count;
+}
+
+u16 NavSearchExtractPathFront(NavSearch *search, u16 *out, u16 max) {
+	if(search->status != NAV_SEARCH_FOUND)
+		return 0;
+
+	u32 length = 0;
+	for(i16 curr = search->target; curr != NAV_NULL_NODE; curr = search->parent[curr])
+		length++;
+
+	u16 count = (length < max) ? length : max;
+
+	// Skip nodes past max
+	i16 curr = search->target;
+	for(u32 i = length; i > count; i--)
+		curr = search->parent[curr];
+
+	for(u16 i = 0; i < count; i++) {
+		out[count - 1 - i] = curr;
+		curr = search->parent[curr];
+	}
+
+	return count;
+}
+
+static void NavSearchBeginInClusters(NavSearch *search, NavGraph *graph, u16 start, u16 target, u16 cluster_A, u16 cluster_B) {
+	NavSearchBegin(search, graph, start, target);
+
+	search->node_cluster = graph->clusters->node_cluster;
+	search->cluster_A = cluster_A;
+	search->cluster_B = cluster_B;
+}
+
+bool NavSearchRunInClusters(NavSearch *search, NavGraph *graph, u16 start, u16 target, u16 cluster_A, u16 cluster_B) {
+	NavSearchBeginInClusters(search, graph, start, target, cluster_A, cluster_B);
+	return (NavSearchStep(search, UINT32_MAX) == NAV_SEARCH_FOUND);
+}
+
+typedef struct {
+	i32 x, y, z;
+	u16 node;
+
+} NavClusterKey;
+
+int NavClusterKeyCompare(const void *a, const void *b) {
+	const NavClusterKey *ka = a;
+	const NavClusterKey *kb = b;
+
+	if(ka->x != kb->x) return (ka->x < kb->x) ? -1 : 1;
+	if(ka->y != kb->y) return (ka->y < kb->y) ? -1 : 1;
+	if(ka->z != kb->z) return (ka->z < kb->z) ? -1 : 1;
+
+	return (ka->node < kb->node) ? -1 : (ka->node > kb->node);
+}
+
+void NavClustersBuild(NavGraph *graph) {
+	NavClustersFree(graph);
+
+	u16 node_count = graph->node_count;
+	if(!node_count)
+		return;
+
+	NavClusters *cl = calloc(1, sizeof(NavClusters));
+	graph->clusters = cl;
+
+	cl->node_cluster = malloc(sizeof(u16) * node_count);
+	cl->node_entrance = malloc(sizeof(u16) * node_count);
+
+	// 1. Group nodes by grid cell
+	NavClusterKey *keys = malloc(sizeof(NavClusterKey) * node_count);
+	for(u16 i = 0; i < node_count; i++) {
+		Vector3 p = graph->nodes[i].position;
+
+		keys[i] = (NavClusterKey) {
+			.x = floorf(p.x / NAV_CLUSTER_SIZE),
+			.y = floorf(p.y / NAV_CLUSTER_SIZE),
+			.z = floorf(p.z / NAV_CLUSTER_SIZE),
+			.node = i
+		};
+	}
+
+	qsort(keys, node_count, sizeof(NavClusterKey), NavClusterKeyCompare);
+
+	for(u16 i = 0; i < node_count; i++) {
+		bool new_cell = (i == 0 || keys[i].x != keys[i - 1].x || keys[i].y != keys[i - 1].y || keys[i].z != keys[i - 1].z);
+		if(new_cell) cl->cluster_count++;
+
+		cl->node_cluster[keys[i].node] = cl->cluster_count - 1;
+	}
+
+	free(keys);
+
+	// 2. Find entrances, grouped by cluster
+	cl->cluster_first = calloc(cl->cluster_count + 1, sizeof(u32));
+
+	bool *is_entrance = calloc(node_count, sizeof(bool));
+	for(u16 i = 0; i < graph->edge_count; i++) {
+		NavEdge *edge = &graph->edges[i];
+
+		if(cl->node_cluster[edge->id_A] == cl->node_cluster[edge->id_B])
+			continue;
+
+		is_entrance[edge->id_A] = true;
+		is_entrance[edge->id_B] = true;
+	}
+
+	for(u16 i = 0; i < node_count; i++) {
+		cl->node_entrance[i] = NAV_NULL_ENTRANCE;
+
+		if(is_entrance[i]) {
+			cl->cluster_first[cl->node_cluster[i] + 1]++;
+			cl->entrance_count++;
+		}
+	}
+
+	for(u16 i = 0; i < cl->cluster_count; i++) {
+		u16 count = cl->cluster_first[i + 1];
+		if(count > cl->max_cluster_entrances)
+			cl->max_cluster_entrances = count;
+
+		cl->cluster_first[i + 1] += cl->cluster_first[i];
+	}
+
+	cl->entrances = malloc(sizeof(u16) * (cl->entrance_count + 1));
+
+	u32 *fill = malloc(sizeof(u32) * (cl->cluster_count + 1));
+	memcpy(fill, cl->cluster_first, sizeof(u32) * (cl->cluster_count + 1));
+
+	for(u16 i = 0; i < node_count; i++) {
+		if(!is_entrance[i])
+			continue;
+
+		u32 id = fill[cl->node_cluster[i]]++;
+		cl->entrances[id] = i;
+		cl->node_entrance[i] = id;
+	}
+
+	free(fill);
+	free(is_entrance);
+
+	cl->start_cost = malloc(sizeof(float) * (cl->max_cluster_entrances + 1));
+	cl->goal_cost = malloc(sizeof(float) * (cl->max_cluster_entrances + 1));
+
+	// 3. Abstract edges
+	u32 edge_cap = 64;
+	cl->edges = malloc(sizeof(NavAbstractEdge) * edge_cap);
+	cl->edge_first = malloc(sizeof(u32) * (cl->entrance_count + 1));
+
+	NavSearch search = {0};
+
+	for(u16 e = 0; e < cl->entrance_count; e++) {
+		u16 node_id = cl->entrances[e];
+		u16 cluster = cl->node_cluster[node_id];
+		NavNode *node = &graph->nodes[node_id];
+
+		cl->edge_first[e] = cl->edge_count;
+
+		u16 intra_count = cl->cluster_first[cluster + 1] - cl->cluster_first[cluster];
+		if(cl->edge_count + node->edge_count + intra_count > edge_cap) {
+			while(cl->edge_count + node->edge_count + intra_count > edge_cap)
+				edge_cap = (edge_cap << 1);
+
+			cl->edges = realloc(cl->edges, sizeof(NavAbstractEdge) * edge_cap);
+		}
+
+		// Between clusters, follow graph edges
+		for(u16 i = 0; i < node->edge_count; i++) {
+			NavEdge *edge = &graph->edges[node->edges[i]];
+			u16 other = (edge->id_A == node_id) ? edge->id_B : edge->id_A;
+
+			if(cl->node_cluster[other] == cluster)
+				continue;
+
+			cl->edges[cl->edge_count++] = (NavAbstractEdge) { .cost = edge->length, .to = cl->node_entrance[other] };
+		}
+
+		// Inside cluster, cost of the path that stays in it
+		for(u32 j = cl->cluster_first[cluster]; j < cl->cluster_first[cluster + 1]; j++) {
+			if(j == e)
+				continue;
+
+			if(!NavSearchRunInClusters(&search, graph, node_id, cl->entrances[j], cluster, cluster))
+				continue;
+
+			cl->edges[cl->edge_count++] = (NavAbstractEdge) { .cost = search.g_cost[cl->entrances[j]], .to = j };
+		}
+	}
+
+	cl->edge_first[cl->entrance_count] = cl->edge_count;
+
+	NavSearchFree(&search);
+}
+
+void NavClustersFree(NavGraph *graph) {
+	NavClusters *cl = graph->clusters;
+	if(!cl)
+		return;
+
+	free(cl->node_cluster);
+	free(cl->node_entrance);
+	free(cl->entrances);
+	free(cl->cluster_first);
+	free(cl->edges);
+	free(cl->edge_first);
+	free(cl->start_cost);
+	free(cl->goal_cost);
+	free(cl);
+
+	graph->clusters = NULL;
+}
+
+void NavRoutePlanBegin(NavRoutePlanner *plan, NavGraph *graph, NavRoute *route, NavPath *path, u16 start, u16 goal, float *start_cost, float *goal_cost) {
+	NavClusters *cl = graph->clusters;
+
+	*plan = (NavRoutePlanner) {
+		.graph = graph,
+		.route = route,
+		.path = path,
+		.start_cost = start_cost,
+		.goal_cost = goal_cost,
+		.direct_cost = FLT_MAX,
+		.start = start,
+		.goal = goal,
+		.start_cluster = cl->node_cluster[start],
+		.goal_cluster = cl->node_cluster[goal],
+		.stage = NAV_PLAN_START_COSTS,
+		.status = NAV_SEARCH_RUNNING
+	};
+
+	route->count = 0;
+	route->curr = 0;
+	route->goal = goal;
+
+	if(path)
+		path->count = 0;
+
+	if(start == goal) {
+		route->nodes[route->count++] = goal;
+		plan->stage = NAV_PLAN_REFINE;
+	}
+}
+
+// Run a search inside clusters for a cost stage, returns true once it's done
+static bool NavRoutePlanLocal(NavRoutePlanner *plan, NavSearch *local, u16 from, u16 to, u16 cluster, u32 max_expansions, float *cost) {
+	if(!plan->searching) {
+		NavSearchBeginInClusters(local, plan->graph, from, to, cluster, cluster);
+		plan->searching = true;
+	}
+
+	u32 expanded = local->expanded;
+	u8 status = NavSearchStep(local, max_expansions);
+	plan->expanded += local->expanded - expanded;
+
+	if(status == NAV_SEARCH_RUNNING)
+		return false;
+
+	*cost = (status == NAV_SEARCH_FOUND) ? local->g_cost[to] : FLT_MAX;
+	plan->searching = false;
+
+	return true;
+}
+
+// Abstract search over entrances plus two extra nodes for start and goal.
+// Start and goal are linked to the entrances of their own clusters by searches inside them
+static void NavRoutePlanAbstract(NavRoutePlanner *plan, NavSearch *search, u32 max_expansions) {
+	NavGraph *graph = plan->graph;
+	NavClusters *cl = graph->clusters;
+
+	u32 start_first = cl->cluster_first[plan->start_cluster];
+	u32 goal_first = cl->cluster_first[plan->goal_cluster];
+	u16 start_count = cl->cluster_first[plan->start_cluster + 1] - start_first;
+
+	u16 start_id = cl->entrance_count;
+	u16 goal_id = cl->entrance_count + 1;
+
+	Vector3 goal_position = graph->nodes[plan->goal].position;
+
+	if(!plan->searching) {
+		NavSearchBeginEx(search, cl->entrance_count + 2, start_id, goal_id, graph->nodes[plan->start].position, goal_position);
+		plan->searching = true;
+	}
+
+	bool found = false;
+	bool failed = false;
+
+	for(u32 n = 0; n < max_expansions; n++) {
+		i32 curr = NavSearchPop(search);
+		plan->expanded++;
+
+		if(curr == NAV_NULL_NODE) {
+			failed = true;
+			break;
+		}
+
+		if(curr == goal_id) {
+			found = true;
+			break;
+		}
+
+		if(curr == start_id) {
+			for(u16 i = 0; i < start_count; i++) {
+				if(plan->start_cost[i] == FLT_MAX)
+					continue;
+
+				u16 entrance = start_first + i;
+				NavSearchRelax(search, curr, entrance, plan->start_cost[i], graph->nodes[cl->entrances[entrance]].position);
+			}
+
+			if(plan->direct_cost != FLT_MAX)
+				NavSearchRelax(search, curr, goal_id, plan->direct_cost, goal_position);
+
+			continue;
+		}
+
+		for(u32 i = cl->edge_first[curr]; i < cl->edge_first[curr + 1]; i++) {
+			NavAbstractEdge *edge = &cl->edges[i];
+			NavSearchRelax(search, curr, edge->to, edge->cost, graph->nodes[cl->entrances[edge->to]].position);
+		}
+
+		if(cl->node_cluster[cl->entrances[curr]] == plan->goal_cluster) {
+			float cost = plan->goal_cost[curr - goal_first];
+			if(cost != FLT_MAX)
+				NavSearchRelax(search, curr, goal_id, cost, goal_position);
+		}
+	}
+
+	if(!found && !failed)
+		return;
+
+	plan->searching = false;
+	search->status = (found) ? NAV_SEARCH_FOUND : NAV_SEARCH_FAILED;
+
+	if(failed) {
+		plan->status = NAV_SEARCH_FAILED;
+		return;
+	}
+
+	// First node is the start, anything past the route length is planned again later
+	NavRoute *route = plan->route;
+	u16 abstract[NAV_MAX_ROUTE + 1];
+	u16 count = NavSearchExtractPathFront(search, abstract, NAV_MAX_ROUTE + 1);
+
+	for(u16 i = 1; i < count; i++) {
+		u16 id = abstract[i];
+		u16 node = (id == goal_id) ? plan->goal : cl->entrances[id];
+
+		// Start can be an entrance itself
+		if(route->count == 0 && node == plan->start)
+			continue;
+
+		route->nodes[route->count++] = node;
+	}
+
+	if(!route->count)
+		plan->status = NAV_SEARCH_FAILED;
+	else
+		plan->stage = NAV_PLAN_REFINE;
+}
+
+// Refine path from start to the next route waypoint, searching only the two clusters involved
+static void NavRoutePlanRefine(NavRoutePlanner *plan, NavSearch *local, u32 max_expansions) {
+	NavGraph *graph = plan->graph;
+	NavClusters *cl = graph->clusters;
+	NavRoute *route = plan->route;
+
+	// Only planning the route, caller refines it
+	if(!plan->path) {
+		plan->status = NAV_SEARCH_FOUND;
+		return;
+	}
+
+	u16 target = route->nodes[route->curr];
+
+	if(!plan->searching) {
+		NavSearchBeginInClusters(local, graph, plan->start, target, cl->node_cluster[plan->start], cl->node_cluster[target]);
+		plan->searching = true;
+		plan->unrestricted = false;
+	}
+
+	u32 expanded = local->expanded;
+	u8 status = NavSearchStep(local, max_expansions);
+	plan->expanded += local->expanded - expanded;
+
+	if(status == NAV_SEARCH_RUNNING)
+		return;
+
+	// Waypoints of a valid route are always linked inside their clusters, this shouldn't happen
+	if(status == NAV_SEARCH_FAILED && !plan->unrestricted) {
+		NavSearchBegin(local, graph, plan->start, target);
+		plan->unrestricted = true;
+		return;
+	}
+
+	plan->searching = false;
+
+	if(status == NAV_SEARCH_FAILED) {
+		plan->status = NAV_SEARCH_FAILED;
+		return;
+	}
+
+	// Segments longer than a path continue from where this one ends
+	NavPath *path = plan->path;
+	path->count = NavSearchExtractPathFront(local, path->nodes, MAX_PATH_NODES - 1);
+	path->curr = 0;
+
+	if(path->nodes[path->count - 1] == target)
+		route->curr++;
+
+	plan->status = NAV_SEARCH_FOUND;
+}
+
+u8 NavRoutePlanStep(NavRoutePlanner *plan, NavSearch *search, NavSearch *local, u32 max_expansions) {
+	NavClusters *cl = plan->graph->clusters;
+	u32 expanded = plan->expanded;
+
+	while(plan->status == NAV_SEARCH_RUNNING) {
+		u32 used = plan->expanded - expanded;
+		if(used >= max_expansions)
+			break;
+
+		u32 left = max_expansions - used;
+
+		switch(plan->stage) {
+			case NAV_PLAN_START_COSTS: {
+				u32 first = cl->cluster_first[plan->start_cluster];
+				u16 count = cl->cluster_first[plan->start_cluster + 1] - first;
+
+				if(plan->index >= count) {
+					plan->index = 0;
+					plan->stage = NAV_PLAN_GOAL_COSTS;
+					break;
+				}
+
+				u16 entrance = cl->entrances[first + plan->index];
+				if(NavRoutePlanLocal(plan, local, plan->start, entrance, plan->start_cluster, left, &plan->start_cost[plan->index]))
+					plan->index++;
+			} break;
+
+			// Graph is undirected, searching out from goal gives the same costs
+			case NAV_PLAN_GOAL_COSTS: {
+				u32 first = cl->cluster_first[plan->goal_cluster];
+				u16 count = cl->cluster_first[plan->goal_cluster + 1] - first;
+
+				if(plan->index >= count) {
+					plan->index = 0;
+					plan->stage = (plan->start_cluster == plan->goal_cluster) ? NAV_PLAN_DIRECT : NAV_PLAN_ABSTRACT;
+					break;
+				}
+
+				u16 entrance = cl->entrances[first + plan->index];
+				if(NavRoutePlanLocal(plan, local, plan->goal, entrance, plan->goal_cluster, left, &plan->goal_cost[plan->index]))
+					plan->index++;
+			} break;
+
+			case NAV_PLAN_DIRECT:
+				if(NavRoutePlanLocal(plan, local, plan->start, plan->goal, plan->start_cluster, left, &plan->direct_cost))
+					plan->stage = NAV_PLAN_ABSTRACT;
+				break;
+
+			case NAV_PLAN_ABSTRACT:
+				NavRoutePlanAbstract(plan, search, left);
+				break;
+
+			case NAV_PLAN_REFINE:
+				NavRoutePlanRefine(plan, local, left);
+				break;
+		}
+	}
+
+	return plan->status;
+}
+
+static bool NavRoutePlan(NavGraph *graph, NavSearch *search, NavSearch *local, NavRoute *route, u16 start, u16 goal) {
+	NavRoutePlanner plan;
+	NavRoutePlanBegin(&plan, graph, route, NULL, start, goal, graph->clusters->start_cost, graph->clusters->goal_cost);
+
+	return (NavRoutePlanStep(&plan, search, local, UINT32_MAX) == NAV_SEARCH_FOUND);
+}
+
+// Refine path from a node to the next route waypoint, searching only the two clusters involved
+static bool NavRouteRefine(NavGraph *graph, NavSearch *local, NavRoute *route, NavPath *path, u16 from) {
+	if(route->curr >= route->count)
+		return false;
+
+	NavRoutePlanner plan = (NavRoutePlanner) {
+		.graph = graph,
+		.route = route,
+		.path = path,
+		.start = from,
+		.stage = NAV_PLAN_REFINE,
+		.status = NAV_SEARCH_RUNNING
+	};
+
+	return (NavRoutePlanStep(&plan, NULL, local, UINT32_MAX) == NAV_SEARCH_FOUND);
+}
+
+bool NavRouteFind(NavGraph *graph, NavSearch *search, NavSearch *local, NavRoute *route, NavPath *path, u16 start, u16 goal) {
+	path->count = 0;
+	route->count = 0;
+	route->curr = 0;
+	route->goal = goal;
+
+	if(!graph->clusters) {
+		if(!NavSearchRun(search, graph, start, goal))
+			return false;
+
+		path->count = NavSearchExtractPath(search, path->nodes, MAX_PATH_NODES - 1);
+		path->curr = 0;
+		return true;
+	}
+
+	NavRoutePlanner plan;
+	NavRoutePlanBegin(&plan, graph, route, path, start, goal, graph->clusters->start_cost, graph->clusters->goal_cost);
+
+	return (NavRoutePlanStep(&plan, search, local, UINT32_MAX) == NAV_SEARCH_FOUND);
+}
+
+bool NavRouteAdvance(NavGraph *graph, NavSearch *search, NavSearch *local, NavRoute *route, NavPath *path, u16 from) {
+	if(!graph->clusters || !route->count || from == route->goal)
+		return false;
+
+	// Route was cut short, plan the rest
+	if(route->curr >= route->count && !NavRoutePlan(graph, search, local, route, from, route->goal))
+		return false;
+
+	return NavRouteRefine(graph, local, route, path, from);
+}
+
+u32 NavIndexKey(i32 x, i32 y, i32 z, u32 mask) {
+	return (((u32)x * 73856093u) ^ ((u32)y * 19349663u) ^ ((u32)z * 83492791u)) & mask;
+}
+
+void NavIndexBuild(NavGraph *graph) {
+	NavIndexFree(graph);
+
+	NavIndex *index = calloc(1, sizeof(NavIndex));
+
+	u32 bucket_count = 1;
+	while(bucket_count < graph->node_count)
+		bucket_count <<= 1;
+
+	index->bucket_mask = bucket_count - 1;
+	index->bucket_first = calloc(bucket_count + 1, sizeof(u32));
+	index->ids = malloc(sizeof(u16) * (graph->node_count + 1));
+
+	u32 *node_bucket = malloc(sizeof(u32) * (graph->node_count + 1));
+
+	// Counting sort nodes into buckets
+	for(u16 i = 0; i < graph->node_count; i++) {
+		Vector3 pos = graph->nodes[i].position;
+
+		node_bucket[i] = NavIndexKey(
+			(i32)floorf(pos.x / NAV_INDEX_CELL),
+			(i32)floorf(pos.y / NAV_INDEX_CELL),
+			(i32)floorf(pos.z / NAV_INDEX_CELL),
+			index->bucket_mask
+		);
+
+		index->bucket_first[node_bucket[i] + 1]++;
+	}
+
+	for(u32 i = 0; i < bucket_count; i++)
+		index->bucket_first[i + 1] += index->bucket_first[i];
+
+	u32 *fill = malloc(sizeof(u32) * bucket_count);
+	memcpy(fill, index->bucket_first, sizeof(u32) * bucket_count);
+
+	for(u16 i = 0; i < graph->node_count; i++)
+		index->ids[fill[node_bucket[i]]++] = i;
+
+	free(fill);
+	free(node_bucket);
+
+	graph->index = index;
+}
+
+void NavIndexFree(NavGraph *graph) {
+	NavIndex *index = graph->index;
+	if(!index)
+		return;
+
+	free(index->bucket_first);
+	free(index->ids);
+	free(index);
+
+	graph->index = NULL;
+}
+
+// Visit nodes within radius. Returns false if the cell range is big enough that scanning nodes is cheaper,
+// callers fall back to a linear scan then
+typedef bool (*NavIndexVisitFunc)(NavGraph *graph, u16 node, float dist_sqr, void *user);
+
+bool NavIndexVisit(NavGraph *graph, Vector3 position, float radius, NavIndexVisitFunc func, void *user) {
+	NavIndex *index = graph->index;
+	if(!index)
+		return false;
+
+	i32 min_x = (i32)floorf((position.x - radius) / NAV_INDEX_CELL);
+	i32 min_y = (i32)floorf((position.y - radius) / NAV_INDEX_CELL);
+	i32 min_z = (i32)floorf((position.z - radius) / NAV_INDEX_CELL);
+	i32 max_x = (i32)floorf((position.x + radius) / NAV_INDEX_CELL);
+	i32 max_y = (i32)floorf((position.y + radius) / NAV_INDEX_CELL);
+	i32 max_z = (i32)floorf((position.z + radius) / NAV_INDEX_CELL);
+
+	float cell_count = (float)(max_x - min_x + 1) * (max_y - min_y + 1) * (max_z - min_z + 1);
+	if(cell_count > graph->node_count)
+		return false;
+
+	float radius_sqr = radius * radius;
+
+	for(i32 z = min_z; z <= max_z; z++) {
+		for(i32 y = min_y; y <= max_y; y++) {
+			for(i32 x = min_x; x <= max_x; x++) {
+				u32 bucket = NavIndexKey(x, y, z, index->bucket_mask);
+
+				for(u32 i = index->bucket_first[bucket]; i < index->bucket_first[bucket + 1]; i++) {
+					u16 node = index->ids[i];
+					Vector3 pos = graph->nodes[node].position;
+
+					// Bucket is shared with other cells, only take nodes from this one so none are visited twice
+					if((i32)floorf(pos.x / NAV_INDEX_CELL) != x || 
+					   (i32)floorf(pos.y / NAV_INDEX_CELL) != y || 
+					   (i32)floorf(pos.z / NAV_INDEX_CELL) != z)
+						continue;
+
+					float dist_sqr = Vector3DistanceSqr(pos, position);
+					if(dist_sqr > radius_sqr)
+						continue;
+
+					if(!func(graph, node, dist_sqr, user))
+						return true;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+typedef struct {
+	float dist_sqr;
+	i32 id;
+
+} NavNearest;
+
+bool NavNearestVisit(NavGraph *graph, u16 node, float dist_sqr, void *user) {
+	NavNearest *nearest = user;
+
+	if(dist_sqr < nearest->dist_sqr || (dist_sqr == nearest->dist_sqr && node < nearest->id)) {
+		nearest->dist_sqr = dist_sqr;
+		nearest->id = node;
+	}
+
+	return true;
+}
+
+i32 NavIndexNearest(NavGraph *graph, Vector3 position, float max_dist) {
+	NavNearest nearest = (NavNearest) { .dist_sqr = FLT_MAX, .id = NAV_NULL_NODE };
+
+	if(!NavIndexVisit(graph, position, max_dist, NavNearestVisit, &nearest)) {
+		float max_sqr = max_dist * max_dist;
+
+		for(u16 i = 0; i < graph->node_count; i++) {
+			float dist_sqr = Vector3DistanceSqr(graph->nodes[i].position, position);
+			if(dist_sqr <= max_sqr)
+				NavNearestVisit(graph, i, dist_sqr, &nearest);
+		}
+	}
+
+	return nearest.id;
+}
+
+typedef struct {
+	Vector3 position;
+
+	u16 *out;
+	u16 count;
+	u16 max;
+
+} NavRadiusQuery;
+
+// Keep out sorted closest first, farthest falls off the end when full.
+// Ties go to the lower id so results don't depend on visit order
+bool NavRadiusVisit(NavGraph *graph, u16 node, float dist_sqr, void *user) {
+	NavRadiusQuery *query = user;
+
+	if(!query->max)
+		return false;
+
+	if(query->count == query->max) {
+		u16 last = query->out[query->count - 1];
+		float last_sqr = Vector3DistanceSqr(graph->nodes[last].position, query->position);
+
+		if(dist_sqr > last_sqr || (dist_sqr == last_sqr && node > last))
+			return true;
+
+		query->count--;
+	}
+
+	i32 j = query->count - 1;
+	while(j >= 0) {
+		u16 other = query->out[j];
+		float other_sqr = Vector3DistanceSqr(graph->nodes[other].position, query->position);
+
+		if(other_sqr < dist_sqr || (other_sqr == dist_sqr && other < node))
+			break;
+
+		query->out[j + 1] = other;
+		j--;
+	}
+
+	query->out[j + 1] = node;
+	query->count++;
+
+	return true;
+}
+
+u16 NavIndexQueryRadius(NavGraph *graph, Vector3 position, float radius, u16 *out, u16 max) {
+	NavRadiusQuery query = (NavRadiusQuery) { .position = position, .out = out, .count = 0, .max = max };
+
+	if(!NavIndexVisit(graph, position, radius, NavRadiusVisit, &query)) {
+		float radius_sqr = radius * radius;
+
+		for(u16 i = 0; i < graph->node_count; i++) {
+			float dist_sqr = Vector3DistanceSqr(graph->nodes[i].position, position);
+			if(dist_sqr <= radius_sqr)
+				NavRadiusVisit(graph, i, dist_sqr, &query);
+		}
+	}
+
+	return query.count;
+}
+
+void NavPathCacheClear(NavPathCache *cache) {
+	for(u16 i = 0; i < NAV_PATH_CACHE_SIZE; i++)
+		cache->entries[i].valid = false;
+
+	cache->tick = 0;
+	cache->hits = 0;
+	cache->suffix_hits = 0;
+	cache->misses = 0;
+	cache->evictions = 0;
+}
+
+void NavPathCacheInvalidate(NavPathCache *cache, NavGraph *graph) {
+	for(u16 i = 0; i < NAV_PATH_CACHE_SIZE; i++) {
+		if(cache->entries[i].graph == graph)
+			cache->entries[i].valid = false;
+	}
+}
+
+// Position of node in an entry's span, -1 if it's not on the path
+static i32 NavPathCacheSpanFind(NavPathCache *cache, NavPathCacheEntry *entry, u16 node) {
+	u16 *nodes = &cache->nodes[entry->first];
+
+	for(u16 i = 0; i < entry->count; i++) {
+		if(nodes[i] == node)
+			return i;
+	}
+
+	return -1;
+}
+
+bool NavPathCacheFind(NavPathCache *cache, NavGraph *graph, u16 start, u16 goal, NavPath *path) {
+	for(u16 i = 0; i < NAV_PATH_CACHE_SIZE; i++) {
+		NavPathCacheEntry *entry = &cache->entries[i];
+		if(!entry->valid || entry->graph != graph || entry->goal != goal)
+			continue;
+
+		i32 at = NavPathCacheSpanFind(cache, entry, start);
+		if(at == -1)
+			continue;
+
+		path->count = entry->count - at;
+		path->curr = 0;
+		memcpy(path->nodes, &cache->nodes[entry->first + at], sizeof(u16) * path->count);
+
+		entry->last_used = ++cache->tick;
+
+		if(at == 0) cache->hits++;
+		else cache->suffix_hits++;
+
+		return true;
+	}
+
+	cache->misses++;
+	return false;
+}
+
+void NavPathCacheInsert(NavPathCache *cache, NavGraph *graph, NavPath *path) {
+	if(!path->count)
+		return;
+
+	u16 goal = path->nodes[path->count - 1];
+
+	// Already covered by a longer path
+	for(u16 i = 0; i < NAV_PATH_CACHE_SIZE; i++) {
+		NavPathCacheEntry *entry = &cache->entries[i];
+		if(!entry->valid || entry->graph != graph || entry->goal != goal)
+			continue;
+
+		if(NavPathCacheSpanFind(cache, entry, path->nodes[0]) != -1) {
+			entry->last_used = ++cache->tick;
+			return;
+		}
+	}
+
+	NavPathCacheEntry *slot = NULL;
+
+	for(u16 i = 0; i < NAV_PATH_CACHE_SIZE; i++) {
+		NavPathCacheEntry *entry = &cache->entries[i];
+
+		if(entry->valid && entry->graph == graph && entry->goal == goal) {
+			// New path covers this one, drop it
+			u16 entry_start = cache->nodes[entry->first];
+			for(u16 j = 0; j < path->count; j++) {
+				if(path->nodes[j] == entry_start) {
+					entry->valid = false;
+					break;
+				}
+			}
+		}
+
+		if(!entry->valid && !slot)
+			slot = entry;
+	}
+
+	// Evict least recently used
+	if(!slot) {
+		slot = &cache->entries[0];
+		for(u16 i = 1; i < NAV_PATH_CACHE_SIZE; i++) {
+			if(cache->entries[i].last_used < slot->last_used)
+				slot = &cache->entries[i];
+		}
+
+		cache->evictions++;
+	}
+
+	u16 id = slot - cache->entries;
+
+	*slot = (NavPathCacheEntry) {
+		.graph = graph,
+		.last_used = ++cache->tick,
+		.first = id * MAX_PATH_NODES,
+		.count = path->count,
+		.goal = goal,
+		.valid = true
+	};
+
+	memcpy(&cache->nodes[slot->first], path->nodes, sizeof(u16) * path->count);
+}
+
+void NavQueueInit(NavQueue *queue, u32 budget_expansions) {
+	NavSearchFree(&queue->search);
+	NavSearchFree(&queue->local);
+
+	free(queue->start_cost);
+	free(queue->goal_cost);
+
+	*queue = (NavQueue) {0};
+	queue->active = -1;
+	queue->budget_expansions = (budget_expansions) ? budget_expansions : NAV_DEFAULT_BUDGET_EXPANSIONS;
+
+	// Start at 1 so a valid handle is never NAV_NULL_REQUEST
+	for(u16 i = 0; i < NAV_MAX_REQUESTS; i++)
+		queue->requests[i].generation = 1;
+}
+
+void NavQueueClose(NavQueue *queue) {
+	NavPathCache *cache = &queue->cache;
+	if(GetLogState()) 
+		printf("path cache: %u hits, %u suffix hits, %u misses, %u evictions\n", cache->hits, cache->suffix_hits, cache->misses, cache->evictions);
+
+	NavSearchFree(&queue->search);
+	NavSearchFree(&queue->local);
+
+	free(queue->start_cost);
+	free(queue->goal_cost);
+
+	*queue = (NavQueue) {0};
+	queue->active = -1;
+}
+
+u32 NavRequestHandle(NavQueue *queue, u16 slot) {
+	return ((u32)queue->requests[slot].generation << 16) | slot;
+}
+
+u32 NavRequestSubmit(NavQueue *queue, NavGraph *graph, u16 start, u16 target, u8 priority, u32 owner) {
+	for(u16 i = 0; i < NAV_MAX_REQUESTS; i++) {
+		NavRequest *req = &queue->requests[i];
+		if(req->status != NAV_SEARCH_IDLE)
+			continue;
+
+		req->graph = graph;
+		req->start = start;
+		req->target = target;
+		req->priority = priority;
+		req->owner = owner;
+		req->seq = queue->seq++;
+		req->path.count = 0;
+		req->route.count = 0;
+		req->status = NAV_SEARCH_RUNNING;
+
+		return NavRequestHandle(queue, i);
+	}
+
+	MessageError("ERROR: Path request queue full", NULL);
+	return NAV_NULL_REQUEST;
+}
+
+NavRequest *NavRequestGet(NavQueue *queue, u32 handle) {
+	if(handle == NAV_NULL_REQUEST)
+		return NULL;
+
+	u16 slot = handle & 0xFFFF;
+	if(slot >= NAV_MAX_REQUESTS)
+		return NULL;
+
+	NavRequest *req = &queue->requests[slot];
+	if(req->generation != (handle >> 16) || req->status == NAV_SEARCH_IDLE)
+		return NULL;
+
+	return req;
+}
+
+void NavRequestCancel(NavQueue *queue, u32 handle) {
+	NavRequest *req = NavRequestGet(queue, handle);
+	if(!req)
+		return;
+
+	u16 slot = handle & 0xFFFF;
+	if(queue->active == slot)
+		queue->active = -1;
+
+	req->status = NAV_SEARCH_IDLE;
+
+	// Skip 0 on wrap
+	if(++req->generation == 0)
+		req->generation = 1;
+}
+
+// Pick highest priority queued request, oldest first on ties
+i16 NavQueueNext(NavQueue *queue) {
+	i16 best = -1;
+
+	for(u16 i = 0; i < NAV_MAX_REQUESTS; i++) {
+		NavRequest *req = &queue->requests[i];
+		if(req->status != NAV_SEARCH_RUNNING)
+			continue;
+
+		if(best > -1) {
+			NavRequest *curr = &queue->requests[best];
+			if(req->priority < curr->priority)
+				continue;
+
+			if(req->priority == curr->priority && (i32)(req->seq - curr->seq) > 0)
+				continue;
+		}
+
+		best = i;
+	}
+
+	return best;
+}
+
+void NavQueueUpdate(NavQueue *queue) {
+	// Counted in node expansions rather than time so results don't depend on machine speed
+	u32 spent = 0;
+
+	do {
+		if(queue->active == -1) {
+			queue->active = NavQueueNext(queue);
+			if(queue->active == -1)
+				break;
+
+			NavRequest *req = &queue->requests[queue->active];
+
+			// Cached paths are complete, there's no route left to refine
+			if(NavPathCacheFind(&queue->cache, req->graph, req->start, req->target, &req->path)) {
+				req->route = (NavRoute) { .goal = req->target };
+				req->status = NAV_SEARCH_FOUND;
+				queue->active = -1;
+				continue;
+			}
+
+			NavClusters *cl = req->graph->clusters;
+			if(cl) {
+				u16 cost_count = cl->max_cluster_entrances + 1;
+				if(cost_count > queue->cost_capacity) {
+					queue->start_cost = realloc(queue->start_cost, sizeof(float) * cost_count);
+					queue->goal_cost = realloc(queue->goal_cost, sizeof(float) * cost_count);
+					queue->cost_capacity = cost_count;
+				}
+
+				NavRoutePlanBegin(&queue->planner, req->graph, &req->route, &req->path, req->start, req->target, queue->start_cost, queue->goal_cost);
+
+			} else 
+				NavSearchBegin(&queue->search, req->graph, req->start, req->target);
+		}
+
+		NavRequest *req = &queue->requests[queue->active];
+
+		if(req->graph->clusters) {
+			NavRoutePlanner *plan = &queue->planner;
+
+			u32 expanded = plan->expanded;
+			u8 status = NavRoutePlanStep(plan, &queue->search, &queue->local, NAV_STEP_EXPANSIONS);
+			spent += plan->expanded - expanded;
+
+			if(status == NAV_SEARCH_RUNNING)
+				continue;
+
+			// First segment made it all the way
+			if(status == NAV_SEARCH_FOUND && req->path.nodes[req->path.count - 1] == req->target)
+				NavPathCacheInsert(&queue->cache, req->graph, &req->path);
+
+			req->status = status;
+			queue->active = -1;
+			continue;
+		}
+
+		u32 expanded = queue->search.expanded;
+		u8 status = NavSearchStep(&queue->search, NAV_STEP_EXPANSIONS);
+		spent += queue->search.expanded - expanded;
+
+		if(status == NAV_SEARCH_RUNNING)
+			continue;
+
+		if(status == NAV_SEARCH_FOUND) {
+			req->path.count = NavSearchExtractPath(&queue->search, req->path.nodes, MAX_PATH_NODES - 1);
+			NavPathCacheInsert(&queue->cache, req->graph, &req->path);
+		}
+
+		req->status = status;
+		queue->active = -1;
+
+	} while(spent < queue->budget_expansions);
+}
+
+void NavFlowReset(NavFlowField *flow, NavGraph *graph) {
+	flow->graph = graph;
+	flow->target = NAV_NULL_NODE;
+	flow->pending = NAV_NULL_NODE;
+	flow->wanted = NAV_NULL_NODE;
+	flow->building = false;
+}
+
+void NavFlowFree(NavFlowField *flow) {
+	NavSearchFree(&flow->fields[0]);
+	NavSearchFree(&flow->fields[1]);
+
+	*flow = (NavFlowField) {0};
+}
+
+void NavFlowSetTarget(NavFlowField *flow, u16 target) {
+	if(!flow->graph || target >= flow->graph->node_count)
+		return;
+
+	flow->wanted = target;
+}
+
+void NavFlowUpdate(NavFlowField *flow, u32 budget_cells) {
+	NavGraph *graph = flow->graph;
+	if(!graph)
+		return;
+
+	u32 spent = 0;
+
+	do {
+		if(!flow->building) {
+			if(flow->wanted == NAV_NULL_NODE || flow->wanted == flow->target)
+				break;
+
+			NavSearch *search = &flow->fields[!flow->curr];
+			Vector3 position = graph->nodes[flow->wanted].position;
+
+			NavSearchBeginEx(search, graph->node_count, flow->wanted, NAV_FLOOD_TARGET, position, position);
+			search->graph = graph;
+
+			flow->pending = flow->wanted;
+			flow->building = true;
+		}
+
+		NavSearch *search = &flow->fields[!flow->curr];
+		u32 expanded = search->expanded;
+
+		// Flood only ends once the open set is empty
+		u8 status = NavSearchStep(search, NAV_STEP_EXPANSIONS);
+		spent += search->expanded - expanded;
+
+		if(status != NAV_SEARCH_RUNNING) {
+			flow->curr = !flow->curr;
+			flow->target = flow->pending;
+			flow->building = false;
+		}
+
+	} while(spent < budget_cells);
+}
+
+i32 NavFlowNext(NavFlowField *flow, u16 node) {
+	if(!flow->graph || node >= flow->graph->node_count)
+		return NAV_NULL_NODE;
+
+	if(flow->building) {
+		NavSearch *search = &flow->fields[!flow->curr];
+
+		if(search->stamp[node] == search->generation && (search->flags[node] & NAV_NODE_CLOSED))
+			return search->parent[node];
+	}
+
+	if(flow->target == NAV_NULL_NODE)
+		return NAV_NULL_NODE;
+
+	NavSearch *search = &flow->fields[flow->curr];
+	if(search->stamp[node] == search->generation && (search->flags[node] & NAV_NODE_CLOSED))
+		return search->parent[node];
+
+	return NAV_NULL_NODE;
+}
@@ -0,0 +1,329 @@
+#include "../include/num_redefs.h"
+#include "ai.h"
+
+#ifndef NAV_H_
+#define NAV_H_
+
+#define NAV_NULL_NODE -1
+
+// Target for searches without a goal, heuristic is 0 and every reachable node gets closed
+#define NAV_FLOOD_TARGET 0xFFFF
+
+enum NAV_SEARCH_STATUS : u8 {
+	NAV_SEARCH_IDLE,
+	NAV_SEARCH_RUNNING,
+	NAV_SEARCH_FOUND,
+	NAV_SEARCH_FAILED
+};
+
+// Node flags, only valid when node stamp matches search generation
+#define NAV_NODE_OPEN	0x01
+#define NAV_NODE_CLOSED	0x02
+
+// * NOTE:
+// A* state, reused between searches.
+// Per node arrays are never cleared, a node is treated as unvisited unless it's stamp matches the current generation.
+// Open set is an indexed binary min-heap on f-cost, heap_index allows decrease-key in place.
+// Each thread running searches owns it's own NavSearch
+typedef struct {
+	float *g_cost;
+	float *f_cost;
+	i16 *parent;
+
+	u32 *stamp;
+	u16 *heap_index;
+	u8 *flags;
+
+	u16 *heap;
+	u16 heap_count;
+
+	u16 capacity;
+	u32 generation;
+
+	// Current query
+	NavGraph *graph;
+	Vector3 target_position;
+
+	// Optional, limits expansion to nodes in either cluster
+	u16 *node_cluster;
+	u16 cluster_A, cluster_B;
+
+	u32 expanded;
+
+	u16 start;
+	u16 target;
+
+	u8 status;
+
+} NavSearch;
+
+// Grow scratch arrays to fit a graph
+void NavSearchReserve(NavSearch *search, u16 node_count);
+
+void NavSearchFree(NavSearch *search);
+
+// Start a new query, previous state is invalidated by bumping generation
+void NavSearchBegin(NavSearch *search, NavGraph *graph, u16 start, u16 target);
+
+// Same as above for searches over something other than a NavGraph (navmesh polys).
+// Caller drives the search with NavSearchPop and NavSearchRelax
+void NavSearchBeginEx(NavSearch *search, u16 node_count, u16 start, u16 target, Vector3 start_position, Vector3 target_position);
+
+// Pop lowest f-cost node and close it, returns NAV_NULL_NODE when open set is empty
+i32 NavSearchPop(NavSearch *search);
+
+// Try reaching neighbour through curr
+void NavSearchRelax(NavSearch *search, u16 curr, u16 neighbour, float cost, Vector3 neighbour_position);
+
+// Expand up to max_expansions nodes, returns search status
+u8 NavSearchStep(NavSearch *search, u32 max_expansions);
+
+// Run query to completion
+bool NavSearchRun(NavSearch *search, NavGraph *graph, u16 start, u16 target);
+
+// Write node ids from start to target into out, keeping the last max nodes if path is longer.
+// Returns node count
+u16 NavSearchExtractPath(NavSearch *search, u16 *out, u16 max);
+
+// Same as above but keeps the first max nodes
+u16 NavSearchExtractPathFront(NavSearch *search, u16 *out, u16 max);
+
+// Run query without leaving two clusters
+bool NavSearchRunInClusters(NavSearch *search, NavGraph *graph, u16 start, u16 target, u16 cluster_A, u16 cluster_B);
+
+// ** Hierarchical search ** //
+//
+// Build cluster abstraction of a graph, sets graph->clusters
+void NavClustersBuild(NavGraph *graph);
+void NavClustersFree(NavGraph *graph);
+
+enum NAV_PLAN_STAGE : u8 {
+	NAV_PLAN_START_COSTS,	// Searches from start to the entrances of its cluster
+	NAV_PLAN_GOAL_COSTS,	// Same for goal
+	NAV_PLAN_DIRECT,		// Start to goal inside their cluster, if they share one
+	NAV_PLAN_ABSTRACT,		// Search over entrances
+	NAV_PLAN_REFINE			// First route segment into path
+};
+
+// * NOTE:
+// Hierarchical query split into stages so it can be spread over frames.
+// Every stage runs searches that resume where they left off, so any budget makes progress.
+// search and local passed to each step must not be used for anything else until the plan is done,
+// start and goal costs are scratch sized for the largest cluster (max_cluster_entrances + 1)
+typedef struct {
+	NavGraph *graph;
+	NavRoute *route;
+	NavPath *path;		// Optional, only the route is planned without one
+
+	float *start_cost;
+	float *goal_cost;
+	float direct_cost;
+
+	u32 expanded;
+
+	u16 start, goal;
+	u16 start_cluster, goal_cluster;
+
+	u16 index;			// Entrance of the cost stage in progress
+
+	u8 stage;
+	u8 status;
+
+	bool searching;		// Search of the current stage was started
+	bool unrestricted;	// Refine fell back to the whole graph
+
+} NavRoutePlanner;
+
+void NavRoutePlanBegin(NavRoutePlanner *plan, NavGraph *graph, NavRoute *route, NavPath *path, u16 start, u16 goal, float *start_cost, float *goal_cost);
+
+// Expand up to max_expansions nodes over all stages, returns plan status
+u8 NavRoutePlanStep(NavRoutePlanner *plan, NavSearch *search, NavSearch *local, u32 max_expansions);
+
+// Plan abstract route between nodes and refine its first segment into path.
+// Falls back to a plain search on graphs without clusters (route count is 0, long paths truncate).
+// search is used for the abstract graph, local for searches inside clusters
+bool NavRouteFind(NavGraph *graph, NavSearch *search, NavSearch *local, NavRoute *route, NavPath *path, u16 start, u16 goal);
+
+// Refine next route segment from a node, planning again if route ran out before reaching goal.
+// Returns false when goal is reached or no segment is left
+bool NavRouteAdvance(NavGraph *graph, NavSearch *search, NavSearch *local, NavRoute *route, NavPath *path, u16 from);
+
+// ** Spatial index ** //
+//
+// Build node lookup grid, sets graph->index
+void NavIndexBuild(NavGraph *graph);
+void NavIndexFree(NavGraph *graph);
+
+// Closest node within max_dist, returns NAV_NULL_NODE if there's none.
+// Graphs without an index fall back to scanning every node
+i32 NavIndexNearest(NavGraph *graph, Vector3 position, float max_dist);
+
+// Write ids of the max closest nodes within radius into out, closest first. Returns count
+u16 NavIndexQueryRadius(NavGraph *graph, Vector3 position, float radius, u16 *out, u16 max);
+
+// ** Path cache ** //
+//
+#define NAV_PATH_CACHE_SIZE 64
+
+typedef struct {
+	NavGraph *graph;
+	u32 last_used;
+
+	// Span of the cache node pool
+	u16 first;
+	u16 count;
+
+	u16 goal;
+
+	bool valid;
+
+} NavPathCacheEntry;
+
+// * NOTE:
+// Recently found paths, the least recently used entry is replaced when full.
+// Any part of a shortest path is a shortest path too, so a request can take the tail 
+// of a cached path to the same goal that passes through its start.
+// Only paths that reach their goal are stored
+typedef struct {
+	NavPathCacheEntry entries[NAV_PATH_CACHE_SIZE];
+	u16 nodes[NAV_PATH_CACHE_SIZE * MAX_PATH_NODES];
+
+	u32 tick;
+
+	u32 hits;
+	u32 suffix_hits;
+	u32 misses;
+	u32 evictions;
+
+} NavPathCache;
+
+// Drop every entry and reset stats
+void NavPathCacheClear(NavPathCache *cache);
+
+// Drop entries of one graph, call when its edges or obstacles change
+void NavPathCacheInvalidate(NavPathCache *cache, NavGraph *graph);
+
+// Copy cached path from start to goal into path, returns false on a miss
+bool NavPathCacheFind(NavPathCache *cache, NavGraph *graph, u16 start, u16 goal, NavPath *path);
+
+// Store a path, last node is the goal
+void NavPathCacheInsert(NavPathCache *cache, NavGraph *graph, NavPath *path);
+
+// ** Path request queue ** //
+//
+#define NAV_MAX_REQUESTS		64
+#define NAV_STEP_EXPANSIONS		32
+#define NAV_DEFAULT_BUDGET_EXPANSIONS	2048
+#define NAV_NULL_REQUEST		0
+
+enum NAV_PRIORITY : u8 {
+	NAV_PRIORITY_LOW,
+	NAV_PRIORITY_NORMAL,
+	NAV_PRIORITY_HIGH
+};
+
+// Slot is free when status is NAV_SEARCH_IDLE,
+// RUNNING while queued or being searched, FOUND/FAILED until released
+typedef struct {
+	NavPath path;
+	NavRoute route;
+
+	NavGraph *graph;
+
+	u32 seq;
+
+	u16 start;
+	u16 target;
+
+	u16 generation;
+	u32 owner;		// Opaque to the queue, entity handle of requester
+
+	u8 priority;
+	u8 status;
+
+} NavRequest;
+
+// * NOTE:
+// Searches are advanced on the main thread once per frame, limited by a budget of node expansions
+// so the work done per frame is the same on every machine and in replays.
+// Only one search is in flight, the next one picked is the highest priority (oldest first).
+// Graphs with clusters are planned hierarchically with a NavRoutePlanner charged to the same budget,
+// only the first route segment is refined here, the rest as the requester advances.
+// Requests are checked against the path cache before searching.
+// Handles pack slot and generation so a stale handle never matches a reused slot
+typedef struct {
+	NavRequest requests[NAV_MAX_REQUESTS];
+	NavSearch search;
+	NavSearch local;
+
+	// Hierarchical plan of the active request, costs are kept here so
+	// plans made elsewhere with the graph's own scratch don't overwrite them
+	NavRoutePlanner planner;
+	float *start_cost;
+	float *goal_cost;
+	u16 cost_capacity;
+
+	NavPathCache cache;
+
+	u32 seq;
+	u32 budget_expansions;
+
+	i16 active;
+
+} NavQueue;
+
+void NavQueueInit(NavQueue *queue, u32 budget_expansions);
+void NavQueueClose(NavQueue *queue);
+
+// Queue a search, returns NAV_NULL_REQUEST if queue is full
+u32 NavRequestSubmit(NavQueue *queue, NavGraph *graph, u16 start, u16 target, u8 priority, u32 owner);
+
+// Drop a request, safe to call with stale or null handles
+void NavRequestCancel(NavQueue *queue, u32 handle);
+
+// Returns NULL if handle is stale
+NavRequest *NavRequestGet(NavQueue *queue, u32 handle);
+
+u32 NavRequestHandle(NavQueue *queue, u16 slot);
+
+// Advance queued searches until the budget runs out. 
+// Always does at least one step so requests can't stall on a small budget
+void NavQueueUpdate(NavQueue *queue);
+
+// ** Flow field ** //
+//
+// Nodes closed per update, floods of bigger graphs finish over several frames
+#define NAV_FLOW_BUDGET_CELLS 1024
+
+// * NOTE:
+// Shared next hops toward one target node, for any number of entities chasing the same thing.
+// Built with a Dijkstra flood out from the target, parent of a closed node is its next hop.
+// Floods are spread over frames, a node closed by the flood in progress is already final
+// so readers use that first and fall back to the last complete field.
+// A target change during a flood is picked up once it finishes
+typedef struct {
+	NavSearch fields[2];
+	NavGraph *graph;
+
+	i32 target;		// Target of complete field, NAV_NULL_NODE if there's none yet
+	i32 pending;	// Target of flood in progress
+	i32 wanted;
+
+	u8 curr;		// Index of complete field
+	bool building;
+
+} NavFlowField;
+
+// Point field at a graph and drop any previous results, keeps allocations
+void NavFlowReset(NavFlowField *flow, NavGraph *graph);
+void NavFlowFree(NavFlowField *flow);
+
+void NavFlowSetTarget(NavFlowField *flow, u16 target);
+
+// Advance flood until budget_cells nodes were closed, starts a new one if the target moved
+void NavFlowUpdate(NavFlowField *flow, u32 budget_cells);
+
+// Next node toward target, NAV_NULL_NODE if node is the target or hasn't been reached
+i32 NavFlowNext(NavFlowField *flow, u16 node);
+
+#endif
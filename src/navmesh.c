@@ -0,0 +1,1193 @@
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "navmesh.h"
+#include "map.h"
+#include "pm.h"
+#include "../include/log_message.h"
+
+#define NAV_NULL_SPAN 	-1
+#define NAV_NO_CON 		0xFF
+#define NAV_MAX_CLIP 	12
+
+// Neighbour offsets: -x, +y, +x, -y
+static const i8 nav_dir_x[4] = { -1, 0, 1, 0 };
+static const i8 nav_dir_y[4] = { 0, 1, 0, -1 };
+
+// Solid span in a tile heightfield, spans in a column are linked bottom to top
+typedef struct {
+	u16 smin, smax;
+	i32 next;
+
+	u8 walkable;
+
+} NavSolidSpan;
+
+// Open space above a walkable floor, heights are in cells
+typedef struct {
+	u16 floor, ceil;
+
+	u16 region;
+	u16 poly;
+
+	u8 con[4];
+	u8 area;
+
+} NavOpenSpan;
+
+typedef struct {
+	u32 first;
+	u8 count;
+
+} NavColumn;
+
+// Rect of cells [x0, x1) * [y0, y1), corner floors in cells
+typedef struct {
+	u16 x0, y0, x1, y1;
+	u16 z[4];
+
+	u16 region;
+
+} NavRect;
+
+typedef struct {
+	TriPool *tris;
+
+	Vector3 origin;
+
+	u16 width, height;
+	u16 tiles_x, tiles_y;
+
+	// Agent limits in cells
+	u16 climb;
+	u16 clearance;
+	u16 radius;
+
+	// Raster output, per tile spans in local column order
+	NavOpenSpan **tile_spans;
+	u8 **tile_counts;
+	u32 *tile_span_count;
+
+	// Rect output, per tile
+	NavRect **tile_rects;
+	u32 *tile_rect_count;
+
+	// Compact heightfield over the whole section
+	NavColumn *columns;
+	NavOpenSpan *spans;
+	u32 span_count;
+
+} NavMeshBuilder;
+
+enum NAV_BUILD_STAGE : u8 {
+	NAV_STAGE_RASTER,
+	NAV_STAGE_RECTS
+};
+
+typedef struct {
+	NavMeshBuilder *builder;
+
+	u32 tile_start;
+	u32 tile_stride;
+
+	u8 stage;
+
+} NavTileWorker;
+
+// Tile column range in cells
+void NavTileRange(NavMeshBuilder *b, u32 tile, u16 *cx0, u16 *cy0, u16 *cx1, u16 *cy1) {
+	*cx0 = (tile % b->tiles_x) * NAVMESH_TILE_CELLS;
+	*cy0 = (tile / b->tiles_x) * NAVMESH_TILE_CELLS;
+
+	*cx1 = *cx0 + NAVMESH_TILE_CELLS;
+	*cy1 = *cy0 + NAVMESH_TILE_CELLS;
+
+	if(*cx1 > b->width) *cx1 = b->width;
+	if(*cy1 > b->height) *cy1 = b->height;
+}
+
+// Clip polygon against an axis aligned plane, keeps side where sign * (v[axis] - value) >= 0
+u8 NavClipPoly(Vector3 *in, u8 count, Vector3 *out, u8 axis, float value, float sign) {
+	u8 out_count = 0;
+
+	for(u8 i = 0; i < count; i++) {
+		Vector3 a = in[i];
+		Vector3 b = in[(i + 1) % count];
+
+		float da = sign * (((float*)&a)[axis] - value);
+		float db = sign * (((float*)&b)[axis] - value);
+
+		if(da >= 0)
+			out[out_count++] = a;
+
+		// Edge crosses plane
+		if((da >= 0) != (db >= 0)) {
+			float t = da / (da - db);
+			out[out_count++] = Vector3Lerp(a, b, t);
+		}
+
+		if(out_count >= NAV_MAX_CLIP - 1)
+			break;
+	}
+
+	return out_count;
+}
+
+typedef struct {
+	NavSolidSpan *spans;
+	i32 *heads;
+
+	u32 count, capacity;
+	i32 free;
+
+} NavHeightfield;
+
+void NavAddSpan(NavHeightfield *hf, u32 col, u16 smin, u16 smax, u8 walkable) {
+	i32 prev = NAV_NULL_SPAN;
+	i32 curr = hf->heads[col];
+
+	while(curr != NAV_NULL_SPAN) {
+		NavSolidSpan *s = &hf->spans[curr];
+
+		// Rest of column is above new span
+		if(s->smin > smax)
+			break;
+
+		if(s->smax < smin) {
+			prev = curr;
+			curr = s->next;
+			continue;
+		}
+
+		// Overlap, merge into new span.
+		// Top surface decides walkability, both count if tops are within a cell
+		u8 top_walkable = (smax >= s->smax) ? walkable : s->walkable;
+		if(abs((i32)smax - (i32)s->smax) <= 1)
+			top_walkable = (walkable | s->walkable);
+
+		if(s->smin < smin) smin = s->smin;
+		if(s->smax > smax) smax = s->smax;
+		walkable = top_walkable;
+
+		i32 next = s->next;
+
+		s->next = hf->free;
+		hf->free = curr;
+
+		if(prev == NAV_NULL_SPAN)
+			hf->heads[col] = next;
+		else
+			hf->spans[prev].next = next;
+
+		curr = next;
+	}
+
+	i32 id = hf->free;
+	if(id != NAV_NULL_SPAN) {
+		hf->free = hf->spans[id].next;
+
+	} else {
+		if(hf->count >= hf->capacity) {
+			hf->capacity = (hf->capacity << 1);
+			hf->spans = realloc(hf->spans, sizeof(NavSolidSpan) * hf->capacity);
+		}
+
+		id = hf->count++;
+	}
+
+	hf->spans[id] = (NavSolidSpan) { .smin = smin, .smax = smax, .walkable = walkable, .next = curr };
+
+	if(prev == NAV_NULL_SPAN)
+		hf->heads[col] = id;
+	else
+		hf->spans[prev].next = id;
+}
+
+void NavTileRasterize(NavMeshBuilder *b, u32 tile) {
+	u16 cx0, cy0, cx1, cy1;
+	NavTileRange(b, tile, &cx0, &cy0, &cx1, &cy1);
+
+	u16 tw = cx1 - cx0;
+	u16 th = cy1 - cy0;
+
+	NavHeightfield hf = {
+		.capacity = 1024,
+		.free = NAV_NULL_SPAN
+	};
+	hf.spans = malloc(sizeof(NavSolidSpan) * hf.capacity);
+	hf.heads = malloc(sizeof(i32) * tw * th);
+
+	for(u32 i = 0; i < (u32)tw * th; i++)
+		hf.heads[i] = NAV_NULL_SPAN;
+
+	float cs = NAVMESH_CELL_SIZE;
+	float ch = NAVMESH_CELL_HEIGHT;
+
+	Vector3 tile_min = { b->origin.x + cx0 * cs, b->origin.y + cy0 * cs, 0 };
+	Vector3 tile_max = { b->origin.x + cx1 * cs, b->origin.y + cy1 * cs, 0 };
+
+	Vector3 row[NAV_MAX_CLIP], cell[NAV_MAX_CLIP], temp[NAV_MAX_CLIP];
+
+	for(u16 t = 0; t < b->tris->count; t++) {
+		Tri tri = TriPoolGet(b->tris, t);
+
+		Vector3 tri_min = Vector3Min(Vector3Min(tri.vertices[0], tri.vertices[1]), tri.vertices[2]);
+		Vector3 tri_max = Vector3Max(Vector3Max(tri.vertices[0], tri.vertices[1]), tri.vertices[2]);
+
+		if(tri_max.x < tile_min.x || tri_min.x > tile_max.x) continue;
+		if(tri_max.y < tile_min.y || tri_min.y > tile_max.y) continue;
+
+		u8 walkable = (tri.normal.z >= FLOOR_NORMAL_Z);
+
+		i32 y0 = floorf((tri_min.y - b->origin.y) / cs);
+		i32 y1 = floorf((tri_max.y - b->origin.y) / cs);
+		if(y0 < cy0) y0 = cy0;
+		if(y1 > cy1 - 1) y1 = cy1 - 1;
+
+		for(i32 y = y0; y <= y1; y++) {
+			float row_min = b->origin.y + y * cs;
+
+			u8 n = NavClipPoly(tri.vertices, 3, temp, 1, row_min, 1);
+			n = NavClipPoly(temp, n, row, 1, row_min + cs, -1);
+			if(n < 3) continue;
+
+			float rx_min = FLT_MAX, rx_max = -FLT_MAX;
+			for(u8 i = 0; i < n; i++) {
+				rx_min = fminf(rx_min, row[i].x);
+				rx_max = fmaxf(rx_max, row[i].x);
+			}
+
+			i32 x0 = floorf((rx_min - b->origin.x) / cs);
+			i32 x1 = floorf((rx_max - b->origin.x) / cs);
+			if(x0 < cx0) x0 = cx0;
+			if(x1 > cx1 - 1) x1 = cx1 - 1;
+
+			for(i32 x = x0; x <= x1; x++) {
+				float col_min = b->origin.x + x * cs;
+
+				u8 m = NavClipPoly(row, n, temp, 0, col_min, 1);
+				m = NavClipPoly(temp, m, cell, 0, col_min + cs, -1);
+				if(m < 3) continue;
+
+				float z_min = FLT_MAX, z_max = -FLT_MAX;
+				for(u8 i = 0; i < m; i++) {
+					z_min = fminf(z_min, cell[i].z);
+					z_max = fmaxf(z_max, cell[i].z);
+				}
+
+				i32 smax = ceilf((z_max - b->origin.z) / ch);
+				i32 smin = floorf((z_min - b->origin.z) / ch);
+				if(smax < 1) smax = 1;
+				if(smin > smax - 1) smin = smax - 1;
+				if(smin < 0) smin = 0;
+				if(smax > UINT16_MAX - 1) continue;
+
+				u32 col = (x - cx0) + (y - cy0) * tw;
+				NavAddSpan(&hf, col, smin, smax, walkable);
+			}
+		}
+	}
+
+	// Keep open space above walkable spans with enough headroom
+	u8 *counts = calloc(tw * th, sizeof(u8));
+
+	u32 open_cap = 256;
+	u32 open_count = 0;
+	NavOpenSpan *open = malloc(sizeof(NavOpenSpan) * open_cap);
+
+	for(u32 col = 0; col < (u32)tw * th; col++) {
+		for(i32 id = hf.heads[col]; id != NAV_NULL_SPAN; id = hf.spans[id].next) {
+			NavSolidSpan *s = &hf.spans[id];
+			if(!s->walkable)
+				continue;
+
+			u16 floor = s->smax;
+			u16 ceil = (s->next != NAV_NULL_SPAN) ? hf.spans[s->next].smin : UINT16_MAX;
+
+			if(ceil - floor < b->clearance)
+				continue;
+
+			if(counts[col] == UINT8_MAX - 1)
+				break;
+
+			if(open_count >= open_cap) {
+				open_cap = (open_cap << 1);
+				open = realloc(open, sizeof(NavOpenSpan) * open_cap);
+			}
+
+			open[open_count++] = (NavOpenSpan) {
+				.floor = floor,
+				.ceil = ceil,
+				.poly = NAVMESH_NULL_POLY,
+				.con = { NAV_NO_CON, NAV_NO_CON, NAV_NO_CON, NAV_NO_CON },
+				.area = 1
+			};
+			counts[col]++;
+		}
+	}
+
+	free(hf.spans);
+	free(hf.heads);
+
+	b->tile_spans[tile] = open;
+	b->tile_counts[tile] = counts;
+	b->tile_span_count[tile] = open_count;
+}
+
+// Global id of span connected to span_id in a direction, -1 if none or not walkable
+i32 NavNeighbour(NavMeshBuilder *b, u16 x, u16 y, u32 span_id, u8 dir) {
+	NavOpenSpan *s = &b->spans[span_id];
+	if(s->con[dir] == NAV_NO_CON)
+		return -1;
+
+	u32 col = (x + nav_dir_x[dir]) + (y + nav_dir_y[dir]) * b->width;
+	u32 id = b->columns[col].first + s->con[dir];
+
+	if(!b->spans[id].area)
+		return -1;
+
+	return id;
+}
+
+// Check if span can join a rect
+bool NavRectSpanFree(NavMeshBuilder *b, i32 id, u16 region) {
+	return (id > -1 && b->spans[id].poly == NAVMESH_NULL_POLY && b->spans[id].region == region);
+}
+
+void NavTileBuildRects(NavMeshBuilder *b, u32 tile) {
+	u16 cx0, cy0, cx1, cy1;
+	NavTileRange(b, tile, &cx0, &cy0, &cx1, &cy1);
+
+	u32 rect_cap = 64;
+	u32 rect_count = 0;
+	NavRect *rects = malloc(sizeof(NavRect) * rect_cap);
+
+	i32 first_row[NAVMESH_TILE_CELLS];
+	i32 last_row[NAVMESH_TILE_CELLS];
+	i32 next_row[NAVMESH_TILE_CELLS];
+
+	for(u16 y = cy0; y < cy1; y++) {
+		for(u16 x = cx0; x < cx1; x++) {
+			NavColumn *column = &b->columns[x + y * b->width];
+
+			for(u32 k = 0; k < column->count; k++) {
+				u32 id = column->first + k;
+				NavOpenSpan *s = &b->spans[id];
+
+				if(!s->area || s->poly != NAVMESH_NULL_POLY)
+					continue;
+
+				if(rect_count >= NAVMESH_NULL_POLY - 1)
+					break;
+
+				u16 poly = rect_count;
+				u16 region = s->region;
+
+				// Grow along x
+				u16 w = 1;
+				first_row[0] = id;
+				s->poly = poly;
+
+				while(x + w < cx1) {
+					i32 n = NavNeighbour(b, x + w - 1, y, first_row[w - 1], 2);
+					if(!NavRectSpanFree(b, n, region))
+						break;
+
+					b->spans[n].poly = poly;
+					first_row[w++] = n;
+				}
+
+				memcpy(last_row, first_row, sizeof(i32) * w);
+
+				// Grow along y while the whole row fits
+				u16 h = 1;
+				while(y + h < cy1) {
+					bool fits = true;
+
+					for(u16 c = 0; c < w; c++) {
+						next_row[c] = NavNeighbour(b, x + c, y + h - 1, last_row[c], 1);
+
+						if(!NavRectSpanFree(b, next_row[c], region)) {
+							fits = false;
+							break;
+						}
+
+						// Row has to be connected along x too, not just stacked columns
+						if(c > 0 && NavNeighbour(b, x + c - 1, y + h, next_row[c - 1], 2) != next_row[c]) {
+							fits = false;
+							break;
+						}
+					}
+
+					if(!fits)
+						break;
+
+					for(u16 c = 0; c < w; c++)
+						b->spans[next_row[c]].poly = poly;
+
+					memcpy(last_row, next_row, sizeof(i32) * w);
+					h++;
+				}
+
+				if(rect_count >= rect_cap) {
+					rect_cap = (rect_cap << 1);
+					rects = realloc(rects, sizeof(NavRect) * rect_cap);
+				}
+
+				rects[rect_count++] = (NavRect) {
+					.x0 = x, .y0 = y, .x1 = x + w, .y1 = y + h,
+					.z = {
+						b->spans[first_row[0]].floor,
+						b->spans[first_row[w - 1]].floor,
+						b->spans[last_row[w - 1]].floor,
+						b->spans[last_row[0]].floor
+					},
+					.region = region
+				};
+			}
+		}
+	}
+
+	b->tile_rects[tile] = rects;
+	b->tile_rect_count[tile] = rect_count;
+}
+
+void *NavTileJobRun(void *arg) {
+	NavTileWorker *worker = arg;
+	NavMeshBuilder *b = worker->builder;
+
+	u32 tile_count = b->tiles_x * b->tiles_y;
+
+	for(u32 tile = worker->tile_start; tile < tile_count; tile += worker->tile_stride) {
+		if(worker->stage == NAV_STAGE_RASTER)
+			NavTileRasterize(b, tile);
+		else
+			NavTileBuildRects(b, tile);
+	}
+
+	return NULL;
+}
+
+// Run a build stage over all tiles, tiles are interleaved between workers to even out load
+void NavMeshRunTiles(NavMeshBuilder *b, u8 stage) {
+	u32 tile_count = b->tiles_x * b->tiles_y;
+
+	int thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+	if(thread_count < 1) thread_count = 1;
+	if(thread_count > MAX_BUILD_THREADS) thread_count = MAX_BUILD_THREADS;
+	if((u32)thread_count > tile_count) thread_count = tile_count;
+
+	NavTileWorker workers[MAX_BUILD_THREADS] = {0};
+	pthread_t threads[MAX_BUILD_THREADS];
+	bool spawned[MAX_BUILD_THREADS] = {0};
+
+	for(int i = 0; i < thread_count; i++) {
+		workers[i] = (NavTileWorker) {
+			.builder = b,
+			.tile_start = i,
+			.tile_stride = thread_count,
+			.stage = stage
+		};
+
+		// Worker 0 runs on the calling thread
+		if(i > 0)
+			spawned[i] = (pthread_create(&threads[i], NULL, NavTileJobRun, &workers[i]) == 0);
+	}
+
+	NavTileJobRun(&workers[0]);
+
+	for(int i = 1; i < thread_count; i++) {
+		// Thread creation failed, fall back to running the tiles here
+		if(!spawned[i]) {
+			NavTileJobRun(&workers[i]);
+			continue;
+		}
+
+		pthread_join(threads[i], NULL);
+	}
+}
+
+// Gather per tile spans into one compact heightfield
+void NavBuildColumns(NavMeshBuilder *b) {
+	u32 tile_count = b->tiles_x * b->tiles_y;
+
+	b->span_count = 0;
+	for(u32 t = 0; t < tile_count; t++)
+		b->span_count += b->tile_span_count[t];
+
+	b->columns = calloc(b->width * b->height, sizeof(NavColumn));
+	b->spans = malloc(sizeof(NavOpenSpan) * (b->span_count + 1));
+
+	u32 offset = 0;
+	for(u32 t = 0; t < tile_count; t++) {
+		u16 cx0, cy0, cx1, cy1;
+		NavTileRange(b, t, &cx0, &cy0, &cx1, &cy1);
+
+		u16 tw = cx1 - cx0;
+		u32 first = offset;
+
+		for(u16 y = cy0; y < cy1; y++) {
+			for(u16 x = cx0; x < cx1; x++) {
+				u8 count = b->tile_counts[t][(x - cx0) + (y - cy0) * tw];
+
+				b->columns[x + y * b->width] = (NavColumn) { .first = first, .count = count };
+				first += count;
+			}
+		}
+
+		memcpy(b->spans + offset, b->tile_spans[t], sizeof(NavOpenSpan) * b->tile_span_count[t]);
+		offset += b->tile_span_count[t];
+
+		free(b->tile_spans[t]);
+		free(b->tile_counts[t]);
+	}
+}
+
+// Link spans an agent can walk between: step height within climb and enough shared headroom
+void NavBuildConnections(NavMeshBuilder *b) {
+	for(u16 y = 0; y < b->height; y++) {
+		for(u16 x = 0; x < b->width; x++) {
+			NavColumn *column = &b->columns[x + y * b->width];
+
+			for(u32 k = 0; k < column->count; k++) {
+				NavOpenSpan *s = &b->spans[column->first + k];
+
+				for(u8 dir = 0; dir < 4; dir++) {
+					i32 nx = x + nav_dir_x[dir];
+					i32 ny = y + nav_dir_y[dir];
+
+					if(nx < 0 || ny < 0 || nx >= b->width || ny >= b->height)
+						continue;
+
+					NavColumn *other = &b->columns[nx + ny * b->width];
+
+					for(u32 j = 0; j < other->count; j++) {
+						NavOpenSpan *n = &b->spans[other->first + j];
+
+						u16 bot = (s->floor > n->floor) ? s->floor : n->floor;
+						u16 top = (s->ceil < n->ceil) ? s->ceil : n->ceil;
+
+						if(top - bot < b->clearance)
+							continue;
+
+						if(abs((i32)n->floor - (i32)s->floor) > b->climb)
+							continue;
+
+						s->con[dir] = j;
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Shrink walkable area by agent radius so polys keep bodies off walls and ledges
+void NavErode(NavMeshBuilder *b) {
+	u8 *border = malloc(b->span_count);
+
+	for(u16 pass = 0; pass < b->radius; pass++) {
+		memset(border, 0, b->span_count);
+
+		for(u16 y = 0; y < b->height; y++) {
+			for(u16 x = 0; x < b->width; x++) {
+				NavColumn *column = &b->columns[x + y * b->width];
+
+				for(u32 k = 0; k < column->count; k++) {
+					u32 id = column->first + k;
+					if(!b->spans[id].area)
+						continue;
+
+					for(u8 dir = 0; dir < 4; dir++) {
+						if(NavNeighbour(b, x, y, id, dir) < 0) {
+							border[id] = 1;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		for(u32 i = 0; i < b->span_count; i++)
+			if(border[i]) b->spans[i].area = 0;
+	}
+
+	free(border);
+}
+
+typedef struct {
+	u16 x, y;
+	u32 id;
+
+} NavFloodItem;
+
+// Flood fill connected walkable spans into regions
+u16 NavBuildRegions(NavMeshBuilder *b) {
+	NavFloodItem *stack = malloc(sizeof(NavFloodItem) * (b->span_count + 1));
+	u16 region_count = 0;
+
+	for(u32 i = 0; i < b->span_count; i++)
+		b->spans[i].region = 0;
+
+	for(u16 y = 0; y < b->height; y++) {
+		for(u16 x = 0; x < b->width; x++) {
+			NavColumn *column = &b->columns[x + y * b->width];
+
+			for(u32 k = 0; k < column->count; k++) {
+				u32 seed = column->first + k;
+				if(!b->spans[seed].area || b->spans[seed].region)
+					continue;
+
+				if(region_count == UINT16_MAX - 1) {
+					MessageError("ERROR: Navmesh region overflow", NULL);
+					free(stack);
+					return region_count;
+				}
+
+				u16 region = ++region_count;
+
+				// Spans are marked when pushed so each one enters the stack once
+				u32 top = 0;
+				stack[top++] = (NavFloodItem) { .x = x, .y = y, .id = seed };
+				b->spans[seed].region = region;
+
+				while(top) {
+					NavFloodItem item = stack[--top];
+
+					for(u8 dir = 0; dir < 4; dir++) {
+						i32 n = NavNeighbour(b, item.x, item.y, item.id, dir);
+						if(n < 0 || b->spans[n].region)
+							continue;
+
+						b->spans[n].region = region;
+						stack[top++] = (NavFloodItem) { 
+							.x = item.x + nav_dir_x[dir], 
+							.y = item.y + nav_dir_y[dir], 
+							.id = n 
+						};
+					}
+				}
+			}
+		}
+	}
+
+	free(stack);
+	return region_count;
+}
+
+// Cell adjacency between two polys, merged into one portal per poly pair
+typedef struct {
+	u16 poly_A, poly_B;		// A is on the lower side of the boundary
+	u16 line;				// Boundary in cells
+	u16 lo, hi;				// Extent along boundary in cells
+
+	float z_lo, z_hi;
+
+	u8 axis;				// 0: boundary crosses x, 1: boundary crosses y
+
+} NavPortalEdge;
+
+int NavPortalEdgeCompare(const void *a, const void *b) {
+	const NavPortalEdge *ea = a;
+	const NavPortalEdge *eb = b;
+
+	if(ea->poly_A != eb->poly_A) return (ea->poly_A < eb->poly_A) ? -1 : 1;
+	if(ea->poly_B != eb->poly_B) return (ea->poly_B < eb->poly_B) ? -1 : 1;
+	if(ea->axis != eb->axis) return (ea->axis < eb->axis) ? -1 : 1;
+	if(ea->lo != eb->lo) return (ea->lo < eb->lo) ? -1 : 1;
+
+	return 0;
+}
+
+Vector3 NavCellPoint(NavMeshBuilder *b, float x, float y, float z) {
+	return (Vector3) {
+		b->origin.x + x * NAVMESH_CELL_SIZE,
+		b->origin.y + y * NAVMESH_CELL_SIZE,
+		b->origin.z + z * NAVMESH_CELL_HEIGHT
+	};
+}
+
+void NavBuildPolys(NavMeshBuilder *b, NavMesh *mesh) {
+	u32 tile_count = b->tiles_x * b->tiles_y;
+
+	mesh->tile_first = malloc(sizeof(u32) * (tile_count + 1));
+
+	u32 total = 0;
+	for(u32 t = 0; t < tile_count; t++) {
+		mesh->tile_first[t] = total;
+		total += b->tile_rect_count[t];
+	}
+	mesh->tile_first[tile_count] = total;
+
+	if(total >= NAVMESH_NULL_POLY) {
+		MessageError("ERROR: Navmesh poly count exceeds limit", NULL);
+		total = NAVMESH_NULL_POLY - 1;
+	}
+
+	mesh->poly_count = total;
+	mesh->polys = calloc(total + 1, sizeof(NavPoly));
+
+	for(u32 t = 0; t < tile_count; t++) {
+		u32 base = mesh->tile_first[t];
+
+		for(u32 r = 0; r < b->tile_rect_count[t]; r++) {
+			if(base + r >= total)
+				break;
+
+			NavRect *rect = &b->tile_rects[t][r];
+			NavPoly *poly = &mesh->polys[base + r];
+
+			poly->verts[0] = NavCellPoint(b, rect->x0, rect->y0, rect->z[0]);
+			poly->verts[1] = NavCellPoint(b, rect->x1, rect->y0, rect->z[1]);
+			poly->verts[2] = NavCellPoint(b, rect->x1, rect->y1, rect->z[2]);
+			poly->verts[3] = NavCellPoint(b, rect->x0, rect->y1, rect->z[3]);
+
+			poly->center = Vector3Scale(Vector3Add(Vector3Add(poly->verts[0], poly->verts[1]), Vector3Add(poly->verts[2], poly->verts[3])), 0.25f);
+			poly->region = rect->region;
+		}
+
+		// Rect ids on spans are tile local until now
+		u16 cx0, cy0, cx1, cy1;
+		NavTileRange(b, t, &cx0, &cy0, &cx1, &cy1);
+
+		for(u16 y = cy0; y < cy1; y++) {
+			for(u16 x = cx0; x < cx1; x++) {
+				NavColumn *column = &b->columns[x + y * b->width];
+
+				for(u32 k = 0; k < column->count; k++) {
+					NavOpenSpan *s = &b->spans[column->first + k];
+					if(s->poly == NAVMESH_NULL_POLY)
+						continue;
+
+					s->poly = (base + s->poly < total) ? base + s->poly : NAVMESH_NULL_POLY;
+				}
+			}
+		}
+
+		free(b->tile_rects[t]);
+	}
+}
+
+void NavBuildLinks(NavMeshBuilder *b, NavMesh *mesh) {
+	u32 edge_cap = 1024;
+	u32 edge_count = 0;
+	NavPortalEdge *edges = malloc(sizeof(NavPortalEdge) * edge_cap);
+
+	// One edge per pair of connected cells in different polys, +x and +y only so each pair is seen once
+	for(u16 y = 0; y < b->height; y++) {
+		for(u16 x = 0; x < b->width; x++) {
+			NavColumn *column = &b->columns[x + y * b->width];
+
+			for(u32 k = 0; k < column->count; k++) {
+				u32 id = column->first + k;
+				NavOpenSpan *s = &b->spans[id];
+
+				if(s->poly == NAVMESH_NULL_POLY)
+					continue;
+
+				for(u8 axis = 0; axis < 2; axis++) {
+					u8 dir = (axis == 0) ? 2 : 1;
+
+					i32 n = NavNeighbour(b, x, y, id, dir);
+					if(n < 0)
+						continue;
+
+					u16 other = b->spans[n].poly;
+					if(other == NAVMESH_NULL_POLY || other == s->poly)
+						continue;
+
+					if(edge_count >= edge_cap) {
+						edge_cap = (edge_cap << 1);
+						edges = realloc(edges, sizeof(NavPortalEdge) * edge_cap);
+					}
+
+					float z = (s->floor + b->spans[n].floor) * 0.5f;
+
+					edges[edge_count++] = (NavPortalEdge) {
+						.poly_A = s->poly,
+						.poly_B = other,
+						.line = (axis == 0) ? x + 1 : y + 1,
+						.lo = (axis == 0) ? y : x,
+						.hi = (axis == 0) ? y + 1 : x + 1,
+						.z_lo = z,
+						.z_hi = z,
+						.axis = axis
+					};
+				}
+			}
+		}
+	}
+
+	qsort(edges, edge_count, sizeof(NavPortalEdge), NavPortalEdgeCompare);
+
+	// Merge runs of cell edges into single portals
+	u32 portal_count = 0;
+	for(u32 i = 0; i < edge_count; i++) {
+		NavPortalEdge *portal = &edges[portal_count];
+		NavPortalEdge *e = &edges[i];
+
+		if(i > 0 && portal->poly_A == e->poly_A && portal->poly_B == e->poly_B && portal->axis == e->axis) {
+			if(e->hi > portal->hi) {
+				portal->hi = e->hi;
+				portal->z_hi = e->z_hi;
+			}
+			continue;
+		}
+
+		if(i > 0)
+			portal = &edges[++portal_count];
+
+		*portal = *e;
+	}
+	if(edge_count)
+		portal_count++;
+
+	// Each portal links both ways
+	u16 *link_counts = calloc(mesh->poly_count + 1, sizeof(u16));
+	for(u32 i = 0; i < portal_count; i++) {
+		link_counts[edges[i].poly_A]++;
+		link_counts[edges[i].poly_B]++;
+	}
+
+	u32 total = 0;
+	for(u16 i = 0; i < mesh->poly_count; i++) {
+		mesh->polys[i].first_link = total;
+		mesh->polys[i].link_count = 0;
+		total += link_counts[i];
+	}
+
+	mesh->link_count = total;
+	mesh->links = malloc(sizeof(NavLink) * (total + 1));
+
+	for(u32 i = 0; i < portal_count; i++) {
+		NavPortalEdge *e = &edges[i];
+
+		Vector3 lo, hi;
+		if(e->axis == 0) {
+			lo = NavCellPoint(b, e->line, e->lo, e->z_lo);
+			hi = NavCellPoint(b, e->line, e->hi, e->z_hi);
+		} else {
+			lo = NavCellPoint(b, e->lo, e->line, e->z_lo);
+			hi = NavCellPoint(b, e->hi, e->line, e->z_hi);
+		}
+
+		NavPoly *poly_A = &mesh->polys[e->poly_A];
+		NavPoly *poly_B = &mesh->polys[e->poly_B];
+
+		// Leaving A towards +x the high end is on the left, towards +y the low end is
+		NavLink *link_A = &mesh->links[poly_A->first_link + poly_A->link_count++];
+		NavLink *link_B = &mesh->links[poly_B->first_link + poly_B->link_count++];
+
+		if(e->axis == 0) {
+			*link_A = (NavLink) { .left = hi, .right = lo, .poly = e->poly_B };
+			*link_B = (NavLink) { .left = lo, .right = hi, .poly = e->poly_A };
+		} else {
+			*link_A = (NavLink) { .left = lo, .right = hi, .poly = e->poly_B };
+			*link_B = (NavLink) { .left = hi, .right = lo, .poly = e->poly_A };
+		}
+	}
+
+	free(link_counts);
+	free(edges);
+}
+
+void NavMeshBuild(NavMesh *mesh, TriPool *tris) {
+	*mesh = (NavMesh) {0};
+
+	if(!tris->count)
+		return;
+
+	Vector3 min = tris->verts[0];
+	Vector3 max = tris->verts[0];
+	for(u32 i = 1; i < tris->vert_count; i++) {
+		min = Vector3Min(min, tris->verts[i]);
+		max = Vector3Max(max, tris->verts[i]);
+	}
+
+	Vector3 body = BODY_VOLUME_MEDIUM;
+
+	NavMeshBuilder b = {
+		.tris = tris,
+		.origin = min,
+		.width = ceilf((max.x - min.x) / NAVMESH_CELL_SIZE) + 1,
+		.height = ceilf((max.y - min.y) / NAVMESH_CELL_SIZE) + 1,
+		.climb = floorf(PM_STEP_Z / NAVMESH_CELL_HEIGHT),
+		.clearance = ceilf(body.z / NAVMESH_CELL_HEIGHT),
+		.radius = ceilf(body.x * 0.5f / NAVMESH_CELL_SIZE)
+	};
+
+	b.tiles_x = (b.width + NAVMESH_TILE_CELLS - 1) / NAVMESH_TILE_CELLS;
+	b.tiles_y = (b.height + NAVMESH_TILE_CELLS - 1) / NAVMESH_TILE_CELLS;
+
+	u32 tile_count = b.tiles_x * b.tiles_y;
+
+	b.tile_spans = calloc(tile_count, sizeof(NavOpenSpan*));
+	b.tile_counts = calloc(tile_count, sizeof(u8*));
+	b.tile_span_count = calloc(tile_count, sizeof(u32));
+	b.tile_rects = calloc(tile_count, sizeof(NavRect*));
+	b.tile_rect_count = calloc(tile_count, sizeof(u32));
+
+	NavMeshRunTiles(&b, NAV_STAGE_RASTER);
+
+	NavBuildColumns(&b);
+	NavBuildConnections(&b);
+	NavErode(&b);
+	mesh->region_count = NavBuildRegions(&b);
+
+	NavMeshRunTiles(&b, NAV_STAGE_RECTS);
+
+	mesh->origin = min;
+	mesh->tile_size = NAVMESH_TILE_CELLS * NAVMESH_CELL_SIZE;
+	mesh->tiles_x = b.tiles_x;
+	mesh->tiles_y = b.tiles_y;
+
+	NavBuildPolys(&b, mesh);
+	NavBuildLinks(&b, mesh);
+
+	free(b.tile_spans);
+	free(b.tile_counts);
+	free(b.tile_span_count);
+	free(b.tile_rects);
+	free(b.tile_rect_count);
+	free(b.columns);
+	free(b.spans);
+}
+
+void NavMeshClose(NavMesh *mesh) {
+	if(mesh->polys)
+		free(mesh->polys);
+
+	if(mesh->links)
+		free(mesh->links);
+
+	if(mesh->tile_first)
+		free(mesh->tile_first);
+
+	*mesh = (NavMesh) {0};
+}
+
+// Floor height at a point inside a poly, bilinear over corners
+float NavPolyHeight(NavPoly *poly, Vector3 point) {
+	float w = poly->verts[1].x - poly->verts[0].x;
+	float h = poly->verts[3].y - poly->verts[0].y;
+
+	float u = (w > 0) ? Clamp((point.x - poly->verts[0].x) / w, 0, 1) : 0;
+	float v = (h > 0) ? Clamp((point.y - poly->verts[0].y) / h, 0, 1) : 0;
+
+	float z0 = Lerp(poly->verts[0].z, poly->verts[1].z, u);
+	float z1 = Lerp(poly->verts[3].z, poly->verts[2].z, u);
+
+	return Lerp(z0, z1, v);
+}
+
+u16 NavMeshFindPoly(NavMesh *mesh, Vector3 point) {
+	if(!mesh->poly_count)
+		return NAVMESH_NULL_POLY;
+
+	i32 tx = floorf((point.x - mesh->origin.x) / mesh->tile_size);
+	i32 ty = floorf((point.y - mesh->origin.y) / mesh->tile_size);
+
+	if(tx < 0 || ty < 0 || tx >= mesh->tiles_x || ty >= mesh->tiles_y)
+		return NAVMESH_NULL_POLY;
+
+	u32 tile = tx + ty * mesh->tiles_x;
+
+	u16 best = NAVMESH_NULL_POLY;
+	float best_dist = FLT_MAX;
+
+	for(u32 i = mesh->tile_first[tile]; i < mesh->tile_first[tile + 1] && i < mesh->poly_count; i++) {
+		NavPoly *poly = &mesh->polys[i];
+
+		if(point.x < poly->verts[0].x || point.x > poly->verts[2].x) continue;
+		if(point.y < poly->verts[0].y || point.y > poly->verts[2].y) continue;
+
+		// Closest floor below point, allow a step of slack for points resting on the floor
+		float dist = point.z - NavPolyHeight(poly, point);
+		if(dist < -PM_STEP_Z)
+			continue;
+
+		dist = fabsf(dist);
+		if(dist < best_dist) {
+			best_dist = dist;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+// Signed area, positive when c is left of a->b seen from above
+float NavCross2(Vector3 a, Vector3 b, Vector3 c) {
+	return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+bool NavSamePoint2(Vector3 a, Vector3 b) {
+	float dx = a.x - b.x;
+	float dy = a.y - b.y;
+
+	return (dx * dx + dy * dy) < 0.0001f;
+}
+
+// Simple stupid funnel, portals include start and end as zero width portals
+u16 NavFunnel(Vector3 *lefts, Vector3 *rights, u16 portal_count, Vector3 *out, u16 max) {
+	if(!portal_count || !max)
+		return 0;
+
+	u16 count = 0;
+
+	Vector3 apex = lefts[0];
+	Vector3 left = lefts[0];
+	Vector3 right = rights[0];
+
+	u16 apex_id = 0, left_id = 0, right_id = 0;
+
+	out[count++] = apex;
+
+	for(u16 i = 1; i < portal_count && count < max; i++) {
+		Vector3 l = lefts[i];
+		Vector3 r = rights[i];
+
+		// Narrow right side
+		if(NavCross2(apex, right, r) >= 0) {
+			if(NavSamePoint2(apex, right) || NavCross2(apex, left, r) < 0) {
+				right = r;
+				right_id = i;
+
+			} else {
+				// Right crossed left, left is a corner
+				apex = left;
+				apex_id = left_id;
+				out[count++] = apex;
+
+				left = right = apex;
+				left_id = right_id = apex_id;
+
+				i = apex_id;
+				continue;
+			}
+		}
+
+		// Narrow left side
+		if(NavCross2(apex, left, l) <= 0) {
+			if(NavSamePoint2(apex, left) || NavCross2(apex, right, l) > 0) {
+				left = l;
+				left_id = i;
+
+			} else {
+				// Left crossed right, right is a corner
+				apex = right;
+				apex_id = right_id;
+				out[count++] = apex;
+
+				left = right = apex;
+				left_id = right_id = apex_id;
+
+				i = apex_id;
+				continue;
+			}
+		}
+	}
+
+	Vector3 end = lefts[portal_count - 1];
+	if(count < max && !NavSamePoint2(out[count - 1], end))
+		out[count++] = end;
+
+	return count;
+}
+
+u16 NavMeshFindPath(NavMesh *mesh, NavSearch *search, Vector3 start, Vector3 end, Vector3 *out, u16 max) {
+	if(max < 2)
+		return 0;
+
+	u16 start_poly = NavMeshFindPoly(mesh, start);
+	u16 end_poly = NavMeshFindPoly(mesh, end);
+
+	if(start_poly == NAVMESH_NULL_POLY || end_poly == NAVMESH_NULL_POLY)
+		return 0;
+
+	NavSearchBeginEx(search, mesh->poly_count, start_poly, end_poly, mesh->polys[start_poly].center, end);
+
+	bool found = false;
+	while(true) {
+		i32 curr = NavSearchPop(search);
+		if(curr == NAV_NULL_NODE)
+			break;
+
+		if(curr == end_poly) {
+			found = true;
+			break;
+		}
+
+		NavPoly *poly = &mesh->polys[curr];
+
+		for(u16 i = 0; i < poly->link_count; i++) {
+			NavLink *link = &mesh->links[poly->first_link + i];
+			NavPoly *next = &mesh->polys[link->poly];
+
+			NavSearchRelax(search, curr, link->poly, Vector3Distance(poly->center, next->center), next->center);
+		}
+	}
+
+	search->status = (found) ? NAV_SEARCH_FOUND : NAV_SEARCH_FAILED;
+	if(!found)
+		return 0;
+
+	// Corridor from start, if it's too long walk towards its last poly instead of the goal
+	u16 corridor[NAVMESH_MAX_CORRIDOR];
+	u16 corridor_count = NavSearchExtractPathFront(search, corridor, NAVMESH_MAX_CORRIDOR);
+
+	if(corridor[corridor_count - 1] != end_poly)
+		end = mesh->polys[corridor[corridor_count - 1]].center;
+
+	Vector3 lefts[NAVMESH_MAX_CORRIDOR + 1];
+	Vector3 rights[NAVMESH_MAX_CORRIDOR + 1];
+	u16 portal_count = 0;
+
+	lefts[portal_count] = rights[portal_count] = start;
+	portal_count++;
+
+	for(u16 i = 0; i + 1 < corridor_count; i++) {
+		NavPoly *poly = &mesh->polys[corridor[i]];
+
+		for(u16 j = 0; j < poly->link_count; j++) {
+			NavLink *link = &mesh->links[poly->first_link + j];
+			if(link->poly != corridor[i + 1])
+				continue;
+
+			lefts[portal_count] = link->left;
+			rights[portal_count] = link->right;
+			portal_count++;
+			break;
+		}
+	}
+
+	lefts[portal_count] = rights[portal_count] = end;
+	portal_count++;
+
+	return NavFunnel(lefts, rights, portal_count, out, max);
+}
+
+void NavMeshDraw(NavMesh *mesh) {
+	Vector3 lift = { 0, 0, 1 };
+
+	for(u16 i = 0; i < mesh->poly_count; i++) {
+		NavPoly *poly = &mesh->polys[i];
+
+		for(u8 j = 0; j < 4; j++) {
+			Vector3 a = Vector3Add(poly->verts[j], lift);
+			Vector3 b = Vector3Add(poly->verts[(j + 1) % 4], lift);
+			DrawLine3D(a, b, ColorAlpha(SKYBLUE, 0.5f));
+		}
+	}
+
+	for(u32 i = 0; i < mesh->link_count; i++) {
+		NavLink *link = &mesh->links[i];
+		DrawLine3D(Vector3Add(link->left, lift), Vector3Add(link->right, lift), ORANGE);
+	}
+}
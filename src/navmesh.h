@@ -0,0 +1,23 @@
+#include "raylib.h"
+#include "../include/num_redefs.h"
+#include "geo.h"
+#include "nav.h"
+
+#ifndef NAVMESH_H_
+#define NAVMESH_H_
+
+// Generate navmesh from an unexpanded tri pool
+void NavMeshBuild(NavMesh *mesh, TriPool *tris);
+
+void NavMeshClose(NavMesh *mesh);
+
+// Find poly under a point, returns NAVMESH_NULL_POLY if point is off the mesh
+u16 NavMeshFindPoly(NavMesh *mesh, Vector3 point);
+
+// Find path between two points, A* over polys then funnel string-pulling.
+// Writes corner points into out, including start and end. Returns point count, 0 if no path
+u16 NavMeshFindPath(NavMesh *mesh, NavSearch *search, Vector3 start, Vector3 end, Vector3 *out, u16 max);
+
+void NavMeshDraw(NavMesh *mesh);
+
+#endif
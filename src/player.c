@@ -49,6 +49,7 @@ EntityHandler *ptr_ent_handler;
 void PlayerInput(Entity *player, InputHandler *input, float dt);
 
 float cam_bob, cam_tilt;
+float cam_time = 0;
 
 BoxPoints box_points;
 
@@ -71,11 +72,82 @@ i16 player_curr_checkpoint = -1;
 
 bool step_frame = false;
 
+// Globals carried in world snapshots
+typedef struct {
+	pmTraceData last_pm;
+
+	float player_accel;
+	float player_accel_forward;
+	float player_accel_side;
+
+	float z_vel_prev;
+	float cam_bob, cam_tilt, cam_time;
+	float cam_input_forward, cam_input_side;
+	float death_timer;
+
+	i16 curr_checkpoint;
+
+	bool player_dead;
+	bool hurt_frame;
+	bool land_frame;
+	bool step_frame;
+
+} PlayerState;
+
+u32 PlayerStateSize() {
+	return sizeof(PlayerState);
+}
+
+void PlayerStateSave(void *out) {
+	PlayerState state = {
+		.last_pm = last_pm,
+		.player_accel = player_accel,
+		.player_accel_forward = player_accel_forward,
+		.player_accel_side = player_accel_side,
+		.z_vel_prev = z_vel_prev,
+		.cam_bob = cam_bob,
+		.cam_tilt = cam_tilt,
+		.cam_time = cam_time,
+		.cam_input_forward = cam_input_forward,
+		.cam_input_side = cam_input_side,
+		.death_timer = death_timer,
+		.curr_checkpoint = player_curr_checkpoint,
+		.player_dead = player_dead,
+		.hurt_frame = hurt_frame,
+		.land_frame = land_frame,
+		.step_frame = step_frame
+	};
+
+	memcpy(out, &state, sizeof(PlayerState));
+}
+
+void PlayerStateLoad(void *in) {
+	PlayerState state;
+	memcpy(&state, in, sizeof(PlayerState));
+
+	last_pm = state.last_pm;
+	player_accel = state.player_accel;
+	player_accel_forward = state.player_accel_forward;
+	player_accel_side = state.player_accel_side;
+	z_vel_prev = state.z_vel_prev;
+	cam_bob = state.cam_bob;
+	cam_tilt = state.cam_tilt;
+	cam_time = state.cam_time;
+	cam_input_forward = state.cam_input_forward;
+	cam_input_side = state.cam_input_side;
+	death_timer = state.death_timer;
+	player_curr_checkpoint = state.curr_checkpoint;
+	player_dead = state.player_dead;
+	hurt_frame = state.hurt_frame;
+	land_frame = state.land_frame;
+	step_frame = state.step_frame;
+}
+
 // **
 // -----------------------------------------------------------------------------
 
 void pm_TraceMoveEx(Entity *ent, Vector3 start, Vector3 wish_vel, pmTraceData *pm, float dt, EntityHandler *handler) {
-	comp_Transform *ct = &ent->comp_transform;
+	comp_Transform *ct = ent->comp_transform;
 
 	Bsp_Hull *bsp = &ptr_sect->bsp[1];
 	EntGrid *grid = &handler->grid;
@@ -175,53 +247,58 @@ void PlayerInit(Camera3D *camera, InputHandler *input, MapSection *test_section,
 	player_debug_data = debug_data;
 }
 
+InputHandler *PlayerGetInput() {
+	return ptr_input;
+}
+
 void PlayerUpdate(Entity *player, float dt) {
-	player->comp_transform.bounds = BoxTranslate(player->comp_transform.bounds, player->comp_transform.position);
+	player->comp_transform->bounds = BoxTranslate(player->comp_transform->bounds, player->comp_transform->position);
+	EntGridMarkDirty(&ptr_ent_handler->grid, player->id);
 	land_frame = false;
 
-	if(player->comp_health.damage_cooldown <= 0)
+	if(player->comp_health->damage_cooldown <= 0)
 		hurt_frame = false;
 
-	player_dead = (player->comp_health.amount <= 0);
+	player_dead = (player->comp_health->amount <= 0);
 	if(player_dead)	{
-		player->comp_ai.state = STATE_DEAD;
+		player->comp_ai->state = STATE_DEAD;
 		
 		death_timer += dt;
 
 		if(death_timer > 3) 
 			death_timer = 3;
 
-		player->comp_ai.task_data.timer = death_timer;
+		player->comp_ai->task_data.timer = death_timer;
 	}
 
 	if(!player_dead) {
-		ptr_cam->position.x = player->comp_transform.position.x;
-		ptr_cam->position.y = player->comp_transform.position.y;
+		ptr_cam->position.x = player->comp_transform->position.x;
+		ptr_cam->position.y = player->comp_transform->position.y;
 
 		if(!step_frame) {
-			//ptr_cam->position.z = Lerp(ptr_cam->position.z, player->comp_transform.position.z + 12, dt * 100);
-			ptr_cam->position.z = player->comp_transform.position.z + 12;
+			//ptr_cam->position.z = Lerp(ptr_cam->position.z, player->comp_transform->position.z + 12, dt * 100);
+			ptr_cam->position.z = player->comp_transform->position.z + 12;
 		} else {
-			ptr_cam->position.z = Lerp(ptr_cam->position.z, player->comp_transform.position.z + 12, dt * 17.5f);
-			if(fabsf(ptr_cam->position.z - (player->comp_transform.position.z + 12)) <= 0.75f) 
+			ptr_cam->position.z = Lerp(ptr_cam->position.z, player->comp_transform->position.z + 12, dt * 17.5f);
+			if(fabsf(ptr_cam->position.z - (player->comp_transform->position.z + 12)) <= 0.75f) 
 				step_frame = false;
 		}
 
 	}
 
 	// Update position + velocity
-	pm_Move(player, &player->comp_transform, ptr_input, ptr_ent_handler, dt);
+	pm_Move(player, player->comp_transform, ptr_input, ptr_ent_handler, dt);
 	if(land_frame) {
 		//printf("land frame!\n");
-		if(z_vel_prev < -FALLDAMAGE_THRESHOLD) player->comp_health.amount -= (short)(z_vel_prev * FALLDAMAGE_MULTIPLIER);
+		if(z_vel_prev < -FALLDAMAGE_THRESHOLD) player->comp_health->amount -= (short)(z_vel_prev * FALLDAMAGE_MULTIPLIER);
 	}
 
-	player->comp_health.damage_cooldown -= dt;
+	player->comp_health->damage_cooldown -= dt;
 
 	if(!player_dead)
-		cam_Adjust(&player->comp_transform, dt);
+		cam_Adjust(player->comp_transform, dt);
 
-	if(!player->comp_transform.on_ground)
+	if(!player->comp_transform->on_ground)
 		step_frame = false;
 }
 
@@ -236,12 +313,12 @@ void PlayerDie(Entity *player) {
 }
 
 void PlayerDisplayDebugInfo(Entity *player) {
-	DrawBoundingBox(player->comp_transform.bounds, RED);
-	DrawSphere(player->comp_transform.position, 1, RED);
+	DrawBoundingBox(player->comp_transform->bounds, RED);
+	DrawSphere(player->comp_transform->position, 1, RED);
 
-	//DrawCubeV(player->comp_transform.position, Vector3Scale(BODY_VOLUME_MEDIUM, 1), LIGHTGRAY);
+	//DrawCubeV(player->comp_transform->position, Vector3Scale(BODY_VOLUME_MEDIUM, 1), LIGHTGRAY);
 
-	Ray view_ray = (Ray) { .position = ptr_cam->position, .direction = player->comp_transform.forward };	
+	Ray view_ray = (Ray) { .position = ptr_cam->position, .direction = player->comp_transform->forward };	
 	player_debug_data->view_dest = Vector3Add(view_ray.position, Vector3Scale(view_ray.direction, FLT_MAX * 0.25f));	
 
 	player_debug_data->view_length = FLT_MAX;
@@ -251,10 +328,10 @@ void PlayerDisplayDebugInfo(Entity *player) {
 	//BvhTracePointEx(view_ray, ptr_sect, &ptr_sect->bvh[1], 0, &tr, FLT_MAX);
 
 	if(tr.hit) {
-		DrawLine3D(player->comp_transform.position, tr.point, SKYBLUE);
+		DrawLine3D(player->comp_transform->position, tr.point, SKYBLUE);
 		
 		BvhNode *node = &ptr_sect->bvh[1].nodes[tr.node_id];
-		//u16 hull_id = ptr_sect->bvh[1].tris.arr[tr.tri_id].hull_id;
+		//u16 hull_id = ptr_sect->bvh[1].tris->arr[tr.tri_id].hull_id;
 		//u16 hull_id = tr.hull_id;
 
 		//DrawBoundingBox(ptr_sect->_hulls[1].arr[hull_id].aabb, SKYBLUE);
@@ -265,14 +342,14 @@ void PlayerDisplayDebugInfo(Entity *player) {
 
 	/*
 	if(tr.hit) {
-		Tri *tri = &ptr_sect->bvh[0].tris.arr[tr.tri_id];
-		DrawTriangle3D(tri->vertices[0], tri->vertices[1], tri->vertices[2], ColorAlpha(SKYBLUE, 0.25f));
-		DrawTriangle3D(tri->vertices[2], tri->vertices[1], tri->vertices[0], ColorAlpha(SKYBLUE, 0.25f));
+		Tri tri = TriPoolGet(ptr_sect->bvh[0].tris, tr.tri_id);
+		DrawTriangle3D(tri.vertices[0], tri.vertices[1], tri.vertices[2], ColorAlpha(SKYBLUE, 0.25f));
+		DrawTriangle3D(tri.vertices[2], tri.vertices[1], tri.vertices[0], ColorAlpha(SKYBLUE, 0.25f));
 	}
 	*/
 
 	// Draw box points
-	box_points = BoxGetPoints(player->comp_transform.bounds);
+	box_points = BoxGetPoints(player->comp_transform->bounds);
 	for(short i = 0; i < 8; i++) {
 		DrawSphere(box_points.v[i], 2, RED);
 	}
@@ -280,18 +357,18 @@ void PlayerDisplayDebugInfo(Entity *player) {
 	player_debug_data->accel = player_accel;
 
 	/*
-	Ray rayX = (Ray) { .position = player->comp_transform.bounds.min, .direction = (Vector3) {1, 0, 0} };
-	Ray rayY = (Ray) { .position = player->comp_transform.bounds.min, .direction = (Vector3) {0, 1, 0} };
-	Ray rayZ = (Ray) { .position = player->comp_transform.bounds.min, .direction = (Vector3) {0, 0, 1} };
+	Ray rayX = (Ray) { .position = player->comp_transform->bounds.min, .direction = (Vector3) {1, 0, 0} };
+	Ray rayY = (Ray) { .position = player->comp_transform->bounds.min, .direction = (Vector3) {0, 1, 0} };
+	Ray rayZ = (Ray) { .position = player->comp_transform->bounds.min, .direction = (Vector3) {0, 0, 1} };
 	DrawRay(rayX, RED);
 	DrawRay(rayY, GREEN);
 	DrawRay(rayZ, SKYBLUE);
 	*/
 
-	Ray vel_ray = (Ray) { .position = player->comp_transform.position, .direction = Vector3Normalize(debug_vel_full) };
+	Ray vel_ray = (Ray) { .position = player->comp_transform->position, .direction = Vector3Normalize(debug_vel_full) };
 	DrawRay(vel_ray, RAYWHITE);
 
-	Ray clip_ray = (Ray) { .position = player->comp_transform.position, .direction = Vector3Normalize(debug_vel_clipped) };
+	Ray clip_ray = (Ray) { .position = player->comp_transform->position, .direction = Vector3Normalize(debug_vel_clipped) };
 	DrawRay(clip_ray, GREEN);
 }
 
@@ -353,7 +430,10 @@ void pm_Move(Entity *ent, comp_Transform *ct, InputHandler *input, EntityHandler
 	ct->on_ground = pm_CheckGround(ct, ct->position);
 
 	for(u16 i = 0; i < handler->checkpoint_list.count; i++) {
-		if(ent->cell_id == handler->checkpoint_list.cells[i] && fabsf(ct->position.z - handler->checkpoint_list.points[i].z) <= 32) {
+		// Fixed size, not tied to the entity grid whose cells are tuned per map
+		Vector3 offset = Vector3Subtract(ct->position, handler->checkpoint_list.points[i]);
+
+		if(fabsf(offset.x) <= CHECKPOINT_SIZE * 0.5f && fabsf(offset.y) <= CHECKPOINT_SIZE * 0.5f && fabsf(offset.z) <= CHECKPOINT_HEIGHT) {
 			player_curr_checkpoint = i;
 			handler->checkpoint_list.active = player_curr_checkpoint;
 			break;
@@ -787,8 +867,8 @@ int pm_CheckHullEx(Vector3 point, u16 node_id) {
 
 	BvhNode *node = &ptr_sect->bvh[1].nodes[node_id];
 	for(u16 i = 0; i < node->tri_count; i++) {
-		u16 tri_id = ptr_sect->bvh->tris.ids[node->first_tri + i];
-		Tri tri = ptr_sect->bvh[1].tris.arr[tri_id];
+		u16 tri_id = ptr_sect->bvh[1].tri_ids[node->first_tri + i];
+		Tri tri = TriPoolGet(ptr_sect->bvh[1].tris, tri_id);
 
 		Plane pl = TriToPlane(tri);
 		float dist = Vector3DotProduct(pl.normal, point) - pl.d;
@@ -812,7 +892,9 @@ int pm_CheckHullEx(Vector3 point, u16 node_id) {
 #define TILT_MAX 0.1f
 void cam_Adjust(comp_Transform *ct, float dt) {
 	// Apply camera motion effects (bob, tilt) 
-	float t = GetTime();
+	// Bob follows simulation time, so a replayed step does the same thing it did live
+	cam_time += dt;
+	float t = cam_time;
 
 	// * NOTE:
 	// okay for now...
@@ -855,7 +937,7 @@ void cam_Adjust(comp_Transform *ct, float dt) {
 }
 
 void PlayerDebugText(Entity *player) {
-	comp_Transform *ct = &player->comp_transform;
+	comp_Transform *ct = player->comp_transform;
 
 	Rectangle rect = (Rectangle) { 
 		.x = 0,
@@ -869,7 +951,7 @@ void PlayerDebugText(Entity *player) {
 	DrawText(TextFormat("on_ground: %d", ct->on_ground), 16, 900, 24, RAYWHITE);
 	DrawText(TextFormat("ground_norm: { %f, %f, %f }", ct->ground_normal.x, ct->ground_normal.y, ct->ground_normal.z), 16, 930, 24, RAYWHITE);
 	DrawText(TextFormat("cell_id: %d", player->cell_id), 16, 960, 24, RAYWHITE);
-	DrawText(TextFormat("graph_id: %d", player->comp_ai.navgraph_id), 16, 990, 24, RAYWHITE);
+	DrawText(TextFormat("graph_id: %d", player->comp_ai->navgraph_id), 16, 990, 24, RAYWHITE);
 	DrawText(TextFormat("checkpoint: %d", player_curr_checkpoint), 16, 1020, 24, RAYWHITE);
 	//DrawText(TextFormat("in hull norm: { %f, %f, %f }", dbg_hull_norm.x, dbg_hull_norm.y, dbg_hull_norm.z), 16, 1020, 24, RAYWHITE);
 }
@@ -901,8 +983,8 @@ void pm_AirFriction(comp_Transform *ct, float dt) {
 }
 
 void OnHitPlayer(Entity *ent, short damage) {
-	comp_Health *health = &ent->comp_health;
-	comp_Transform *ct = &ent->comp_transform;
+	comp_Health *health = ent->comp_health;
+	comp_Transform *ct = ent->comp_transform;
 
 	ct->velocity.x *= (0.5f);
 	ct->velocity.y *= (0.5f);
@@ -913,19 +995,19 @@ void OnHitPlayer(Entity *ent, short damage) {
 void SpawnPlayer(Entity *ent, Vector3 position) {
 	player_curr_checkpoint = -1;
 
-	ent->comp_transform.position = position;
-	ent->comp_transform.position.z += 20;
+	ent->comp_transform->position = position;
+	ent->comp_transform->position.z += 20;
 
-	ent->comp_transform.bounds.max = Vector3Scale(BODY_VOLUME_MEDIUM,  0.5f);
-	ent->comp_transform.bounds.min = Vector3Scale(BODY_VOLUME_MEDIUM, -0.5f);
-	ent->comp_transform.on_ground = true;
+	ent->comp_transform->bounds.max = Vector3Scale(BODY_VOLUME_MEDIUM,  0.5f);
+	ent->comp_transform->bounds.min = Vector3Scale(BODY_VOLUME_MEDIUM, -0.5f);
+	ent->comp_transform->on_ground = true;
 
-	ent->comp_health.amount = 100;
-	ent->comp_health.on_hit = -1;
+	ent->comp_health->amount = 100;
+	ent->comp_health->on_hit = -1;
 
-	ent->comp_ai.component_valid = false;
-	ent->comp_ai.state = STATE_IDLE;
-	ent->comp_ai.task_data.timer = 0;
+	ent->comp_ai->component_valid = false;
+	ent->comp_ai->state = STATE_IDLE;
+	ent->comp_ai->task_data.timer = 0;
 
 	ent->flags = (ENT_ACTIVE | ENT_COLLIDERS);
 
@@ -39,6 +39,7 @@ typedef struct {
 	MapSection *sect;
 	Entity *player;
 	vEffect_Manager *effect_manager;
+	InputHandler *input;
 
 } PlayerGunRefs;
 PlayerGunRefs gun_refs = {0};
@@ -69,7 +70,7 @@ comp_Weapon weapons[] = {
 Model models[4];
 Matrix gun_matrix;
 
-void PlayerGunInit(PlayerGun *player_gun, Entity *player, EntityHandler *handler, MapSection *sect, vEffect_Manager *effect_manager) {
+void PlayerGunInit(PlayerGun *player_gun, Entity *player, EntityHandler *handler, MapSection *sect, vEffect_Manager *effect_manager, InputHandler *input) {
 	player_gun->cam = (Camera3D) {
 		.position = (Vector3) { 0, 0, -1 },
 		.target = (Vector3) { 0, 0, 1 },
@@ -98,35 +99,42 @@ void PlayerGunInit(PlayerGun *player_gun, Entity *player, EntityHandler *handler
 	gun_refs.sect = sect;
 	gun_refs.handler = handler;
 	gun_refs.effect_manager = effect_manager;
+	gun_refs.input = input;
 
-	//player->comp_weapon.id = WEAP_DISRUPTOR;
+	//player->comp_weapon->id = WEAP_DISRUPTOR;
 	player_gun->current_gun = WEAP_DISRUPTOR;
 
 	player_gun->model = models[player_gun->current_gun];
 	mat = player_gun->model.transform;
 }
 
+// Latched by the input handler, a click between steps still fires once
+static bool PlayerGunTriggered() {
+	return (gun_refs.input->actions[ACTION_SHOOT].state == INPUT_PRESSED);
+}
+
 void PlayerGunUpdate(PlayerGun *player_gun, float dt) {
+	InputHandler *input = gun_refs.input;
 	int scroll = 0;
 
 	if(USE_MWHEEL)
-		scroll = GetMouseWheelMove();
+		scroll = input->mouse_wheel;
 
-	if(IsKeyPressed(KEY_Q)) 
+	if(input->actions[ACTION_PREV_WEAPON].state == INPUT_PRESSED) 
 		scroll = -1;
 
-	if(IsKeyPressed(KEY_E))
+	if(input->actions[ACTION_NEXT_WEAPON].state == INPUT_PRESSED)
 		scroll = +1;
 
 	int next_gun = player_gun->current_gun + scroll;
 	player_gun->current_gun = (next_gun % 2 == 0) ? WEAP_DISRUPTOR : WEAP_REVOLVER;
-	gun_refs.player->comp_weapon = weapons[player_gun->current_gun];
+	*gun_refs.player->comp_weapon = weapons[player_gun->current_gun];
 
-	//gun_refs.player->comp_weapon.id = (gun_refs.player->comp_weapon.id + scroll) % 2;
-	//player_gun->current_gun = gun_refs.player->comp_weapon.id;
-	//gun_refs.player->comp_weapon = weapons[gun_refs.player->comp_weapon.id];
+	//gun_refs.player->comp_weapon->id = (gun_refs.player->comp_weapon->id + scroll) % 2;
+	//player_gun->current_gun = gun_refs.player->comp_weapon->id;
+	//*gun_refs.player->comp_weapon = weapons[gun_refs.player->comp_weapon->id];
 
-	if(gun_refs.player->comp_ai.state == STATE_DEAD)
+	if(gun_refs.player->comp_ai->state == STATE_DEAD)
 		return;
 
 	switch(player_gun->current_gun) {
@@ -159,7 +167,7 @@ void PlayerGunUpdatePistol(PlayerGun *player_gun, float dt) {
 	recoil -= (recoil * friction) * dt; 
 	if(recoil <= -EPSILON) recoil = 0;
 
-	if(IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && recoil <= 0.9f) {
+	if(PlayerGunTriggered() && recoil <= 0.9f) {
 		PlayerShootPistol(player_gun, gun_refs.handler, gun_refs.sect);
 
 		recoil_add = false;
@@ -185,7 +193,7 @@ void PlayerGunUpdateRevolver(PlayerGun *player_gun, float dt) {
 	recoil -= (recoil * friction) * dt; 
 	if(recoil <= -EPSILON) recoil = 0;
 
-	if(IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && recoil <= 1.0f) {
+	if(PlayerGunTriggered() && recoil <= 1.0f) {
 		PlayerShootRevolver(player_gun, gun_refs.handler, gun_refs.sect);
 
 		recoil_add = false;
@@ -204,7 +212,7 @@ void PlayerGunUpdateDisruptor(PlayerGun *player_gun, float dt) {
 	mat = MatrixRotateX(-DISRUPTOR_REST_ANGLE_REST * DEG2RAD);
 	mat = MatrixMultiply(mat, MatrixRotateY(DISRUPTOR_REST_ANGLE_REST * DEG2RAD));
 
-	if(IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
+	if(PlayerGunTriggered()) {
 		PlayerShoot(player_gun, gun_refs.handler, gun_refs.sect);
 	}
 
@@ -213,14 +221,14 @@ void PlayerGunUpdateDisruptor(PlayerGun *player_gun, float dt) {
 }
 
 void PlayerGunDraw(PlayerGun *player_gun) {
-	if(gun_refs.player->comp_ai.state == STATE_DEAD)
+	if(gun_refs.player->comp_ai->state == STATE_DEAD)
 		return;
 
 	Entity *bug_ent = &gun_refs.handler->ents[gun_refs.handler->bug_id];
 	bool skip_draw = false;
 
 	if(player_gun->current_gun == WEAP_DISRUPTOR) {
-		if(bug_ent->comp_ai.state > 0) {
+		if(bug_ent->comp_ai->state > 0) {
 			skip_draw = true;
 		}
 	}
@@ -235,7 +243,7 @@ void PlayerGunDraw(PlayerGun *player_gun) {
 		EndMode3D();
 	}
 
-	DrawText(TextFormat("_H_%d", gun_refs.player->comp_health.amount), 64, 980, 80, ColorAlpha(SKYBLUE, 0.95f));	
+	DrawText(TextFormat("_H_%d", gun_refs.player->comp_health->amount), 64, 980, 80, ColorAlpha(SKYBLUE, 0.95f));	
 }
 
 void PlayerShoot(PlayerGun *player_gun, EntityHandler *handler, MapSection *sect) {
@@ -259,7 +267,7 @@ void PlayerShoot(PlayerGun *player_gun, EntityHandler *handler, MapSection *sect
 }
 
 void PlayerShootPistol(PlayerGun *player_gun, EntityHandler *handler, MapSection *sect) {
-	comp_Transform *ct = &gun_refs.player->comp_transform;
+	comp_Transform *ct = gun_refs.player->comp_transform;
 
 	Vector3 trace_start = ct->position;
 	trace_start.z -= 4;
@@ -307,7 +315,7 @@ void PlayerShootShotgun(PlayerGun *player_gun, EntityHandler *handler, MapSectio
 }
 
 void PlayerShootRevolver(PlayerGun *player_gun, EntityHandler *handler, MapSection *sect) {
-	comp_Transform *ct = &gun_refs.player->comp_transform;
+	comp_Transform *ct = gun_refs.player->comp_transform;
 
 	Vector3 trace_start = ct->position;
 	trace_start.z += 12;
@@ -344,8 +352,8 @@ void PlayerShootDisruptor(PlayerGun *player_gun, EntityHandler *handler, MapSect
 	Entity *bug_ent = &handler->ents[handler->bug_id];
 	Entity *player_ent = &handler->ents[handler->player_id];
 
-	comp_Ai *ai = &bug_ent->comp_ai;
-	comp_Transform *ct = &bug_ent->comp_transform;
+	comp_Ai *ai = bug_ent->comp_ai;
+	comp_Transform *ct = bug_ent->comp_transform;
 
 	if(ai->state > 0) 
 		return;
@@ -354,10 +362,10 @@ void PlayerShootDisruptor(PlayerGun *player_gun, EntityHandler *handler, MapSect
 	bug_ent->flags = ENT_ACTIVE;
 	bug_ent->flags |= ENT_COLLIDERS;
 
-	ct->position = player_ent->comp_transform.position;
+	ct->position = player_ent->comp_transform->position;
 	ct->position.z += 10;
 
-	ct->forward = player_ent->comp_transform.forward;
+	ct->forward = player_ent->comp_transform->forward;
 	
 	ct->position = Vector3Add(ct->position, Vector3Scale(ct->forward, 10));
 
@@ -377,11 +385,11 @@ void PlayerShootDisruptor(PlayerGun *player_gun, EntityHandler *handler, MapSect
 		ct->velocity.z += 250;
 	}
 
-	if(Vector3DotProduct(player_ent->comp_transform.velocity, ct->forward) > 0)
-		ct->velocity = Vector3Add(ct->velocity, Vector3Scale(ct->forward, Vector3Length(player_ent->comp_transform.velocity) * 0.5f));
+	if(Vector3DotProduct(player_ent->comp_transform->velocity, ct->forward) > 0)
+		ct->velocity = Vector3Add(ct->velocity, Vector3Scale(ct->forward, Vector3Length(player_ent->comp_transform->velocity) * 0.5f));
 
 	float angle = atan2f(-ct->forward.x, -ct->forward.y);
-	bug_ent->model.transform = MatrixRotateY(angle);
-	bug_ent->model.transform = MatrixMultiply(bug_ent->model.transform, MatrixRotateX(90*DEG2RAD));
+	bug_ent->comp_render->model.transform = MatrixRotateY(angle);
+	bug_ent->comp_render->model.transform = MatrixMultiply(bug_ent->comp_render->model.transform, MatrixRotateX(90*DEG2RAD));
 }
 
@@ -2,6 +2,7 @@
 #include "raylib.h"
 #include "ent.h"
 #include "v_effect.h"
+#include "input_handler.h"
 
 #ifndef PLAYER_GUN_H_
 #define PLAYER_GUN_H_
@@ -15,7 +16,9 @@ typedef struct {
 
 } PlayerGun;
 
-void PlayerGunInit(PlayerGun *player_gun, Entity *player, EntityHandler *handler, MapSection *sect, vEffect_Manager *effect_manager);
+void PlayerGunInit(PlayerGun *player_gun, Entity *player, EntityHandler *handler, MapSection *sect, vEffect_Manager *effect_manager, InputHandler *input);
+
+// Switching, recoil and firing, call once per simulation step before input is consumed
 void PlayerGunUpdate(PlayerGun *player_gun, float dt);
 void PlayerGunDraw(PlayerGun *player_gun);
 void PlayerShoot(PlayerGun *player_gun, EntityHandler *handler, MapSection *sect);
@@ -0,0 +1,267 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "raylib.h"
+#include "raymath.h"
+#include "replay.h"
+#include "geo.h"
+
+// Replay counts as a match when the player ends up this close to the recorded end
+#define REPLAY_MATCH_DIST 0.01f
+
+void ReplayRecordBegin(InputRecording *rec, Entity *player, char *map_path) {
+	ReplayFree(rec);
+
+	rec->header = (ReplayHeader) {
+		.magic = REPLAY_MAGIC,
+		.version = REPLAY_VERSION,
+		.tick_size = sizeof(ReplayTick),
+		.player_state_size = PlayerStateSize(),
+		.health_size = sizeof(comp_Health),
+		.start = *player->comp_transform,
+		.start_health = *player->comp_health
+	};
+	strncpy(rec->header.map_path, map_path, sizeof(rec->header.map_path) - 1);
+
+	rec->player_state = malloc(rec->header.player_state_size);
+	PlayerStateSave(rec->player_state);
+
+	rec->tick_capacity = 1024;
+	rec->ticks = malloc(sizeof(ReplayTick) * rec->tick_capacity);
+
+	rec->recording = true;
+}
+
+void ReplayRecordTick(InputRecording *rec, InputHandler *input, float dt) {
+	if(!rec->recording)
+		return;
+
+	if(rec->tick_count >= rec->tick_capacity) {
+		rec->tick_capacity = (rec->tick_capacity << 1);
+		rec->ticks = realloc(rec->ticks, sizeof(ReplayTick) * rec->tick_capacity);
+	}
+
+	ReplayTick tick = (ReplayTick) { .mouse_delta = input->mouse_delta, .dt = dt };
+	for(u8 i = 0; i < INPUT_ACTION_COUNT; i++)
+		tick.action_states |= ((u32)(input->actions[i].state & 0x03) << (i * 2));
+
+	rec->ticks[rec->tick_count++] = tick;
+}
+
+bool ReplayRecordEnd(InputRecording *rec, Entity *player, char *path) {
+	if(!rec->recording)
+		return false;
+
+	rec->recording = false;
+	rec->header.tick_count = rec->tick_count;
+	rec->header.end = *player->comp_transform;
+
+	FILE *pF = fopen(path, "wb");
+	if(!pF) {
+		printf("ERROR: Could not open %s for writing\n", path);
+		return false;
+	}
+
+	fwrite(&rec->header, sizeof(ReplayHeader), 1, pF);
+	fwrite(rec->player_state, rec->header.player_state_size, 1, pF);
+	fwrite(rec->ticks, sizeof(ReplayTick), rec->tick_count, pF);
+	fclose(pF);
+
+	return true;
+}
+
+bool ReplayLoad(InputRecording *rec, char *path) {
+	ReplayFree(rec);
+
+	FILE *pF = fopen(path, "rb");
+	if(!pF) {
+		printf("ERROR: Could not open replay %s\n", path);
+		return false;
+	}
+
+	ReplayHeader *header = &rec->header;
+	bool valid =
+		fread(header, sizeof(ReplayHeader), 1, pF) == 1 &&
+		header->magic == REPLAY_MAGIC &&
+		header->version == REPLAY_VERSION &&
+		header->tick_size == sizeof(ReplayTick) &&
+		header->player_state_size == PlayerStateSize() &&
+		header->health_size == sizeof(comp_Health);
+
+	if(!valid) {
+		printf("ERROR: %s is not a replay or is from another version (expected version %d)\n", path, REPLAY_VERSION);
+		fclose(pF);
+		return false;
+	}
+
+	rec->player_state = malloc(header->player_state_size);
+	rec->ticks = malloc(sizeof(ReplayTick) * (header->tick_count + 1));
+	rec->tick_capacity = header->tick_count + 1;
+
+	valid =
+		fread(rec->player_state, header->player_state_size, 1, pF) == 1 &&
+		fread(rec->ticks, sizeof(ReplayTick), header->tick_count, pF) == header->tick_count;
+
+	fclose(pF);
+
+	if(!valid) {
+		printf("ERROR: Replay %s is cut short\n", path);
+		ReplayFree(rec);
+		return false;
+	}
+
+	rec->tick_count = header->tick_count;
+	return true;
+}
+
+void ReplayFree(InputRecording *rec) {
+	if(rec->player_state) free(rec->player_state);
+	if(rec->ticks) free(rec->ticks);
+
+	*rec = (InputRecording) {0};
+}
+
+void ReplayApplyTick(ReplayTick *tick, InputHandler *input) {
+	input->mouse_delta = tick->mouse_delta;
+
+	for(u8 i = 0; i < INPUT_ACTION_COUNT; i++)
+		input->actions[i].state = (tick->action_states >> (i * 2)) & 0x03;
+}
+
+double ReplayNow() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int ReplayCompareTimes(const void *a, const void *b) {
+	double time_A = *(double*)a;
+	double time_B = *(double*)b;
+
+	return (time_A > time_B) - (time_A < time_B);
+}
+
+int ReplayRunHeadless(char *path, char *csv_path) {
+	InputRecording rec = {0};
+	if(!ReplayLoad(&rec, path))
+		return 1;
+
+	ReplayHeader *header = &rec.header;
+
+	// Collision only, BuildMapSect needs a window for models and textures
+	FilePathList bsp_files = LoadDirectoryFilesEx(header->map_path, ".bsp", false);
+	if(bsp_files.count == 0) {
+		printf("ERROR: No .bsp in %s\n", header->map_path);
+		UnloadDirectoryFiles(bsp_files);
+		ReplayFree(&rec);
+		return 1;
+	}
+
+	// Big structs, kept off the stack
+	static MapSection sect;
+	sect = (MapSection) {0};
+	sect.bsp_data = LoadBspCollision(bsp_files.paths[0]);
+	UnloadDirectoryFiles(bsp_files);
+
+	if(sect.bsp_data.num_models == 0) {
+		ReplayFree(&rec);
+		return 1;
+	}
+
+	for(short i = 0; i < 4; i++)
+		sect.bsp[i] = Bsp_BuildHull(&sect.bsp_data, i);
+
+	// Pool with just the player
+	static EntityHandler handler;
+	handler = (EntityHandler) {0};
+	EntGridInit(&handler);
+	EntReserve(&handler, ENT_START_CAPACITY);
+	handler.checkpoint_list.active = -1;
+	handler.grid.bsp = &sect.bsp_data;
+
+	handler.player_id = EntAlloc(&handler);
+	Entity *player = &handler.ents[handler.player_id];
+	player->type = ENT_PLAYER;
+	player->flags = (ENT_ACTIVE | ENT_COLLIDERS);
+	*player->comp_transform = header->start;
+	*player->comp_health = header->start_health;
+
+	EntBuildTypeLists(&handler);
+	EntGridRebuild(&handler);
+
+	Camera3D camera = (Camera3D) { .up = UP, .fovy = 90, .projection = CAMERA_PERSPECTIVE };
+	InputHandler input = (InputHandler) {0};
+	InputInit(&input);
+
+	static PlayerDebugData debug_data;
+	debug_data = (PlayerDebugData) {0};
+	PlayerInit(&camera, &input, &sect, &debug_data, &handler);
+	PlayerStateLoad(rec.player_state);
+
+	FILE *csv = NULL;
+	if(csv_path) {
+		csv = fopen(csv_path, "w");
+		if(csv)
+			fprintf(csv, "tick,us,x,y,z,vx,vy,vz,on_ground\n");
+		else
+			printf("ERROR: Could not open %s for writing\n", csv_path);
+	}
+
+	u32 tick_count = rec.tick_count;
+	double *times = malloc(sizeof(double) * (tick_count + 1));
+	double total = 0;
+
+	for(u32 i = 0; i < tick_count; i++) {
+		ReplayTick *tick = &rec.ticks[i];
+		ReplayApplyTick(tick, &input);
+
+		// Same as the player's part of a step in UpdateEntities
+		double start = ReplayNow();
+		PlayerUpdate(player, tick->dt);
+		UpdateGrid(&handler);
+		double end = ReplayNow();
+
+		InputConsume(&input);
+
+		times[i] = (end - start) * 1e6;
+		total += times[i];
+
+		if(csv) {
+			comp_Transform *ct = player->comp_transform;
+			fprintf(csv, "%u,%.3f,%f,%f,%f,%f,%f,%f,%d\n", i, times[i],
+				ct->position.x, ct->position.y, ct->position.z, ct->velocity.x, ct->velocity.y, ct->velocity.z, ct->on_ground);
+		}
+	}
+
+	if(csv)
+		fclose(csv);
+
+	Vector3 final_pos = player->comp_transform->position;
+	Vector3 expected_pos = header->end.position;
+	float error = Vector3Distance(final_pos, expected_pos);
+	bool match = (error <= REPLAY_MATCH_DIST);
+
+	printf("replay: %s, map: %s, %u ticks\n", path, header->map_path, tick_count);
+
+	if(tick_count) {
+		qsort(times, tick_count, sizeof(double), ReplayCompareTimes);
+
+		printf("tick us: min %.2f, avg %.2f, p50 %.2f, p99 %.2f, max %.2f, total %.2f ms\n",
+			times[0], total / tick_count, times[tick_count / 2], times[(u32)(tick_count * 0.99f)], times[tick_count - 1], total * 1e-3);
+	}
+
+	printf("final:    { %f, %f, %f }\n", final_pos.x, final_pos.y, final_pos.z);
+	printf("expected: { %f, %f, %f }\n", expected_pos.x, expected_pos.y, expected_pos.z);
+	printf("%s, off by %f\n", match ? "MATCH" : "MISMATCH", error);
+
+	free(times);
+	ReplayFree(&rec);
+
+	EntHandlerClose(&handler);
+	UnloadBsp(&sect.bsp_data);
+
+	return match ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+#include <stdbool.h>
+#include "../include/num_redefs.h"
+#include "input_handler.h"
+#include "ent.h"
+
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#define REPLAY_MAGIC	0x50524E49	// "INRP"
+#define REPLAY_VERSION	2
+
+#define REPLAY_SAVE_PATH "replay.rec"
+
+// Input read by one simulation step
+typedef struct {
+	Vector2 mouse_delta;
+	float dt;
+
+	// 2 bits per action, state of action i at bits (i * 2)
+	u32 action_states;
+
+} ReplayTick;
+
+// File is header, player state blob (PlayerStateSave) and ticks
+typedef struct {
+	u32 magic;
+	u32 version;
+
+	u32 tick_count;
+	u16 tick_size;
+	u16 player_state_size;
+	u16 health_size;
+
+	// Map directory, as passed to GameLoadTestScene1
+	char map_path[128];
+
+	// Player before the first tick and after the last one, end is the expected result of a replay
+	comp_Transform start;
+	comp_Transform end;
+
+	// Whole component, damage cooldown changes how hits land during the replay
+	comp_Health start_health;
+
+} ReplayHeader;
+
+// * NOTE:
+// Records input per simulation step, together with where the player started and ended up.
+// Replaying the ticks from the same start runs the same movement code with the same input,
+// so player movement can be timed and checked headless against the recorded result.
+// Start state is the player's transform and health components plus every player module global (PlayerState).
+// Only the player is simulated on replay, recordings that bump into other entities won't match
+typedef struct {
+	ReplayHeader header;
+	u8 *player_state;
+
+	ReplayTick *ticks;
+	u32 tick_count;
+	u32 tick_capacity;
+
+	bool recording;
+
+} InputRecording;
+
+void ReplayRecordBegin(InputRecording *rec, Entity *player, char *map_path);
+
+// Call once per simulation step, before the step reads input
+void ReplayRecordTick(InputRecording *rec, InputHandler *input, float dt);
+
+// Stop and write recording to path
+bool ReplayRecordEnd(InputRecording *rec, Entity *player, char *path);
+
+bool ReplayLoad(InputRecording *rec, char *path);
+void ReplayFree(InputRecording *rec);
+
+// Put recorded tick into input handler, same as what polling gave the step
+void ReplayApplyTick(ReplayTick *tick, InputHandler *input);
+
+// Load map collision without a window, replay a recording and print per tick timings and final position.
+// Optional csv_path gets one line per tick. Returns 0 if final position matches the recording
+int ReplayRunHeadless(char *path, char *csv_path);
+
+#endif
@@ -0,0 +1,369 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+
+u32 SnapshotSize(SnapshotHeader *head) {
+	return sizeof(SnapshotHeader) +
+		head->count * (head->ent_size + head->transform_size + head->ai_size + head->health_size + head->weapon_size + head->render_size) +
+		sizeof(u16) * (head->count + head->free_count + head->live_count) +
+		head->projectile_size * head->projectile_count +
+		head->player_state_size + head->bug_state_size;
+}
+
+void SnapshotPut(u8 **ptr, void *src, u32 size) {
+	memcpy(*ptr, src, size);
+	*ptr += size;
+}
+
+void SnapshotTake(u8 **ptr, void *dest, u32 size) {
+	memcpy(dest, *ptr, size);
+	*ptr += size;
+}
+
+void SnapshotCapture(WorldSnapshot *snapshot, EntityHandler *handler, u64 map_hash) {
+	SnapshotHeader head = {
+		.magic = SNAPSHOT_MAGIC,
+		.version = SNAPSHOT_VERSION,
+		.map_hash = map_hash,
+
+		.ent_size = sizeof(Entity),
+		.transform_size = sizeof(comp_Transform),
+		.ai_size = sizeof(comp_Ai),
+		.health_size = sizeof(comp_Health),
+		.weapon_size = sizeof(comp_Weapon),
+		.render_size = sizeof(comp_Render),
+		.projectile_size = sizeof(Projectile),
+		.player_state_size = PlayerStateSize(),
+		.bug_state_size = BugStateSize(),
+
+		.count = handler->count,
+		.free_count = handler->free_count,
+		.live_count = handler->live_count,
+		.projectile_count = handler->projectile_count,
+
+		.player_id = handler->player_id,
+		.bug_id = handler->bug_id,
+
+		.checkpoint_active = handler->checkpoint_list.active,
+
+		.player_start = handler->player_start,
+		.ai_tick = handler->ai_tick
+	};
+	head.size = SnapshotSize(&head);
+
+	if(head.size > snapshot->capacity) {
+		if(snapshot->capacity == 0)
+			snapshot->capacity = 4096;
+
+		while(snapshot->capacity < head.size)
+			snapshot->capacity = (snapshot->capacity << 1);
+
+		snapshot->data = realloc(snapshot->data, snapshot->capacity);
+	}
+
+	u16 count = handler->count;
+	u8 *ptr = snapshot->data;
+
+	SnapshotPut(&ptr, &head, sizeof(SnapshotHeader));
+
+	SnapshotPut(&ptr, handler->ents, sizeof(Entity) * count);
+	SnapshotPut(&ptr, handler->transforms, sizeof(comp_Transform) * count);
+	SnapshotPut(&ptr, handler->ais, sizeof(comp_Ai) * count);
+	SnapshotPut(&ptr, handler->healths, sizeof(comp_Health) * count);
+	SnapshotPut(&ptr, handler->weapons, sizeof(comp_Weapon) * count);
+	SnapshotPut(&ptr, handler->renders, sizeof(comp_Render) * count);
+
+	SnapshotPut(&ptr, handler->generations, sizeof(u16) * count);
+	SnapshotPut(&ptr, handler->free_ids, sizeof(u16) * handler->free_count);
+	SnapshotPut(&ptr, handler->live, sizeof(u16) * handler->live_count);
+
+	SnapshotPut(&ptr, handler->projectiles, sizeof(Projectile) * handler->projectile_count);
+
+	PlayerStateSave(ptr);
+	ptr += head.player_state_size;
+
+	BugStateSave(ptr);
+	ptr += head.bug_state_size;
+
+	snapshot->size = head.size;
+}
+
+bool SnapshotRestore(WorldSnapshot *snapshot, EntityHandler *handler) {
+	if(!SnapshotValid(snapshot))
+		return false;
+
+	SnapshotHeader head;
+	u8 *ptr = snapshot->data;
+	SnapshotTake(&ptr, &head, sizeof(SnapshotHeader));
+
+	u16 count = head.count;
+	EntReserve(handler, count);
+
+	// Live list is replaced below, any slot not in it is unused
+	for(u16 i = 0; i < handler->count; i++)
+		handler->live_index[i] = ENT_NOT_LIVE;
+
+	SnapshotTake(&ptr, handler->ents, sizeof(Entity) * count);
+	SnapshotTake(&ptr, handler->transforms, sizeof(comp_Transform) * count);
+	SnapshotTake(&ptr, handler->ais, sizeof(comp_Ai) * count);
+	SnapshotTake(&ptr, handler->healths, sizeof(comp_Health) * count);
+	SnapshotTake(&ptr, handler->weapons, sizeof(comp_Weapon) * count);
+
+	// Model data is shared with the base models, only transform and animation state come from the snapshot
+	for(u16 i = 0; i < count; i++) {
+		comp_Render *render = &handler->renders[i];
+
+		comp_Render stored;
+		SnapshotTake(&ptr, &stored, sizeof(comp_Render));
+
+		Model model = render->model;
+		ModelAnimation *animations = render->animations;
+
+		u8 type = handler->ents[i].type;
+		if(type < ENT_TYPE_COUNT && handler->base_ent_models[type].meshCount > 0)
+			model = handler->base_ent_models[type];
+
+		*render = stored;
+		render->model = model;
+		render->model.transform = stored.model.transform;
+		render->animations = animations;
+	}
+
+	SnapshotTake(&ptr, handler->generations, sizeof(u16) * count);
+	SnapshotTake(&ptr, handler->free_ids, sizeof(u16) * head.free_count);
+	SnapshotTake(&ptr, handler->live, sizeof(u16) * head.live_count);
+
+	handler->count = count;
+	handler->free_count = head.free_count;
+	handler->live_count = head.live_count;
+
+	// Stored pointers are from whenever the snapshot was taken
+	for(u16 i = 0; i < count; i++) {
+		Entity *ent = &handler->ents[i];
+		ent->comp_transform = &handler->transforms[i];
+		ent->comp_ai = &handler->ais[i];
+		ent->comp_health = &handler->healths[i];
+		ent->comp_weapon = &handler->weapons[i];
+		ent->comp_render = &handler->renders[i];
+	}
+
+	for(u16 n = 0; n < handler->live_count; n++)
+		handler->live_index[handler->live[n]] = n;
+
+	if(head.projectile_count > handler->projectile_capacity) {
+		while(handler->projectile_capacity < head.projectile_count)
+			handler->projectile_capacity = (handler->projectile_capacity << 1);
+
+		handler->projectiles = realloc(handler->projectiles, sizeof(Projectile) * handler->projectile_capacity);
+	}
+
+	SnapshotTake(&ptr, handler->projectiles, sizeof(Projectile) * head.projectile_count);
+	handler->projectile_count = head.projectile_count;
+
+	PlayerStateLoad(ptr);
+	ptr += head.player_state_size;
+
+	BugStateLoad(ptr);
+	ptr += head.bug_state_size;
+
+	handler->player_id = head.player_id;
+	handler->bug_id = head.bug_id;
+	handler->checkpoint_list.active = head.checkpoint_active;
+	handler->player_start = head.player_start;
+	handler->ai_tick = head.ai_tick;
+
+	handler->type_lists_dirty = true;
+	EntGridRebuild(handler);
+
+	// Requests in the queue belong to the world being replaced
+	AiDropPaths(handler);
+
+	// Don't blend from where things were before the restore
+	for(u16 n = 0; n < handler->live_count; n++) {
+		u16 i = handler->live[n];
+		handler->transforms[i].prev_pos = handler->transforms[i].position;
+	}
+
+	return true;
+}
+
+bool SnapshotValid(WorldSnapshot *snapshot) {
+	if(!snapshot->data || snapshot->size < sizeof(SnapshotHeader))
+		return false;
+
+	SnapshotHeader head;
+	memcpy(&head, snapshot->data, sizeof(SnapshotHeader));
+
+	return
+		head.magic == SNAPSHOT_MAGIC &&
+		head.version == SNAPSHOT_VERSION &&
+		head.ent_size == sizeof(Entity) &&
+		head.transform_size == sizeof(comp_Transform) &&
+		head.ai_size == sizeof(comp_Ai) &&
+		head.health_size == sizeof(comp_Health) &&
+		head.weapon_size == sizeof(comp_Weapon) &&
+		head.render_size == sizeof(comp_Render) &&
+		head.projectile_size == sizeof(Projectile) &&
+		head.player_state_size == PlayerStateSize() &&
+		head.bug_state_size == BugStateSize() &&
+		head.count <= ENT_MAX_COUNT &&
+		head.free_count <= head.count &&
+		head.live_count <= head.count &&
+		head.size == snapshot->size &&
+		head.size == SnapshotSize(&head);
+}
+
+void SnapshotFree(WorldSnapshot *snapshot) {
+	if(snapshot->data)
+		free(snapshot->data);
+
+	*snapshot = (WorldSnapshot) {0};
+}
+
+bool SnapshotWriteFile(WorldSnapshot *snapshot, char *path) {
+	// Runs on the writer thread, so no TextFormat here
+	char temp_path[264];
+	snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+	FILE *pF = fopen(temp_path, "wb");
+	if(!pF) {
+		printf("ERROR: Could not open %s for writing\n", temp_path);
+		return false;
+	}
+
+	bool written = (fwrite(snapshot->data, 1, snapshot->size, pF) == snapshot->size);
+	written = (fclose(pF) == 0) && written;
+
+	if(!written || rename(temp_path, path) != 0) {
+		printf("ERROR: Could not write snapshot to %s\n", path);
+		remove(temp_path);
+		return false;
+	}
+
+	return true;
+}
+
+bool SnapshotReadFile(WorldSnapshot *snapshot, char *path, u64 map_hash) {
+	FILE *pF = fopen(path, "rb");
+	if(!pF)
+		return false;
+
+	fseek(pF, 0, SEEK_END);
+	long size = ftell(pF);
+	fseek(pF, 0, SEEK_SET);
+
+	if(size < (long)sizeof(SnapshotHeader)) {
+		printf("ERROR: Snapshot %s is too small\n", path);
+		fclose(pF);
+		return false;
+	}
+
+	if((u32)size > snapshot->capacity) {
+		snapshot->capacity = size;
+		snapshot->data = realloc(snapshot->data, snapshot->capacity);
+	}
+
+	snapshot->size = fread(snapshot->data, 1, size, pF);
+	fclose(pF);
+
+	if(!SnapshotValid(snapshot)) {
+		printf("ERROR: Snapshot %s is damaged or from another version (expected version %d)\n", path, SNAPSHOT_VERSION);
+		snapshot->size = 0;
+		return false;
+	}
+
+	SnapshotHeader head;
+	memcpy(&head, snapshot->data, sizeof(SnapshotHeader));
+
+	if(head.map_hash != map_hash) {
+		printf("ERROR: Snapshot %s was saved in another map\n", path);
+		snapshot->size = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void *SnapshotWriterRun(void *arg) {
+	SnapshotWriter *writer = arg;
+
+	pthread_mutex_lock(&writer->lock);
+	for(;;) {
+		while(!writer->has_queued && !writer->quit)
+			pthread_cond_wait(&writer->wake, &writer->lock);
+
+		// Queued write is still finished when closing
+		if(!writer->has_queued)
+			break;
+
+		WorldSnapshot temp = writer->writing;
+		writer->writing = writer->queued;
+		writer->queued = temp;
+		writer->has_queued = false;
+		pthread_mutex_unlock(&writer->lock);
+
+		SnapshotWriteFile(&writer->writing, writer->path);
+
+		pthread_mutex_lock(&writer->lock);
+	}
+	pthread_mutex_unlock(&writer->lock);
+
+	return NULL;
+}
+
+void SnapshotWriterInit(SnapshotWriter *writer, char *path) {
+	*writer = (SnapshotWriter) {0};
+	strncpy(writer->path, path, sizeof(writer->path) - 1);
+
+	pthread_mutex_init(&writer->lock, NULL);
+	pthread_cond_init(&writer->wake, NULL);
+
+	if(pthread_create(&writer->thread, NULL, SnapshotWriterRun, writer) != 0) {
+		printf("ERROR: Could not start snapshot writer, snapshots will be written on the calling thread\n");
+		return;
+	}
+
+	writer->running = true;
+}
+
+void SnapshotWriterClose(SnapshotWriter *writer) {
+	if(writer->running) {
+		pthread_mutex_lock(&writer->lock);
+		writer->quit = true;
+		pthread_cond_signal(&writer->wake);
+		pthread_mutex_unlock(&writer->lock);
+
+		pthread_join(writer->thread, NULL);
+		writer->running = false;
+	}
+
+	pthread_mutex_destroy(&writer->lock);
+	pthread_cond_destroy(&writer->wake);
+
+	SnapshotFree(&writer->queued);
+	SnapshotFree(&writer->writing);
+}
+
+void SnapshotWriteAsync(SnapshotWriter *writer, WorldSnapshot *snapshot) {
+	if(!writer->running) {
+		SnapshotWriteFile(snapshot, writer->path);
+		return;
+	}
+
+	pthread_mutex_lock(&writer->lock);
+
+	WorldSnapshot *queued = &writer->queued;
+	if(snapshot->size > queued->capacity) {
+		queued->capacity = snapshot->capacity;
+		queued->data = realloc(queued->data, queued->capacity);
+	}
+
+	memcpy(queued->data, snapshot->data, snapshot->size);
+	queued->size = snapshot->size;
+
+	writer->has_queued = true;
+	pthread_cond_signal(&writer->wake);
+
+	pthread_mutex_unlock(&writer->lock);
+}
@@ -0,0 +1,105 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include "../include/num_redefs.h"
+#include "ent.h"
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#define SNAPSHOT_MAGIC		0x50414E53	// "SNAP"
+#define SNAPSHOT_VERSION	2
+
+#define SNAPSHOT_SAVE_PATH	"save.snap"
+
+// Struct sizes are stored too, a layout change that forgot to bump the version is still caught
+typedef struct {
+	u32 magic;
+	u32 version;
+	u32 size;		// Whole snapshot, header included
+
+	u64 map_hash;	// Cache hash of the map section it was taken in
+
+	u16 ent_size;
+	u16 transform_size;
+	u16 ai_size;
+	u16 health_size;
+	u16 weapon_size;
+	u16 render_size;
+	u16 projectile_size;
+	u16 player_state_size;
+	u16 bug_state_size;
+
+	u16 count;
+	u16 free_count;
+	u16 live_count;
+	u16 projectile_count;
+
+	u16 player_id;
+	u16 bug_id;
+
+	i16 checkpoint_active;
+
+	Vector3 player_start;
+	float ai_tick;
+
+} SnapshotHeader;
+
+// * NOTE:
+// Mutable simulation state packed into one buffer: header, then entity slots [0, count) of every
+// component array, generations, free and live lists, live projectiles and module globals from player and bug.
+// Everything is plain data copied as is, so capture and restore are a handful of memcpys.
+// Entity structs are stored with their component pointers, those get rebound on restore.
+// Render components are stored for their transform and animation state, model data is rebound
+// to the type's base model (or whatever the slot already holds for types without one, player and bug).
+// Snapshots only restore into the map they were taken in, files are checked against the map hash.
+// Path searches in flight are dropped on restore and asked for again
+typedef struct {
+	u8 *data;
+	u32 size;
+	u32 capacity;
+
+} WorldSnapshot;
+
+void SnapshotCapture(WorldSnapshot *snapshot, EntityHandler *handler, u64 map_hash);
+
+// Returns false if snapshot is empty or from another version, world is left untouched then
+bool SnapshotRestore(WorldSnapshot *snapshot, EntityHandler *handler);
+
+bool SnapshotValid(WorldSnapshot *snapshot);
+
+void SnapshotFree(WorldSnapshot *snapshot);
+
+// Written to a temporary file first and renamed over path, so an interrupted write keeps the old file
+bool SnapshotWriteFile(WorldSnapshot *snapshot, char *path);
+
+// Fails on a missing file and on snapshots of another version or map
+bool SnapshotReadFile(WorldSnapshot *snapshot, char *path, u64 map_hash);
+
+// * NOTE:
+// Thread writing snapshots to disk so saving never waits on the file system.
+// Queued snapshot is copied, the caller can keep using its own right away.
+// Only the latest queued snapshot is written, older ones still waiting are replaced
+typedef struct {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+
+	WorldSnapshot queued;
+	WorldSnapshot writing;
+
+	char path[256];
+
+	bool has_queued;
+	bool running;
+	bool quit;
+
+} SnapshotWriter;
+
+void SnapshotWriterInit(SnapshotWriter *writer, char *path);
+
+// Finishes queued write before returning
+void SnapshotWriterClose(SnapshotWriter *writer);
+
+void SnapshotWriteAsync(SnapshotWriter *writer, WorldSnapshot *snapshot);
+
+#endif